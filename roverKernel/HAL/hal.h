@@ -24,6 +24,12 @@
     #include "tm4c1294/hal_ts_tm4c.h"
     #include "tm4c1294/hal_eng_tm4c.h"
 
+#elif defined(__BOARD_HOST__)
+
+    #include "host/hal_common_host.h"
+    #include "host/hal_ts_host.h"
+    #include "host/hal_esp_host.h"
+
 #elif __BOARD_ATMEGA328P__
 //TODO: Arduino support
     #include "atmega328p_hal.h"
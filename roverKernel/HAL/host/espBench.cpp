@@ -0,0 +1,1151 @@
+/**
+ * espBench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host (PC) benchmark of ESP8266 library talking to emulated ESP (see
+ *  hal_esp_emu.h). Frames carrying sequence number and time they were handed
+ *  to the library are sent through DataStream to a local server; server
+ *  measures latency from handing the frame to the library to its arrival
+ *  through the bridged socket. Reports throughput (frames per second, KB/s),
+ *  latency distribution and metrics of the library and the emulator.
+ *  In windowed mode frames are sent as DataStream frames with reliable delivery
+ *  (DataStream::SetWindow()) to a server standing in for the real one, which
+ *  acknowledges them (optionally after a delay) and loses a given share of
+ *  frames and ACKs on purpose. Latency is then measured to the in-order arrival.
+ *  Check modes don't measure throughput, they drive the library through the
+ *  emulator and public API only and report whether it behaved as expected
+ *  (exit code 0 if it did).
+ *  Replay mode measures parsing alone: trace of ESP replies is fed through
+ *  ATParser the way ESP8266 library feeds it, or (with -o) through the former
+ *  path, which buffered each message and scanned it with strstr().
+ *
+ *  Build (from repository root):
+ *  g++ -O2 -Wall -Wextra -D__BOARD_HOST__ -D__ESP_BENCH__ -IroverKernel -I.
+ *      -o espBench
+ *      roverKernel/HAL/host/espBench.cpp roverKernel/HAL/host/\*.c
+ *      roverKernel/esp8266/\*.cpp roverKernel/network/\*.cpp
+ *      roverKernel/taskScheduler/\*.cpp roverKernel/libs/bufferPool.cpp
+ *      roverKernel/libs/strBuilder.cpp roverKernel/libs/myLib.c
+ *      roverKernel/init/eventLog.cpp -lpthread -lm
+ *
+ *  Usage: espBench [-n frames] [-s frameSize] [-r framesPerSec] [-m mode]
+ *                  [-t] [-k sendOkUs] [-b] [-w window] [-l lossPct] [-d ackMs]
+ *                  [-o] [-f traceFile]
+ *  mode: send (DataStream::Send, default), write (DataStream::Write, frames
+ *  coalesced), udp (datagram stream), pt (passthrough mode), large (all frames
+ *  sent at once by DataStream::SendLarge), win (windowed reliable frames)
+ *  check modes: slot (200 injected close/open cycles of a socket: no heap
+ *  allocations for clients, stale handle detected, stream rebinds and sends),
+ *  cmd (itoa() against snprintf(), StrBuilder bounds, over-long command
+ *  rejected, time to build CIPSTART/CIPSEND against the former strcat path),
+ *  met (link metrics: send round trips binned by emulated SEND OK latency,
+ *  busy reply, watchdog timeout, socket churn, RSSI sampled through kernel
+ *  service and reset on WIFI DISCONNECT), rxq (queue of received messages:
+ *  bursts kept in order, drop-oldest and drop-newest policies, hook bursts in
+ *  order, queue released when socket closes or CIPCLOSE fails)
+ *  replay mode: replay (parse trace of ESP replies -n times, report ns/byte)
+ *  -w: frames in flight in win mode (1 waits for ACK of every frame)
+ *  -l: percent of frames and ACKs the server loses in win mode
+ *  -d: delay of ACKs sent by the server in win mode
+ *  -t: talk to emulator over pseudo-terminal instead of in-process
+ *  -b: emulated firmware doesn't support buffered send (AT+CIPSENDBUF)
+ *  -r 0 (default) sends as fast as the library accepts frames
+ *  -o: replay through the former strstr() parser instead of ATParser
+ *  -f: replay raw ESP output captured in a file instead of built-in trace
+ */
+#if defined(__BOARD_HOST__) && defined(__ESP_BENCH__)
+
+#include "HAL/hal.h"
+#include "HAL/host/hal_esp_emu.h"
+#include "esp8266/esp8266.h"
+#include "libs/myLib.h"
+#include "libs/strBuilder.h"
+#include "network/dataStream.h"
+#include "taskScheduler/taskScheduler.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+//  Frame header: sequence number and time the frame was handed to the library
+struct _benchHdr
+{
+    uint32_t    seq;
+    uint64_t    sentNs;
+} __attribute__((packed));
+
+/// Benchmark parameters
+static uint32_t _frames = 1000;
+static uint16_t _frameSize = 64;
+static uint32_t _rate = 0;
+static char _mode[8] = "send";
+static bool _udp = false;
+static bool _win = false;
+static uint8_t _window = 8;
+static uint32_t _loss = 0;
+static uint32_t _ackMs = 0;
+static bool _oldParser = false;
+static const char *_traceFile = 0;
+
+/// Results collected by server thread
+static std::vector<uint64_t> _lat;
+static volatile uint32_t _rxFrames = 0;
+static volatile uint64_t _rxLastNs = 0;
+static pthread_mutex_t _latLock = PTHREAD_MUTEX_INITIALIZER;
+
+/// Heap allocations made by the calling thread (server threads count their own)
+static thread_local uint32_t _allocs = 0;
+
+void* operator new(size_t size)
+{
+    void *ptr = malloc((size > 0) ? size : 1);
+
+    if (ptr == 0)
+        throw std::bad_alloc();
+    _allocs++;
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+    (void)size;
+    free(ptr);
+}
+
+static uint64_t _Now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * Record arrival of a frame
+ */
+static void _Arrived(const uint8_t *frame)
+{
+    struct _benchHdr hdr;
+    uint64_t now = _Now();
+
+    memcpy(&hdr, frame, sizeof(hdr));
+    pthread_mutex_lock(&_latLock);
+    _lat.push_back(now - hdr.sentNs);
+    _rxFrames++;
+    _rxLastNs = now;
+    pthread_mutex_unlock(&_latLock);
+}
+
+/**
+ * Server receiving frames: TCP stream is split into frames of fixed size, UDP
+ * datagram carries one frame (or more, if written together)
+ */
+static void* _Server(void *arg)
+{
+    int fd = (int)(long)arg;
+    static uint8_t buf[8192];
+    uint32_t have = 0, i;
+    ssize_t n;
+
+    if (!_udp)
+        fd = accept(fd, 0, 0);
+
+    while (1)
+    {
+        n = recv(fd, buf + have, sizeof(buf) - have, 0);
+        if (n <= 0)
+            break;
+        have += n;
+        for (i = 0; (i + _frameSize) <= have; i += _frameSize)
+            _Arrived(buf + i);
+        if (_udp)
+            have = 0;
+        else
+        {
+            memmove(buf, buf + i, have - i);
+            have -= i;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Server of windowed mode: takes frames in order and acknowledges them
+ * cumulatively, losing [_loss] percent of frames and ACKs. ACK goes out
+ * [_ackMs] after the first frame it acknowledges.
+ */
+static void* _WinServer(void *arg)
+{
+    int fd = accept((int)(long)arg, 0, 0);
+    static uint8_t decBuf[4096], buf[2048];
+    DataFrame dec(decBuf, sizeof(decBuf));
+    struct timeval tv = { 0, 1000 };
+    uint8_t ack[DATAF_HDR_LEN(0) + DATAF_CRC_LEN];
+    uint8_t next = 0;
+    bool pend = false;
+    uint64_t due = 0;
+    ssize_t n;
+    uint16_t off, k;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (1)
+    {
+        n = recv(fd, buf, sizeof(buf), 0);
+        if (n == 0)
+            break;
+        for (off = 0; (n > 0) && (off < n); off += k)
+        {
+            k = dec.Feed(buf + off, n - off);
+            if (!dec.Ready())
+                continue;
+            struct _dataFrame frm = dec.Frame();
+            if ((uint32_t)(rand() % 100) < _loss)
+                continue;
+            if (frm.seq == next)
+            {
+                _Arrived(frm.data);
+                next++;
+            }
+            if (!pend)
+                due = _Now() + (uint64_t)_ackMs * 1000000ULL;
+            pend = true;
+        }
+        if (pend && (_Now() >= due))
+        {
+            pend = false;
+            if ((uint32_t)(rand() % 100) < _loss)
+                continue;
+            DataFrame::Encode(ack, sizeof(ack), DATAS_ACK, next, 0, 0);
+            send(fd, ack, sizeof(ack), 0);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Run task scheduler until condition is met or timeout (ms) expires
+ */
+template<typename F>
+static bool _Pump(F cond, uint32_t ms)
+{
+    uint64_t end = _Now() + (uint64_t)ms * 1000000ULL;
+
+    while (!cond())
+    {
+        if (_Now() > end)
+            return false;
+        TS_GlobalCheck();
+    }
+    return true;
+}
+
+static void _Hist(const char *name, const uint32_t *hist)
+{
+    printf("%s", name);
+    for (uint8_t i = 0; i < ESP_HIST_BINS; i++)
+        printf("%s%u", (i > 0) ? "," : "", hist[i]);
+    printf("\n");
+}
+
+/**
+ * Report outcome of one expectation of a check mode
+ * @return 1 if expectation failed, 0 otherwise
+ */
+static uint32_t _Expect(const char *what, bool ok)
+{
+    printf("  %-48s %s\n", what, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * Slot check: ESP reports socket 0 closed and connected again (as after a
+ * dropped and re-established connection) 200 times. Client slots are reused
+ * in place, so the cycles must not allocate clients on heap. Only the task
+ * scheduler may allocate: parsing of every received message is deferred to it
+ * as a task, whose cost is measured first with lines the parser ignores.
+ * Handle taken before the cycles must be detected as stale, and the stream must
+ * rebind and send.
+ * @return number of failed expectations
+ */
+static uint32_t _CheckSlot(ESP8266 &esp, DataStream &ds)
+{
+    const uint32_t cycles = 200;
+    _espClient *cli = esp.GetClientBySockID(0);
+    uint8_t gen = cli->Generation();
+    uint32_t fails = 0, allocs, perMsg, i;
+    uint64_t start;
+    bool ok = true;
+
+    fails += _Expect("open socket reports valid generation", cli->Valid(gen));
+    //  Cost of scheduling parser for one message
+    allocs = _allocs;
+    for (i = 0; i < 20; i++)
+    {
+        HAL_ESP_EmuLine("bench");
+        _Pump([&]{ return false; }, 5);
+    }
+    perMsg = (_allocs - allocs + 19) / 20;
+
+    allocs = _allocs;
+    start = _Now();
+    for (i = 0; ok && (i < cycles); i++)
+    {
+        HAL_ESP_EmuLine("0,CLOSED");
+        ok = _Pump([&]{ return !esp.ValidSocket(0); }, 1000);
+        HAL_ESP_EmuLine("0,CONNECT");
+        ok = ok && _Pump([&]{ return esp.ValidSocket(0); }, 1000);
+    }
+    allocs = _allocs - allocs;
+    printf("slot: %u close/open cycles, %u heap allocations (%.1f per cycle, "
+           "%u per parsed message), %.1f us per cycle\n", i, allocs,
+           (double)allocs / cycles, perMsg, (_Now() - start) / 1e3 / cycles);
+
+    fails += _Expect("every close and open reported", ok);
+    fails += _Expect("no allocations besides scheduling the parser",
+                     allocs <= (2 * perMsg * cycles));
+    fails += _Expect("old handle stale after reopen", !cli->Valid(gen));
+    fails += _Expect("socket reopened in the same slot",
+                     esp.GetClientBySockID(0) == cli);
+    fails += _Expect("generation advanced", cli->Generation() != gen);
+
+    struct _espEmuStats e = HAL_ESP_EmuStats();
+    fails += _Expect("stream sends after reopen",
+                     ds.Send((uint8_t*)"slot", 4) == STATUS_OK);
+    _Pump([&]{ return esp.CmdIdle(); }, 1000);
+    fails += _Expect("data reached the network",
+                     HAL_ESP_EmuStats().bytesToNet >= (e.bytesToNet + 4));
+
+    return fails;
+}
+
+/**
+ * Former itoa(): counts digits with powf() and leaves string unterminated
+ */
+static void _OldItoa(int32_t num, uint8_t *str)
+{
+    uint8_t it = 0, digits = 1;
+
+    if (num < 0)
+    {
+        str[it++] = '-';
+        num = labs(num);
+    }
+    while ((num / ((int32_t)powf(10.0f, (float)digits))) > 0)
+        digits++;
+    it += digits - 1;
+    while ((digits--) > 0)
+    {
+        str[it--] = (uint8_t)(48 + num % 10);
+        num /= 10;
+    }
+}
+
+/**
+ * Command check: itoa() must match snprintf() on edge values and StrBuilder
+ * must stay within its buffer, flag overflow and keep it. Command that
+ * doesn't fit in command buffer must be rejected before anything is sent.
+ * Also times assembly of CIPSTART and CIPSEND the way ESP8266 library does
+ * now, against the former memset of 2 KB buffer followed by strcat() calls.
+ * @return number of failed expectations
+ */
+static uint32_t _CheckCmd(ESP8266 &esp)
+{
+    const int32_t values[] = { 0, 7, 10, 99, 100, 65535, -1, INT32_MIN,
+                               INT32_MAX, 1000000 };
+    const uint32_t n = 1000000;
+    const char *ip = "192.168.1.100";
+    static char big[2048];
+    char small[ESP_CMD_LEN], a[16], b[16];
+    volatile uint32_t sink = 0;
+    uint32_t fails = 0, bad = 0, i;
+    uint64_t t[5];
+
+    for (int32_t v : values)
+    {
+        uint8_t len = itoa(v, (uint8_t*)a);
+
+        snprintf(b, sizeof(b), "%ld", (long)v);
+        if ((strcmp(a, b) != 0) || (len != strlen(b)))
+        {
+            printf("  itoa(%s) gave \"%s\" (%u)\n", b, a, len);
+            bad++;
+        }
+    }
+    fails += _Expect("itoa() matches snprintf() on edge values", bad == 0);
+
+    char tiny[8];
+    StrBuilder sb(tiny, sizeof(tiny));
+
+    sb.Add("AT+");
+    sb.AddNum(123456);
+    fails += _Expect("number not fitting is cut at buffer end",
+                     sb.Overflow() && (sb.Len() == 7) &&
+                     (strcmp(tiny, "AT+1234") == 0));
+    sb.Reset();
+    fails += _Expect("string filling buffer exactly fits",
+                     sb.Add("1234567") && !sb.Overflow());
+    fails += _Expect("overflow is sticky and string terminated",
+                     !sb.Add('x') && !sb.Add("") && sb.Overflow() &&
+                     (strcmp(tiny, "1234567") == 0));
+
+    std::vector<char> longName(ESP_CMD_LEN, 'a');
+    uint32_t cmds = HAL_ESP_EmuStats().commands;
+
+    longName.back() = 0;
+    fails += _Expect("over-long AP credentials rejected",
+                     esp.ConnectAP(longName.data(), (char*)"bench", true) ==
+                     ESP_STATUS_ERROR);
+    _Pump([&]{ return false; }, 20);
+    fails += _Expect("nothing sent for rejected command",
+                     esp.CmdIdle() && (HAL_ESP_EmuStats().commands == cmds));
+
+    t[0] = _Now();
+    for (i = 0; i < n; i++)
+    {
+        uint8_t s[6] = { 0 };
+
+        memset(big, 0, sizeof(big));
+        strcat(big, "AT+CIPSTART=");
+        _OldItoa(i % 5, s);
+        strcat(big, (char*)s);
+        strcat(big, ",\"TCP\",\"");
+        strcat(big, ip);
+        strcat(big, "\",");
+        memset(s, 0, sizeof(s));
+        _OldItoa(2000 + (i & 1023), s);
+        strcat(big, (char*)s);
+        strcat(big, ",7200");
+        sink += big[20];
+    }
+    t[1] = _Now();
+    for (i = 0; i < n; i++)
+    {
+        StrBuilder cmd(small, sizeof(small));
+
+        cmd.Add("AT+CIPSTART=");
+        cmd.AddNum(i % 5);
+        cmd.Add(",\"TCP\",\"");
+        cmd.Add(ip);
+        cmd.Add("\",");
+        cmd.AddNum(2000 + (i & 1023));
+        cmd.Add(",7200");
+        sink += small[20];
+    }
+    t[2] = _Now();
+    for (i = 0; i < n; i++)
+    {
+        uint8_t s[6] = { 0 };
+
+        memset(big, 0, sizeof(big));
+        strcat(big, "AT+CIPSEND=");
+        _OldItoa(i % 5, s);
+        strcat(big, (char*)s);
+        strcat(big, ",");
+        memset(s, 0, sizeof(s));
+        _OldItoa(1 + (i & 2047), s);
+        strcat(big, (char*)s);
+        sink += big[12];
+    }
+    t[3] = _Now();
+    for (i = 0; i < n; i++)
+    {
+        StrBuilder cmd(small, sizeof(small));
+
+        cmd.Add("AT+CIPSEND=");
+        cmd.AddNum(i % 5);
+        cmd.Add(',');
+        cmd.AddNum(1 + (i & 2047));
+        sink += small[12];
+    }
+    t[4] = _Now();
+    printf("cmd: CIPSTART strcat %.1f ns, StrBuilder %.1f ns\n"
+           "cmd: CIPSEND  strcat %.1f ns, StrBuilder %.1f ns\n",
+           (double)(t[1] - t[0]) / n, (double)(t[2] - t[1]) / n,
+           (double)(t[3] - t[2]) / n, (double)(t[4] - t[3]) / n);
+
+    return fails;
+}
+
+/**
+ * Metrics check: sends with SEND OK delayed by 2, 15 and 70 ms must land in
+ * histogram bin of their delay or the next one (round trip also includes
+ * prompt and transfer). Busy reply, command left without reply, reported
+ * socket closes and opens must be counted. AP is joined again under SSID
+ * containing comma (emulator reports it back in +CWJAP), RSSI sampled through
+ * ESP_T_RSSI kernel service must match the emulated one and must be cleared
+ * on WIFI DISCONNECT.
+ * @return number of failed expectations
+ */
+static uint32_t _CheckMet(ESP8266 &esp, DataStream &ds, int8_t rssi)
+{
+    const uint32_t delayMs[] = { 2, 15, 70 };
+    const uint32_t count[] = { 20, 30, 10 };
+    std::vector<uint8_t> frame(_frameSize, 'x');
+    struct _espStats s, prev;
+    uint32_t fails = 0, sends = 0, i, j;
+
+    for (i = 0; i < 3; i++)
+    {
+        uint8_t bin = 0;
+
+        HAL_ESP_EmuSendOk(delayMs[i] * 1000);
+        prev = esp.Stats();
+        for (j = 0; j < count[i]; j++)
+        {
+            sends += (ds.Send(frame.data(), _frameSize) == STATUS_OK);
+            _Pump([&]{ return esp.CmdIdle(); }, 1000);
+        }
+        s = esp.Stats();
+        while ((delayMs[i] >> (bin + 1)) > 0)
+            bin++;
+        printf("met: SEND OK after %u ms: %u in bin %u, %u in bin %u\n",
+               delayMs[i], s.sendRTT[bin] - prev.sendRTT[bin], bin,
+               s.sendRTT[bin + 1] - prev.sendRTT[bin + 1], bin + 1);
+        fails += _Expect("round trips binned by SEND OK latency",
+                         (s.sendRTT[bin] - prev.sendRTT[bin] +
+                          s.sendRTT[bin + 1] - prev.sendRTT[bin + 1]) ==
+                         count[i]);
+    }
+    fails += _Expect("all sends confirmed",
+                     (sends == 60) && (s.sends == 60) && (s.sendFails == 0));
+
+    //  Emulated module drops command it answers busy to, so it also times out
+    prev = esp.Stats();
+    HAL_ESP_EmuBusy(1);
+    esp.SendAsync("AT\0");
+    _Pump([&]{ return esp.CmdIdle(); }, 1000);
+    s = esp.Stats();
+    fails += _Expect("busy reply counted", (s.busy - prev.busy) == 1);
+
+    prev = esp.Stats();
+    HAL_ESP_EmuDrop(1);
+    esp.SendAsync("AT\0", 0, 0, 0, 100);
+    _Pump([&]{ return esp.CmdIdle(); }, 1000);
+    s = esp.Stats();
+    fails += _Expect("watchdog timeout counted",
+                     (s.wdTimeouts - prev.wdTimeouts) == 1);
+
+    prev = esp.Stats();
+    for (i = 0; i < 5; i++)
+    {
+        HAL_ESP_EmuLine("0,CLOSED");
+        _Pump([&]{ return !esp.ValidSocket(0); }, 1000);
+        HAL_ESP_EmuLine("0,CONNECT");
+        _Pump([&]{ return esp.ValidSocket(0); }, 1000);
+    }
+    s = esp.Stats();
+    fails += _Expect("socket closes and opens counted",
+                     ((s.sockCloses - prev.sockCloses) == 5) &&
+                     ((s.sockOpens - prev.sockOpens) == 5));
+
+    esp.ConnectAP((char*)"my,ssid", (char*)"bench", true);
+    _Pump([&]{ return esp.IsConnected() && esp.CmdIdle(); }, 5000);
+    prev = esp.Stats();
+    TaskScheduler::GetI().SyncTask(ESP_UID, ESP_T_RSSI, T_ASAP);
+    TaskScheduler::GetI().AddArgs((void*)"", 1);
+    _Pump([&]{ return (esp.Stats().rssiSamples > prev.rssiSamples) &&
+                      esp.CmdIdle(); }, 1000);
+    s = esp.Stats();
+    printf("met: rssi=%d dBm after %u samples\n", s.rssi, s.rssiSamples);
+    fails += _Expect("RSSI sampled through kernel service",
+                     s.rssi == rssi);
+    HAL_ESP_EmuLine("WIFI DISCONNECT");
+    _Pump([&]{ return esp.Stats().rssi == 0; }, 100);
+    fails += _Expect("RSSI cleared on WIFI DISCONNECT", esp.Stats().rssi == 0);
+
+    s = esp.Stats();
+    printf("met: in=%u out=%u sends=%u fails=%u rttMax=%ums busy=%u "
+           "busyRetries=%u wd=%u opens=%u closes=%u\n", s.bytesIn,
+           s.bytesOut, s.sends, s.sendFails, s.sendRTTMaxMs, s.busy,
+           s.busyRetries, s.wdTimeouts, s.sockOpens, s.sockCloses);
+    _Hist("met: sendRTT ms bins ", s.sendRTT);
+    printf("met: parseRuns=%u parseMax=%uus\n", s.parseRuns, s.parseMaxUs);
+    _Hist("met: parseTime us bins ", s.parseTime);
+
+    return fails;
+}
+
+/// Messages handed to user hook by rxq check
+static std::string _hooked;
+
+static void _RxqHook(const uint8_t id, const uint8_t *data, const uint16_t len)
+{
+    _hooked += std::to_string(id) + ":" + std::string((const char*)data, len) +
+               "|";
+}
+
+/**
+ * Inject [n] messages named [prefix]1..[prefix]n received on link [id] back to
+ * back, and let them reach the library before it parses any of them
+ */
+static void _RxqBurst(uint8_t id, const char *prefix, uint8_t n)
+{
+    for (uint8_t i = 1; i <= n; i++)
+    {
+        std::string msg = prefix + std::to_string(i);
+
+        HAL_ESP_EmuIPD(id, (const uint8_t*)msg.data(), msg.size());
+    }
+    usleep(20000);
+}
+
+/**
+ * Take all queued messages from a stream, joined with '|'
+ */
+static std::string _RxqDrain(DataStream &ds)
+{
+    static uint8_t buf[2048];
+    std::string retVal;
+    uint16_t len;
+
+    _Pump([&]{ return false; }, 10);
+    while (ds.Receive(buf, &len))
+        retVal += std::string((char*)buf, len) + "|";
+
+    return retVal;
+}
+
+/**
+ * Received queue check: a burst of 3 messages must be kept in order. Bursts of
+ * 6 must keep the last 4 with drop-oldest policy and the first 4 with
+ * drop-newest, counting 2 drops each. Burst handed to user hook must arrive in
+ * order. Closing a socket with messages (one of them pooled) queued must
+ * release them, both when ESP reports CLOSED and when CIPCLOSE fails.
+ * @return number of failed expectations
+ */
+static uint32_t _CheckRxq(ESP8266 &esp, DataStream &a, uint16_t port)
+{
+    DataStream b((uint8_t*)"127.0.0.1", port);
+    std::string big(600, 'z'), got;
+    uint8_t pool = BufferPool::GetI().FreeCount();
+    uint32_t fails = 0;
+
+    b.BindToSocketID(1);
+    if (!_Pump([&]{ return esp.ValidSocket(1) && esp.CmdIdle(); }, 5000))
+        return _Expect("second socket opened", false);
+
+    _RxqBurst(0, "m", 3);
+    got = _RxqDrain(a);
+    printf("rxq: burst of 3: %s dropped %u\n", got.c_str(), a.RxDropped());
+    fails += _Expect("burst of 3 kept in order",
+                     (got == "m1|m2|m3|") && (a.RxDropped() == 0));
+
+    _RxqBurst(0, "o", 6);
+    got = _RxqDrain(a);
+    printf("rxq: drop-oldest: %s dropped %u\n", got.c_str(), a.RxDropped());
+    fails += _Expect("drop-oldest keeps the last 4",
+                     (got == "o3|o4|o5|o6|") && (a.RxDropped() == 2));
+
+    b.SetRxPolicy(ESP_RX_DROP_NEWEST);
+    _RxqBurst(1, "n", 6);
+    got = _RxqDrain(b);
+    printf("rxq: drop-newest: %s dropped %u\n", got.c_str(), b.RxDropped());
+    fails += _Expect("drop-newest keeps the first 4",
+                     (got == "n1|n2|n3|n4|") && (b.RxDropped() == 2));
+
+    esp.AddHook(_RxqHook);
+    _RxqBurst(0, "h", 3);
+    _Pump([&]{ return false; }, 20);
+    esp.AddHook(0);
+    printf("rxq: hook: %s\n", _hooked.c_str());
+    fails += _Expect("hook burst delivered in order",
+                     _hooked == "0:h1|0:h2|0:h3|");
+
+    //  Socket closed by ESP with short and pooled message queued
+    _espClient *cli = esp.GetClientBySockID(1);
+
+    _RxqBurst(1, "z", 2);
+    HAL_ESP_EmuIPD(1, (const uint8_t*)big.data(), big.size());
+    _Pump([&]{ return cli->Pending() == 3; }, 100);
+    fails += _Expect("long message queued in pooled buffer",
+                     (cli->Pending() == 3) &&
+                     (BufferPool::GetI().FreeCount() < pool));
+    HAL_ESP_EmuLine("1,CLOSED");
+    _Pump([&]{ return !esp.ValidSocket(1); }, 100);
+    fails += _Expect("close reported by ESP releases queue",
+                     (cli->Pending() == 0) &&
+                     (BufferPool::GetI().FreeCount() == pool));
+
+    //  Socket closed by library while ESP fails to close it
+    HAL_ESP_EmuIPD(0, (const uint8_t*)"abc", 3);
+    HAL_ESP_EmuIPD(0, (const uint8_t*)big.data(), big.size());
+    cli = esp.GetClientBySockID(0);
+    _Pump([&]{ return cli->Pending() == 2; }, 100);
+    HAL_ESP_EmuError(1);
+    cli->Close();
+    _Pump([&]{ return esp.CmdIdle(); }, 1000);
+    printf("rxq: pool free %u of %u after failed close\n",
+           BufferPool::GetI().FreeCount(), pool);
+    fails += _Expect("failed CIPCLOSE still releases queue",
+                     (cli->Pending() == 0) &&
+                     (BufferPool::GetI().FreeCount() == pool));
+
+    return fails;
+}
+
+/**
+ * ESP replies to the library during a session: echo of commands until ATE0,
+ * joining AP, reading station IP, socket open, prompt and confirmation of
+ * sends (plain and buffered), received data (also carrying keywords), RSSI,
+ * busy and error replies, socket closes and losing AP. +IPD payloads are not
+ * followed by \r\n, as ESP sends them.
+ */
+static const char _trace[] =
+    "AT\r\r\n\r\nOK\r\n"
+    "ATE0\r\r\n\r\nOK\r\n"
+    "\r\nOK\r\n"
+    "WIFI DISCONNECT\r\n"
+    "WIFI CONNECTED\r\n"
+    "WIFI GOT IP\r\n\r\nOK\r\n"
+    "+CIPSTA:ip:\"192.168.0.7\"\r\n"
+    "+CIPSTA:gateway:\"192.168.0.1\"\r\n"
+    "+CIPSTA:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n"
+    "\r\nOK\r\n"
+    "0,CONNECT\r\n\r\nOK\r\n"
+    "\r\nOK\r\n> "
+    "\r\nRecv 64 bytes\r\n\r\nSEND OK\r\n"
+    "\r\n+IPD,0,24:{\"cmd\":\"OK\",\"val\":12345}"
+    "\r\nOK\r\n> "
+    "\r\nRecv 40 bytes\r\n\r\nSEND OK\r\n"
+    "1,CONNECT\r\n\r\nOK\r\n"
+    "\r\n+IPD,1,48:1*:0.12:0.34:0.56:0.00:0.00:0.00:12:34:ERROR\r\n"
+    "\r\nOK\r\n"
+    "0,1,SEND OK\r\n"
+    "+CWJAP:\"my,ssid\",\"18:d6:c7:aa:bb:cc\",6,-67\r\n\r\nOK\r\n"
+    "busy p...\r\n"
+    "\r\nERROR\r\n"
+    "\r\n+IPD,0,5:hello"
+    "0,CLOSED\r\n1,CLOSED\r\n"
+    "\r\nOK\r\n";
+
+/**
+ * Former parser: keywords searched for by strstr() in the whole message,
+ * station IP and +IPD payload extracted from it
+ * @return bitwise OR of all statuses (ESP_STATUS_*) found in the message
+ */
+static uint32_t _OldParse(char *rxBuffer, uint16_t rxLen)
+{
+    static char ipStr[16];
+    static char body[1024];
+    uint32_t retVal = ESP_NO_STATUS;
+    int16_t ipFlag = -1, respFlag = -1;
+    char *retTemp;
+
+    if (rxLen < 1)
+        return retVal;
+
+    if ((retTemp = strstr(rxBuffer, "ip:\"")) != NULL)
+        ipFlag = retTemp - rxBuffer + 4;
+    if ((retTemp = strstr(rxBuffer, "+IPD,")) != NULL)
+    {
+        respFlag = retTemp - rxBuffer + 5;
+        retVal |= ESP_STATUS_IPD;
+    }
+    if (strstr(rxBuffer, "WIFI CONN") != NULL)
+        retVal |= ESP_STATUS_CONNECTED;
+    if (strstr(rxBuffer, "WIFI DISCONN") != NULL)
+        retVal |= ESP_STATUS_DISCN;
+    if (strstr(rxBuffer, "OK") != NULL)
+        retVal |= ESP_STATUS_OK;
+    if (strstr(rxBuffer, "busy...") != NULL)
+        retVal |= ESP_STATUS_BUSY;
+    if (strstr(rxBuffer, "FAIL") != NULL)
+        retVal |= ESP_STATUS_FAIL;
+    if (strstr(rxBuffer, "ERROR") != NULL)
+        retVal |= ESP_STATUS_ERROR;
+    if (strstr(rxBuffer, "READY") != NULL)
+        retVal |= ESP_STATUS_READY;
+    if (strstr(rxBuffer, "SEND OK") != NULL)
+        retVal |= ESP_STATUS_SENDOK;
+    if (strstr(rxBuffer, "SUCCESS") != NULL)
+        retVal |= ESP_RESPOND_SUCC;
+    if (strstr(rxBuffer, ">") != NULL)
+        retVal |= ESP_STATUS_RECV;
+    if (strstr(rxBuffer, ",CONNECT") != NULL)
+        retVal |= ESP_STATUS_SOCKOPEN;
+    if ((retTemp = strstr(rxBuffer, ",CLOSED")) != NULL)
+    {
+        while (retTemp != NULL)
+            retTemp = strstr(retTemp + 1, ",CLOSED");
+        retVal |= ESP_STATUS_SOCKCLOSE;
+    }
+
+    if (ipFlag >= 0)
+    {
+        int i = ipFlag;
+
+        memset(ipStr, 0, sizeof(ipStr));
+        while (((rxBuffer[i] == '.') || isdigit(rxBuffer[i])) && (i < rxLen) &&
+               ((i - ipFlag) < 15))
+        {
+            ipStr[i - ipFlag] = rxBuffer[i];
+            i++;
+        }
+        retVal |= ESP_GOT_IP;
+    }
+    if (respFlag >= 0)
+    {
+        uint8_t msgLen[5] = { 0 };
+        int i = respFlag + 2, start;
+        uint16_t len;
+
+        while ((rxBuffer[i] != ':') && (i < rxLen) && ((i - respFlag - 2) < 4))
+        {
+            msgLen[i - respFlag - 2] = rxBuffer[i];
+            i++;
+        }
+        len = (uint16_t)lroundf(stof(msgLen, i - respFlag - 2));
+        for (start = ++i; ((i - start) < len) && (i < rxLen) &&
+                          ((i - start) < (int)sizeof(body)); i++)
+            body[i - start] = rxBuffer[i];
+    }
+
+    return retVal;
+}
+
+/**
+ * Replay mode: parse trace [_frames] times, either through ATParser (payload
+ * skipped in one piece after +IPD header, as ESP8266::_Parse() does) or through
+ * the former path (message buffered until \r\n or "> ", parsed by _OldParse(),
+ * buffer cleared)
+ * @return exit code
+ */
+static int _Replay()
+{
+    static char rxBuffer[1024];
+    std::vector<char> trace(_trace, _trace + sizeof(_trace) - 1);
+    uint32_t statuses = 0, reports = 0, mask = 0;
+    uint16_t rxLen = 0;
+    uint64_t start;
+    ATParser parser;
+
+    if (_traceFile != 0)
+    {
+        FILE *f = fopen(_traceFile, "rb");
+        int c;
+
+        if (f == 0)
+        {
+            fprintf(stderr, "Can't open %s\n", _traceFile);
+            return 1;
+        }
+        trace.clear();
+        while ((c = fgetc(f)) != EOF)
+            trace.push_back((char)c);
+        fclose(f);
+    }
+
+    start = _Now();
+    for (uint32_t r = 0; r < _frames; r++)
+    {
+        for (size_t i = 0, n; i < trace.size(); i += n)
+        {
+            uint32_t ev;
+
+            n = 1;
+            if (_oldParser)
+            {
+                rxBuffer[rxLen++] = trace[i];
+                rxLen %= sizeof(rxBuffer);
+                if ((rxLen < 2) ||
+                    !(((rxBuffer[rxLen - 2] == '\r') &&
+                       (rxBuffer[rxLen - 1] == '\n')) ||
+                      ((rxBuffer[rxLen - 2] == '>') &&
+                       (rxBuffer[rxLen - 1] == ' '))))
+                    continue;
+                ev = (rxLen > 2) ? _OldParse(rxBuffer, rxLen) : 0;
+                memset(rxBuffer, 0, sizeof(rxBuffer));
+                rxLen = 0;
+            }
+            else if ((n = std::min<size_t>(parser.PayloadLeft(),
+                                           trace.size() - i)) > 0)
+                ev = parser.Skip(n);
+            else
+            {
+                n = 1;
+                ev = parser.Feed(trace[i]);
+            }
+            ev &= 0xFFFF;
+            statuses += (ev != 0);
+            mask |= ev;
+        }
+        if (r == 0)
+            reports = statuses;
+    }
+    double ns = (double)(_Now() - start);
+
+    printf("replay: parser=%s bytes=%zu x%u: %.2f ns/byte\n",
+           _oldParser ? "strstr" : "ATParser", trace.size(), _frames,
+           ns / trace.size() / ((_frames > 0) ? _frames : 1));
+    printf("replay: %u messages with status per pass, statuses seen %04x\n",
+           reports, mask);
+
+    return 0;
+}
+
+/**
+ * Run check mode [name] if it is one
+ * @return -1 if [name] is not a check mode, exit code of the check otherwise
+ */
+static int _Check(const char *name, ESP8266 &esp, DataStream &ds,
+                  const struct _espEmuCfg &cfg, uint16_t port)
+{
+    uint32_t fails;
+
+    if (strcmp(name, "slot") == 0)
+        fails = _CheckSlot(esp, ds);
+    else if (strcmp(name, "cmd") == 0)
+        fails = _CheckCmd(esp);
+    else if (strcmp(name, "met") == 0)
+        fails = _CheckMet(esp, ds, cfg.rssi);
+    else if (strcmp(name, "rxq") == 0)
+        fails = _CheckRxq(esp, ds, port);
+    else
+        return -1;
+
+    printf("%s: %s (%u failed)\n", name, (fails == 0) ? "PASS" : "FAIL", fails);
+    return (fails == 0) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    struct _espEmuCfg cfg;
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    char slave[64];
+    bool pty = false;
+    pthread_t th;
+    int opt, srv;
+
+    setvbuf(stdout, 0, _IONBF, 0);
+    HAL_ESP_EmuDefaults(&cfg);
+    while ((opt = getopt(argc, argv, "n:s:r:m:tk:bw:l:d:of:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': _frames = atoi(optarg); break;
+        case 's': _frameSize = atoi(optarg); break;
+        case 'r': _rate = atoi(optarg); break;
+        case 'm': strncpy(_mode, optarg, sizeof(_mode) - 1); break;
+        case 't': pty = true; break;
+        case 'k': cfg.sendOkUs = atoi(optarg); break;
+        case 'b': cfg.sendBuf = false; break;
+        case 'w': _window = atoi(optarg); break;
+        case 'l': _loss = atoi(optarg); break;
+        case 'd': _ackMs = atoi(optarg); break;
+        case 'o': _oldParser = true; break;
+        case 'f': _traceFile = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n frames] [-s frameSize] "
+                    "[-r framesPerSec]\n"
+                    "    [-m send|write|udp|pt|large|win|slot|cmd|met|rxq|replay]\n"
+                    "    [-t] [-k sendOkUs] [-b] [-w window] [-l lossPct] "
+                    "[-d ackMs] [-o] [-f traceFile]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (_frameSize < sizeof(struct _benchHdr))
+        _frameSize = sizeof(struct _benchHdr);
+    _udp = (strcmp(_mode, "udp") == 0);
+    _win = (strcmp(_mode, "win") == 0);
+    if (strcmp(_mode, "replay") == 0)
+        return _Replay();
+
+    //  Local server bridged sockets connect to
+    srv = socket(AF_INET, _udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(srv, (struct sockaddr*)&addr, sizeof(addr));
+    if (!_udp)
+        listen(srv, 1);
+    getsockname(srv, (struct sockaddr*)&addr, &addrLen);
+    pthread_create(&th, 0, _win ? _WinServer : _Server, (void*)(long)srv);
+
+    //  Emulated ESP, in-process or behind pseudo-terminal
+    HAL_BOARD_CLOCK_Init();
+    if (pty)
+    {
+        if (!HAL_ESP_EmuStartPty(&cfg, slave, sizeof(slave)) ||
+            !HAL_ESP_HostTTY(slave))
+        {
+            fprintf(stderr, "Can't open pseudo-terminal\n");
+            return 1;
+        }
+        printf("Emulator on %s\n", slave);
+    }
+    else
+        HAL_ESP_EmuStart(&cfg);
+
+    //  Library, the way the platform brings it up
+    TaskScheduler::GetI().InitHW(1);
+    ESP8266 &esp = ESP8266::GetI();
+    esp.InitHW();
+    esp.ConnectAP((char*)"bench", (char*)"bench", true);
+    if (!_Pump([&]{ return esp.IsConnected() && esp.CmdIdle(); }, 5000))
+    {
+        fprintf(stderr, "Can't connect to AP\n");
+        return 1;
+    }
+
+    DataStream_InitHW();
+    DataStream ds((uint8_t*)"127.0.0.1", ntohs(addr.sin_port), _udp);
+    if (strcmp(_mode, "pt") == 0)
+    {
+        if (ds.Passthrough(true) != STATUS_OK)
+        {
+            fprintf(stderr, "Can't enter passthrough mode\n");
+            return 1;
+        }
+    }
+    else
+    {
+        ds.BindToSocketID(0);
+        if (!_Pump([&]{ return esp.ValidSocket(0) && esp.CmdIdle(); }, 5000))
+        {
+            fprintf(stderr, "Can't open socket\n");
+            return 1;
+        }
+    }
+    esp.ResetStats();
+
+    int checkRet = _Check(_mode, esp, ds, cfg, ntohs(addr.sin_port));
+    if (checkRet >= 0)
+        return checkRet;
+
+    //  Frames of windowed mode: decoder for ACKs and slots of the window
+    static uint8_t decBuf[64];
+    static uint8_t ring[DATAS_WIN_MAX * 2048];
+    DataFrame dec(decBuf, sizeof(decBuf));
+
+    if (_win)
+    {
+        ds.SetFraming(&dec);
+        if (ds.SetWindow(ring, (uint16_t)std::min<uint32_t>(sizeof(ring) - 1,
+                         (uint32_t)_window * (_frameSize + DATAF_OVERHEAD)),
+                         _window) != STATUS_OK)
+        {
+            fprintf(stderr, "Can't set up window\n");
+            return 1;
+        }
+    }
+
+    //  Send frames, paced if rate is given
+    std::vector<uint8_t> frame(_frameSize, 'x');
+    struct _benchHdr hdr;
+    uint64_t start = _Now(), next = start;
+    uint32_t fails = 0;
+    bool large = (strcmp(_mode, "large") == 0);
+
+    //  All frames in a single buffer, handed to the library at once
+    if (large)
+    {
+        std::vector<uint8_t> all((size_t)_frames * _frameSize, 'x');
+
+        hdr.sentNs = _Now();
+        for (uint32_t i = 0; i < _frames; i++)
+        {
+            hdr.seq = i;
+            memcpy(all.data() + (size_t)i * _frameSize, &hdr, sizeof(hdr));
+        }
+        if (ds.SendLarge(all.data(), all.size()) != STATUS_OK)
+            fails = _frames;
+    }
+
+    for (uint32_t i = 0; !large && (i < _frames); i++)
+    {
+        if (_rate > 0)
+        {
+            next += 1000000000ULL / _rate;
+            _Pump([&]{ return _Now() >= next; }, 1000);
+        }
+        hdr.seq = i;
+        hdr.sentNs = _Now();
+        memcpy(frame.data(), &hdr, sizeof(hdr));
+        if (_win)
+            fails += !_Pump([&]{ return ds.SendFrame(1, frame.data(),
+                                     _frameSize) == STATUS_OK; }, 5000);
+        else if (strcmp(_mode, "write") == 0)
+            fails += (ds.Write(frame.data(), _frameSize) != STATUS_OK);
+        else
+            fails += (ds.Send(frame.data(), _frameSize) != STATUS_OK);
+        TS_GlobalCheck();
+    }
+    ds.Flush();
+    _Pump([&]{ return ds.InFlight() == 0; }, 10000);
+    _Pump([&]{ return esp.CmdIdle() && (_rxFrames >= (_frames - fails)); },
+          5000);
+    //  Let late frames (e.g. sitting in emulator) arrive
+    _Pump([&]{ return false; }, 50);
+
+    //  Report
+    double secs = (double)(_rxLastNs - start) / 1e9;
+    struct _espStats s = esp.Stats();
+    struct _espEmuStats e = HAL_ESP_EmuStats();
+
+    pthread_mutex_lock(&_latLock);
+    std::sort(_lat.begin(), _lat.end());
+    printf("mode=%s frames=%u size=%u rate=%u sendOkUs=%u transport=%s\n",
+           _mode, _frames, _frameSize, _rate, cfg.sendOkUs,
+           pty ? "pty" : "in-process");
+    printf("received %u/%u frames (%u rejected) in %.3f s: %.1f fps, "
+           "%.1f KB/s\n", _rxFrames, _frames, fails, secs,
+           (secs > 0) ? _rxFrames / secs : 0.0,
+           (secs > 0) ? _rxFrames * _frameSize / secs / 1024.0 : 0.0);
+    if (!_lat.empty())
+    {
+        uint64_t sum = 0;
+
+        for (uint64_t l : _lat)
+            sum += l;
+        printf("latency ms: mean %.2f p50 %.2f p99 %.2f max %.2f\n",
+               sum / 1e6 / _lat.size(), _lat[_lat.size() / 2] / 1e6,
+               _lat[_lat.size() * 99 / 100] / 1e6, _lat.back() / 1e6);
+    }
+    pthread_mutex_unlock(&_latLock);
+
+    printf("esp: in=%u out=%u sends=%u fails=%u rttMax=%ums busy=%u "
+           "busyRetries=%u wd=%u\n", s.bytesIn, s.bytesOut, s.sends,
+           s.sendFails, s.sendRTTMaxMs, s.busy, s.busyRetries, s.wdTimeouts);
+    _Hist("esp: sendRTT ms bins ", s.sendRTT);
+    printf("esp: parseRuns=%u parseMax=%uus isrRuns=%u isrMax=%uus\n",
+           s.parseRuns, s.parseMaxUs, s.isrRuns, s.isrMaxUs);
+    _Hist("esp: isrTime us bins ", s.isrTime);
+    if (_win)
+    {
+        struct _dataWinStats w = ds.WindowStats();
+
+        printf("win: window=%u loss=%u%% ackMs=%u sent=%u retransmits=%u "
+               "timeouts=%u (fast %u) acked=%u full=%u\n", _window, _loss,
+               _ackMs, w.sent, w.retransmits, w.timeouts, w.fastRetransmits,
+               w.acked, w.full);
+    }
+    printf("emu: commands=%u sends=%u segments=%u toNet=%u toESP=%u "
+           "faults=%u\n", e.commands, e.sends, e.segments, e.bytesToNet,
+           e.bytesToESP, e.faults);
+
+    return 0;
+}
+
+#endif  /* __BOARD_HOST__ && __ESP_BENCH__ */
@@ -0,0 +1,123 @@
+/**
+ * hal_common_host.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "hal_common_host.h"
+
+#if defined(__BOARD_HOST__)        //  Compile only when building for host
+
+#include <pthread.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdlib.h>
+
+/// Environment variable passed to re-executed process image to mark warm reset
+#define HOST_WARM_RESET_ENV     "ROVER_WARM_RESET"
+
+uint32_t g_ui32SysClock;
+
+/// Held while interrupts are disabled and while emulated ISR is running
+static pthread_mutex_t _intLock = PTHREAD_MUTEX_INITIALIZER;
+/// Whether main context currently has interrupts disabled
+static bool _intMasked = false;
+/// Set in thread currently executing emulated ISR
+static __thread bool _inISR = false;
+/// Whether process was started by emulated warm reset, latched on board init
+static bool _warmReset = false;
+
+/**
+ *  Dummy function to be called to suppress "Unused variable" warnings
+ */
+void UNUSED (int32_t arg) { (void)arg; }
+
+/**
+ * Host has no clock to configure, only report clock of the real board so
+ * time-based calculations in libraries give the same results
+ */
+void HAL_BOARD_CLOCK_Init()
+{
+    g_ui32SysClock = 120000000;
+
+    //  Latch cause of last reset, cleared so the next reset reports its own
+    _warmReset = (getenv(HOST_WARM_RESET_ENV) != 0);
+    unsetenv(HOST_WARM_RESET_ENV);
+}
+
+/**
+ * Check whether process is coming from a (emulated) warm reset
+ * @note Valid only after HAL_BOARD_CLOCK_Init() has been called
+ * @return true if started through HAL_BOARD_Reset(), false otherwise
+ */
+bool HAL_BOARD_WarmReset()
+{
+    return _warmReset;
+}
+
+/**
+ * Software-triggered reboot, emulated by re-executing the process image.
+ * Memory preserved across warm reset on the board is emulated by files.
+ */
+void HAL_BOARD_Reset()
+{
+    char path[PATH_MAX] = {0};
+
+    setenv(HOST_WARM_RESET_ENV, "1", 1);
+    if (readlink("/proc/self/exe", path, sizeof(path) - 1) > 0)
+        execl(path, path, (char*)0);
+    _exit(1);
+}
+
+/**
+ * Suppress or enable (emulated) interrupts. Nested disable calls are not
+ * counted, same as on the board. Calls from within ISR are ignored since other
+ * interrupts are already blocked while it runs.
+ * @param enable New state to set
+ */
+void HAL_BOARD_InterruptEnable(bool enable)
+{
+    if (_inISR)
+        return;
+
+    if (!enable && !_intMasked)
+    {
+        pthread_mutex_lock(&_intLock);
+        _intMasked = true;
+    }
+    else if (enable && _intMasked)
+    {
+        _intMasked = false;
+        pthread_mutex_unlock(&_intLock);
+    }
+}
+
+/**
+ * Called by thread emulating a peripheral before it runs interrupt handler.
+ * Blocks while main context has interrupts disabled.
+ */
+void _HOST_IntEnter()
+{
+    pthread_mutex_lock(&_intLock);
+    _inISR = true;
+}
+
+/**
+ * Called by thread emulating a peripheral after interrupt handler returns
+ */
+void _HOST_IntExit()
+{
+    _inISR = false;
+    pthread_mutex_unlock(&_intLock);
+}
+
+/**
+ * Wait for given amount of us - blocking function
+ * @param us time in us to wait
+ */
+void HAL_DelayUS(uint32_t us)
+{
+    usleep(us);
+}
+
+#endif  /* __BOARD_HOST__ */
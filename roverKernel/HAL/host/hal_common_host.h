@@ -0,0 +1,44 @@
+/**
+ * hal_common_host.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host (PC) stand-in for board-common HAL functions. Allows kernel libraries
+ *  to be compiled and run as a regular process on a POSIX host.
+ ****Host dependencies:
+ *  POSIX threads (interrupts are emulated by threads, disabling interrupts
+ *  locks a mutex shared with them)
+ */
+#include "hwconfig.h"
+
+#if !defined(ROVERKERNEL_HAL_HOST_HAL_COMMON_HOST_H_) && defined(__BOARD_HOST__)
+#define ROVERKERNEL_HAL_HOST_HAL_COMMON_HOST_H_
+
+#define HAL_OK                  0
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Global clock variable
+extern uint32_t g_ui32SysClock;
+
+
+extern void         HAL_DelayUS(uint32_t us);
+extern void         HAL_BOARD_CLOCK_Init();
+extern void         HAL_BOARD_Reset();
+extern void         HAL_BOARD_InterruptEnable(bool enable);
+extern bool         HAL_BOARD_WarmReset();
+extern void         UNUSED (int32_t arg);
+
+/**     Emulated interrupts - called from threads emulating peripherals     */
+extern void         _HOST_IntEnter();
+extern void         _HOST_IntExit();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROVERKERNEL_HAL_HOST_HAL_COMMON_HOST_H_ */
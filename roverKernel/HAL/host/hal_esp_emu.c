@@ -0,0 +1,1190 @@
+/**
+ * hal_esp_emu.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     //  ptsname_r()
+#endif
+#include "hal_esp_emu.h"
+
+#if defined(__HAL_USE_ESP8266__) && defined(__BOARD_HOST__)
+
+#include "HAL/host/hal_common_host.h"
+#include "HAL/host/hal_esp_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+//  Max number of replies waiting to be sent to the library
+#define EMU_OUTQ_LEN        64
+//  Max length of a single reply (+IPD header and payload fit in it)
+#define EMU_OUT_LEN         (HAL_ESP_EMU_IPD_MAX + 32)
+//  Max length of a command line
+#define EMU_LINE_LEN        256
+//  Max length of reply delivered at once while flow control is in use
+#define EMU_FLOW_CHUNK      64
+//  Max number of buffered segments (CIPSENDBUF) waiting for delivery
+#define EMU_ACKQ_LEN        16
+
+/**
+ * Reply waiting to be sent to the library once its time comes
+ */
+struct _emuOut
+{
+    uint64_t    due;
+    uint32_t    baud;       //  Baud rate ESP used to send it
+    uint16_t    len;
+    char        data[EMU_OUT_LEN];
+};
+
+/**
+ * Socket (link) of emulated ESP
+ */
+struct _emuLink
+{
+    int         fd;         //  Bridged host socket, -1 if not bridged
+    bool        open;
+    bool        udp;
+    uint16_t    seg;        //  ID of the last segment taken (CIPSENDBUF)
+    uint16_t    segAcked;   //  ID of the last segment delivered
+};
+
+/**
+ * Buffered segment waiting to be confirmed as delivered once its time comes
+ */
+struct _emuAck
+{
+    uint64_t    due;
+    uint8_t     link;       //  Link ID, 0xFF if link got closed meanwhile
+    uint16_t    seg;
+};
+
+/// Configuration, and whether the emulator is running
+static struct _espEmuCfg _cfg;
+static bool _running = false;
+/// Guards all emulator state below, held only for short non-blocking sections
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t _thread;
+/// Pseudo-terminal transport (master side), -1 when running in-process
+static int _ptyFd = -1;
+static int _ptySlaveFd = -1;
+
+/// Replies waiting to be sent, in order of their due time
+static struct _emuOut _outQ[EMU_OUTQ_LEN];
+static uint16_t _outHead = 0;
+static uint16_t _outN = 0;
+static uint64_t _outLast = 0;
+
+/// Command line being received, and data of CIPSEND being received
+static char _line[EMU_LINE_LEN];
+static uint16_t _lineLen = 0;
+static uint8_t _data[HAL_ESP_EMU_SEND_MAX];
+static uint16_t _dataLen = 0;
+static uint16_t _dataLeft = 0;
+static uint8_t _dataLink = 0;
+static bool _dataBuf = false;
+
+/// Buffered segments waiting for confirmation of delivery, in order
+static struct _emuAck _ackQ[EMU_ACKQ_LEN];
+static uint16_t _ackHead = 0;
+static uint16_t _ackN = 0;
+
+/// State of emulated firmware
+static bool _echo = true;
+static uint8_t _mux = 0;
+static uint8_t _mode = 0;
+static uint32_t _baud = 0;
+static uint8_t _flow = 0;
+static uint32_t _hwCycles = 0;
+static bool _pt = false;
+static bool _joined = false;
+static char _ssid[33] = {0};
+static struct _emuLink _links[HAL_ESP_EMU_MAX_LINK];
+static int _servFd = -1;
+
+/// Detection of "+++" in passthrough mode
+static uint8_t _plus = 0;
+static uint64_t _lastRx = 0;
+static uint64_t _plusGap = 0;
+
+/// Injected faults, applied to the following commands
+static uint16_t _busyN = 0;
+static uint16_t _errorN = 0;
+static uint16_t _dropN = 0;
+
+static struct _espEmuStats _stats;
+
+///-----------------------------------------------------------------------------
+///                      Helper functions                              [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Get monotonic time in microseconds
+ */
+static uint64_t _EMU_Now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+/**
+ * Queue data to be sent to the library after given delay. Replies are never
+ * reordered, reply is not sent before the one queued ahead of it.
+ * @note Has to be called with _lock held
+ * @param data bytes to send
+ * @param len number of bytes in [data]
+ * @param delayUs time to wait before sending
+ */
+static void _EMU_Out(const char *data, uint16_t len, uint32_t delayUs)
+{
+    struct _emuOut *out;
+    uint64_t due = _EMU_Now() + delayUs;
+
+    if ((_outN >= EMU_OUTQ_LEN) || (len > EMU_OUT_LEN))
+        return;
+
+    if (due < _outLast)
+        due = _outLast;
+    _outLast = due;
+
+    out = &_outQ[(_outHead + _outN) % EMU_OUTQ_LEN];
+    memcpy(out->data, data, len);
+    out->len = len;
+    out->due = due;
+    out->baud = _baud;
+    _outN++;
+}
+
+/**
+ * Queue null-terminated reply to be sent to the library
+ * @note Has to be called with _lock held
+ */
+static void _EMU_Reply(const char *str, uint32_t delayUs)
+{
+    _EMU_Out(str, strlen(str), delayUs);
+}
+
+/**
+ * Check if data crossing in-process link at given baud rate of ESP gets
+ * corrupted: either side runs at a different rate or link is unreliable at it
+ */
+static bool _EMU_LineBad(uint32_t baud)
+{
+    return ((_ptyFd < 0) && ((baud != HAL_ESP_HostBaud()) ||
+            ((_cfg.maxBaud != 0) && (baud > _cfg.maxBaud))));
+}
+
+/**
+ * Send data to the library over the transport in use
+ * @note Called without _lock held, in-process transport runs UART interrupt
+ * handler of the library from within this call
+ * @param data bytes to send
+ * @param len number of bytes in [data]
+ * @param baud baud rate ESP sent data at
+ */
+static void _EMU_Deliver(char *data, uint16_t len, uint32_t baud)
+{
+    uint16_t n;
+
+    if (_ptyFd >= 0)
+    {
+        uint16_t done = 0;
+        ssize_t n;
+
+        while (done < len)
+        {
+            n = write(_ptyFd, data + done, len - done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+    }
+    else
+    {
+        //  Receiver sees garbage and reports framing error
+        if (_EMU_LineBad(baud))
+        {
+            for (n = 0; n < len; n++)
+                data[n] ^= 0x55;
+            HAL_ESP_HostRxError();
+            pthread_mutex_lock(&_lock);
+            _stats.lineErrors++;
+            pthread_mutex_unlock(&_lock);
+        }
+
+        //  With flow control ESP pauses whenever RTS is raised
+        while (len > 0)
+        {
+            n = len;
+            if (_flow & 0x02)
+            {
+                n = (len > EMU_FLOW_CHUNK) ? EMU_FLOW_CHUNK : len;
+                while (!HAL_ESP_HostRxReady())
+                    usleep(100);
+            }
+            HAL_ESP_HostInject((const uint8_t*)data, n);
+            data += n;
+            len -= n;
+        }
+    }
+}
+
+/**
+ * Close link and its bridged socket
+ * @note Has to be called with _lock held
+ * @param id link ID
+ * @param report whether to tell the library that link got closed
+ */
+static void _EMU_LinkClose(uint8_t id, bool report)
+{
+    char msg[16];
+
+    if ((id >= HAL_ESP_EMU_MAX_LINK) || !_links[id].open)
+        return;
+
+    //  Segments still waiting for delivery are lost
+    for (uint16_t i = 0; i < _ackN; i++)
+        if (_ackQ[(_ackHead + i) % EMU_ACKQ_LEN].link == id)
+            _ackQ[(_ackHead + i) % EMU_ACKQ_LEN].link = 0xFF;
+
+    if (_links[id].fd >= 0)
+        close(_links[id].fd);
+    _links[id].fd = -1;
+    _links[id].open = false;
+
+    if (report)
+    {
+        if (_mux)
+            snprintf(msg, sizeof(msg), "%d,CLOSED\r\n", id);
+        else
+            snprintf(msg, sizeof(msg), "CLOSED\r\n");
+        _EMU_Reply(msg, 0);
+    }
+}
+
+/**
+ * Open link and bridge it to host's socket (if bridging is enabled)
+ * @param id link ID
+ * @param udp whether to open UDP socket instead of TCP one
+ * @param ip IP address of server
+ * @param port port of server
+ * @return true on success, false if server can't be reached
+ */
+static bool _EMU_LinkOpen(uint8_t id, bool udp, const char *ip, uint16_t port)
+{
+    struct sockaddr_in addr;
+    int fd, one = 1;
+
+    _links[id].fd = -1;
+    _links[id].udp = udp;
+    _links[id].seg = _links[id].segAcked = 0;
+    if (!_cfg.bridge)
+    {
+        _links[id].open = true;
+        return true;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, (_cfg.bridgeIP != 0) ? _cfg.bridgeIP : ip,
+                  &addr.sin_addr) != 1)
+        return false;
+
+    fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    if (!udp)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    _links[id].fd = fd;
+    _links[id].open = true;
+    return true;
+}
+
+/**
+ * Forward data sent by the library to link's socket
+ * @note Has to be called with _lock held
+ */
+static void _EMU_LinkSend(uint8_t id, const uint8_t *data, uint16_t len)
+{
+    uint16_t done = 0;
+    ssize_t n;
+
+    if ((id >= HAL_ESP_EMU_MAX_LINK) || !_links[id].open)
+        return;
+
+    _stats.bytesToNet += len;
+    if (_links[id].fd < 0)
+        return;
+
+    //  Datagram is sent as a whole, stream might take more writes
+    while (done < len)
+    {
+        n = send(_links[id].fd, data + done, len - done, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+}
+
+/**
+ * Queue data received on link's socket for the library, as +IPD frames (or
+ * as-is in passthrough mode)
+ * @note Has to be called with _lock held
+ */
+static void _EMU_LinkRecv(uint8_t id, const uint8_t *data, uint16_t len)
+{
+    char frame[EMU_OUT_LEN];
+    uint16_t n, hdr;
+
+    _stats.bytesToESP += len;
+    while (len > 0)
+    {
+        n = (len > HAL_ESP_EMU_IPD_MAX) ? HAL_ESP_EMU_IPD_MAX : len;
+        if (_pt)
+            hdr = 0;
+        else if (_mux)
+            hdr = snprintf(frame, sizeof(frame), "\r\n+IPD,%d,%d:", id, n);
+        else
+            hdr = snprintf(frame, sizeof(frame), "\r\n+IPD,%d:", n);
+        memcpy(frame + hdr, data, n);
+        _EMU_Out(frame, hdr + n, 0);
+        data += n;
+        len -= n;
+    }
+}
+
+///-----------------------------------------------------------------------------
+///                      AT command interpreter                        [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Reboot emulated module: all links are closed, settings not stored in flash
+ * (mode, baud rate) get default values. Module reconnects to the last AP.
+ * @note Has to be called with _lock held
+ * @param delayUs time it takes to boot
+ */
+static void _EMU_Boot(uint32_t delayUs)
+{
+    for (uint8_t id = 0; id < HAL_ESP_EMU_MAX_LINK; id++)
+        _EMU_LinkClose(id, false);
+    if (_servFd >= 0)
+        close(_servFd);
+    _servFd = -1;
+    _mux = _mode = 0;
+    _pt = false;
+    _echo = _cfg.echo;
+    _baud = _cfg.baud;
+    _flow = 0;
+    _lineLen = 0;
+    _dataLeft = 0;
+    _ackN = 0;
+    _stats.boots++;
+
+    _EMU_Reply("\r\n ets Jan  8 2013,rst cause:2\r\n\r\nready\r\n", delayUs);
+    if (_joined)
+        _EMU_Reply("WIFI CONNECTED\r\nWIFI GOT IP\r\n", _cfg.joinUs);
+}
+
+/**
+ * Execute command line received from the library
+ * @note Has to be called with _lock held
+ * @param cmd null-terminated command, without \r\n
+ */
+static void _EMU_Command(char *cmd)
+{
+    char msg[128];
+    char ip[32], type[8];
+    int id, len, port, val;
+    uint32_t rUs = _cfg.replyUs;
+
+    _stats.commands++;
+    if (_echo)
+    {
+        _EMU_Reply(cmd, 0);
+        _EMU_Reply("\r\r\n", 0);
+    }
+
+    //  Injected faults: ESP busy with previous command drops the new one
+    if (_busyN > 0)
+    {
+        _busyN--;
+        _stats.faults++;
+        _EMU_Reply("busy p...\r\n", rUs);
+        return;
+    }
+    if (_errorN > 0)
+    {
+        _errorN--;
+        _stats.faults++;
+        _EMU_Reply("\r\nERROR\r\n", rUs);
+        return;
+    }
+    if (_dropN > 0)
+    {
+        _dropN--;
+        _stats.faults++;
+        return;
+    }
+
+    if ((strcmp(cmd, "AT") == 0) || (strncmp(cmd, "AT+CWMODE", 9) == 0) ||
+        (strncmp(cmd, "AT+CIPSTO=", 10) == 0))
+        _EMU_Reply("\r\nOK\r\n", rUs);
+    else if ((strcmp(cmd, "ATE0") == 0) || (strcmp(cmd, "ATE1") == 0))
+    {
+        _echo = (cmd[3] == '1');
+        _EMU_Reply("\r\nOK\r\n", rUs);
+    }
+    else if (strcmp(cmd, "AT+RST") == 0)
+    {
+        _EMU_Reply("\r\nOK\r\n", rUs);
+        _EMU_Boot(300000);
+    }
+    else if (strcmp(cmd, "AT+GMR") == 0)
+        _EMU_Reply("AT version:1.2.0.0(Jul  1 2016 20:04:45)\r\n"
+                   "SDK version:1.5.4.1(39cb9a32)\r\n"
+                   "Ai-Thinker Technology Co. Ltd.\r\n"
+                   "Dec  2 2016 14:21:16\r\nOK\r\n", rUs);
+    else if (strncmp(cmd, "AT+UART_CUR=", 12) == 0)
+    {
+        unsigned int baud;
+        int bits, stop, parity, flow;
+
+        if ((sscanf(cmd, "AT+UART_CUR=%u,%d,%d,%d,%d", &baud, &bits, &stop,
+                    &parity, &flow) != 5) || (baud < 110) || (baud > 4608000) ||
+            (bits != 8) || (stop != 1) || (parity != 0) || (flow > 3))
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+        else
+        {
+            //  Reply is sent at the old rate, module switches right after it
+            _EMU_Reply("\r\nOK\r\n", rUs);
+            _baud = baud;
+            _flow = flow;
+        }
+    }
+    else if ((strncmp(cmd, "AT+CWJAP", 8) == 0) && (strchr(cmd, '?') != 0))
+    {
+        if (_joined)
+        {
+            snprintf(msg, sizeof(msg),
+                     "+CWJAP:\"%s\",\"18:d6:c7:aa:bb:cc\",6,%d\r\n\r\nOK\r\n",
+                     _ssid, _cfg.rssi);
+            _EMU_Reply(msg, rUs);
+        }
+        else
+            _EMU_Reply("No AP\r\n\r\nOK\r\n", rUs);
+    }
+    else if (strncmp(cmd, "AT+CWJAP", 8) == 0)
+    {
+        char *s = strchr(cmd, '"');
+        char *e = (s != 0) ? strchr(s + 1, '"') : 0;
+
+        if ((s == 0) || (e == 0) || ((e - s - 1) >= (int)sizeof(_ssid)))
+        {
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+            return;
+        }
+        memset(_ssid, 0, sizeof(_ssid));
+        memcpy(_ssid, s + 1, e - s - 1);
+        if (_joined)
+            _EMU_Reply("WIFI DISCONNECT\r\n", rUs);
+        _joined = true;
+        _EMU_Reply("WIFI CONNECTED\r\n", _cfg.joinUs / 2);
+        _EMU_Reply("WIFI GOT IP\r\n\r\nOK\r\n", _cfg.joinUs / 2);
+    }
+    else if (strcmp(cmd, "AT+CWQAP") == 0)
+    {
+        _EMU_Reply("\r\nOK\r\n", rUs);
+        if (_joined)
+            _EMU_Reply("WIFI DISCONNECT\r\n", 0);
+        _joined = false;
+    }
+    else if (strncmp(cmd, "AT+CIPSTA?", 10) == 0)
+    {
+        if (_joined)
+            snprintf(msg, sizeof(msg), "+CIPSTA:ip:\"%s\"\r\n"
+                     "+CIPSTA:gateway:\"0.0.0.0\"\r\n"
+                     "+CIPSTA:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n", _cfg.ip);
+        else
+            snprintf(msg, sizeof(msg), "+CIPSTA:ip:\"0.0.0.0\"\r\n\r\nOK\r\n");
+        _EMU_Reply(msg, rUs);
+    }
+    else if (sscanf(cmd, "AT+CIPMUX=%d", &val) == 1)
+    {
+        bool open = false;
+
+        for (id = 0; id < HAL_ESP_EMU_MAX_LINK; id++)
+            open |= _links[id].open;
+        //  Mode can't change while there are open links
+        if (open || ((val == 1) && _mode) || (val > 1))
+            _EMU_Reply("link is builded\r\n\r\nERROR\r\n", rUs);
+        else
+        {
+            _mux = val;
+            _EMU_Reply("\r\nOK\r\n", rUs);
+        }
+    }
+    else if (sscanf(cmd, "AT+CIPMODE=%d", &val) == 1)
+    {
+        if ((val > 1) || (val && _mux))
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+        else
+        {
+            _mode = val;
+            _EMU_Reply("\r\nOK\r\n", rUs);
+        }
+    }
+    else if (sscanf(cmd, "AT+CIPSERVER=%d,%d", &val, &port) >= 1)
+    {
+        if (!_mux)
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+        else
+        {
+            if (_servFd >= 0)
+                close(_servFd);
+            _servFd = -1;
+            if ((val == 1) && _cfg.bridge)
+            {
+                struct sockaddr_in addr;
+                int one = 1;
+
+                memset(&addr, 0, sizeof(addr));
+                addr.sin_family = AF_INET;
+                addr.sin_port = htons(port);
+                inet_pton(AF_INET, (_cfg.bridgeIP != 0) ?
+                          _cfg.bridgeIP : "127.0.0.1", &addr.sin_addr);
+                _servFd = socket(AF_INET, SOCK_STREAM, 0);
+                setsockopt(_servFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                if ((bind(_servFd, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+                    (listen(_servFd, HAL_ESP_EMU_MAX_LINK) != 0))
+                {
+                    close(_servFd);
+                    _servFd = -1;
+                }
+            }
+            _EMU_Reply("\r\nOK\r\n", rUs);
+        }
+    }
+    else if (strncmp(cmd, "AT+CIPSTART=", 12) == 0)
+    {
+        //  Multiple connections: AT+CIPSTART=id,"TCP","ip",port[,keepAlive]
+        //  Single connection: AT+CIPSTART="TCP","ip",port[,keepAlive]
+        if (_mux)
+            val = sscanf(cmd, "AT+CIPSTART=%d,\"%7[^\"]\",\"%31[^\"]\",%d",
+                         &id, type, ip, &port) - 1;
+        else
+        {
+            id = 0;
+            val = sscanf(cmd, "AT+CIPSTART=\"%7[^\"]\",\"%31[^\"]\",%d",
+                         type, ip, &port);
+        }
+
+        if ((val != 3) || (id < 0) || (id >= HAL_ESP_EMU_MAX_LINK) ||
+            (strcmp(type, "TCP") && strcmp(type, "UDP")))
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+        else if (_links[id].open)
+            _EMU_Reply("ALREADY CONNECTED\r\n\r\nERROR\r\n", rUs);
+        else if (!_joined)
+            _EMU_Reply("no ip\r\n\r\nERROR\r\n", rUs);
+        else if (!_EMU_LinkOpen(id, (type[0] == 'U'), ip, port))
+            _EMU_Reply("\r\nERROR\r\nCLOSED\r\n", _cfg.connectUs);
+        else
+        {
+            if (_mux)
+                snprintf(msg, sizeof(msg), "%d,CONNECT\r\n\r\nOK\r\n", id);
+            else
+                snprintf(msg, sizeof(msg), "CONNECT\r\n\r\nOK\r\n");
+            _EMU_Reply(msg, _cfg.connectUs);
+        }
+    }
+    else if (strcmp(cmd, "AT+CIPSEND") == 0)
+    {
+        //  Passthrough mode, everything that follows is data of link 0
+        if (_mux || !_mode || !_links[0].open)
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+        else
+        {
+            _pt = true;
+            _plus = 0;
+            _EMU_Reply("\r\nOK\r\n\r\n>", _cfg.promptUs);
+        }
+    }
+    else if (strncmp(cmd, "AT+CIPSEND=", 11) == 0)
+    {
+        if (_mux)
+            val = sscanf(cmd, "AT+CIPSEND=%d,%d", &id, &len);
+        else
+        {
+            id = 0;
+            val = sscanf(cmd, "AT+CIPSEND=%d", &len) + 1;
+        }
+
+        if ((val != 2) || (id < 0) || (id >= HAL_ESP_EMU_MAX_LINK) ||
+            !_links[id].open)
+            _EMU_Reply("link is not valid\r\n\r\nERROR\r\n", rUs);
+        else if ((len <= 0) || (len > HAL_ESP_EMU_SEND_MAX))
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+        else
+        {
+            _dataLink = id;
+            _dataLen = 0;
+            _dataLeft = len;
+            _dataBuf = false;
+            _EMU_Reply("\r\nOK\r\n> ", _cfg.promptUs);
+        }
+    }
+    else if (_cfg.sendBuf && (strncmp(cmd, "AT+CIPSENDBUF=", 14) == 0))
+    {
+        //  Buffered send: segment is taken right away and confirmed once it's
+        //  delivered, reply carries ID of the next segment and of the last
+        //  delivered one
+        if ((sscanf(cmd, "AT+CIPSENDBUF=%d,%d", &id, &len) != 2) || !_mux ||
+            (id < 0) || (id >= HAL_ESP_EMU_MAX_LINK) || !_links[id].open)
+            _EMU_Reply("link is not valid\r\n\r\nERROR\r\n", rUs);
+        else if ((len <= 0) || (len > HAL_ESP_EMU_SEND_MAX) ||
+                 _links[id].udp || (_ackN >= EMU_ACKQ_LEN))
+            _EMU_Reply("\r\nERROR\r\n", rUs);
+        else
+        {
+            _dataLink = id;
+            _dataLen = 0;
+            _dataLeft = len;
+            _dataBuf = true;
+            snprintf(msg, sizeof(msg), "%d,%d\r\n\r\nOK\r\n> ",
+                     _links[id].seg + 1, _links[id].segAcked);
+            _EMU_Reply(msg, _cfg.promptUs);
+        }
+    }
+    else if (strncmp(cmd, "AT+CIPCLOSE", 11) == 0)
+    {
+        if (sscanf(cmd, "AT+CIPCLOSE=%d", &id) != 1)
+            id = 0;
+        //  ID 5 closes all links
+        if (id == HAL_ESP_EMU_MAX_LINK)
+        {
+            for (id = 0; id < HAL_ESP_EMU_MAX_LINK; id++)
+                _EMU_LinkClose(id, true);
+            _EMU_Reply("\r\nOK\r\n", rUs);
+        }
+        else if ((id < 0) || (id > HAL_ESP_EMU_MAX_LINK) || !_links[id].open)
+            _EMU_Reply("UNLINK\r\n\r\nERROR\r\n", rUs);
+        else
+        {
+            _EMU_LinkClose(id, true);
+            _EMU_Reply("\r\nOK\r\n", rUs);
+        }
+    }
+    else
+        _EMU_Reply("\r\nERROR\r\n", rUs);
+}
+
+/**
+ * Process single byte sent by the library
+ * @note Has to be called with _lock held
+ */
+static void _EMU_Rx(char c)
+{
+    uint64_t now = _EMU_Now();
+    uint64_t gap = now - _lastRx;
+
+    _lastRx = now;
+
+    //  Passthrough: data goes to link 0 as-is, "+++" surrounded by silence
+    //  is held back until it's clear whether it's the escape sequence
+    if (_pt)
+    {
+        if (c == '+')
+        {
+            if (_plus == 0)
+                _plusGap = gap;
+            if (_plus < 3)
+            {
+                _plus++;
+                return;
+            }
+        }
+        if (_plus > 0)
+            _EMU_LinkSend(0, (const uint8_t*)"+++", _plus);
+        _plus = 0;
+        _EMU_LinkSend(0, (const uint8_t*)&c, 1);
+        return;
+    }
+
+    //  Data of CIPSEND
+    if (_dataLeft > 0)
+    {
+        _data[_dataLen++] = (uint8_t)c;
+        if (--_dataLeft == 0)
+        {
+            char msg[48];
+
+            _EMU_LinkSend(_dataLink, _data, _dataLen);
+            _stats.sends++;
+            if (_dataBuf)
+            {
+                //  Segments are delivered in order, [sendOkUs] after they're
+                //  taken
+                struct _emuAck *ack = &_ackQ[(_ackHead + _ackN) % EMU_ACKQ_LEN];
+                uint64_t last = (_ackN > 0) ?
+                    _ackQ[(_ackHead + _ackN - 1) % EMU_ACKQ_LEN].due : 0;
+
+                ack->due = now + _cfg.sendOkUs;
+                if (ack->due < last)
+                    ack->due = last;
+                ack->link = _dataLink;
+                ack->seg = ++_links[_dataLink].seg;
+                _ackN++;
+                _stats.segments++;
+                snprintf(msg, sizeof(msg), "\r\nRecv %d bytes\r\n", _dataLen);
+                _EMU_Reply(msg, 0);
+            }
+            else
+            {
+                snprintf(msg, sizeof(msg),
+                         "\r\nRecv %d bytes\r\n\r\nSEND OK\r\n", _dataLen);
+                _EMU_Reply(msg, _cfg.sendOkUs);
+            }
+        }
+        return;
+    }
+
+    //  Command line, terminated by \r\n
+    if (c == '\n')
+    {
+        if ((_lineLen > 0) && (_line[_lineLen - 1] == '\r'))
+            _lineLen--;
+        _line[_lineLen] = '\0';
+        if (_lineLen > 0)
+            _EMU_Command(_line);
+        _lineLen = 0;
+    }
+    else if (_lineLen < (EMU_LINE_LEN - 1))
+        _line[_lineLen++] = c;
+}
+
+/**
+ * Tx hook of host HAL, receives bytes sent by the library in-process
+ */
+static void _EMU_TxHook(char c)
+{
+    //  Powered-off module doesn't respond
+    if (!HAL_ESP_IsHWEnabled())
+        return;
+
+    pthread_mutex_lock(&_lock);
+    if (_EMU_LineBad(_baud))
+    {
+        c ^= 0x55;
+        _stats.lineErrors++;
+    }
+    _EMU_Rx(c);
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Emulator thread: sends replies once they're due, moves data from bridged
+ * sockets (and from pseudo-terminal) to the emulated firmware and accepts
+ * connections to emulated TCP server
+ */
+static void* _EMU_Thread(void *arg)
+{
+    struct pollfd fds[HAL_ESP_EMU_MAX_LINK + 2];
+    uint8_t ids[HAL_ESP_EMU_MAX_LINK + 2];
+    static struct _emuOut out;
+    static uint8_t buf[HAL_ESP_EMU_SEND_MAX];
+    uint8_t nfds, i;
+    uint64_t next;
+    int timeout;
+    ssize_t n;
+
+    UNUSED((int32_t)(intptr_t)arg);
+    while (1)
+    {
+        //  Confirm delivery of buffered segments whose time has come
+        pthread_mutex_lock(&_lock);
+        while ((_ackN > 0) && (_ackQ[_ackHead].due <= _EMU_Now()))
+        {
+            struct _emuAck *ack = &_ackQ[_ackHead];
+
+            if (ack->link != 0xFF)
+            {
+                char msg[32];
+
+                _links[ack->link].segAcked = ack->seg;
+                snprintf(msg, sizeof(msg), "%d,%d,SEND OK\r\n", ack->link,
+                         ack->seg);
+                _EMU_Reply(msg, 0);
+            }
+            _ackHead = (_ackHead + 1) % EMU_ACKQ_LEN;
+            _ackN--;
+        }
+
+        //  Send replies that are due, one at a time without holding the lock
+        if ((_outN > 0) && (_outQ[_outHead].due <= _EMU_Now()))
+        {
+            out = _outQ[_outHead];
+            _outHead = (_outHead + 1) % EMU_OUTQ_LEN;
+            _outN--;
+            pthread_mutex_unlock(&_lock);
+            _EMU_Deliver(out.data, out.len, out.baud);
+            continue;
+        }
+
+        //  Module powered off and on again (in-process only), replies still
+        //  waiting are lost
+        if ((_ptyFd < 0) && (_hwCycles != HAL_ESP_HostPowerCycles()))
+        {
+            _hwCycles = HAL_ESP_HostPowerCycles();
+            _outN = 0;
+            _EMU_Boot(0);
+        }
+
+        //  "+++" followed by silence terminates passthrough mode
+        if (_pt && (_plus == 3) &&
+            (_plusGap >= HAL_ESP_EMU_PT_GUARD * 1000ULL) &&
+            ((_EMU_Now() - _lastRx) >= HAL_ESP_EMU_PT_GUARD * 1000ULL))
+        {
+            _pt = false;
+            _plus = 0;
+        }
+
+        //  Wait for data on sockets until the next reply is due
+        nfds = 0;
+        for (i = 0; i < HAL_ESP_EMU_MAX_LINK; i++)
+            if (_links[i].open && (_links[i].fd >= 0))
+            {
+                fds[nfds].fd = _links[i].fd;
+                fds[nfds].events = POLLIN;
+                ids[nfds++] = i;
+            }
+        if (_servFd >= 0)
+        {
+            fds[nfds].fd = _servFd;
+            fds[nfds].events = POLLIN;
+            ids[nfds++] = 0xFE;
+        }
+        if (_ptyFd >= 0)
+        {
+            fds[nfds].fd = _ptyFd;
+            fds[nfds].events = POLLIN;
+            ids[nfds++] = 0xFF;
+        }
+        //  Next reply or confirmation of segment, whichever is due first
+        next = (_outN > 0) ? _outQ[_outHead].due : 0;
+        if ((_ackN > 0) && ((next == 0) || (_ackQ[_ackHead].due < next)))
+            next = _ackQ[_ackHead].due;
+        timeout = 1;
+        if ((next != 0) && (next > (_EMU_Now() + 1000)))
+        {
+            //  Wake up every 10ms to notice power cycle of the module
+            timeout = (next - _EMU_Now()) / 1000;
+            if (timeout > 10)
+                timeout = 10;
+        }
+        if ((next != 0) && (next <= (_EMU_Now() + 1000)))
+            timeout = 0;
+        pthread_mutex_unlock(&_lock);
+
+        if (poll(fds, nfds, timeout) <= 0)
+        {
+            //  Next reply is less than 1ms away, wait for it precisely
+            if (timeout == 0)
+                usleep(50);
+            continue;
+        }
+
+        for (i = 0; i < nfds; i++)
+        {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            n = read(fds[i].fd, buf, sizeof(buf));
+            pthread_mutex_lock(&_lock);
+            if (ids[i] == 0xFF)
+            {
+                for (ssize_t j = 0; j < n; j++)
+                    _EMU_Rx((char)buf[j]);
+            }
+            else if (ids[i] == 0xFE)
+            {
+                //  read() on listening socket failed, accept connection
+                uint8_t id;
+                int fd = accept(_servFd, 0, 0);
+
+                for (id = 0; id < HAL_ESP_EMU_MAX_LINK; id++)
+                    if (!_links[id].open)
+                        break;
+                if ((fd >= 0) && (id < HAL_ESP_EMU_MAX_LINK))
+                {
+                    char msg[16];
+
+                    _links[id].fd = fd;
+                    _links[id].open = true;
+                    _links[id].udp = false;
+                    _links[id].seg = _links[id].segAcked = 0;
+                    snprintf(msg, sizeof(msg), "%d,CONNECT\r\n", id);
+                    _EMU_Reply(msg, 0);
+                }
+                else if (fd >= 0)
+                    close(fd);
+            }
+            else if (_links[ids[i]].fd == fds[i].fd)
+            {
+                if (n > 0)
+                    _EMU_LinkRecv(ids[i], buf, n);
+                else if (!_links[ids[i]].udp)
+                    _EMU_LinkClose(ids[i], true);
+            }
+            pthread_mutex_unlock(&_lock);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Reset state of emulated firmware and start emulator thread
+ */
+static bool _EMU_Init(const struct _espEmuCfg *cfg)
+{
+    if (_running)
+        return false;
+
+    _cfg = *cfg;
+    _echo = _cfg.echo;
+    _baud = _cfg.baud;
+    _hwCycles = HAL_ESP_HostPowerCycles();
+    for (uint8_t i = 0; i < HAL_ESP_EMU_MAX_LINK; i++)
+    {
+        _links[i].fd = -1;
+        _links[i].open = false;
+    }
+    memset(&_stats, 0, sizeof(_stats));
+
+    if (pthread_create(&_thread, 0, _EMU_Thread, 0) != 0)
+        return false;
+    _running = true;
+
+    return true;
+}
+
+///-----------------------------------------------------------------------------
+///                      Emulator API                                   [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Fill configuration with defaults: latencies of a module at 1Mbaud on a good
+ * link, echo on (as after power-up), sockets bridged to servers on localhost
+ * @param cfg[out] configuration to initialize
+ */
+void HAL_ESP_EmuDefaults(struct _espEmuCfg *cfg)
+{
+    cfg->replyUs = 200;
+    cfg->promptUs = 500;
+    cfg->sendOkUs = 5000;
+    cfg->connectUs = 20000;
+    cfg->joinUs = 100000;
+    cfg->rssi = -60;
+    cfg->echo = true;
+    cfg->bridge = true;
+    cfg->bridgeIP = "127.0.0.1";
+    cfg->ip = "192.168.4.2";
+    cfg->baud = 1000000;
+    cfg->maxBaud = 0;
+    cfg->sendBuf = true;
+}
+
+/**
+ * Start emulator connected to host HAL in-process: bytes sent through
+ * HAL_ESP_TxWrite() reach the emulator through Tx hook, replies are injected
+ * into Rx ring. Emulator responds only while the module is enabled
+ * (HAL_ESP_HWEnable).
+ * @param cfg configuration of emulated ESP
+ * @return true if emulator started, false if it's already running
+ */
+bool HAL_ESP_EmuStart(const struct _espEmuCfg *cfg)
+{
+    _ptyFd = -1;
+    if (!_EMU_Init(cfg))
+        return false;
+    HAL_ESP_HostTxHook(_EMU_TxHook);
+
+    return true;
+}
+
+/**
+ * Start emulator behind a pseudo-terminal. Library talks to it after opening
+ * the slave side with HAL_ESP_HostTTY() (in the same or another process)
+ * @param cfg configuration of emulated ESP
+ * @param slave[out] buffer to store path to slave side of pseudo-terminal in
+ * @param slaveLen size of [slave] buffer
+ * @return true if emulator started, false on error
+ */
+bool HAL_ESP_EmuStartPty(const struct _espEmuCfg *cfg, char *slave,
+                         uint16_t slaveLen)
+{
+    struct termios tio;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if ((fd < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0) ||
+        (ptsname_r(fd, slave, slaveLen) != 0))
+    {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    //  Keep slave side open so that master doesn't see hang-up while there's
+    //  no one on the other side, and put it in raw mode (no line editing, no
+    //  echo, no translation of \r\n)
+    _ptySlaveFd = open(slave, O_RDWR | O_NOCTTY);
+    if ((_ptySlaveFd >= 0) && (tcgetattr(_ptySlaveFd, &tio) == 0))
+    {
+        cfmakeraw(&tio);
+        tcsetattr(_ptySlaveFd, TCSANOW, &tio);
+    }
+
+    _ptyFd = fd;
+    if (!_EMU_Init(cfg))
+    {
+        close(fd);
+        _ptyFd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Make the following [n] commands fail with "busy p..." (command is dropped,
+ * as the module does while it's processing previous command)
+ */
+void HAL_ESP_EmuBusy(uint16_t n)
+{
+    pthread_mutex_lock(&_lock);
+    _busyN = n;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Make the following [n] commands fail with ERROR
+ */
+void HAL_ESP_EmuError(uint16_t n)
+{
+    pthread_mutex_lock(&_lock);
+    _errorN = n;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Make the following [n] commands get no reply at all
+ */
+void HAL_ESP_EmuDrop(uint16_t n)
+{
+    pthread_mutex_lock(&_lock);
+    _dropN = n;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Change latency of SEND OK for data sent from now on
+ * @param us time in us from the last byte of data to SEND OK
+ */
+void HAL_ESP_EmuSendOk(uint32_t us)
+{
+    pthread_mutex_lock(&_lock);
+    _cfg.sendOkUs = us;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Send arbitrary line to the library (e.g. "WIFI DISCONNECT")
+ * @param line null-terminated line, \r\n is appended
+ */
+void HAL_ESP_EmuLine(const char *line)
+{
+    pthread_mutex_lock(&_lock);
+    _EMU_Reply(line, 0);
+    _EMU_Reply("\r\n", 0);
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Send data to the library as if it was received on a link
+ * @param id link ID
+ * @param data payload
+ * @param len length of payload (split into multiple +IPD frames if needed)
+ * @return true if link is open and data got queued, false otherwise
+ */
+bool HAL_ESP_EmuIPD(uint8_t id, const uint8_t *data, uint16_t len)
+{
+    bool retVal = false;
+
+    pthread_mutex_lock(&_lock);
+    if ((id < HAL_ESP_EMU_MAX_LINK) && _links[id].open)
+    {
+        _EMU_LinkRecv(id, data, len);
+        retVal = true;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return retVal;
+}
+
+/**
+ * Close link as if the remote side closed it
+ * @param id link ID
+ * @return true if link was open, false otherwise
+ */
+bool HAL_ESP_EmuClose(uint8_t id)
+{
+    bool retVal = false;
+
+    pthread_mutex_lock(&_lock);
+    if ((id < HAL_ESP_EMU_MAX_LINK) && _links[id].open)
+    {
+        _EMU_LinkClose(id, true);
+        retVal = true;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return retVal;
+}
+
+/**
+ * Get counters of emulated ESP
+ * @return copy of counters
+ */
+struct _espEmuStats HAL_ESP_EmuStats()
+{
+    struct _espEmuStats retVal;
+
+    pthread_mutex_lock(&_lock);
+    retVal = _stats;
+    pthread_mutex_unlock(&_lock);
+
+    return retVal;
+}
+
+#endif  /* __HAL_USE_ESP8266__ && __BOARD_HOST__ */
@@ -0,0 +1,116 @@
+/**
+ * hal_esp_emu.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host (PC) emulator of ESP8266 running AT firmware, used to run and measure
+ *  ESP8266/_espClient/DataStream code without the chip. Emulator implements
+ *  the subset of AT commands used by ESP8266 library (AT, ATE, AT+RST, GMR,
+ *  UART_CUR, CWMODE, CWJAP, CWQAP, CIPSTA, CIPMUX, CIPMODE, CIPSTO, CIPSERVER,
+ *  CIPSTART, CIPSEND, CIPSENDBUF, CIPCLOSE, passthrough mode and its "+++"
+ *  escape) with configurable reply latencies. Sockets opened through the
+ *  emulator are bridged to real TCP/UDP sockets of the host, so data sent by
+ *  the library ends up on a local server and data sent by the server comes
+ *  back as +IPD frames. Busy, error and missing replies, +IPD frames and
+ *  arbitrary lines can be injected.
+ *
+ *  Emulator is connected to the library either in-process (through Tx hook and
+ *  HAL_ESP_HostInject() of host HAL) or over a pseudo-terminal, whose slave side
+ *  can be opened by HAL_ESP_HostTTY() of the same or another process.
+ ****Host dependencies:
+ *  POSIX threads, BSD sockets, pseudo-terminals (posix_openpt)
+ *
+ *  @version 1.2.1
+ *  V1.0.0
+ *  +AT command set used by ESP8266 library, bridging of sockets to host's
+ *  network stack, fault injection, in-process and pseudo-terminal transport
+ *  V1.1.0
+ *  +Baud rate (AT+UART_CUR) and RTS/CTS flow control of in-process transport:
+ *  data crossing the link at mismatched or unreliable baud rate is corrupted
+ *  and reported as UART error, output pauses while host HAL raises RTS.
+ *  Emulated module reboots when it's powered off and on (HAL_ESP_HWEnable)
+ *  V1.2.0
+ *  +Buffered send (AT+CIPSENDBUF): segment is taken right away and its delivery
+ *  confirmed later (<link>,<segment>,SEND OK), segments are in flight together
+ *  V1.2.1
+ *  +Latency of SEND OK can be changed while emulator runs (HAL_ESP_EmuSendOk)
+ */
+#include "hwconfig.h"
+
+//  Compile following section only if hwconfig.h says to include this module
+#if !defined(ROVERKERNEL_HAL_HOST_HAL_ESP_EMU_H_) && defined(__HAL_USE_ESP8266__) \
+    && defined(__BOARD_HOST__)
+#define ROVERKERNEL_HAL_HOST_HAL_ESP_EMU_H_
+
+//  Max number of sockets (link IDs) of emulated ESP
+#define HAL_ESP_EMU_MAX_LINK    5
+//  Max payload of a single +IPD frame (ESP splits received data into TCP MSS)
+#define HAL_ESP_EMU_IPD_MAX     1460
+//  Max length of data accepted by a single CIPSEND
+#define HAL_ESP_EMU_SEND_MAX    2048
+//  Silence in ms required around "+++" to leave passthrough mode
+#define HAL_ESP_EMU_PT_GUARD    20
+
+/**
+ * Configuration of emulated ESP, initialize with HAL_ESP_EmuDefaults()
+ */
+struct _espEmuCfg
+{
+    uint32_t    replyUs;    //  Latency of reply to plain commands
+    uint32_t    promptUs;   //  Latency of "> " prompt after CIPSEND
+    uint32_t    sendOkUs;   //  Latency of SEND OK after the last byte of data
+    uint32_t    connectUs;  //  Latency of reply to CIPSTART
+    uint32_t    joinUs;     //  Time to connect to AP (CWJAP)
+    int8_t      rssi;       //  RSSI reported by CWJAP? (dBm)
+    bool        echo;       //  Echo commands back until ATE0 is received
+    bool        bridge;     //  Connect sockets to real servers (otherwise
+                            //  connecting always succeeds, data is dropped)
+    const char  *bridgeIP;  //  If not 0, connect to this IP address instead
+                            //  of the one in CIPSTART (servers listen on it)
+    const char  *ip;        //  Station IP address reported by CIPSTA?
+    uint32_t    baud;       //  Baud rate after power-up (stored in flash)
+    uint32_t    maxBaud;    //  Highest baud rate link works at without
+                            //  errors (0 - no limit), in-process only
+    bool        sendBuf;    //  Firmware supports buffered send (CIPSENDBUF)
+};
+
+/**
+ * Counters of emulated ESP
+ */
+struct _espEmuStats
+{
+    uint32_t    commands;   //  Commands received
+    uint32_t    sends;      //  Completed CIPSENDs (and CIPSENDBUFs)
+    uint32_t    segments;   //  Segments taken by CIPSENDBUF
+    uint32_t    bytesToNet; //  Bytes forwarded from library to sockets
+    uint32_t    bytesToESP; //  Bytes received on sockets and sent to library
+    uint32_t    faults;     //  Injected busy/error/missing replies
+    uint32_t    lineErrors; //  Transfers corrupted by baud rate mismatch
+    uint32_t    boots;      //  Reboots (power cycle or AT+RST)
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern void     HAL_ESP_EmuDefaults(struct _espEmuCfg *cfg);
+extern bool     HAL_ESP_EmuStart(const struct _espEmuCfg *cfg);
+extern bool     HAL_ESP_EmuStartPty(const struct _espEmuCfg *cfg, char *slave,
+                                    uint16_t slaveLen);
+/**     Fault and event injection       */
+extern void     HAL_ESP_EmuBusy(uint16_t n);
+extern void     HAL_ESP_EmuError(uint16_t n);
+extern void     HAL_ESP_EmuDrop(uint16_t n);
+extern void     HAL_ESP_EmuSendOk(uint32_t us);
+extern void     HAL_ESP_EmuLine(const char *line);
+extern bool     HAL_ESP_EmuIPD(uint8_t id, const uint8_t *data, uint16_t len);
+extern bool     HAL_ESP_EmuClose(uint8_t id);
+extern struct _espEmuStats HAL_ESP_EmuStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROVERKERNEL_HAL_HOST_HAL_ESP_EMU_H_ */
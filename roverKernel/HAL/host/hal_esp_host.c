@@ -0,0 +1,842 @@
+/**
+ * hal_esp_host.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "hal_esp_host.h"
+
+#if defined(__HAL_USE_ESP8266__) && defined(__BOARD_HOST__)
+
+#include "libs/myLib.h"
+#include "HAL/host/hal_common_host.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <termios.h>
+
+//  Length of half of the Rx ring (length of a single uDMA transfer)
+#define ESP_RX_DMA_HALF     (HAL_ESP_RX_RING_SIZE / 2)
+//  Max length of a single uDMA transfer
+#define ESP_DMA_MAX_XFER    1024
+
+/// Rx ring buffer, filled by emulated uDMA and read from main context
+static uint8_t _rxRing[HAL_ESP_RX_RING_SIZE];
+/// Number of bytes written by emulated uDMA, published to reader, parsed and
+/// released by reader
+static volatile uint32_t _rxDMA = 0;
+static volatile uint32_t _rxHead = 0;
+static volatile uint32_t _rxRead = 0;
+static volatile uint32_t _rxTail = 0;
+static volatile uint32_t _rxOverrun = 0;
+/// Emulated uDMA stopped at half of the ring reader still holds data in
+static volatile bool _rxStall = false;
+static volatile uint32_t _rxErrors = 0;
+/// Scan for message boundaries in received data: number of characters of +IPD
+/// header matched, whether header fields are being read, length read so far,
+/// bytes of +IPD payload still to come and receive losses seen by last scan
+static uint8_t _rxScanMatch = 0;
+static bool _rxScanHdr = false;
+static uint32_t _rxScanLen = 0;
+static uint32_t _rxScanIPD = 0;
+static uint32_t _rxScanLost = 0;
+/// Emulated RTS/CTS flow control, and whether ESP was asked to pause
+static bool _flowCtrl = false;
+static volatile bool _rtsStop = false;
+
+/// Tx ring buffer, filled from main context and drained by emulated uDMA
+static uint8_t _txRing[HAL_ESP_TX_RING_SIZE];
+static volatile uint32_t _txHead = 0;
+static volatile uint32_t _txTail = 0;
+/// Length of emulated uDMA transfer in progress, and whether it's running
+static volatile uint16_t _txXfer = 0;
+static volatile bool _txBusy = false;
+static pthread_t _txThread;
+static uint32_t _baud = 1000000;
+
+/// Emulated state of UART and ESP chip
+static void (*_uartHandler)(void) = 0;
+static void (*_txHook)(char) = 0;
+static volatile bool _intEnabled = false;
+static volatile uint32_t _intStatus = 0;
+static bool _hwEnabled = false;
+static volatile uint32_t _hwCycles = 0;
+
+/// Emulated watchdog timer
+static void (*_wdHandler)(void) = 0;
+static pthread_t _wdThread;
+static volatile bool _wdRun = false;
+static volatile uint64_t _wdDeadline = 0;
+static uint32_t _wdTimeout = 0;
+static volatile bool _uartPend = false;
+
+/// Serial device (or pseudo-terminal) the emulated UART is attached to
+static int _ttyFd = -1;
+static pthread_t _ttyThread;
+
+/// Emulated software interrupt, pending until UART handler returns
+static void (*_softHandler)(void) = 0;
+static volatile bool _softPend = false;
+static volatile bool _softMasked = false;
+static __thread bool _inSoftInt = false;
+
+/// Time spent in UART interrupt handler
+static uint64_t _isrNs = 0;
+static uint32_t _isrCalls = 0;
+
+/**
+ * Get monotonic time in nanoseconds
+ */
+static uint64_t _HOST_Now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * Run software interrupt handler in emulated interrupt context, if it's
+ * pending and not masked
+ */
+static void _HOST_SoftInt()
+{
+    if (!_softPend || _softMasked || (_softHandler == 0))
+        return;
+
+    _HOST_IntEnter();
+    if (_softPend && !_softMasked)
+    {
+        _softPend = false;
+        _inSoftInt = true;
+        _softHandler();
+        _inSoftInt = false;
+    }
+    _HOST_IntExit();
+}
+
+/**
+ * Run UART interrupt handler in emulated interrupt context, if it's enabled
+ * @param status interrupt flags to raise
+ */
+static void _HOST_UARTInt(uint32_t status)
+{
+    uint64_t start;
+
+    if (!_intEnabled || (_uartHandler == 0))
+        return;
+
+    _HOST_IntEnter();
+    _intStatus |= status;
+    start = _HOST_Now();
+    _uartHandler();
+    _isrNs += _HOST_Now() - start;
+    _isrCalls++;
+    _HOST_IntExit();
+
+    //  Software interrupt is tail-chained to the handler that triggered it
+    _HOST_SoftInt();
+}
+
+/**
+ * Thread emulating watchdog timer, raises interrupt when deadline expires.
+ * Pending UART interrupt (HAL_ESP_WDClearInt) is executed right after it.
+ */
+static void* _HOST_WDThread(void *arg)
+{
+    UNUSED((int32_t)(intptr_t)arg);
+    while (1)
+    {
+        usleep(1000);
+
+        if (!_wdRun || (_HOST_Now() < _wdDeadline))
+            continue;
+
+        _wdRun = false;
+        _HOST_IntEnter();
+        _wdHandler();
+        _HOST_IntExit();
+
+        if (_uartPend)
+        {
+            _uartPend = false;
+            _HOST_UARTInt(0);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Write bytes to attached serial device
+ */
+static void _HOST_TTYWrite(const uint8_t *data, uint16_t len)
+{
+    ssize_t n;
+
+    while (len > 0)
+    {
+        n = write(_ttyFd, data, len);
+        if (n <= 0)
+            break;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * Thread reading attached serial device, received data is passed to emulated
+ * uDMA the same way test code injects it
+ */
+static void* _HOST_TTYThread(void *arg)
+{
+    uint8_t buf[256];
+    ssize_t n;
+
+    UNUSED((int32_t)(intptr_t)arg);
+
+    while (1)
+    {
+        n = read(_ttyFd, buf, sizeof(buf));
+        if (n > 0)
+            HAL_ESP_HostInject(buf, (uint16_t)n);
+        else
+            usleep(1000);
+    }
+
+    return 0;
+}
+
+/**
+ * Account for finished emulated uDMA transfer from Tx ring and start transfer
+ * of the next continuous block of data waiting in the ring (if any)
+ * @note Has to be called with interrupts disabled
+ */
+static void _HOST_TxAdvance()
+{
+    uint32_t idx, len;
+
+    if (_txBusy)
+        return;
+
+    _txTail += _txXfer;
+    _txXfer = 0;
+
+    idx = _txTail & (HAL_ESP_TX_RING_SIZE - 1);
+    len = min(_txHead - _txTail, HAL_ESP_TX_RING_SIZE - idx);
+    len = min(len, ESP_DMA_MAX_XFER);
+    if (len == 0)
+        return;
+
+    _txXfer = len;
+    _txBusy = true;
+}
+
+/**
+ * Thread emulating uDMA moving data from Tx ring to UART. Every byte is passed
+ * to Tx hook, transfer takes as long as it would on the wire. UART interrupt
+ * is raised when transfer completes.
+ */
+static void* _HOST_TxThread(void *arg)
+{
+    uint32_t idx;
+
+    UNUSED((int32_t)(intptr_t)arg);
+    while (1)
+    {
+        if (!_txBusy)
+        {
+            usleep(50);
+            continue;
+        }
+
+        idx = _txTail & (HAL_ESP_TX_RING_SIZE - 1);
+        for (uint16_t i = 0; i < _txXfer; i++)
+            if (_txHook != 0)
+                _txHook(_txRing[idx + i]);
+        if (_ttyFd >= 0)
+            _HOST_TTYWrite(_txRing + idx, _txXfer);
+        //  10 bits per byte on the wire (start, 8 data, stop)
+        usleep((uint64_t)_txXfer * 10000000ULL / _baud);
+
+        _HOST_IntEnter();
+        _txBusy = false;
+        _HOST_IntExit();
+        _HOST_UARTInt(HAL_ESP_HOST_INT_DMATX);
+    }
+
+    return 0;
+}
+
+/**
+ * Emulated UART port needs no configuration, baud rate only determines speed
+ * at which emulated uDMA sends data
+ * @param baud designated speed of communication
+ * @param flowCtrl true to use (emulated) RTS/CTS flow control
+ * @return HAL library error code
+ */
+uint32_t HAL_ESP_InitPort(uint32_t baud, bool flowCtrl)
+{
+    if (baud > 0)
+        _baud = baud;
+    _flowCtrl = flowCtrl;
+    _rtsStop = false;
+    return HAL_OK;
+}
+
+/**
+ * Attach interrupt handler to emulated UART, reset Rx and Tx rings and start
+ * thread emulating uDMA of Tx ring
+ */
+void HAL_ESP_RegisterIntHandler(void((*intHandler)(void)))
+{
+    static bool txInit = false;
+
+    _uartHandler = intHandler;
+    _rxDMA = _rxHead = _rxRead = _rxTail = 0;
+    _rxStall = false;
+
+    HAL_BOARD_InterruptEnable(false);
+    _txHead = _txTail = _txXfer = 0;
+    _txBusy = false;
+    HAL_BOARD_InterruptEnable(true);
+    if (!txInit && (pthread_create(&_txThread, 0, _HOST_TxThread, 0) == 0))
+        txInit = true;
+}
+
+/**
+ * Enable or disable emulated ESP chip
+ * @param enable is state of device
+ */
+void HAL_ESP_HWEnable(bool enable)
+{
+    if (!_hwEnabled && enable)
+        _hwCycles++;
+    _hwEnabled = enable;
+}
+
+/**
+ * Check whether the emulated chip is enabled or disabled
+ */
+bool HAL_ESP_IsHWEnabled()
+{
+    return _hwEnabled;
+}
+
+/**
+ * Enable/disable emulated UART interrupt
+ * @param enable
+ */
+void HAL_ESP_IntEnable(bool enable)
+{
+    _intEnabled = enable;
+}
+
+/**
+ * Clear all interrupt flags when an interrupt occurs
+ * @return interrupt flags raised (HAL_ESP_HOST_INT_*)
+ */
+int32_t HAL_ESP_ClearInt()
+{
+    int32_t retVal = _intStatus;
+
+    _intStatus = 0;
+    return retVal;
+}
+
+/**
+ * Emulated UART transmits immediately, it's never busy
+ */
+bool HAL_ESP_UARTBusy()
+{
+    return false;
+}
+
+/**
+ * Send single char to emulated ESP (passed to hook set by test code)
+ * @param c character to send
+ */
+void HAL_ESP_SendChar(char c)
+{
+    if (_txHook != 0)
+        _txHook(c);
+    if (_ttyFd >= 0)
+        _HOST_TTYWrite((const uint8_t*)&c, 1);
+}
+
+/**
+ * Emulated uDMA moves all data into the ring, UART FIFO is always empty
+ */
+bool HAL_ESP_CharAvail()
+{
+    return false;
+}
+char HAL_ESP_GetChar()
+{
+    return 0;
+}
+
+/**
+ * Start thread emulating watchdog timer
+ */
+void HAL_ESP_InitWD(void((*intHandler)(void)))
+{
+    static bool wdInit = false;
+
+    _wdHandler = intHandler;
+    if (!wdInit && (pthread_create(&_wdThread, 0, _HOST_WDThread, 0) == 0))
+        wdInit = true;
+}
+
+/**
+ * On/Off control for emulated WD timer
+ * @param enable desired state of timer (true-run/false-stop)
+ * @param ms time in millisec. after which the communication is interrupted
+ */
+void HAL_ESP_WDControl(bool enable, uint32_t ms)
+{
+    if (ms != 0)
+        _wdTimeout = ms;
+
+    _wdRun = false;
+    if (enable)
+    {
+        _wdDeadline = _HOST_Now() + (uint64_t)_wdTimeout * 1000000ULL;
+        _wdRun = true;
+    }
+}
+
+/**
+ * Stop WD timer and request UART interrupt after WD interrupt returns
+ */
+void HAL_ESP_WDClearInt()
+{
+    _wdRun = false;
+    _uartPend = true;
+}
+
+/**
+ * Scan bytes just published in Rx ring for end of message parser can act on:
+ * line end, send prompt ('>') or end of +IPD payload (which has no line end).
+ * Payload length is taken from +IPD,[id,]len: header so payload is skipped in
+ * one step and bytes inside it aren't mistaken for line ends.
+ * @param from position of the first new byte in the ring
+ * @param to position after the last new byte in the ring
+ * @return true if a boundary was found in new bytes
+ */
+static bool _ESP_RxScan(uint32_t from, uint32_t to)
+{
+    const char ipd[] = "+IPD,";
+    bool retVal = false;
+    uint8_t c;
+
+    while (from != to)
+    {
+        //  Skip payload of +IPD frame, frame ends with its last byte
+        if (_rxScanIPD > 0)
+        {
+            uint32_t n = to - from;
+
+            if (n > _rxScanIPD)
+                n = _rxScanIPD;
+            _rxScanIPD -= n;
+            from += n;
+            retVal |= (_rxScanIPD == 0);
+            continue;
+        }
+
+        c = _rxRing[(from++) & (HAL_ESP_RX_RING_SIZE - 1)];
+
+        //  Reading fields of +IPD header, last number before ':' is length
+        if (_rxScanHdr)
+        {
+            if ((c >= '0') && (c <= '9'))
+                _rxScanLen = _rxScanLen * 10 + (c - '0');
+            else if (c == ',')
+                _rxScanLen = 0;
+            else
+            {
+                if (c == ':')
+                    _rxScanIPD = _rxScanLen;
+                _rxScanHdr = false;
+            }
+            continue;
+        }
+
+        if ((c == '\n') || (c == '>'))
+            retVal = true;
+
+        //  Match beginning of +IPD header
+        if (c == ipd[_rxScanMatch])
+            _rxScanMatch++;
+        else
+            _rxScanMatch = (c == ipd[0]) ? 1 : 0;
+        if (_rxScanMatch == (sizeof(ipd) - 1))
+        {
+            _rxScanMatch = 0;
+            _rxScanLen = 0;
+            _rxScanHdr = true;
+        }
+    }
+
+    return retVal;
+}
+
+/**
+ * Called from UART interrupt: publish data written into Rx ring by emulated
+ * uDMA since the last call
+ * @param intStatus interrupt flags returned by HAL_ESP_ClearInt()
+ * @param boundary[out] set to true if there's data worth parsing: end of line,
+ * prompt or +IPD payload was received, line went idle, data was lost or ring
+ * is filling up; false while the middle of a message is being received
+ * @return number of new bytes available in the ring
+ */
+uint16_t HAL_ESP_RxCollect(uint32_t intStatus, bool *boundary)
+{
+    uint32_t oldHead = _rxHead;
+
+    _rxHead = _rxDMA;
+
+    //  Ask ESP to pause before the ring could overflow
+    if (_flowCtrl && ((_rxHead - _rxTail) > HAL_ESP_RTS_HIGH))
+        _rtsStop = true;
+
+    //  Scan is out of step with data once something got lost, parser resyncs
+    if ((_rxOverrun + _rxErrors) != _rxScanLost)
+    {
+        _rxScanLost = _rxOverrun + _rxErrors;
+        _rxScanMatch = 0;
+        _rxScanHdr = false;
+        _rxScanIPD = 0;
+        *boundary = true;
+    }
+    else
+        *boundary = _ESP_RxScan(oldHead, _rxHead) ||
+                    ((intStatus & HAL_ESP_HOST_INT_RT) != 0) ||
+                    ((_rxHead - _rxRead) > HAL_ESP_RTS_HIGH);
+
+    return (uint16_t)(_rxHead - oldHead);
+}
+
+/**
+ * Get number of received bytes waiting in Rx ring
+ * @return number of unread bytes
+ */
+uint16_t HAL_ESP_RxAvail()
+{
+    return (uint16_t)(_rxHead - _rxRead);
+}
+
+/**
+ * Get pointer to the oldest unread byte in Rx ring, without copying data
+ * @param data[out] pointer to the first unread byte
+ * @return number of unread bytes stored continuously from [data]
+ */
+uint16_t HAL_ESP_RxPeek(const uint8_t **data)
+{
+    uint32_t read = _rxRead;
+    uint32_t len = _rxHead - read;
+    uint32_t idx = read & (HAL_ESP_RX_RING_SIZE - 1);
+
+    if (len > (HAL_ESP_RX_RING_SIZE - idx))
+        len = HAL_ESP_RX_RING_SIZE - idx;
+    *data = _rxRing + idx;
+
+    return (uint16_t)len;
+}
+
+/**
+ * Mark bytes returned by HAL_ESP_RxPeek() as read
+ * @param len number of bytes read
+ */
+void HAL_ESP_RxConsume(uint16_t len)
+{
+    _rxRead += len;
+}
+
+/**
+ * Get position of the next unread byte (free-running number of bytes read)
+ */
+uint32_t HAL_ESP_RxPosition()
+{
+    return _rxRead;
+}
+
+/**
+ * Get pointer to already read data at given position in Rx ring
+ * @param pos position in the ring (as returned by HAL_ESP_RxPosition())
+ * @param data[out] pointer to byte at position [pos]
+ * @return number of bytes stored continuously from [data] up to the end of the
+ * ring, or up to the first unread byte
+ */
+uint16_t HAL_ESP_RxPeekAt(uint32_t pos, const uint8_t **data)
+{
+    uint32_t len = _rxRead - pos;
+    uint32_t idx = pos & (HAL_ESP_RX_RING_SIZE - 1);
+
+    if (len > (HAL_ESP_RX_RING_SIZE - idx))
+        len = HAL_ESP_RX_RING_SIZE - idx;
+    *data = _rxRing + idx;
+
+    return (uint16_t)len;
+}
+
+/**
+ * Free space in Rx ring up to given position
+ * @param pos position in the ring (at most HAL_ESP_RxPosition())
+ */
+void HAL_ESP_RxRelease(uint32_t pos)
+{
+    _rxTail = pos;
+
+    //  Enough space got freed, let ESP continue sending
+    if (_rtsStop && ((_rxHead - _rxTail) < HAL_ESP_RTS_LOW))
+        _rtsStop = false;
+}
+
+/**
+ * Get number of Rx ring overruns (emulated uDMA stopped because reader held
+ * data in the whole ring)
+ */
+uint32_t HAL_ESP_RxOverrun()
+{
+    return _rxOverrun;
+}
+
+/**
+ * Get number of receive errors raised by test code
+ */
+uint32_t HAL_ESP_RxErrors()
+{
+    return _rxErrors;
+}
+
+/**
+ * Queue data to be sent to emulated ESP. Data is copied into Tx ring and sent
+ * by emulated uDMA, function waits only if there's no space in the ring.
+ * @param data bytes to send
+ * @param len number of bytes in [data]
+ * @return number of bytes queued (always [len])
+ */
+uint16_t HAL_ESP_TxWrite(const uint8_t *data, uint16_t len)
+{
+    uint32_t idx, n;
+    uint16_t done = 0;
+
+    while (done < len)
+    {
+        n = min(len - done, HAL_ESP_TX_RING_SIZE - (_txHead - _txTail));
+        idx = _txHead & (HAL_ESP_TX_RING_SIZE - 1);
+        if (n > (HAL_ESP_TX_RING_SIZE - idx))
+            n = HAL_ESP_TX_RING_SIZE - idx;
+        memcpy((void*)(_txRing + idx), (void*)(data + done), n);
+        done += n;
+
+        HAL_BOARD_InterruptEnable(false);
+        _txHead += n;
+        _HOST_TxAdvance();
+        HAL_BOARD_InterruptEnable(true);
+
+        if (n == 0)
+            usleep(50);
+    }
+
+    return len;
+}
+
+/**
+ * Called from UART interrupt: continue sending data from Tx ring once emulated
+ * uDMA transfer completes
+ * @param intStatus interrupt flags returned by HAL_ESP_ClearInt()
+ * @return true if all data from the ring was sent
+ */
+bool HAL_ESP_TxCollect(uint32_t intStatus)
+{
+    if (!(intStatus & HAL_ESP_HOST_INT_DMATX))
+        return false;
+
+    _HOST_TxAdvance();
+
+    return (_txHead == _txTail);
+}
+
+/**
+ * Get number of bytes in Tx ring that haven't been sent yet
+ */
+uint16_t HAL_ESP_TxPending()
+{
+    uint16_t retVal;
+
+    HAL_BOARD_InterruptEnable(false);
+    _HOST_TxAdvance();
+    retVal = (uint16_t)(_txHead - _txTail);
+    HAL_BOARD_InterruptEnable(true);
+
+    return retVal;
+}
+
+/**
+ * Register handler of emulated software interrupt
+ * @param intHandler function to call when software interrupt is triggered
+ */
+void HAL_ESP_InitSoftInt(void((*intHandler)(void)))
+{
+    _softHandler = intHandler;
+}
+
+/**
+ * Trigger software interrupt, it runs once UART interrupt handler returns
+ */
+void HAL_ESP_SoftIntTrigger()
+{
+    _softPend = true;
+}
+
+/**
+ * Hold back software interrupt while main context is doing the same work,
+ * interrupt triggered in the meantime runs once it's unmasked
+ * @param mask true to hold back software interrupt, false to allow it
+ */
+void HAL_ESP_SoftIntMask(bool mask)
+{
+    //  Interrupt handler itself can't be preempted by it
+    if (_inSoftInt)
+        return;
+
+    HAL_BOARD_InterruptEnable(false);
+    _softMasked = mask;
+    HAL_BOARD_InterruptEnable(true);
+    if (!mask)
+        _HOST_SoftInt();
+}
+
+/**
+ * Emulate ESP sending data: bytes are written into Rx ring the way uDMA does
+ * it, raising UART interrupt every time half of the ring fills up and once
+ * more at the end (idle line). Like uDMA, emulation doesn't write into half of
+ * the ring until reader released data it held there before, bytes received in
+ * the meantime are lost (UART receive error)
+ * @param data bytes "sent" by ESP
+ * @param len number of bytes in [data]
+ */
+void HAL_ESP_HostInject(const uint8_t *data, uint16_t len)
+{
+    uint32_t half;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        half = _rxDMA - (_rxDMA % ESP_RX_DMA_HALF);
+        if ((int32_t)(_rxTail - (half - ESP_RX_DMA_HALF)) < 0)
+        {
+            if (!_rxStall)
+                _rxErrors++;
+            _rxStall = true;
+            continue;
+        }
+        if (_rxStall)
+            _rxOverrun++;
+        _rxStall = false;
+        _rxRing[_rxDMA & (HAL_ESP_RX_RING_SIZE - 1)] = data[i];
+        _rxDMA++;
+        if ((_rxDMA % ESP_RX_DMA_HALF) == 0)
+            _HOST_UARTInt(HAL_ESP_HOST_INT_DMARX);
+    }
+    _HOST_UARTInt(HAL_ESP_HOST_INT_RT);
+}
+
+/**
+ * Set hook receiving characters sent to emulated ESP
+ * @param txHook function called for every character sent
+ */
+void HAL_ESP_HostTxHook(void((*txHook)(char)))
+{
+    _txHook = txHook;
+}
+
+/**
+ * Attach emulated UART to a serial device, e.g. slave side of pseudo-terminal
+ * created by HAL_ESP_EmuStartPty() or USB-serial adapter wired to real ESP.
+ * Device is put in raw mode; everything sent is also written to it and
+ * everything read from it is injected into Rx ring.
+ * @param path path to the device
+ * @return true if device got opened, false otherwise
+ */
+bool HAL_ESP_HostTTY(const char *path)
+{
+    struct termios tio;
+
+    if (_ttyFd >= 0)
+        return false;
+
+    _ttyFd = open(path, O_RDWR | O_NOCTTY);
+    if (_ttyFd < 0)
+        return false;
+
+    if (tcgetattr(_ttyFd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(_ttyFd, TCSANOW, &tio);
+    }
+
+    if (pthread_create(&_ttyThread, 0, _HOST_TTYThread, 0) != 0)
+    {
+        close(_ttyFd);
+        _ttyFd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Get baud rate emulated UART currently runs at
+ */
+uint32_t HAL_ESP_HostBaud()
+{
+    return _baud;
+}
+
+/**
+ * Check emulated RTS line: with flow control enabled, ESP has to stop sending
+ * while reader falls behind (Rx ring fill level crossed HAL_ESP_RTS_HIGH)
+ * @return true if more data can be injected, false if ESP should pause
+ */
+bool HAL_ESP_HostRxReady()
+{
+    return (!_flowCtrl || !_rtsStop);
+}
+
+/**
+ * Emulate UART receive error (e.g. framing error on baud rate mismatch)
+ */
+void HAL_ESP_HostRxError()
+{
+    _rxErrors++;
+}
+
+/**
+ * Get number of times emulated chip got powered on
+ */
+uint32_t HAL_ESP_HostPowerCycles()
+{
+    return _hwCycles;
+}
+
+/**
+ * Get time spent in UART interrupt handler
+ * @param isrNs[out] total time in ns spent in handler
+ * @param isrCalls[out] number of handler calls
+ * @param rxBytes[out] number of bytes received so far
+ */
+void HAL_ESP_HostISRStats(uint64_t *isrNs, uint32_t *isrCalls, uint32_t *rxBytes)
+{
+    *isrNs = _isrNs;
+    *isrCalls = _isrCalls;
+    *rxBytes = _rxDMA;
+}
+
+#endif  /* __HAL_USE_ESP8266__ && __BOARD_HOST__ */
@@ -0,0 +1,95 @@
+/**
+ * hal_esp_host.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host (PC) stand-in for ESP8266 HAL
+ ****Host dependencies:
+ *  Data "received" from ESP is injected by test code through
+ *  HAL_ESP_HostInject(), which emulates uDMA filling the Rx ring and raises
+ *  UART interrupt the same way the board does (half of the ring full/idle line)
+ *  Data "sent" to ESP is queued in Tx ring and passed to a hook set by
+ *  HAL_ESP_HostTxHook() from a POSIX thread emulating uDMA, at the speed of
+ *  the wire (baud rate passed to HAL_ESP_InitPort())
+ *  RTS flow control line is emulated by a flag test code can check before
+ *  injecting more data (HAL_ESP_HostRxReady()), UART receive errors are raised
+ *  by test code through HAL_ESP_HostRxError(), power cycles of the chip are
+ *  counted (HAL_ESP_HostPowerCycles()) so the emulator doesn't miss short ones
+ *  POSIX thread emulating watchdog timer
+ *  Software interrupt (HAL_ESP_SoftIntTrigger()) runs right after the UART
+ *  interrupt handler that triggered it returns, or once it's unmasked
+ *  Optionally, emulated UART is attached to a serial device or pseudo-terminal
+ *  (HAL_ESP_HostTTY()) so the library can talk to hal_esp_emu emulator running
+ *  in another process, or to real ESP over USB-serial adapter
+ */
+#include "hwconfig.h"
+
+//  Compile following section only if hwconfig.h says to include this module
+#if !defined(ROVERKERNEL_HAL_HOST_HAL_ESP_HOST_H_) && defined(__HAL_USE_ESP8266__) \
+    && defined(__BOARD_HOST__)
+#define ROVERKERNEL_HAL_HOST_HAL_ESP_HOST_H_
+
+/**     Rx ring buffer filled by (emulated) uDMA        */
+#define HAL_ESP_RX_RING_SIZE    2048
+/**     Tx ring buffer drained by (emulated) uDMA       */
+#define HAL_ESP_TX_RING_SIZE    4096
+/**     Flow control (same thresholds as on the board)      */
+#define HAL_ESP_RTS_HIGH        (HAL_ESP_RX_RING_SIZE / 2 - 64)
+#define HAL_ESP_RTS_LOW         (HAL_ESP_RX_RING_SIZE / 4)
+
+/**     Emulated UART interrupt flags       */
+#define HAL_ESP_HOST_INT_RT     0x01    /// Receive timeout (idle line)
+#define HAL_ESP_HOST_INT_DMARX  0x02    /// uDMA filled half of the Rx ring
+#define HAL_ESP_HOST_INT_DMATX  0x04    /// uDMA transfer from Tx ring completed
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern uint32_t    HAL_ESP_InitPort(uint32_t baud, bool flowCtrl);
+extern void        HAL_ESP_RegisterIntHandler(void((*intHandler)(void)));
+extern void        HAL_ESP_HWEnable(bool enable);
+extern bool        HAL_ESP_IsHWEnabled();
+extern void        HAL_ESP_IntEnable(bool enable);
+extern int32_t     HAL_ESP_ClearInt();
+extern bool        HAL_ESP_UARTBusy();
+extern void        HAL_ESP_SendChar(char c);
+extern bool        HAL_ESP_CharAvail();
+extern char        HAL_ESP_GetChar();
+extern void        HAL_ESP_InitWD(void((*intHandler)(void)));
+extern void        HAL_ESP_WDControl(bool enable, uint32_t timeout);
+extern void        HAL_ESP_WDClearInt();
+extern uint16_t    HAL_ESP_RxCollect(uint32_t intStatus, bool *boundary);
+extern uint16_t    HAL_ESP_RxAvail();
+extern uint16_t    HAL_ESP_RxPeek(const uint8_t **data);
+extern void        HAL_ESP_RxConsume(uint16_t len);
+extern uint32_t    HAL_ESP_RxPosition();
+extern uint16_t    HAL_ESP_RxPeekAt(uint32_t pos, const uint8_t **data);
+extern void        HAL_ESP_RxRelease(uint32_t pos);
+extern uint32_t    HAL_ESP_RxOverrun();
+extern uint32_t    HAL_ESP_RxErrors();
+extern uint16_t    HAL_ESP_TxWrite(const uint8_t *data, uint16_t len);
+extern bool        HAL_ESP_TxCollect(uint32_t intStatus);
+extern uint16_t    HAL_ESP_TxPending();
+extern void        HAL_ESP_InitSoftInt(void((*intHandler)(void)));
+extern void        HAL_ESP_SoftIntTrigger();
+extern void        HAL_ESP_SoftIntMask(bool mask);
+
+/**     Host-only API used by test code in place of ESP chip        */
+extern void        HAL_ESP_HostInject(const uint8_t *data, uint16_t len);
+extern void        HAL_ESP_HostTxHook(void((*txHook)(char)));
+extern bool        HAL_ESP_HostTTY(const char *path);
+extern uint32_t    HAL_ESP_HostBaud();
+extern bool        HAL_ESP_HostRxReady();
+extern void        HAL_ESP_HostRxError();
+extern uint32_t    HAL_ESP_HostPowerCycles();
+extern void        HAL_ESP_HostISRStats(uint64_t *isrNs, uint32_t *isrCalls,
+                                        uint32_t *rxBytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROVERKERNEL_HAL_HOST_HAL_ESP_HOST_H_ */
@@ -0,0 +1,340 @@
+/**
+ * hal_ts_host.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     //  dl_iterate_phdr()
+#endif
+#include "hal_ts_host.h"
+
+#if defined(__HAL_USE_TASKSCH__) && defined(__BOARD_HOST__)
+
+#include "libs/myLib.h"
+#include "HAL/host/hal_common_host.h"
+
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <link.h>
+
+///Keep track whether the SysTick has already been configured
+static bool _systickSet = false;
+static volatile bool _systickRun = false;
+static uint32_t _periodMS = 0;
+static void (*_sysTickHook)(void) = 0;
+static pthread_t _sysTickThread;
+
+/**
+ * Thread emulating SysTick interrupt, calls hook every period while enabled
+ */
+static void* _HOST_SysTickThread(void *arg)
+{
+    UNUSED((int32_t)(intptr_t)arg);
+    while (1)
+    {
+        usleep(_periodMS * 1000);
+
+        if (!_systickRun)
+            continue;
+
+        _HOST_IntEnter();
+        _sysTickHook();
+        _HOST_IntExit();
+    }
+
+    return 0;
+}
+
+/**
+ * Setup emulated SysTick interrupt and period
+ * @param periodMs time in milliseconds how often to trigger an interrupt
+ * @param custHook pointer to function that will be called on SysTick interrupt
+ * @return HAL library error code
+ */
+uint8_t HAL_TS_InitSysTick(uint32_t periodMs, void((*custHook)(void)))
+{
+    /// Forbid configuring the timer period multiple times
+    if (_systickSet)
+        return HAL_SYSTICK_SET_ERR;
+    if (periodMs < 1)
+        return HAL_SYSTICK_PEROOR;
+
+    _periodMS = periodMs;
+    _sysTickHook = custHook;
+
+    if (pthread_create(&_sysTickThread, 0, _HOST_SysTickThread, 0) != 0)
+        return HAL_SYSTICK_NOTSET_ERR;
+    _systickSet = true;
+
+    return HAL_OK;
+}
+
+/**
+ * Wrapper for SysTick start function
+ */
+uint8_t HAL_TS_StartSysTick()
+{
+    if (!_systickSet)
+        return HAL_SYSTICK_NOTSET_ERR;
+
+    _systickRun = true;
+    return HAL_OK;
+}
+
+/**
+ * Wrapper for SysTick stop function
+ */
+uint8_t HAL_TS_StopSysTick()
+{
+    if (!_systickSet)
+        return HAL_SYSTICK_NOTSET_ERR;
+
+    _systickRun = false;
+    return HAL_OK;
+}
+
+/**
+ * Calculate time step between two SysTick interrupts (in milliseconds)
+ * @return time step between two SysTicks (in ms)
+ */
+uint32_t HAL_TS_GetTimeStepMS()
+{
+    return _periodMS;
+}
+
+/**
+ * Save task scheduler snapshot into a file emulating memory preserved across
+ * warm reset. File holds snapshot length, CRC and data.
+ * @param data serialized snapshot of task scheduler
+ * @param len length of [data] array
+ * @return HAL library error code
+ */
+uint8_t HAL_TS_SnapshotSave(const uint8_t *data, uint16_t len)
+{
+    FILE *fp;
+    uint16_t crc;
+
+    if (len > HAL_TS_SNAP_SIZE)
+        return HAL_TS_SNAP_SIZE_ERR;
+
+    fp = fopen(HAL_TS_SNAP_FILE, "wb");
+    if (fp == 0)
+        return HAL_TS_SNAP_SIZE_ERR;
+
+    crc = crc16(data, len, 0xFFFF);
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(&crc, sizeof(crc), 1, fp);
+    fwrite(data, 1, len, fp);
+    fclose(fp);
+
+    return HAL_OK;
+}
+
+/**
+ * Load task scheduler snapshot saved before last (emulated) reset. Snapshot is
+ * accepted only after a warm reset, file is removed once read so snapshot can't
+ * be restored twice.
+ * @param data[out] buffer to copy snapshot into
+ * @param maxLen size of [data] buffer
+ * @param warmReset true if process is coming from warm reset, as latched on
+ * board init (see HAL_BOARD_WarmReset())
+ * @return length of snapshot copied into [data], 0 if there's no valid snapshot
+ */
+uint16_t HAL_TS_SnapshotLoad(uint8_t *data, uint16_t maxLen, bool warmReset)
+{
+    FILE *fp;
+    uint16_t len = 0, crc = 0;
+
+    if (!warmReset)
+    {
+        remove(HAL_TS_SNAP_FILE);
+        return 0;
+    }
+
+    fp = fopen(HAL_TS_SNAP_FILE, "rb");
+    if (fp == 0)
+        return 0;
+
+    if ((fread(&len, sizeof(len), 1, fp) != 1) ||
+        (fread(&crc, sizeof(crc), 1, fp) != 1) ||
+        (len > maxLen) ||
+        (fread(data, 1, len, fp) != len) ||
+        (crc != crc16(data, len, 0xFFFF)))
+        len = 0;
+
+    fclose(fp);
+    remove(HAL_TS_SNAP_FILE);
+
+    return len;
+}
+
+/**
+ * Callback of dl_iterate_phdr() - fold GNU build-ID note of the executable
+ * into 32-bit identifier. Only the first object (executable itself) is checked.
+ */
+static int _HOST_BuildID(struct dl_phdr_info *info, size_t size, void *arg)
+{
+    uint32_t *id = (uint32_t*)arg;
+
+    UNUSED((int32_t)size);
+    for (uint16_t i = 0; i < info->dlpi_phnum; i++)
+    {
+        const uint8_t *it, *end;
+
+        if (info->dlpi_phdr[i].p_type != PT_NOTE)
+            continue;
+
+        it = (const uint8_t*)(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+        end = it + info->dlpi_phdr[i].p_memsz;
+        while ((it + sizeof(ElfW(Nhdr))) <= end)
+        {
+            const ElfW(Nhdr) *note = (const ElfW(Nhdr)*)it;
+            const uint8_t *desc = it + sizeof(ElfW(Nhdr)) +
+                                  ((note->n_namesz + 3) & ~3);
+
+            if ((note->n_type == NT_GNU_BUILD_ID) && (note->n_namesz == 4) &&
+                (memcmp(it + sizeof(ElfW(Nhdr)), "GNU", 4) == 0))
+            {
+                for (uint32_t j = 0; j < note->n_descsz; j++)
+                    *id ^= (uint32_t)desc[j] << (8 * (j % 4));
+                return 1;
+            }
+            it = desc + ((note->n_descsz + 3) & ~3);
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Get identifier of firmware image, used to reject snapshot of task scheduler
+ * made by a different build. Taken from GNU build-ID the linker stored in the
+ * executable, falls back to build time if executable has no build-ID.
+ * @return identifier of firmware image
+ */
+uint32_t HAL_TS_ImageID()
+{
+    static uint32_t id = 0;
+
+    if (id == 0)
+        dl_iterate_phdr(_HOST_BuildID, &id);
+    if (id == 0)
+    {
+        const char build[] = __DATE__ " " __TIME__;
+        id = crc16((const uint8_t*)build, sizeof(build), 0xFFFF);
+    }
+
+    return id;
+}
+
+///Keep track whether the hard-tier timer has already been configured
+static bool _hardTimerSet = false;
+static volatile bool _hardTimerRun = false;
+static uint32_t _hardPeriodUs = 0;
+static void (*_hardTimerHook)(void) = 0;
+static pthread_t _hardTimerThread;
+
+/**
+ * Thread emulating periodic timer interrupt of hard real-time tier. Sleeps
+ * until absolute deadlines so period doesn't drift.
+ */
+static void* _HOST_HardTimerThread(void *arg)
+{
+    struct timespec next;
+
+    UNUSED((int32_t)(intptr_t)arg);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (1)
+    {
+        next.tv_nsec += _hardPeriodUs * 1000;
+        while (next.tv_nsec >= 1000000000)
+        {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0);
+
+        if (!_hardTimerRun)
+            continue;
+
+        _HOST_IntEnter();
+        _hardTimerHook();
+        _HOST_IntExit();
+    }
+
+    return 0;
+}
+
+/**
+ * Setup emulated periodic timer interrupt used as base tick of hard tier
+ * @param periodUs time in microseconds how often to trigger an interrupt
+ * @param custHook pointer to function that will be called on timer interrupt
+ * @return HAL library error code
+ */
+uint8_t HAL_TS_InitHardTimer(uint32_t periodUs, void((*custHook)(void)))
+{
+    if (_hardTimerSet)
+        return HAL_SYSTICK_SET_ERR;
+    if (periodUs < 1)
+        return HAL_SYSTICK_PEROOR;
+
+    _hardPeriodUs = periodUs;
+    _hardTimerHook = custHook;
+
+    if (pthread_create(&_hardTimerThread, 0, _HOST_HardTimerThread, 0) != 0)
+        return HAL_SYSTICK_NOTSET_ERR;
+    _hardTimerSet = true;
+
+    return HAL_OK;
+}
+
+/**
+ * Start emulated hard-tier timer
+ */
+uint8_t HAL_TS_StartHardTimer()
+{
+    if (!_hardTimerSet)
+        return HAL_SYSTICK_NOTSET_ERR;
+
+    _hardTimerRun = true;
+    return HAL_OK;
+}
+
+/**
+ * Stop emulated hard-tier timer
+ */
+uint8_t HAL_TS_StopHardTimer()
+{
+    if (!_hardTimerSet)
+        return HAL_SYSTICK_NOTSET_ERR;
+
+    _hardTimerRun = false;
+    return HAL_OK;
+}
+
+/**
+ * Read free-running cycle counter, emulated by monotonic clock in nanoseconds
+ * @return current value of cycle counter
+ */
+uint32_t HAL_TS_GetCycles()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec);
+}
+
+/**
+ * Get number of cycle counter ticks in one microsecond
+ * @return cycles per microsecond
+ */
+uint32_t HAL_TS_CyclesPerUS()
+{
+    return 1000;
+}
+
+#endif  /* __HAL_USE_TASKSCH__ && __BOARD_HOST__ */
@@ -0,0 +1,61 @@
+/**
+ * hal_ts_host.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host (PC) stand-in for task scheduler HAL
+ ****Host dependencies:
+ *  POSIX thread emulating SysTick interrupt
+ *  POSIX thread emulating periodic timer interrupt of hard real-time tier
+ *  Monotonic clock (cycle counter with 1ns resolution)
+ *  File on host file system emulating memory preserved across warm reset
+ *  (path set by HAL_TS_SNAP_FILE)
+ */
+#include "hwconfig.h"
+
+//  Compile following section only if hwconfig.h says to include this module
+#if !defined(ROVERKERNEL_HAL_HOST_HAL_TS_HOST_H_) && defined(__HAL_USE_TASKSCH__) \
+    && defined(__BOARD_HOST__)
+#define ROVERKERNEL_HAL_HOST_HAL_TS_HOST_H_
+
+/**     SysTick peripheral error codes      */
+#define HAL_SYSTICK_PEROOR      1   /// Period value for SysTick is out of range
+#define HAL_SYSTICK_SET_ERR     2   /// SysTick has already been configured
+#define HAL_SYSTICK_NOTSET_ERR  3   /// SysTick hasn't been configured yet
+#define HAL_TS_SNAP_SIZE_ERR    4   /// Snapshot doesn't fit into reserved space
+
+/**     Size of memory reserved for task scheduler snapshot (in bytes)      */
+#define HAL_TS_SNAP_SIZE        512
+
+/**     File emulating memory preserved across warm reset       */
+#ifndef HAL_TS_SNAP_FILE
+#define HAL_TS_SNAP_FILE        "tsSnapshot.bin"
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/**     TaskScheduler - related API     */
+extern uint8_t     HAL_TS_InitSysTick(uint32_t periodMs, void((*custHook)(void)));
+extern uint8_t     HAL_TS_StartSysTick();
+extern uint8_t     HAL_TS_StopSysTick();
+extern uint32_t    HAL_TS_GetTimeStepMS();
+extern uint8_t     HAL_TS_SnapshotSave(const uint8_t *data, uint16_t len);
+extern uint16_t    HAL_TS_SnapshotLoad(uint8_t *data, uint16_t maxLen,
+                                       bool warmReset);
+extern uint32_t    HAL_TS_ImageID();
+
+/**     Hard real-time tier - related API       */
+extern uint8_t     HAL_TS_InitHardTimer(uint32_t periodUs, void((*custHook)(void)));
+extern uint8_t     HAL_TS_StartHardTimer();
+extern uint8_t     HAL_TS_StopHardTimer();
+extern uint32_t    HAL_TS_GetCycles();
+extern uint32_t    HAL_TS_CyclesPerUS();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROVERKERNEL_HAL_HOST_HAL_TS_HOST_H_ */
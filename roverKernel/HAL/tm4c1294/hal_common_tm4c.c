@@ -21,10 +21,19 @@
 #include "driverlib/fpu.h"
 #include "driverlib/interrupt.h"
 #include "driverlib/pwm.h"
+#include "driverlib/udma.h"
 
 
 uint32_t g_ui32SysClock;
 
+/// uDMA channel control table, shared by all peripherals using uDMA (has to be
+/// aligned on 1024-byte boundary)
+#pragma DATA_ALIGN(_dmaCtrlTable, 1024)
+static uint8_t _dmaCtrlTable[1024];
+
+/// Cause of last reset, read (and cleared in hardware) once on board init
+static uint32_t _resetCause = 0;
+
 /**
  *  Dummy function to be called to suppress "Unused variable" warnings
  */
@@ -43,10 +52,23 @@ void HAL_BOARD_CLOCK_Init()
     MAP_FPUEnable();
     //FPULazyStackingEnable();
     MAP_FPUStackingEnable();
+    //  Latch cause of last reset, cleared so the next reset reports its own
+    _resetCause = MAP_SysCtlResetCauseGet();
+    MAP_SysCtlResetCauseClear(_resetCause);
     //  Enable interrupt handler
     MAP_IntMasterEnable();
 }
 
+/**
+ * Check whether board is coming from a warm reset (memory content preserved)
+ * @note Valid only after HAL_BOARD_CLOCK_Init() has been called
+ * @return true if last reset wasn't a power-on reset, false otherwise
+ */
+bool HAL_BOARD_WarmReset()
+{
+    return ((_resetCause & SYSCTL_CAUSE_POR) == 0);
+}
+
 /**
  * Software-triggered reboot of microcontroller
  */
@@ -89,6 +111,26 @@ uint32_t _TM4CMsToCycles(uint32_t ms)
     return (ms*(g_ui32SysClock/1000));
 }
 
+/**
+ * Enable uDMA controller and set up its channel control table. Safe to call
+ * multiple times, every peripheral using uDMA calls it before configuring its
+ * channels.
+ */
+void HAL_BOARD_DMAInit()
+{
+    static bool dmaInit = false;
+
+    if (dmaInit)
+        return;
+
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_UDMA);
+    MAP_uDMAEnable();
+    MAP_uDMAControlBaseSet(_dmaCtrlTable);
+
+    dmaInit = true;
+}
+
 /**
  * Set desired PWM duty cycle on specific output channel
  * @param id is channel ID of PWM channel affected
@@ -24,14 +24,197 @@
 #include "utils/uartstdio.h"
 #include "driverlib/systick.h"
 #include "driverlib/timer.h"
+#include "driverlib/udma.h"
+#include "inc/hw_uart.h"
+
+/**     uDMA-related macros     */
+#define ESP_RX_DMA_CH       UDMA_CH20_UART7RX
+#define ESP_TX_DMA_CH       UDMA_CH21_UART7TX
+//  Length of half of the Rx ring (length of a single uDMA transfer)
+#define ESP_RX_DMA_HALF     (HAL_ESP_RX_RING_SIZE / 2)
+//  Max length of a single uDMA transfer
+#define ESP_DMA_MAX_XFER    1024
+
+/// Rx ring buffer, filled by uDMA and read from main context
+static uint8_t _rxRing[HAL_ESP_RX_RING_SIZE];
+/// Free-running number of bytes written into the ring, read (parsed) from it
+/// and released by the reader (space before _rxTail can be reused by uDMA)
+static volatile uint32_t _rxHead = 0;
+static volatile uint32_t _rxRead = 0;
+static volatile uint32_t _rxTail = 0;
+/// Value of _rxHead at the beginning of the ring half currently filled by uDMA
+static uint32_t _rxHalfStart = 0;
+/// Half of the ring currently filled by uDMA (0-primary, 1-alternate structure)
+static uint8_t _rxActive = 0;
+/// Halves of the ring with armed uDMA control structure (bit 0-primary, bit
+/// 1-alternate). Half is armed only once reader released data it held before
+static volatile uint8_t _rxArmed = 0;
+/// Number of times uDMA stopped because reader held data in the whole ring
+static volatile uint32_t _rxOverrun = 0;
+/// Number of receive errors reported by UART (overrun, framing, parity, break)
+static volatile uint32_t _rxErrors = 0;
+/// Scan for message boundaries in received data: number of characters of +IPD
+/// header matched, whether header fields are being read, length read so far,
+/// bytes of +IPD payload still to come and receive losses seen by last scan
+static uint8_t _rxScanMatch = 0;
+static bool _rxScanHdr = false;
+static uint32_t _rxScanLen = 0;
+static uint32_t _rxScanIPD = 0;
+static uint32_t _rxScanLost = 0;
+
+/// Whether RTS/CTS flow control is in use, and whether ESP was asked to pause
+static bool _flowCtrl = false;
+static volatile bool _rtsStop = false;
+
+/// Tx ring buffer, filled from main context and drained by uDMA
+static uint8_t _txRing[HAL_ESP_TX_RING_SIZE];
+/// Free-running number of bytes written into the ring and sent by uDMA
+static volatile uint32_t _txHead = 0;
+static volatile uint32_t _txTail = 0;
+/// Length of uDMA transfer in progress
+static volatile uint16_t _txXfer = 0;
+
+/**
+ * Raise or drop RTS line asking ESP to pause sending
+ * @param stop true to pause ESP, false to let it send again
+ */
+static void _ESP_RTS(bool stop)
+{
+    _rtsStop = stop;
+    MAP_GPIOPinWrite(ESP8266_RTS_PORT, ESP8266_RTS_PIN,
+                     stop ? ESP8266_RTS_PIN : 0);
+}
+
+/**
+ * Set up uDMA control structure to transfer data from UART into the ring
+ * @param half half of the ring the transfer belongs to (0-primary structure,
+ * 1-alternate structure)
+ * @param offset offset within the half where transfer starts
+ */
+static void _ESP_RxArm(uint8_t half, uint16_t offset)
+{
+    MAP_uDMAChannelTransferSet(ESP_RX_DMA_CH |
+                               (half ? UDMA_ALT_SELECT : UDMA_PRI_SELECT),
+                               UDMA_MODE_PINGPONG,
+                               (void*)(ESP8266_UART_BASE + UART_O_DR),
+                               _rxRing + half*ESP_RX_DMA_HALF + offset,
+                               ESP_RX_DMA_HALF - offset);
+    _rxArmed |= (1 << half);
+}
+
+/**
+ * Arm halves of the ring whose old data reader has released, so that uDMA never
+ * overwrites data reader still holds (e.g. payload handed out in place): the
+ * half uDMA switches to next is armed once data up to the start of the half
+ * being filled now is released. If uDMA stopped at unarmed half it's resumed
+ * once that half is released; received data got lost in the meantime (or is
+ * waiting in UART FIFO), which is counted as an overrun
+ * @note Has to be called with uDMA channel disabled
+ */
+static void _ESP_RxRearm()
+{
+    if (!(_rxArmed & (1 << _rxActive)))
+    {
+        if ((int32_t)(_rxTail - (_rxHalfStart - ESP_RX_DMA_HALF)) < 0)
+            return;
+        _ESP_RxArm(_rxActive, 0);
+        if (_rxActive)
+            MAP_uDMAChannelAttributeEnable(ESP_RX_DMA_CH, UDMA_ATTR_ALTSELECT);
+        else
+            MAP_uDMAChannelAttributeDisable(ESP_RX_DMA_CH, UDMA_ATTR_ALTSELECT);
+        _rxOverrun++;
+    }
+
+    if (!(_rxArmed & (1 << (_rxActive ^ 1))) &&
+        ((int32_t)(_rxTail - _rxHalfStart) >= 0))
+        _ESP_RxArm(_rxActive ^ 1, 0);
+}
+
+/**
+ * Move on to the other half of the ring once the active one got filled. Filled
+ * half isn't re-armed here, it holds data reader hasn't released yet. If the
+ * other half isn't armed either uDMA stops, ESP is asked to pause (if flow
+ * control is used)
+ */
+static void _ESP_RxNextHalf()
+{
+    _rxArmed &= ~(1 << _rxActive);
+    _rxHalfStart += ESP_RX_DMA_HALF;
+    _rxActive ^= 1;
+
+    if (_flowCtrl && !(_rxArmed & (1 << _rxActive)))
+        _ESP_RTS(true);
+}
+
+/**
+ * Account for ring halves uDMA has filled completely and arm the ones that can
+ * be reused (see _ESP_RxRearm())
+ * @note Has to be called with uDMA channel disabled
+ */
+static void _ESP_RxAdvance()
+{
+    _ESP_RxRearm();
+    while ((_rxArmed & (1 << _rxActive)) &&
+           (MAP_uDMAChannelModeGet(ESP_RX_DMA_CH |
+            (_rxActive ? UDMA_ALT_SELECT : UDMA_PRI_SELECT)) == UDMA_MODE_STOP))
+        _ESP_RxNextHalf();
+
+    _ESP_RxRearm();
+}
+
+/**
+ * Account for finished uDMA transfer from Tx ring and start transfer of the
+ * next continuous block of data waiting in the ring (if any)
+ * @note Has to be called with interrupts disabled
+ */
+static void _ESP_TxAdvance()
+{
+    uint32_t idx, len;
+
+    //  Channel is disabled by uDMA once basic transfer completes
+    if (MAP_uDMAChannelIsEnabled(ESP_TX_DMA_CH))
+        return;
+
+    _txTail += _txXfer;
+    _txXfer = 0;
+
+    //  ESP can't take more data, transfer is started from CTS interrupt
+    if (_flowCtrl &&
+        (MAP_GPIOPinRead(ESP8266_CTS_PORT, ESP8266_CTS_PIN) & ESP8266_CTS_PIN))
+        return;
+
+    idx = _txTail & (HAL_ESP_TX_RING_SIZE - 1);
+    len = min(_txHead - _txTail, HAL_ESP_TX_RING_SIZE - idx);
+    len = min(len, _flowCtrl ? HAL_ESP_CTS_XFER : ESP_DMA_MAX_XFER);
+    if (len == 0)
+        return;
+
+    MAP_uDMAChannelTransferSet(ESP_TX_DMA_CH | UDMA_PRI_SELECT,
+                               UDMA_MODE_BASIC, _txRing + idx,
+                               (void*)(ESP8266_UART_BASE + UART_O_DR), len);
+    _txXfer = len;
+    MAP_uDMAChannelEnable(ESP_TX_DMA_CH);
+}
+
+/**
+ * CTS line dropped (ESP can take data again), continue sending from Tx ring
+ */
+static void _ESP_CTSInt(void)
+{
+    MAP_GPIOIntClear(ESP8266_CTS_PORT, ESP8266_CTS_PIN);
+    _ESP_TxAdvance();
+}
 
 /**
  * Initialize UART port communicating with ESP8266 chip - 8 data bits, no parity,
- * 1 stop bit, no flow control
+ * 1 stop bit, optionally with RTS/CTS flow control. Port can be reinitialized
+ * to change baud rate, Rx and Tx rings have to be set up again afterwards
+ * (HAL_ESP_RegisterIntHandler)
  * @param baud designated speed of communication
+ * @param flowCtrl true to use RTS/CTS flow control
  * @return HAL library error code
  */
-uint32_t HAL_ESP_InitPort(uint32_t baud)
+uint32_t HAL_ESP_InitPort(uint32_t baud, bool flowCtrl)
 {
     static bool pinInit = false;
 
@@ -50,9 +233,27 @@ uint32_t HAL_ESP_InitPort(uint32_t baud)
         MAP_GPIOPinTypeGPIOOutput(GPIO_PORTC_BASE, GPIO_PIN_7);
         MAP_GPIOPinWrite(GPIO_PORTC_BASE, GPIO_PIN_7, 0xFF);
 
+        //  Flow control lines; CTS is pulled down so that unconnected line
+        //  doesn't block sending
+        MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOK);
+        MAP_GPIOPinTypeGPIOOutput(ESP8266_RTS_PORT, ESP8266_RTS_PIN);
+        MAP_GPIOPinWrite(ESP8266_RTS_PORT, ESP8266_RTS_PIN, 0x00);
+        MAP_GPIOPinTypeGPIOInput(ESP8266_CTS_PORT, ESP8266_CTS_PIN);
+        MAP_GPIOPadConfigSet(ESP8266_CTS_PORT, ESP8266_CTS_PIN,
+                             GPIO_STRENGTH_2MA, GPIO_PIN_TYPE_STD_WPD);
+        MAP_GPIOIntTypeSet(ESP8266_CTS_PORT, ESP8266_CTS_PIN, GPIO_FALLING_EDGE);
+        GPIOIntRegister(ESP8266_CTS_PORT, _ESP_CTSInt);
+
         pinInit = true;
     }
 
+    _flowCtrl = flowCtrl;
+    _ESP_RTS(false);
+    if (flowCtrl)
+        MAP_GPIOIntEnable(ESP8266_CTS_PORT, ESP8266_CTS_PIN);
+    else
+        MAP_GPIOIntDisable(ESP8266_CTS_PORT, ESP8266_CTS_PIN);
+
     //    Configure UART 7 peripheral used for ESP communication
     MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UART7);
     MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_UART7);
@@ -67,16 +268,61 @@ uint32_t HAL_ESP_InitPort(uint32_t baud)
 }
 
 /**
- * Attach specific interrupt handler to ESP's UART and configure interrupt to
- * occur on every received character
+ * Attach specific interrupt handler to ESP's UART and configure uDMA to move
+ * received data into Rx ring. Interrupt occurs when half of the ring is filled
+ * or when the line goes idle (receive timeout) after a message
+ * uDMA is only allowed burst requests (4 bytes), so up to 3 last bytes of the
+ * message stay in UART FIFO which then triggers receive timeout interrupt.
+ * Second uDMA channel moves data from Tx ring to UART, interrupt occurs when
+ * each transfer completes.
  */
 void HAL_ESP_RegisterIntHandler(void((*intHandler)(void)))
 {
     MAP_UARTDisable(ESP8266_UART_BASE);
-    //  Enable Interrupt on received data
-    MAP_UARTFIFOLevelSet(ESP8266_UART_BASE,UART_FIFO_TX1_8, UART_FIFO_RX1_8 );
+
+    //  Configure uDMA channel in ping-pong mode, each half of the ring is
+    //  filled by one of the control structures
+    HAL_BOARD_DMAInit();
+    MAP_uDMAChannelAssign(ESP_RX_DMA_CH);
+    MAP_uDMAChannelAttributeDisable(ESP_RX_DMA_CH, UDMA_ATTR_ALTSELECT |
+                                    UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+    MAP_uDMAChannelAttributeEnable(ESP_RX_DMA_CH, UDMA_ATTR_USEBURST);
+    MAP_uDMAChannelControlSet(ESP_RX_DMA_CH | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 |
+                              UDMA_ARB_4);
+    MAP_uDMAChannelControlSet(ESP_RX_DMA_CH | UDMA_ALT_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 |
+                              UDMA_ARB_4);
+    _rxHead = _rxRead = _rxTail = _rxHalfStart = 0;
+    _rxActive = 0;
+    _rxArmed = 0;
+    _ESP_RxArm(0, 0);
+    _ESP_RxArm(1, 0);
+
+    //  Tx channel copies 8-bit data from the ring into UART data register
+    MAP_uDMAChannelDisable(ESP_TX_DMA_CH);
+    MAP_uDMAChannelAssign(ESP_TX_DMA_CH);
+    MAP_uDMAChannelAttributeDisable(ESP_TX_DMA_CH, UDMA_ATTR_ALTSELECT |
+                                    UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK |
+                                    UDMA_ATTR_USEBURST);
+    MAP_uDMAChannelControlSet(ESP_TX_DMA_CH | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE |
+                              UDMA_ARB_4);
+    _txHead = _txTail = 0;
+    _txXfer = 0;
+
+    //  uDMA burst is requested when FIFO holds 4 bytes (Rx) or has space for
+    //  at least 14 bytes (Tx)
+    MAP_UARTFIFOLevelSet(ESP8266_UART_BASE,UART_FIFO_TX1_8, UART_FIFO_RX1_4 );
+    MAP_UARTDMAEnable(ESP8266_UART_BASE, UART_DMA_RX | UART_DMA_TX);
+    MAP_uDMAChannelEnable(ESP_RX_DMA_CH);
+
     UARTIntRegister(ESP8266_UART_BASE, intHandler);
-    MAP_UARTIntEnable(ESP8266_UART_BASE, UART_INT_RX | UART_INT_RT);
+    MAP_IntPrioritySet(INT_UART7, HAL_ESP_INT_PRIO);
+    MAP_UARTIntEnable(ESP8266_UART_BASE, UART_INT_DMARX | UART_INT_RT |
+                                         UART_INT_DMATX | UART_INT_OE |
+                                         UART_INT_BE | UART_INT_PE |
+                                         UART_INT_FE);
     MAP_IntDisable(INT_UART7);
     MAP_UARTEnable(ESP8266_UART_BASE);
 }
@@ -109,7 +355,8 @@ bool HAL_ESP_IsHWEnabled()
 }
 
 /**
- * Enable/disable UART interrupt - interrupt occurs on every char received
+ * Enable/disable UART interrupt - interrupt occurs when half of Rx ring is full
+ * or on idle line
  * @param enable
  */
 void HAL_ESP_IntEnable(bool enable)
@@ -141,6 +388,7 @@ void HAL_ESP_InitWD(void((*intHandler)(void)))
     MAP_TimerConfigure(TIMER6_BASE, TIMER_CFG_ONE_SHOT_UP);
     TimerIntRegister(TIMER6_BASE, TIMER_A, intHandler);
     MAP_TimerIntEnable(TIMER6_BASE, TIMER_TIMA_TIMEOUT);
+    MAP_IntPrioritySet(INT_TIMER6A, HAL_ESP_INT_PRIO);
     MAP_IntEnable(INT_TIMER6A);
     g_intHandler = intHandler;
 }
@@ -195,6 +443,368 @@ void HAL_ESP_WDClearInt()
     MAP_IntPendSet(INT_UART7);
 }
 
+/**
+ * Scan bytes just published in Rx ring for end of message parser can act on:
+ * line end, send prompt ('>') or end of +IPD payload (which has no line end).
+ * Payload length is taken from +IPD,[id,]len: header so payload is skipped in
+ * one step and bytes inside it aren't mistaken for line ends.
+ * @param from position of the first new byte in the ring
+ * @param to position after the last new byte in the ring
+ * @return true if a boundary was found in new bytes
+ */
+static bool _ESP_RxScan(uint32_t from, uint32_t to)
+{
+    const char ipd[] = "+IPD,";
+    bool retVal = false;
+    uint8_t c;
+
+    while (from != to)
+    {
+        //  Skip payload of +IPD frame, frame ends with its last byte
+        if (_rxScanIPD > 0)
+        {
+            uint32_t n = to - from;
+
+            if (n > _rxScanIPD)
+                n = _rxScanIPD;
+            _rxScanIPD -= n;
+            from += n;
+            retVal |= (_rxScanIPD == 0);
+            continue;
+        }
+
+        c = _rxRing[(from++) & (HAL_ESP_RX_RING_SIZE - 1)];
+
+        //  Reading fields of +IPD header, last number before ':' is length
+        if (_rxScanHdr)
+        {
+            if ((c >= '0') && (c <= '9'))
+                _rxScanLen = _rxScanLen * 10 + (c - '0');
+            else if (c == ',')
+                _rxScanLen = 0;
+            else
+            {
+                if (c == ':')
+                    _rxScanIPD = _rxScanLen;
+                _rxScanHdr = false;
+            }
+            continue;
+        }
+
+        if ((c == '\n') || (c == '>'))
+            retVal = true;
+
+        //  Match beginning of +IPD header
+        if (c == ipd[_rxScanMatch])
+            _rxScanMatch++;
+        else
+            _rxScanMatch = (c == ipd[0]) ? 1 : 0;
+        if (_rxScanMatch == (sizeof(ipd) - 1))
+        {
+            _rxScanMatch = 0;
+            _rxScanLen = 0;
+            _rxScanHdr = true;
+        }
+    }
+
+    return retVal;
+}
+
+/**
+ * Called from UART interrupt: publish data moved into Rx ring by uDMA since the
+ * last call. On idle line, bytes remaining in UART FIFO (less than uDMA burst)
+ * are copied into the ring by CPU at the position uDMA is going to write next.
+ * @param intStatus interrupt flags returned by HAL_ESP_ClearInt()
+ * @param boundary[out] set to true if there's data worth parsing: end of line,
+ * prompt or +IPD payload was received, line went idle, data was lost or ring
+ * is filling up; false while the middle of a message is being received
+ * @return number of new bytes available in the ring
+ */
+uint16_t HAL_ESP_RxCollect(uint32_t intStatus, bool *boundary)
+{
+    uint32_t oldHead = _rxHead;
+    uint32_t rem;
+
+    //  Data received with errors (or lost because UART FIFO overflowed)
+    if (intStatus & (UART_INT_OE | UART_INT_BE | UART_INT_PE | UART_INT_FE))
+    {
+        _rxErrors++;
+        MAP_UARTRxErrorClear(ESP8266_UART_BASE);
+    }
+
+    //  Stop uDMA while its control structures are being modified
+    MAP_uDMAChannelDisable(ESP_RX_DMA_CH);
+    _ESP_RxAdvance();
+
+    //  Line idle - move the remainder of the message from FIFO to the ring (if
+    //  uDMA is stopped at a half reader holds, data waits in FIFO)
+    if (intStatus & UART_INT_RT)
+        while ((_rxArmed & (1 << _rxActive)) &&
+               MAP_UARTCharsAvail(ESP8266_UART_BASE))
+        {
+            rem = MAP_uDMAChannelSizeGet(ESP_RX_DMA_CH |
+                      (_rxActive ? UDMA_ALT_SELECT : UDMA_PRI_SELECT));
+            _rxRing[_rxActive*ESP_RX_DMA_HALF + ESP_RX_DMA_HALF - rem] =
+                    MAP_UARTCharGetNonBlocking(ESP8266_UART_BASE);
+            rem--;
+            //  Continue uDMA transfer after the byte written by CPU. If this
+            //  filled the half, switch uDMA to the other half
+            if (rem > 0)
+                _ESP_RxArm(_rxActive, ESP_RX_DMA_HALF - rem);
+            else
+            {
+                _ESP_RxNextHalf();
+                _ESP_RxRearm();
+                if (_rxActive)
+                    MAP_uDMAChannelAttributeEnable(ESP_RX_DMA_CH,
+                                                   UDMA_ATTR_ALTSELECT);
+                else
+                    MAP_uDMAChannelAttributeDisable(ESP_RX_DMA_CH,
+                                                    UDMA_ATTR_ALTSELECT);
+            }
+        }
+
+    //  Nothing got written into the half uDMA stopped at
+    if (_rxArmed & (1 << _rxActive))
+    {
+        rem = MAP_uDMAChannelSizeGet(ESP_RX_DMA_CH |
+                  (_rxActive ? UDMA_ALT_SELECT : UDMA_PRI_SELECT));
+        MAP_uDMAChannelEnable(ESP_RX_DMA_CH);
+    }
+    else
+        rem = ESP_RX_DMA_HALF;
+    _rxHead = _rxHalfStart + ESP_RX_DMA_HALF - rem;
+
+    //  Ask ESP to pause before the ring could overflow
+    if (_flowCtrl && ((_rxHead - _rxTail) > HAL_ESP_RTS_HIGH))
+        _ESP_RTS(true);
+
+    //  Scan is out of step with data once something got lost, parser resyncs
+    if ((_rxOverrun + _rxErrors) != _rxScanLost)
+    {
+        _rxScanLost = _rxOverrun + _rxErrors;
+        _rxScanMatch = 0;
+        _rxScanHdr = false;
+        _rxScanIPD = 0;
+        *boundary = true;
+    }
+    else
+        *boundary = _ESP_RxScan(oldHead, _rxHead) ||
+                    ((intStatus & UART_INT_RT) != 0) ||
+                    ((_rxHead - _rxRead) > HAL_ESP_RTS_HIGH);
+
+    return (uint16_t)(_rxHead - oldHead);
+}
+
+/**
+ * Get number of received bytes waiting in Rx ring
+ * @return number of unread bytes
+ */
+uint16_t HAL_ESP_RxAvail()
+{
+    return (uint16_t)(_rxHead - _rxRead);
+}
+
+/**
+ * Get pointer to the oldest unread byte in Rx ring, without copying data
+ * @param data[out] pointer to the first unread byte
+ * @return number of unread bytes stored continuously from [data] (data that
+ * wraps around the end of the ring is returned by the next call)
+ */
+uint16_t HAL_ESP_RxPeek(const uint8_t **data)
+{
+    uint32_t read = _rxRead;
+    uint32_t len = _rxHead - read;
+    uint32_t idx = read & (HAL_ESP_RX_RING_SIZE - 1);
+
+    if (len > (HAL_ESP_RX_RING_SIZE - idx))
+        len = HAL_ESP_RX_RING_SIZE - idx;
+    *data = _rxRing + idx;
+
+    return (uint16_t)len;
+}
+
+/**
+ * Mark bytes returned by HAL_ESP_RxPeek() as read. Space they occupy is not
+ * freed until it's released by HAL_ESP_RxRelease()
+ * @param len number of bytes read
+ */
+void HAL_ESP_RxConsume(uint16_t len)
+{
+    _rxRead += len;
+}
+
+/**
+ * Get position of the next unread byte in Rx ring
+ * @return free-running number of bytes read from the ring
+ */
+uint32_t HAL_ESP_RxPosition()
+{
+    return _rxRead;
+}
+
+/**
+ * Get pointer to already read data at given position in Rx ring. Allows reader
+ * to keep data in the ring and access it later, without copying it.
+ * @param pos position in the ring (as returned by HAL_ESP_RxPosition())
+ * @param data[out] pointer to byte at position [pos]
+ * @return number of bytes stored continuously from [data] up to the end of the
+ * ring, or up to the first unread byte
+ */
+uint16_t HAL_ESP_RxPeekAt(uint32_t pos, const uint8_t **data)
+{
+    uint32_t len = _rxRead - pos;
+    uint32_t idx = pos & (HAL_ESP_RX_RING_SIZE - 1);
+
+    if (len > (HAL_ESP_RX_RING_SIZE - idx))
+        len = HAL_ESP_RX_RING_SIZE - idx;
+    *data = _rxRing + idx;
+
+    return (uint16_t)len;
+}
+
+/**
+ * Free space in Rx ring occupied by data before given position, so that uDMA
+ * can reuse it. Half of the ring is handed back to uDMA once all data in it is
+ * released
+ * @param pos position in the ring (at most HAL_ESP_RxPosition())
+ */
+void HAL_ESP_RxRelease(uint32_t pos)
+{
+    if (_rxArmed == 0x03)
+        _rxTail = pos;
+    else
+    {
+        HAL_BOARD_InterruptEnable(false);
+        _rxTail = pos;
+        MAP_uDMAChannelDisable(ESP_RX_DMA_CH);
+        _ESP_RxAdvance();
+        if (_rxArmed & (1 << _rxActive))
+            MAP_uDMAChannelEnable(ESP_RX_DMA_CH);
+        HAL_BOARD_InterruptEnable(true);
+    }
+
+    //  Enough space got freed, let ESP continue sending
+    if (_rtsStop && ((_rxHead - _rxTail) < HAL_ESP_RTS_LOW))
+        _ESP_RTS(false);
+}
+
+/**
+ * Get number of Rx ring overruns (uDMA stopped because reader held data in the
+ * whole ring, data received in the meantime is lost)
+ * @return number of overruns since startup
+ */
+uint32_t HAL_ESP_RxOverrun()
+{
+    return _rxOverrun;
+}
+
+/**
+ * Get number of receive errors reported by UART (data lost because UART FIFO
+ * overflowed, framing, parity and break errors)
+ * @return number of errors since startup
+ */
+uint32_t HAL_ESP_RxErrors()
+{
+    return _rxErrors;
+}
+
+/**
+ * Queue data to be sent to ESP. Data is copied into Tx ring and sent by uDMA
+ * in background, function returns as soon as data is in the ring. If there's
+ * not enough space in the ring function waits for uDMA to free it.
+ * @param data bytes to send
+ * @param len number of bytes in [data]
+ * @return number of bytes queued (always [len])
+ */
+uint16_t HAL_ESP_TxWrite(const uint8_t *data, uint16_t len)
+{
+    uint32_t idx, n;
+    uint16_t done = 0;
+
+    while (done < len)
+    {
+        //  Copy as much as fits into the ring, in up to 2 continuous blocks
+        n = min(len - done, HAL_ESP_TX_RING_SIZE - (_txHead - _txTail));
+        idx = _txHead & (HAL_ESP_TX_RING_SIZE - 1);
+        if (n > (HAL_ESP_TX_RING_SIZE - idx))
+            n = HAL_ESP_TX_RING_SIZE - idx;
+        memcpy((void*)(_txRing + idx), (void*)(data + done), n);
+        done += n;
+
+        //  Publish data and start uDMA if it's idle (interrupt that would
+        //  otherwise do it can be disabled)
+        HAL_BOARD_InterruptEnable(false);
+        _txHead += n;
+        _ESP_TxAdvance();
+        HAL_BOARD_InterruptEnable(true);
+    }
+
+    return len;
+}
+
+/**
+ * Called from UART interrupt: continue sending data from Tx ring once uDMA
+ * transfer completes
+ * @param intStatus interrupt flags returned by HAL_ESP_ClearInt()
+ * @return true if this interrupt signals that all data from the ring was handed
+ * over to UART, false otherwise
+ */
+bool HAL_ESP_TxCollect(uint32_t intStatus)
+{
+    if (!(intStatus & UART_INT_DMATX))
+        return false;
+
+    _ESP_TxAdvance();
+
+    return (_txHead == _txTail);
+}
+
+/**
+ * Get number of bytes in Tx ring that haven't been sent yet
+ * @return number of bytes waiting to be sent
+ */
+uint16_t HAL_ESP_TxPending()
+{
+    uint16_t retVal;
+
+    HAL_BOARD_InterruptEnable(false);
+    _ESP_TxAdvance();
+    retVal = (uint16_t)(_txHead - _txTail);
+    HAL_BOARD_InterruptEnable(true);
+
+    return retVal;
+}
+
+/**
+ * Register handler of software interrupt (PendSV) at the lowest priority, used
+ * to run work deferred from UART interrupt
+ * @param intHandler function to call when software interrupt is triggered
+ */
+void HAL_ESP_InitSoftInt(void((*intHandler)(void)))
+{
+    IntRegister(FAULT_PENDSV, intHandler);
+    MAP_IntPrioritySet(FAULT_PENDSV, HAL_ESP_SOFTINT_PRIO);
+}
+
+/**
+ * Trigger software interrupt, it runs once no other interrupt is active
+ */
+void HAL_ESP_SoftIntTrigger()
+{
+    MAP_IntPendSet(FAULT_PENDSV);
+}
+
+/**
+ * Hold back software interrupt (and only it) while main context is doing the
+ * same work, interrupt triggered in the meantime runs once it's unmasked
+ * @param mask true to hold back software interrupt, false to allow it
+ */
+void HAL_ESP_SoftIntMask(bool mask)
+{
+    MAP_IntPriorityMaskSet(mask ? HAL_ESP_SOFTINT_PRIO : 0);
+}
+
 ///-----------------------------------------------------------------------------
 ///         Deprecated functions, replaced by macro definitions in header file
 ///-----------------------------------------------------------------------------
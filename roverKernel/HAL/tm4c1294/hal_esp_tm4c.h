@@ -8,6 +8,14 @@
  *      UART7, pins PC4(Rx), PC5(Tx)
  *      GPIO PC6(CH_PD), PC7(Reset-not implemented!)
  *      Timer 6 - watchdog timer in case UART port hangs(likes to do so)
+ *      uDMA channel 20 - moves received data from UART7 into Rx ring buffer
+ *      uDMA channel 21 - moves data to send from Tx ring buffer into UART7
+ *      GPIO PK4(RTS) - wired to GPIO13 (U0CTS) of ESP, driven high to pause ESP
+ *      GPIO PK5(CTS) - wired to GPIO15 (U0RTS) of ESP, high while ESP can't
+ *          take more data. UART7 has no hardware flow control lines, both are
+ *          handled in software (only if flow control is enabled)
+ *      PendSV - software interrupt running parser when there is no task
+ *          scheduler to defer parsing to
  */
 #include "hwconfig.h"
 
@@ -22,6 +30,11 @@
 
 /**     ESP8266 - related macros        */
 #define ESP8266_UART_BASE       0x40013000
+/**     Flow control lines (GPIO, see hardware dependencies above)      */
+#define ESP8266_RTS_PORT        GPIO_PORTK_BASE
+#define ESP8266_RTS_PIN         GPIO_PIN_4
+#define ESP8266_CTS_PORT        GPIO_PORTK_BASE
+#define ESP8266_CTS_PIN         GPIO_PIN_5
 
 /*
  * To prevent unnecessary stack layers (calling function from function) some
@@ -32,13 +45,41 @@
 #define HAL_ESP_CharAvail()     MAP_UARTCharsAvail(ESP8266_UART_BASE)
 #define HAL_ESP_GetChar()       MAP_UARTCharGetNonBlocking(ESP8266_UART_BASE)
 
+/**     Rx ring buffer filled by uDMA       */
+//  Size of the ring in bytes (power of 2). uDMA fills it in 2 halves (ping-pong
+//  mode), half of the ring is at most 1024B - max length of single uDMA transfer
+#define HAL_ESP_RX_RING_SIZE    2048
+
+/**     Tx ring buffer drained by uDMA      */
+//  Size of the ring in bytes (power of 2), fits longest data ESP accepts in a
+//  single send (2048B) together with a command
+#define HAL_ESP_TX_RING_SIZE    4096
+
+/**     Flow control        */
+//  RTS is raised once ring holds more than this many unreleased bytes. Fill
+//  level is only known on interrupt (every half of the ring at most) so the
+//  threshold leaves space for a whole half to come in before RTS takes effect
+#define HAL_ESP_RTS_HIGH        (HAL_ESP_RX_RING_SIZE / 2 - 64)
+//  RTS is dropped once reader releases data below this level
+#define HAL_ESP_RTS_LOW         (HAL_ESP_RX_RING_SIZE / 4)
+//  Max length of uDMA transfer while CTS is in use, CTS is only checked before
+//  a transfer starts so transfer has to fit in ESP's Rx FIFO (128B)
+#define HAL_ESP_CTS_XFER        64
+
+/**     Interrupt priorities (upper 3 bits, lower value is more urgent)     */
+//  UART and watchdog timer, below encoders and task scheduler timers (0) so
+//  that ESP traffic doesn't delay them
+#define HAL_ESP_INT_PRIO        0x40
+//  Software interrupt running the parser, below every other interrupt
+#define HAL_ESP_SOFTINT_PRIO    0xE0
+
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
-extern uint32_t    HAL_ESP_InitPort(uint32_t baud);
+extern uint32_t    HAL_ESP_InitPort(uint32_t baud, bool flowCtrl);
 extern void        HAL_ESP_RegisterIntHandler(void((*intHandler)(void)));
 extern void        HAL_ESP_HWEnable(bool enable);
 extern bool        HAL_ESP_IsHWEnabled();
@@ -49,6 +90,21 @@ extern int32_t     HAL_ESP_ClearInt();
 extern void        HAL_ESP_InitWD(void((*intHandler)(void)));
 extern void        HAL_ESP_WDControl(bool enable, uint32_t timeout);
 extern void        HAL_ESP_WDClearInt();
+extern uint16_t    HAL_ESP_RxCollect(uint32_t intStatus, bool *boundary);
+extern uint16_t    HAL_ESP_RxAvail();
+extern uint16_t    HAL_ESP_RxPeek(const uint8_t **data);
+extern void        HAL_ESP_RxConsume(uint16_t len);
+extern uint32_t    HAL_ESP_RxPosition();
+extern uint16_t    HAL_ESP_RxPeekAt(uint32_t pos, const uint8_t **data);
+extern void        HAL_ESP_RxRelease(uint32_t pos);
+extern uint32_t    HAL_ESP_RxOverrun();
+extern uint32_t    HAL_ESP_RxErrors();
+extern uint16_t    HAL_ESP_TxWrite(const uint8_t *data, uint16_t len);
+extern bool        HAL_ESP_TxCollect(uint32_t intStatus);
+extern uint16_t    HAL_ESP_TxPending();
+extern void        HAL_ESP_InitSoftInt(void((*intHandler)(void)));
+extern void        HAL_ESP_SoftIntTrigger();
+extern void        HAL_ESP_SoftIntMask(bool mask);
 
 #ifdef __cplusplus
 }
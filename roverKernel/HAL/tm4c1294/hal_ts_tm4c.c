@@ -23,6 +23,8 @@
 #include "driverlib/timer.h"
 #include "driverlib/systick.h"
 
+#include <crc_tbl.h>
+
 
 uint32_t g_ui32SysClock;
 
@@ -93,5 +95,191 @@ uint32_t HAL_TS_GetTimeStepMS()
     return _periodMS;
 }
 
+/**
+ * Memory holding task scheduler snapshot. Placed in a section which is not
+ * initialized on start-up so its content survives software reset. Content is
+ * considered valid only if magic number and CRC match.
+ */
+#define HAL_TS_SNAP_MAGIC   0x54534E50  /// "TSNP"
+struct _tsSnapshot
+{
+    uint32_t    magic;
+    uint16_t    len;
+    uint16_t    crc;
+    uint8_t     data[HAL_TS_SNAP_SIZE];
+};
+#pragma DATA_SECTION(_tsSnap, ".tssnap")
+struct _tsSnapshot _tsSnap;
+
+/**
+ * Save task scheduler snapshot to memory preserved across warm reset
+ * @param data serialized snapshot of task scheduler
+ * @param len length of [data] array
+ * @return HAL library error code
+ */
+uint8_t HAL_TS_SnapshotSave(const uint8_t *data, uint16_t len)
+{
+    if (len > HAL_TS_SNAP_SIZE)
+        return HAL_TS_SNAP_SIZE_ERR;
+
+    memcpy(_tsSnap.data, data, len);
+    _tsSnap.len = len;
+    _tsSnap.crc = crc16(_tsSnap.data, len, 0xFFFF);
+    _tsSnap.magic = HAL_TS_SNAP_MAGIC;
+
+    return HAL_OK;
+}
+
+/**
+ * Load task scheduler snapshot saved before last reset. Snapshot is accepted
+ * only after a warm reset (memory content after power-on reset is undefined)
+ * and is invalidated once read so it can't be restored twice.
+ * @param data[out] buffer to copy snapshot into
+ * @param maxLen size of [data] buffer
+ * @param warmReset true if board is coming from warm reset, as latched on board
+ * init (see HAL_BOARD_WarmReset())
+ * @return length of snapshot copied into [data], 0 if there's no valid snapshot
+ */
+uint16_t HAL_TS_SnapshotLoad(uint8_t *data, uint16_t maxLen, bool warmReset)
+{
+    uint16_t retVal = 0;
+
+    if (warmReset &&
+        (_tsSnap.magic == HAL_TS_SNAP_MAGIC) &&
+        (_tsSnap.len <= maxLen) && (_tsSnap.len <= HAL_TS_SNAP_SIZE) &&
+        (_tsSnap.crc == crc16(_tsSnap.data, _tsSnap.len, 0xFFFF)))
+    {
+        memcpy(data, _tsSnap.data, _tsSnap.len);
+        retVal = _tsSnap.len;
+    }
+
+    _tsSnap.magic = 0;
+
+    return retVal;
+}
+
+/**
+ * CRC table generated by the linker over code and constant data of firmware
+ * image (see crc_table() operator in linker command file)
+ */
+extern const CRC_TABLE _tsImageCrc;
+
+/**
+ * Get identifier of firmware image, used to reject snapshot of task scheduler
+ * made by a different firmware. Calculated from CRC values the linker stored
+ * for each section of the image, so it costs nothing at run-time.
+ * @return identifier of firmware image
+ */
+uint32_t HAL_TS_ImageID()
+{
+    uint32_t retVal = 0;
+
+    for (uint32_t i = 0; i < _tsImageCrc.num_recs; i++)
+        retVal ^= _tsImageCrc.recs[i].crc_value;
+
+    return retVal;
+}
+
+/**     Data Watchpoint and Trace unit registers (ARMv7-M architecture)     */
+#define DEMCR_REG           0xE000EDFC  /// Debug exception & monitor control
+#define DEMCR_TRCENA        0x01000000  /// Enable DWT unit
+#define DWT_CTRL_REG        0xE0001000  /// DWT control register
+#define DWT_CTRL_CYCCNTENA  0x00000001  /// Enable cycle counter
+#define DWT_CYCCNT_REG      0xE0001004  /// Cycle counter
+
+///Keep track whether the hard-tier timer has already been configured
+bool _hardTimerSet = false;
+void((*_hardTimerHook)(void)) = 0;
+
+/**
+ * Timer5A interrupt handler - clears interrupt flag and calls hard-tier hook
+ */
+void _HAL_TS_HardTimerISR()
+{
+    MAP_TimerIntClear(TIMER5_BASE, TIMER_TIMA_TIMEOUT);
+    _hardTimerHook();
+}
+
+/**
+ * Setup periodic timer interrupt used as base tick of hard real-time task tier.
+ * Interrupt has highest priority so it can preempt all other interrupts. Also
+ * starts DWT cycle counter used for measuring runtime and jitter.
+ * @param periodUs time in microseconds how often to trigger an interrupt
+ * @param custHook pointer to function that will be called on timer interrupt
+ * @return HAL library error code
+ */
+uint8_t HAL_TS_InitHardTimer(uint32_t periodUs, void((*custHook)(void)))
+{
+    uint32_t cycles = periodUs * (g_ui32SysClock / 1000000);
+
+    if (_hardTimerSet)
+        return HAL_SYSTICK_SET_ERR;
+    if (cycles < 1)
+        return HAL_SYSTICK_PEROOR;
+
+    //  Start free-running cycle counter
+    HWREG(DEMCR_REG) |= DEMCR_TRCENA;
+    HWREG(DWT_CYCCNT_REG) = 0;
+    HWREG(DWT_CTRL_REG) |= DWT_CTRL_CYCCNTENA;
+
+    _hardTimerHook = custHook;
+
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER5);
+    MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_TIMER5);
+    MAP_TimerConfigure(TIMER5_BASE, TIMER_CFG_PERIODIC);
+    MAP_TimerLoadSet(TIMER5_BASE, TIMER_A, cycles - 1);
+    TimerIntRegister(TIMER5_BASE, TIMER_A, _HAL_TS_HardTimerISR);
+    MAP_IntPrioritySet(INT_TIMER5A, 0);
+    MAP_TimerIntEnable(TIMER5_BASE, TIMER_TIMA_TIMEOUT);
+    MAP_IntEnable(INT_TIMER5A);
+    _hardTimerSet = true;
+
+    return HAL_OK;
+}
+
+/**
+ * Start hard-tier timer
+ */
+uint8_t HAL_TS_StartHardTimer()
+{
+    if(_hardTimerSet)
+        MAP_TimerEnable(TIMER5_BASE, TIMER_A);
+    else
+        return HAL_SYSTICK_NOTSET_ERR;
+
+    return HAL_OK;
+}
+
+/**
+ * Stop hard-tier timer
+ */
+uint8_t HAL_TS_StopHardTimer()
+{
+    if(_hardTimerSet)
+        MAP_TimerDisable(TIMER5_BASE, TIMER_A);
+    else
+        return HAL_SYSTICK_NOTSET_ERR;
+
+    return HAL_OK;
+}
+
+/**
+ * Read free-running cycle counter (wraps around every ~35s at 120MHz)
+ * @return current value of cycle counter
+ */
+uint32_t HAL_TS_GetCycles()
+{
+    return HWREG(DWT_CYCCNT_REG);
+}
+
+/**
+ * Get number of cycle counter ticks in one microsecond
+ * @return cycles per microsecond
+ */
+uint32_t HAL_TS_CyclesPerUS()
+{
+    return (g_ui32SysClock / 1000000);
+}
+
 #endif  /* __HAL_USE_TASKSCH__ */
 
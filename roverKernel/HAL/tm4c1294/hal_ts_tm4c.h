@@ -6,6 +6,12 @@
  *
  ****Hardware dependencies:
  *  SysTick timer & interrupt
+ *  Timer5A periodic interrupt (base tick of hard real-time task tier)
+ *  DWT cycle counter (time measurements with cycle resolution)
+ *  SRAM section excluded from start-up initialization (.tssnap, see linker
+ *  command file) holding task scheduler snapshot across warm reset
+ *  Linker-generated CRC table of firmware image (_tsImageCrc, see linker
+ *  command file) identifying image which made the snapshot
  */
 #include "hwconfig.h"
 
@@ -17,6 +23,10 @@
 #define HAL_SYSTICK_PEROOR      1   /// Period value for SysTick is out of range
 #define HAL_SYSTICK_SET_ERR     2   /// SysTick has already been configured
 #define HAL_SYSTICK_NOTSET_ERR  3   /// SysTick hasn't been configured yet
+#define HAL_TS_SNAP_SIZE_ERR    4   /// Snapshot doesn't fit into reserved space
+
+/**     Size of memory reserved for task scheduler snapshot (in bytes)      */
+#define HAL_TS_SNAP_SIZE        512
 
 #ifdef __cplusplus
 extern "C"
@@ -27,6 +37,17 @@ extern uint8_t     HAL_TS_InitSysTick(uint32_t periodMs, void((*custHook)(void))
 extern uint8_t     HAL_TS_StartSysTick();
 extern uint8_t     HAL_TS_StopSysTick();
 extern uint32_t    HAL_TS_GetTimeStepMS();
+extern uint8_t     HAL_TS_SnapshotSave(const uint8_t *data, uint16_t len);
+extern uint16_t    HAL_TS_SnapshotLoad(uint8_t *data, uint16_t maxLen,
+                                       bool warmReset);
+extern uint32_t    HAL_TS_ImageID();
+
+/**     Hard real-time tier - related API       */
+extern uint8_t     HAL_TS_InitHardTimer(uint32_t periodUs, void((*custHook)(void)));
+extern uint8_t     HAL_TS_StartHardTimer();
+extern uint8_t     HAL_TS_StopHardTimer();
+extern uint32_t    HAL_TS_GetCycles();
+extern uint32_t    HAL_TS_CyclesPerUS();
 
 /**     Test probes     */
 extern void        HAL_ESP_TestProbe();
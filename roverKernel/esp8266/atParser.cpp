@@ -0,0 +1,444 @@
+/**
+ * atParser.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "atParser.h"
+
+#if defined(__HAL_USE_ESP8266__)       //  Compile only if module is enabled
+
+#include "esp8266.h"
+#include "libs/myLib.h"
+
+#include <ctype.h>
+
+/*      States of field decoder     */
+#define ATP_S_TEXT      0   //  Plain text, matching keywords
+#define ATP_S_IP        1   //  Reading IP address after ip:"
+#define ATP_S_IPD_ID    2   //  Reading socket ID after +IPD,
+#define ATP_S_IPD_LEN   3   //  Reading payload length after +IPD,id,
+#define ATP_S_IPD_DATA  4   //  Passing through payload of +IPD frame
+#define ATP_S_CWJAP     5   //  Reading fields of +CWJAP: reply
+
+/**
+ * Keywords recognized in ESP responses and events reported when found
+ */
+static const struct
+{
+    const char  *str;
+    uint32_t    ev;
+} _atpKeywords[] =
+{
+    { "OK",             ESP_STATUS_OK        },
+    { "ERROR",          ESP_STATUS_ERROR     },
+    { "SEND OK",        ESP_STATUS_SENDOK    },
+    { "FAIL",           ESP_STATUS_FAIL      },
+    { "busy...",        ESP_STATUS_BUSY      },
+    { "busy p...",      ESP_STATUS_BUSY      },
+    { "busy s...",      ESP_STATUS_BUSY      },
+    { "READY",          ESP_STATUS_READY     },
+    { "SUCCESS",        ESP_RESPOND_SUCC     },
+    { ">",              ESP_STATUS_RECV      },
+    { "WIFI CONN",      ESP_STATUS_CONNECTED },
+    { "WIFI GOT IP",    ATP_EV_WIFI_IP       },
+    { "WIFI DISCONN",   ESP_STATUS_DISCN     },
+    { ",CONNECT",       ESP_STATUS_SOCKOPEN  },
+    { ",CLOSED",        ESP_STATUS_SOCKCLOSE },
+    { "+IPD,",          ATP_EV_IPD_START     },
+    { "ip:\"",          ATP_EV_IP_START      },
+    { "+CWJAP:",        ATP_EV_CWJAP_START   },
+    { ",SEND OK",       ATP_EV_SEG_OK        },
+    { ",SEND FAIL",     ATP_EV_SEG_FAIL      },
+    { "Recv ",          ATP_EV_SEG_RECV      },
+};
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Consume next character received from ESP
+ * @param c received character
+ * @return bitwise OR of ESP_STATUS_* flags of keywords completed by this char
+ * and ATP_EV_* events (see atParser.h)
+ */
+uint32_t ATParser::Feed(char c)
+{
+    uint32_t retVal = 0;
+
+    switch (_state)
+    {
+    case ATP_S_IPD_DATA:
+        retVal = ATP_EV_IPD_DATA;
+        if (--_ipdLeft == 0)
+        {
+            retVal |= ATP_EV_IPD_END | ATP_EV_LINE | ESP_STATUS_IPD;
+            Reset();
+        }
+        return retVal;
+    case ATP_S_IPD_ID:
+        if (isdigit(c))
+            _sockID = _sockID * 10 + (c - '0');
+        else if (c == ',')
+        {
+            _ipdLen = 0;
+            _state = ATP_S_IPD_LEN;
+        }
+        else
+            _state = ATP_S_TEXT;
+        _lineLen++;
+        return 0;
+    case ATP_S_IPD_LEN:
+        _lineLen++;
+        if (isdigit(c))
+        {
+            if ((_ipdLen * 10 + (c - '0')) > ATP_IPD_MAX)
+                _state = ATP_S_TEXT;
+            else
+                _ipdLen = _ipdLen * 10 + (c - '0');
+            return 0;
+        }
+        if (c != ':')
+        {
+            _state = ATP_S_TEXT;
+            return 0;
+        }
+        //  Header complete, payload follows
+        retVal = ATP_EV_IPD_HDR;
+        _ipdLeft = _ipdLen;
+        _state = ATP_S_IPD_DATA;
+        if (_ipdLeft == 0)
+        {
+            retVal |= ATP_EV_IPD_END | ATP_EV_LINE | ESP_STATUS_IPD;
+            Reset();
+        }
+        return retVal;
+    case ATP_S_IP:
+        if ((isdigit(c) || (c == '.')) && (_ipLen < (sizeof(_ipStr) - 1)))
+        {
+            _ipStr[_ipLen++] = c;
+            _lineLen++;
+            return 0;
+        }
+        //  IP address complete, continue processing char as plain text
+        _ipStr[_ipLen] = '\0';
+        _state = ATP_S_TEXT;
+        retVal = ESP_GOT_IP;
+        break;
+    case ATP_S_CWJAP:
+        //  Reply: +CWJAP:"ssid","bssid",channel,rssi
+        if ((c != '\r') && (c != '\n'))
+        {
+            if (c == ',')
+            {
+                _fieldN++;
+                _fieldVal = 0;
+                _fieldNeg = false;
+            }
+            else if (c == '-')
+                _fieldNeg = true;
+            else if (isdigit(c) && (_fieldVal < 1000))
+                _fieldVal = _fieldVal * 10 + (c - '0');
+            _lineLen++;
+            return 0;
+        }
+        //  Line complete, continue processing char as plain text. Replies
+        //  without RSSI field (e.g. error code on failed connect) are ignored
+        _state = ATP_S_TEXT;
+        if (_fieldN >= 3)
+        {
+            _rssi = (int8_t)(_fieldNeg ? -_fieldVal : _fieldVal);
+            retVal = ATP_EV_RSSI;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return retVal | _Text(c);
+}
+
+/**
+ * Skip bytes of +IPD payload without passing them through Feed() one by one
+ * @param n number of payload bytes to skip (cropped to PayloadLeft())
+ * @return ATP_EV_IPD_END | ATP_EV_LINE | ESP_STATUS_IPD if the last byte of
+ * payload got skipped, 0 otherwise
+ */
+uint32_t ATParser::Skip(uint16_t n)
+{
+    if (_state != ATP_S_IPD_DATA)
+        return 0;
+
+    if (n < _ipdLeft)
+    {
+        _ipdLeft -= n;
+        return 0;
+    }
+
+    Reset();
+    return (ATP_EV_IPD_END | ATP_EV_LINE | ESP_STATUS_IPD);
+}
+
+/**
+ * Get number of bytes of +IPD payload that are still to be received
+ * @return number of payload bytes left, 0 if payload is not being received
+ */
+uint16_t ATParser::PayloadLeft()
+{
+    return ((_state == ATP_S_IPD_DATA) ? _ipdLeft : 0);
+}
+
+/**
+ * Terminate current line regardless of its content (e.g. on communication
+ * timeout) and return parser to initial state. Partially received +IPD frame
+ * is discarded.
+ * @return ATP_EV_LINE if current line wasn't empty, 0 otherwise
+ */
+uint32_t ATParser::Flush()
+{
+    uint32_t retVal = (_lineLen > 0) ? ATP_EV_LINE : 0;
+
+    Reset();
+
+    return retVal;
+}
+
+/**
+ * Return parser to initial state (start of a new line)
+ */
+void ATParser::Reset()
+{
+    _node = 0;
+    _state = ATP_S_TEXT;
+    _lineLen = 0;
+    _hist[_histIt] = '\0';
+}
+
+/**
+ * Get ID of socket reported by last ESP_STATUS_SOCKOPEN, ESP_STATUS_SOCKCLOSE
+ * or ATP_EV_IPD_HDR event
+ * @return socket ID
+ */
+uint8_t ATParser::SockID()
+{
+    return _sockID;
+}
+
+/**
+ * Get payload length of +IPD frame reported by last ATP_EV_IPD_HDR event
+ * @return payload length (in bytes)
+ */
+uint16_t ATParser::IPDLength()
+{
+    return _ipdLen;
+}
+
+/**
+ * Get IP address reported by last ESP_GOT_IP event
+ * @return null-terminated IP address string
+ */
+const char* ATParser::IPStr()
+{
+    return _ipStr;
+}
+
+/**
+ * Get signal strength reported by last ATP_EV_RSSI event
+ * @return RSSI of access point ESP is connected to (in dBm)
+ */
+int8_t ATParser::RSSI()
+{
+    return _rssi;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions           [PROTECTED]
+///-----------------------------------------------------------------------------
+
+/**
+ * Process character of plain text: detect line terminator and advance keyword
+ * automaton
+ * @param c received character
+ * @return events of keywords completed by this character
+ */
+uint32_t ATParser::_Text(char c)
+{
+    uint32_t retVal = 0;
+    char prev = _hist[_histIt];
+
+    _histIt = (_histIt + 1) & (ATP_HIST_LEN - 1);
+    _hist[_histIt] = c;
+
+    //  Line terminator, or prompt for data which comes without terminator
+    if (((prev == '\r') && (c == '\n')) || ((prev == '>') && (c == ' ')))
+    {
+        //  Empty lines are not reported
+        if ((c == ' ') || (_lineLen > 1))
+            retVal = ATP_EV_LINE;
+        _node = 0;
+        _lineLen = 0;
+        return retVal;
+    }
+    _lineLen++;
+
+    _node = _Step(_node, c);
+    retVal = _trie[_node].out;
+
+    //  Socket ID is a digit right in front of ,CONNECT or ,CLOSED
+    if (retVal & (ESP_STATUS_SOCKOPEN | ESP_STATUS_SOCKCLOSE))
+    {
+        uint8_t len = _trie[_node].len;
+        char id = _hist[(_histIt - len) & (ATP_HIST_LEN - 1)];
+
+        if (isdigit(id))
+            _sockID = id - '0';
+        else
+            retVal &= ~(ESP_STATUS_SOCKOPEN | ESP_STATUS_SOCKCLOSE);
+    }
+    //  Confirmation of buffered segment, <link>,<segment>,SEND OK/FAIL: its
+    //  (SEND) OK/FAIL is not a reply to the current command. Socket ID is the
+    //  digit in front of segment ID
+    if (retVal & (ATP_EV_SEG_OK | ATP_EV_SEG_FAIL))
+    {
+        uint8_t len = _trie[_node].len;
+        uint8_t i = len;
+        char id;
+
+        retVal &= ~(ESP_STATUS_SENDOK | ESP_STATUS_OK | ESP_STATUS_FAIL);
+        while ((i < (ATP_HIST_LEN - 2)) &&
+               isdigit(_hist[(_histIt - i) & (ATP_HIST_LEN - 1)]))
+            i++;
+        id = _hist[(_histIt - i - 1) & (ATP_HIST_LEN - 1)];
+        if ((i > len) && (_hist[(_histIt - i) & (ATP_HIST_LEN - 1)] == ',') &&
+            isdigit(id))
+            _sockID = id - '0';
+        else
+            retVal &= ~(ATP_EV_SEG_OK | ATP_EV_SEG_FAIL);
+    }
+    //  Keywords that start a field decoded by state machine
+    if (retVal & ATP_EV_IPD_START)
+    {
+        _sockID = 0;
+        _state = ATP_S_IPD_ID;
+        _node = 0;
+    }
+    if (retVal & ATP_EV_IP_START)
+    {
+        _ipLen = 0;
+        _state = ATP_S_IP;
+        _node = 0;
+    }
+    if (retVal & ATP_EV_CWJAP_START)
+    {
+        _fieldN = 0;
+        _fieldVal = 0;
+        _fieldNeg = false;
+        _state = ATP_S_CWJAP;
+        _node = 0;
+    }
+
+    return retVal & ~(ATP_EV_IPD_START | ATP_EV_IP_START | ATP_EV_CWJAP_START);
+}
+
+/**
+ * Advance keyword automaton by one character
+ * @param node current node
+ * @param c next character
+ * @return new node
+ */
+uint8_t ATParser::_Step(uint8_t node, char c)
+{
+    while (1)
+    {
+        for (uint8_t ch = _trie[node].child; ch != ATP_NONE; ch = _trie[ch].next)
+            if (_trie[ch].c == c)
+                return ch;
+
+        if (node == 0)
+            return 0;
+        node = _trie[node].fail;
+    }
+}
+
+/**
+ * Build keyword trie and its failure links from keyword table
+ */
+void ATParser::_Build()
+{
+    uint8_t queue[ATP_MAX_NODES];
+    uint8_t qHead = 0, qTail = 0;
+
+    memset((void*)_trie, 0, sizeof(_trie));
+    _trie[0].child = ATP_NONE;
+    _trie[0].next = ATP_NONE;
+    _nodes = 1;
+
+    //  Insert keywords into the trie
+    for (uint8_t i = 0; i < (sizeof(_atpKeywords)/sizeof(_atpKeywords[0])); i++)
+    {
+        uint8_t node = 0;
+
+        for (const char *s = _atpKeywords[i].str; *s != '\0'; s++)
+        {
+            uint8_t ch;
+
+            for (ch = _trie[node].child; ch != ATP_NONE; ch = _trie[ch].next)
+                if (_trie[ch].c == *s)
+                    break;
+
+            if (ch == ATP_NONE)
+            {
+                if (_nodes >= ATP_MAX_NODES)
+                    return;
+                ch = _nodes++;
+                _trie[ch].c = *s;
+                _trie[ch].child = ATP_NONE;
+                _trie[ch].next = _trie[node].child;
+                _trie[ch].len = _trie[node].len + 1;
+                _trie[node].child = ch;
+            }
+            node = ch;
+        }
+        _trie[node].out |= _atpKeywords[i].ev;
+    }
+
+    //  Failure links in breadth-first order, so that the node 'fail' points
+    //  to is already complete when processing current node
+    for (uint8_t ch = _trie[0].child; ch != ATP_NONE; ch = _trie[ch].next)
+    {
+        _trie[ch].fail = 0;
+        queue[qTail++] = ch;
+    }
+    while (qHead < qTail)
+    {
+        uint8_t node = queue[qHead++];
+
+        for (uint8_t ch = _trie[node].child; ch != ATP_NONE; ch = _trie[ch].next)
+        {
+            _trie[ch].fail = _Step(_trie[node].fail, _trie[ch].c);
+            //  Keyword that is suffix of this one completes at the same time
+            _trie[ch].out |= _trie[_trie[ch].fail].out;
+            queue[qTail++] = ch;
+        }
+    }
+}
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                 [PUBLIC]
+///-----------------------------------------------------------------------------
+
+ATParser::ATParser() : _nodes(0), _node(0), _state(ATP_S_TEXT), _histIt(0),
+                       _lineLen(0), _sockID(0), _ipdLen(0), _ipdLeft(0),
+                       _ipLen(0), _rssi(0), _fieldVal(0), _fieldNeg(false),
+                       _fieldN(0)
+{
+    memset((void*)_hist, 0, sizeof(_hist));
+    memset((void*)_ipStr, 0, sizeof(_ipStr));
+    _Build();
+}
+
+ATParser::~ATParser()
+{}
+
+#endif  /* __HAL_USE_ESP8266__ */
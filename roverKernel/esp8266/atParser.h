@@ -0,0 +1,138 @@
+/**
+ * atParser.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Incremental parser of ESP8266 AT responses. Consumes one character at a time
+ *  as it arrives from UART and reports results as soon as they are known:
+ *  status keywords (OK, ERROR, SEND OK, ...) are matched in a single pass by a
+ *  keyword trie with failure links (Aho-Corasick automaton) built once on init,
+ *  while socket events, IP address and +IPD frames are decoded by a small state
+ *  machine. Payload of +IPD frames is passed through byte by byte and is never
+ *  matched against keywords. Parser has no side effects, interpreting reported
+ *  events is left to its owner (ESP8266 class).
+ *
+ *  @version 1.3.0
+ *  V1.0.0
+ *  +Keyword trie, +IPD header/payload decoding, socket ID and IP extraction
+ *  V1.1.0
+ *  +Payload of +IPD frame can be skipped in bulk, leaving it in receive buffer
+ *  to be read by its consumer directly
+ *  V1.2.0
+ *  +Signal strength (RSSI) is extracted from +CWJAP: reply (AT+CWJAP?)
+ *  V1.2.1
+ *  ++IPD header with payload length above ATP_IPD_MAX is taken as garbled
+ *  V1.3.0
+ *  +Replies to buffered sends (AT+CIPSENDBUF): segment taken ("Recv "), and
+ *  segment delivered or failed (<link>,<segment>,SEND OK/FAIL, socket ID is
+ *  extracted, SEND OK/FAIL of the current command is not reported for it)
+ */
+#ifndef ROVERKERNEL_ESP8266_ATPARSER_H_
+#define ROVERKERNEL_ESP8266_ATPARSER_H_
+
+#include "hwconfig.h"
+
+/*      Events reported by the parser in addition to ESP_STATUS_* flags     */
+//  Lower 16 bits of value returned by Feed() hold ESP_STATUS_* flags
+#define ATP_STATUS_MASK     0x0000FFFF
+//  Non-empty line terminated by \r\n (or prompt "> "), or +IPD frame completed
+#define ATP_EV_LINE         (1UL<<16)
+//  Header of +IPD frame decoded, SockID() and IPDLength() are valid
+#define ATP_EV_IPD_HDR      (1UL<<17)
+//  Character passed to Feed() is a byte of +IPD payload
+#define ATP_EV_IPD_DATA     (1UL<<18)
+//  Last byte of +IPD payload received
+#define ATP_EV_IPD_END      (1UL<<19)
+//  ESP acquired IP address from access point (WIFI GOT IP)
+#define ATP_EV_WIFI_IP      (1UL<<20)
+//  Reply to AT+CWJAP? decoded, RSSI() is valid
+#define ATP_EV_RSSI         (1UL<<23)
+//  Internal events - keyword starts a field decoded by state machine
+#define ATP_EV_IPD_START    (1UL<<21)
+#define ATP_EV_IP_START     (1UL<<22)
+#define ATP_EV_CWJAP_START  (1UL<<24)
+//  Segment of buffered send delivered, or its delivery failed; SockID() is valid
+#define ATP_EV_SEG_OK       (1UL<<25)
+#define ATP_EV_SEG_FAIL     (1UL<<26)
+//  Data following the prompt received by ESP ("Recv <n> bytes")
+#define ATP_EV_SEG_RECV     (1UL<<27)
+
+//  Max number of nodes in keyword trie (sum of lengths of all keywords + root)
+#define ATP_MAX_NODES       128
+//  Length of history of received characters (has to be power of 2)
+#define ATP_HIST_LEN        32
+//  Node index marking that there's no node
+#define ATP_NONE            0xFF
+//  Longest payload of +IPD frame, header announcing more is taken as garbled
+//  text (length field doesn't overflow, parser doesn't swallow what follows)
+#define ATP_IPD_MAX         8192
+
+/**
+ * ATParser class definition
+ * Incremental (byte-at-a-time) parser of ESP8266 AT responses
+ */
+class ATParser
+{
+    public:
+        ATParser();
+        ~ATParser();
+
+        uint32_t        Feed(char c);
+        uint32_t        Skip(uint16_t n);
+        uint16_t        PayloadLeft();
+        uint32_t        Flush();
+        void            Reset();
+
+        uint8_t         SockID();
+        uint16_t        IPDLength();
+        const char*     IPStr();
+        int8_t          RSSI();
+
+    protected:
+        /**
+         * Node of keyword trie
+         */
+        struct _atpNode
+        {
+            char        c;      //  Character leading into this node
+            uint8_t     child;  //  First child node
+            uint8_t     next;   //  Next sibling node
+            uint8_t     fail;   //  Node of longest proper suffix in the trie
+            uint32_t    out;    //  Events of all keywords ending in this node
+                                //  (including ones reachable through 'fail')
+            uint8_t     len;    //  Depth of node (length of matched keyword)
+        };
+
+        uint8_t         _Step(uint8_t node, char c);
+        void            _Build();
+        uint32_t        _Text(char c);
+
+        //  Keyword trie, node 0 is root
+        struct _atpNode _trie[ATP_MAX_NODES];
+        uint8_t         _nodes;
+        //  Current state of keyword automaton
+        uint8_t         _node;
+        //  State of field decoder (one of ATP_S_* in atParser.cpp)
+        uint8_t         _state;
+        //  Last received characters, used to find socket ID preceding keyword
+        char            _hist[ATP_HIST_LEN];
+        uint8_t         _histIt;
+        //  Number of characters in current line (excluding terminator)
+        uint16_t        _lineLen;
+
+        //  Decoded fields
+        uint8_t         _sockID;
+        uint16_t        _ipdLen;
+        uint16_t        _ipdLeft;
+        char            _ipStr[16];
+        uint8_t         _ipLen;
+        //  Fields of +CWJAP: reply, RSSI is its last field (SSID might contain
+        //  commas, so only the field currently being read is kept)
+        int8_t          _rssi;
+        int16_t         _fieldVal;
+        bool            _fieldNeg;
+        uint8_t         _fieldN;
+};
+
+#endif /* ROVERKERNEL_ESP8266_ATPARSER_H_ */
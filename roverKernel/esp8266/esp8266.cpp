@@ -9,6 +9,7 @@
 #if defined(__HAL_USE_ESP8266__)       //  Compile only if module is enabled
 
 #include "libs/myLib.h"
+#include "libs/strBuilder.h"
 #include "HAL/hal.h"
 
 #include <stdio.h>
@@ -30,11 +31,48 @@
 
 //  Function prototype for an interrupt handler (declared at the bottom)
 void UART7RxIntHandler(void);
+void ESPParseIntHandler(void);
+#if defined(__USE_TASK_SCHEDULER__)
+//  Completion routine of data sent from task scheduler
+void _ESP_SendDone(const uint8_t tag, const uint32_t status);
+#endif  /* __USE_TASK_SCHEDULER__ */
+
+//  Buffer used to assemble commands (shared between all functions), longer
+//  commands are not accepted by command queue anyway
+char _commBuf[ESP_CMD_LEN];
+
+//  Baud rates tried by NegotiateBaud(), in ascending order. Only rates both
+//  sides generate exactly are used: ESP divides 80MHz clock by an integer,
+//  TM4C divides 120MHz by 16 with 1/64 fractional divider
+static const uint32_t _espBaudSteps[] = { 2000000, 2500000, 4000000 };
 
-//  Buffer used to assemble commands (shared between all functions )
-//  2048 is max allowed length for a continuous stream ESP can handle
-char _commBuf[2048];
+/**
+ * Read free-running cycle counter used to time link metrics. Counter is
+ * provided by task scheduler's HAL, without it all timings are 0
+ * @return current value of cycle counter
+ */
+static inline uint32_t _ESP_Cycles()
+{
+#if defined(__USE_TASK_SCHEDULER__)
+    return HAL_TS_GetCycles();
+#else
+    return 0;
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
 
+/**
+ * Convert number of cycles of the counter used to time link metrics to us
+ * @param cycles number of cycles
+ * @return time in us
+ */
+static inline uint32_t _ESP_CyclesToUs(uint32_t cycles)
+{
+#if defined(__USE_TASK_SCHEDULER__)
+    return (cycles / HAL_TS_CyclesPerUS());
+#else
+    return 0;
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
 
 #if defined(__USE_TASK_SCHEDULER__)
 /**
@@ -86,7 +124,8 @@ void _ESP_KernelCallback(void)
     /*
      * Connect to TCP client on given IP address and port
      * args[] = KeepAlive(1B)|IPaddress(7B-15B)|port(2B)|socketID(1B)
-     * retVal ESP library error code (if > 5); or socket ID (if <=5)
+     * retVal socket ID (if < ESP_MAX_CLI); ESP_SOCK_PENDING, ESP_SOCK_BUSY or
+     * ESP library error code otherwise
      */
     case ESP_T_CONNTCP:
         {
@@ -110,23 +149,47 @@ void _ESP_KernelCallback(void)
             //  1st data byte is keep alive flag
             //  Double negation to convert any integer !=0 into boolean
             bool KA = !(!__esp._ker.args[0]);
-            __esp._ker.retVal = __esp.OpenTCPSock(ipAddr, port, KA, sockID);
+            //  Outcome is reported by completion routine once ESP replies
+            __esp._ker.retVal = __esp.OpenTCPSockAsync(ipAddr, port, KA, sockID);
         }
         break;
     /*
      * Send message to specific TCP client
      * args[] = socketID(1B)|message|
+     * When chained to a task with output forwarding, message is omitted from
+     * args[] and forwarded output of preceding task is sent instead
+     * args[] = socketID(1B); fwdArgs[] = message
+     * Nothing is sent if there's no message (e.g. preceding task in chain
+     * produced no output)
      */
     case ESP_T_SENDTCP:
         {
             //  Check if socket ID is valid
             if (!__esp.ValidSocket(__esp._ker.args[0]))
                return;
-            //  Ensure that message is null-terminated
-            __esp._ker.args[__esp._ker.argN] = '\0';
-            //  Initiate TCP send to required client
-            __esp._ker.retVal = __esp.GetClientBySockID(__esp._ker.args[0])
-                                      ->SendTCP((char*)(__esp._ker.args+1));
+            //  No forwarded output and no message in args[], nothing to send
+            if ((__esp._ker.fwdArgN == 0) && (__esp._ker.argN <= 1))
+                return;
+            _espClient *cli = __esp.GetClientBySockID(__esp._ker.args[0]);
+            char *msg = (char*)(__esp._ker.args+1);
+            uint16_t msgLen = 0;
+
+            //  Send forwarded data as-is (it's not null-terminated)
+            if (__esp._ker.fwdArgN > 0)
+            {
+                msg = (char*)(__esp._ker.fwdArgs);
+                msgLen = __esp._ker.fwdArgN;
+            }
+            else    //  Ensure that message is null-terminated
+                __esp._ker.args[__esp._ker.argN] = '\0';
+            //  Queue message for sending, if command queue (or buffer pool) is
+            //  full fall back to sending it right away
+            __esp._ker.retVal = cli->SendTCPAsync(msg, msgLen, _ESP_SendDone);
+            if (__esp._ker.retVal == ESP_STATUS_BUSY)
+            {
+                __esp._stats.busyRetries++;
+                __esp._ker.retVal = cli->SendTCP(msg, msgLen);
+            }
         }
         break;
     /*
@@ -136,13 +199,16 @@ void _ESP_KernelCallback(void)
     case ESP_T_RECVSOCK:
         {
             _espClient  *cli;
+            struct _espRxSlice slc;
             //  Check if socket ID is valid
             if (!__esp.ValidSocket(__esp._ker.args[0]))
                 return;
             cli = __esp.GetClientBySockID(__esp._ker.args[0]);
-            __esp.custHook(__esp._ker.args[0],
-                            (uint8_t*)(cli->RespBody),
-                            (uint16_t)((cli->RespLen)));
+            //  Data is passed to user routine directly from Rx ring
+            if (!cli->Receive(slc))
+                return;
+            __esp.custHook(__esp._ker.args[0], slc.data, slc.len);
+            __esp.Release(slc);
             __esp._ker.retVal = ESP_STATUS_OK;
         }
         break;
@@ -169,8 +235,8 @@ void _ESP_KernelCallback(void)
                 return;
             //  Start by closing all opened sockets
             for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
-                if (__esp._clients[i] != 0)
-                    ((_espClient*)__esp._clients[i])->Close();
+                if (__esp.ValidSocket(i))
+                    __esp._clients[i].Close();
             //  Power down ESP chip
             __esp.Enable(false);
 #ifdef __HAL_USE_EVENTLOG__
@@ -184,25 +250,171 @@ void _ESP_KernelCallback(void)
             //  its flash memory. Result is picked up through ISR asynchronously
         }
         break;
+    /*
+     * Parse data received from ESP, scheduled from UART interrupt
+     * args[] = dummy(1B)
+     * retVal none
+     */
     case ESP_T_PARSE:
         {
+            __esp._ParseRx();
+        }
+        //  Parsing happens all the time, don't report it to event logger
+        return;
+    /*
+     * Send data held in a pooled buffer to specific TCP client. Task takes over
+     * one reference to the buffer and releases it once data is sent
+     * args[] = socketID(1B)|slice(_bufSlice)
+     * When chained to a task with output forwarding, slice is omitted from
+     * args[] and forwarded output of preceding task is taken as the slice. Such
+     * slice is only borrowed from preceding task and is not released here
+     * args[] = socketID(1B); fwdArgs[] = slice(_bufSlice)
+     */
+    case ESP_T_SENDBUF:
+        {
+            struct _bufSlice slc;
+            bool borrowed = (__esp._ker.fwdArgN == sizeof(struct _bufSlice));
+
+            if (borrowed)
+                memcpy((void*)&slc, (void*)__esp._ker.fwdArgs, sizeof(slc));
+            else if (__esp._ker.argN >= (1 + sizeof(struct _bufSlice)))
+                memcpy((void*)&slc, (void*)(__esp._ker.args + 1), sizeof(slc));
+            else
+                return;
 
+            __esp._ker.retVal = ESP_STATUS_ERROR;
+            //  Send only if socket ID is valid, release buffer regardless
+            //  (queued command holds its own reference to the buffer)
+            if (__esp.ValidSocket(__esp._ker.args[0]))
+            {
+                _espClient *cli = __esp.GetClientBySockID(__esp._ker.args[0]);
+
+                __esp._ker.retVal = cli->SendTCPAsync(slc, _ESP_SendDone);
+                if (__esp._ker.retVal == ESP_STATUS_BUSY)
+                {
+                    __esp._stats.busyRetries++;
+                    __esp._ker.retVal = cli->SendTCP(slc);
+                }
+            }
+            if (!borrowed)
+                BufferPool::GetI().Release(slc);
         }
         break;
+    /*
+     * Send data written to specific TCP client that is still waiting to be
+     * coalesced with more data, scheduled once linger time expires
+     * args[] = socketID(1B)
+     */
+    case ESP_T_FLUSH:
+        {
+            //  Client tracks its pending flush task even if socket got closed
+            if (__esp._ker.args[0] >= ESP_MAX_CLI)
+                return;
+            __esp._clients[__esp._ker.args[0]]._FlushDue();
+        }
+        //  Flushing happens all the time, don't report it to event logger
+        return;
+    /*
+     * Sample signal strength of AP ESP is connected to, reply is picked up by
+     * parser and saved into link metrics (see Stats())
+     * args[] = none(1B)
+     * retVal ESP library status code
+     */
+    case ESP_T_RSSI:
+        {
+            __esp._ker.retVal = __esp.SampleRSSI();
+        }
+        //  Sampled periodically, don't report it to event logger
+        return;
     default:
         break;
     }
 
-    //  Report outcome to event logger
+    //  Report outcome to event logger (queued commands report errors once
+    //  they complete)
 #ifdef __HAL_USE_EVENTLOG__
-    if ((__esp._ker.retVal & ESP_STATUS_OK) > 0)
+    if ((__esp._ker.retVal & (ESP_STATUS_OK | ESP_NONBLOCKING_MODE)) > 0)
         EMIT_EV(__esp._ker.serviceID, EVENT_OK);
     else
         EMIT_EV(__esp._ker.serviceID, EVENT_ERROR);
 #endif  /* __HAL_USE_EVENTLOG__ */
 }
+
+/**
+ * Completion routine of data sent from task scheduler, reports failed sending
+ * @param tag socket ID data was sent to
+ * @param status bitwise OR of ESP_STATUS_* returned by the ESP module
+ */
+void _ESP_SendDone(const uint8_t tag, const uint32_t status)
+{
+    UNUSED(tag);
+#ifdef __HAL_USE_EVENTLOG__
+    if ((status & ESP_STATUS_SENDOK) == 0)
+        EMIT_EV(ESP_T_SENDTCP, EVENT_ERROR);
+#else
+    UNUSED(status);
+#endif  /* __HAL_USE_EVENTLOG__ */
+}
 #endif  /* __USE_TASK_SCHEDULER__ */
 
+/**
+ * Completion routine of commands issued by blocking functions, publishes
+ * outcome to the function waiting for it
+ * @param tag unused
+ * @param status bitwise OR of ESP_STATUS_* returned by the ESP module
+ */
+void _ESP_SyncDone(const uint8_t tag, const uint32_t status)
+{
+    UNUSED(tag);
+    ESP8266::GetI()._syncStatus = status;
+    ESP8266::GetI()._syncDone = true;
+}
+
+/**
+ * Completion routine of queued command opening a socket. On success starts
+ * listening for incoming data and applies keep-alive setting and socket type to
+ * the new client
+ * @param tag socket ID in lower 6 bits, UDP flag in bit 6, keep-alive flag in
+ * MSB
+ * @param status bitwise OR of ESP_STATUS_* returned by the ESP module
+ */
+void _ESP_SockDone(const uint8_t tag, const uint32_t status)
+{
+    ESP8266 &__esp = ESP8266::GetI();
+    uint8_t sockID = tag & 0x3F;
+    bool ok;
+
+    __esp._sockPend &= ~(1 << sockID);
+
+    ok = __esp._InStatus(status, ESP_STATUS_OK) &&
+         !__esp._InStatus(status, ESP_STATUS_ERROR) &&
+         (__esp.GetClientBySockID(sockID) != 0);
+    if (ok)
+    {
+        __esp.TCPListen(true);
+        __esp.GetClientBySockID(sockID)->KeepAlive = ((tag & 0x80) > 0);
+        __esp.GetClientBySockID(sockID)->_udp = ((tag & 0x40) > 0);
+    }
+
+#if defined(__HAL_USE_EVENTLOG__) && defined(__USE_TASK_SCHEDULER__)
+    EMIT_EV(ESP_T_CONNTCP, (ok ? EVENT_OK : EVENT_ERROR));
+#endif  /* __HAL_USE_EVENTLOG__ && __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Completion routine of queued command connecting to AP
+ * @param tag unused
+ * @param status bitwise OR of ESP_STATUS_* returned by the ESP module
+ */
+static void _ESP_APDone(const uint8_t tag, const uint32_t status)
+{
+    UNUSED(tag);
+    if ((status & ESP_STATUS_OK) && !(status & ESP_STATUS_ERROR))
+        ESP8266::GetI().wifiStatus = ESP_WIFI_CONNECTED;
+    else
+        ESP8266::GetI().wifiStatus = ESP_WIFI_NONE;
+}
+
 /**
  * Routine invoked by watchdog timer on timeout
  * Sets global status for current communication to "error", clears WD interrupt
@@ -212,6 +424,7 @@ void _ESP_KernelCallback(void)
 void ESPWDISR()
 {
     ESP8266::GetI().flowControl = ESP_STATUS_ERROR;
+    ESP8266::GetI()._stats.wdTimeouts++;
 
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_HANG);
@@ -262,9 +475,32 @@ uint32_t ESP8266::InitHW(int32_t baud)
     EMIT_EV(-1, EVENT_STARTUP);
 #endif  /* __HAL_USE_EVENTLOG__ */
 
-    HAL_ESP_InitPort(baud);
-    HAL_ESP_RegisterIntHandler(UART7RxIntHandler);
+    //  Module starts at its default rate without flow control after power-up
+    _baudDef = baud;
+    _PortInit(baud, false);
     HAL_ESP_InitWD(ESPWDISR);
+    //  Module is still in passthrough mode, make it take commands again
+    if (_ptMode)
+    {
+        _ptServPort = 0;
+        _PTEscape();
+        _PTLeave();
+    }
+    //  Commands still in the queue are never going to get a reply, fail them
+    for (uint8_t i = _cmdN; i > 0; i--)
+        _CmdDone(ESP_STATUS_ERROR);
+    _sockPend = 0;
+    //  Rx ring got emptied, start parsing from the beginning of a message
+    _parser.Reset();
+    _lineStatus = ESP_NO_STATUS;
+    _IPDAbort();
+    _rxFlush = false;
+    for (uint8_t i = 0; i < ESP_RX_SLICES; i++)
+    {
+        if (_rxHeld[i].used)
+            BufferPool::GetI().Release(_rxHeld[i].buf);
+        _rxHeld[i].used = false;
+    }
 
     //    Turn ESP8266 chip ON
     Enable(true);
@@ -276,14 +512,19 @@ uint32_t ESP8266::InitHW(int32_t baud)
     //  Allow for multiple connections
     retVal |= _SendRAW("AT+CIPMUX=1\0");
 
+    //  Go back to the rate negotiated before module got reinitialized
+    if (_baudMax > (uint32_t)baud)
+        NegotiateBaud(_baudMax, _flowReq);
+
     //  Reset internal parameters
     _ipAddress = 0;
     memset(_ipStr, 0, sizeof(_ipStr));
     _servOpen = false;
     _tcpServPort = 0;
+    _sendBuf = ESP_SENDBUF_UNKNOWN;
     wifiStatus = ESP_WIFI_NONE;
     for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
-        _clients[i] = 0;
+        _SlotClose(i);
 
 #if defined(__USE_TASK_SCHEDULER__)
     //  Register module services with task scheduler
@@ -332,6 +573,78 @@ void ESP8266::AddHook(void((*funPoint)(const uint8_t, const uint8_t*, const uint
     custHook = funPoint;
 }
 
+/**
+ * Find the highest baud rate link to ESP works at without errors, up to
+ * [maxBaud]. Rate is stepped up one rate at a time: module is switched with
+ * AT+UART_CUR (not stored in its flash) and link is tested with
+ * ESP_BAUD_PROBES commands. Once a rate fails, link goes back to the previous
+ * one (module is rebooted if it can't be reached at it anymore). Negotiated
+ * rate is restored whenever module is reinitialized (InitHW).
+ * @note Has to be called while there are no commands in progress and no
+ * received data held by consumers (Rx ring is reset when the rate changes)
+ * @param maxBaud highest baud rate to try
+ * @param flowCtrl true to use RTS/CTS flow control
+ * @return baud rate the link runs at
+ */
+uint32_t ESP8266::NegotiateBaud(uint32_t maxBaud, bool flowCtrl)
+{
+    uint32_t prev;
+    uint8_t i;
+
+    if (_ptMode || !CmdIdle())
+        return _baud;
+    for (i = 0; i < ESP_RX_SLICES; i++)
+        if (_rxHeld[i].used)
+            return _baud;
+
+    _baudMax = maxBaud;
+    _flowReq = flowCtrl;
+
+    //  Flow control is turned on (or off) at current rate first
+    if (flowCtrl != _flowCtrl)
+    {
+        prev = _baud;
+        if (!_BaudSet(_baud, flowCtrl))
+            return _baud;
+        if (!_BaudProbe())
+        {
+            _BaudRevert(prev, !flowCtrl);
+            return _baud;
+        }
+    }
+
+    for (i = 0; i < (sizeof(_espBaudSteps) / sizeof(_espBaudSteps[0])); i++)
+    {
+        if ((_espBaudSteps[i] <= _baud) || (_espBaudSteps[i] > maxBaud))
+            continue;
+
+        prev = _baud;
+        //  Module refused the rate, it's still at the previous one
+        if (!_BaudSet(_espBaudSteps[i], flowCtrl))
+            break;
+        if (!_BaudProbe())
+        {
+            _BaudRevert(prev, flowCtrl);
+            break;
+        }
+    }
+
+#ifdef __DEBUG_SESSION__
+    DEBUG_WRITE("ESP link at %d baud\n", _baud);
+#endif
+
+    return _baud;
+}
+
+/**
+ * Get baud rate link to ESP currently runs at
+ * @return baud rate
+ */
+uint32_t ESP8266::Baud()
+{
+    return _baud;
+}
+
 ///-----------------------------------------------------------------------------
 ///                  Functions used with access points                  [PUBLIC]
 ///-----------------------------------------------------------------------------
@@ -346,7 +659,32 @@ void ESP8266::AddHook(void((*funPoint)(const uint8_t, const uint8_t*, const uint
  */
 uint32_t ESP8266::ConnectAP(char* APname, char* APpass, bool nonBlocking)
 {
-    int8_t retVal = ESP_NO_STATUS;
+    uint32_t retVal = ESP_NO_STATUS;
+
+    //  Assemble command for connecting to AP, return if credentials are too
+    //  long to fit in a command
+    StrBuilder cmd(_commBuf, sizeof(_commBuf));
+    cmd.Add("AT+CWJAP_DEF=\"");
+    cmd.Add(APname);
+    cmd.Add("\",\"");
+    cmd.Add(APpass);
+    if (!cmd.Add('"'))
+        return ESP_STATUS_ERROR;
+
+    //  In non-blocking mode queue all commands back-to-back and return, outcome
+    //  of connecting is picked up by completion routine
+    if (nonBlocking)
+    {
+        retVal = SendAsync("AT+CWMODE_DEF=1\0");
+        if (!_InStatus(retVal, ESP_NONBLOCKING_MODE)) return retVal;
+        retVal = SendAsync(_commBuf, _ESP_APDone, 0, 0, 16000);
+        if (!_InStatus(retVal, ESP_NONBLOCKING_MODE)) return retVal;
+        wifiStatus = ESP_WIFI_CONNECTING;
+        //  Read acquired IP address (parser saves it locally)
+        SendAsync("AT+CIPSTA\?\0");
+
+        return retVal;
+    }
 
     //  Set ESP in client mode
     retVal = _SendRAW("AT+CWMODE_DEF=1\0");
@@ -354,17 +692,9 @@ uint32_t ESP8266::ConnectAP(char* APname, char* APpass, bool nonBlocking)
 
     wifiStatus = ESP_WIFI_CONNECTING;
 
-    //  Assemble command & send it
-    memset((void*)_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CWJAP_DEF=\"");
-    strcat(_commBuf, APname);
-    strcat(_commBuf, "\",\"");
-    strcat(_commBuf, APpass);
-    strcat(_commBuf, "\"\0");
-
-    //  Use standard send function but increase timeout to 6s as acquiring IP
+    //  Use standard send function but increase timeout to 16s as acquiring IP
     //  address might take time
-    retVal = _SendRAW(_commBuf, (nonBlocking?ESP_NONBLOCKING_MODE:0), 16000);
+    retVal = _SendRAW(_commBuf, 0, 16000);
     if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
     wifiStatus = ESP_WIFI_CONNECTED;
 
@@ -421,13 +751,11 @@ uint32_t ESP8266::MyIP()
 uint32_t ESP8266::StartTCPServer(uint16_t port)
 {
     int8_t retVal = ESP_STATUS_OK;
-    uint8_t portStr[6] = {0};
+    StrBuilder cmd(_commBuf, sizeof(_commBuf));
 
     //  Start TCP server, in case of error return
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPSERVER=1,");
-    itoa(port, portStr);
-    strcat(_commBuf, (char*)portStr);
+    cmd.Add("AT+CIPSERVER=1,");
+    cmd.AddNum(port);
 
     retVal = _SendRAW(_commBuf);
     if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
@@ -499,41 +827,14 @@ uint32_t ESP8266::OpenTCPSock(char *ipAddr, uint16_t port,
                               bool keepAlive, uint8_t sockID)
 {
     uint32_t retVal;
-    uint8_t strNum[6] = {0};
 
-    //  Can't continue if ESP is not connected
-    if (wifiStatus != ESP_WIFI_CONNECTED)
+    //  Assemble command, in case of error return
+    sockID = _SockCmd(ipAddr, port, sockID);
+    if (sockID >= ESP_MAX_CLI)
         return ESP_STATUS_ERROR;
 
-    //  Check if socket with this ID already exists, if not create it, if yes
-    //  fined first free socket ID and use it instead
-    if (GetClientBySockID(sockID) != 0 || (sockID >= ESP_MAX_CLI))
-    {
-        //  Find free socket number (0-(ESP_MAX_CLI-1) supported)
-        for (sockID = 0; sockID <= ESP_MAX_CLI; sockID++)
-            if (_clients[sockID] == 0)
-                break;
-        //  If loop hit ESP_MAX_CLI there are no free sockets, return error code
-        if (sockID >= ESP_MAX_CLI)
-            return ESP_STATUS_ERROR;
-    }
-
-    //  Assemble command: Open TCP socket to specified IP and port, set
-    //  keep alive interval to 7200ms
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPSTART=");
-    itoa(sockID, strNum);
-    strcat(_commBuf, (char*)strNum);
-    strcat(_commBuf, ",\"TCP\",\"");
-    strcat(_commBuf, ipAddr);
-    strcat(_commBuf, "\",");
-    memset(strNum, 0, sizeof(strNum));
-    itoa(port, strNum);
-    strcat(_commBuf, (char*)strNum);
-    strcat(_commBuf, ",7200\0");
-
     //  Execute command and check outcome
-    retVal = _SendRAW(_commBuf);
+    retVal = _SendRAW(_commBuf, 0, ESP_SOCK_TIMEOUT);
     if (_InStatus(retVal, ESP_STATUS_OK) && !_InStatus(retVal, ESP_STATUS_ERROR))
     {
         //  If success, start listening for potential incoming data from server
@@ -546,273 +847,1146 @@ uint32_t ESP8266::OpenTCPSock(char *ipAddr, uint16_t port,
 }
 
 /**
- * Check if socket with the specified [id] is open (alive)
- * @param id ID of the socket to check
- * @return alive status of particular socket
+ * Queue command opening TCP socket to a client at specific IP and port, without
+ * waiting for ESP to open it. Socket can be used once ValidSocket() reports it.
+ * @param ipAddr string containing IP address of server(null-terminated)
+ * @param port TCP socket port of server
+ * @param keepAlive[optional] whether to maintain the socket open or drop after
+ * first transfer
+ * @param sockID[optional] desired socket ID to assign to this connection, if
+ * not specified smallest free ID is used
+ * @return On success socket ID socket is going to be opened with,
+ *         ESP_SOCK_PENDING if socket with this ID is already being opened,
+ *         ESP_SOCK_BUSY if command queue is full,
+ *         On failure ESP_STATUS_ERROR error code
  */
-bool ESP8266::ValidSocket(uint8_t id)
+uint32_t ESP8266::OpenTCPSockAsync(char *ipAddr, uint16_t port,
+                                   bool keepAlive, uint8_t sockID)
 {
-    return (GetClientBySockID(id) != 0);
+    uint32_t retVal;
+
+    if ((sockID < ESP_MAX_CLI) && (_sockPend & (1 << sockID)))
+        return ESP_SOCK_PENDING;
+
+    //  Assemble command, in case of error return
+    sockID = _SockCmd(ipAddr, port, sockID);
+    if (sockID >= ESP_MAX_CLI)
+        return ESP_STATUS_ERROR;
+
+    //  Socket ID and keep-alive flag are passed to completion routine in tag
+    retVal = SendAsync(_commBuf, _ESP_SockDone,
+                       sockID | (keepAlive ? 0x80 : 0x00), 0, ESP_SOCK_TIMEOUT);
+    if (_InStatus(retVal, ESP_STATUS_BUSY))
+        return ESP_SOCK_BUSY;
+    if (!_InStatus(retVal, ESP_NONBLOCKING_MODE))
+        return retVal;
+
+    _sockPend |= (1 << sockID);
+    return sockID;
 }
 
 /**
- * Get pointer to client object based on specified [index] in _client vector
- * @param index desired index of client to get
- * @return pointer to ESP client object under given index (if it exists, if not
- *          NULL pointer(0) returned)
+ * Open UDP socket for exchanging datagrams with specific IP and port. Data sent
+ * through the socket isn't acknowledged by the receiver, so ESP reports it as
+ * sent as soon as datagram leaves the module. Socket is never closed by remote
+ * side, it stays open until closed locally.
+ * @param ipAddr string containing IP address of remote side(null-terminated)
+ * @param port UDP port on remote side
+ * @param sockID[optional] desired socket ID to assign to this connection, if
+ * not specified smallest free ID is used
+ * @return On success socket ID of UDP socket in _client vector,
+ *         On failure ESP_STATUS_ERROR error code
  */
-_espClient* ESP8266::GetClientByIndex(uint8_t index)
+uint32_t ESP8266::OpenUDPSock(char *ipAddr, uint16_t port, uint8_t sockID)
 {
-    if (ESP_MAX_CLI > index)
-        return const_cast<_espClient*>(_clients[index]);
-    else
-        return 0;
+    uint32_t retVal;
+
+    //  Assemble command, in case of error return
+    sockID = _SockCmd(ipAddr, port, sockID, true);
+    if (sockID >= ESP_MAX_CLI)
+        return ESP_STATUS_ERROR;
+
+    //  Execute command and check outcome
+    retVal = _SendRAW(_commBuf, 0, ESP_SOCK_TIMEOUT);
+    if (_InStatus(retVal, ESP_STATUS_OK) && !_InStatus(retVal, ESP_STATUS_ERROR))
+    {
+        //  If success, start listening for potential incoming datagrams
+        TCPListen(true);
+        GetClientBySockID(sockID)->KeepAlive = true;
+        GetClientBySockID(sockID)->_udp = true;
+        retVal = sockID;
+    }
+
+    return retVal;
 }
 
 /**
- * Get pointer to client object having specified socket [id]
- * @param id socket id as returned by ESP on opened socket
- * @return pointer to ESP client object under given id (if it exists, if not
- *          NULL pointer(0) returned)
+ * Queue command opening UDP socket to specific IP and port, without waiting for
+ * ESP to open it. Socket can be used once ValidSocket() reports it.
+ * @param ipAddr string containing IP address of remote side(null-terminated)
+ * @param port UDP port on remote side
+ * @param sockID[optional] desired socket ID to assign to this connection, if
+ * not specified smallest free ID is used
+ * @return On success socket ID socket is going to be opened with,
+ *         ESP_SOCK_PENDING if socket with this ID is already being opened,
+ *         ESP_SOCK_BUSY if command queue is full,
+ *         On failure ESP_STATUS_ERROR error code
  */
-_espClient* ESP8266::GetClientBySockID(uint8_t id)
+uint32_t ESP8266::OpenUDPSockAsync(char *ipAddr, uint16_t port, uint8_t sockID)
 {
-    return GetClientByIndex(id);
+    uint32_t retVal;
+
+    if ((sockID < ESP_MAX_CLI) && (_sockPend & (1 << sockID)))
+        return ESP_SOCK_PENDING;
+
+    //  Assemble command, in case of error return
+    sockID = _SockCmd(ipAddr, port, sockID, true);
+    if (sockID >= ESP_MAX_CLI)
+        return ESP_STATUS_ERROR;
+
+    //  Socket ID, UDP and keep-alive flag are passed to completion routine in tag
+    retVal = SendAsync(_commBuf, _ESP_SockDone, sockID | 0x40 | 0x80, 0,
+                       ESP_SOCK_TIMEOUT);
+    if (_InStatus(retVal, ESP_STATUS_BUSY))
+        return ESP_SOCK_BUSY;
+    if (!_InStatus(retVal, ESP_NONBLOCKING_MODE))
+        return retVal;
+
+    _sockPend |= (1 << sockID);
+    return sockID;
 }
 
 ///-----------------------------------------------------------------------------
-///                      Miscellaneous functions                        [PUBLIC]
+///                      Functions related to passthrough mode          [PUBLIC]
 ///-----------------------------------------------------------------------------
 
 /**
- * ESP reply message parser
- * Checks ESP reply stream for commands, actions and events and updates global
- * variables accordingly.
- * @param rxBuffer string containing reply message from ESP
- * @param rxLen length of [rxBuffer] string
- * @return bitwise OR of all statuses(ESP_STATUS_*) found in the message string
+ * Enter passthrough mode: open a single socket (TCP or UDP) to specific IP and
+ * port and stream data to it without issuing AT command for every send. Data
+ * written through the socket's _espClient (ID ESP_PT_SOCK) goes to the wire
+ * as-is and ESP forwards it every 20ms. Everything received is data of the
+ * socket. All other sockets are closed and TCP server is stopped as ESP only
+ * supports passthrough in single connection mode. No AT commands can be sent
+ * until passthrough mode is left through StopPassthrough().
+ * @note Blocking function, returns once ESP is ready to take data
+ * @param ipAddr string containing IP address of server(null-terminated)
+ * @param port TCP/UDP port of server
+ * @param udp[optional] whether to open UDP socket instead of TCP one
+ * @return On success socket ID of passthrough socket (ESP_PT_SOCK),
+ *         On failure bitwise OR of ESP_STATUS_* (including ESP_STATUS_ERROR)
  */
-uint32_t ESP8266::ParseResponse(char* rxBuffer, uint16_t rxLen)
+uint32_t ESP8266::StartPassthrough(char *ipAddr, uint16_t port, bool udp)
 {
-    //  Return value
-    uint32_t retVal = ESP_NO_STATUS;
-    //  Flags to be set when the parameter has been found
-    int16_t ipFlag= -1, respFlag = -1, sockOflag = -1, sockCflag = -1;
-    //  Pointer to char, used to temporary store return value of strstr function
-    char *retTemp;
-
-    //  If message is empty return here
-    if (rxLen < 1)
-        return retVal;
+    uint32_t retVal;
+    uint16_t i;
 
-    //  IP address embedded, save pointer to its first digit(as string)
-    if ((retTemp = strstr(rxBuffer,"ip:\"")) != NULL)
-        ipFlag = retTemp - rxBuffer + 4;
+    if (_ptMode || (wifiStatus != ESP_WIFI_CONNECTED))
+        return ESP_STATUS_ERROR;
 
-    //  Message from one of the sockets, save pointer to first character
-    //  (which is always message length!)
-    if ((retTemp = strstr(rxBuffer,"+IPD,")) != NULL)
+    //  Single connection mode can't be entered while there are open sockets
+    //  or TCP server is running, close them first
+    for (i = 0; i < ESP_MAX_CLI; i++)
+        if (ValidSocket(i))
+            _clients[i].Close();
+    _ptServPort = _tcpServPort;
+    if (_tcpServPort != 0)
+        StopTCPServer();
+
+    retVal = _SendRAW("AT+CIPMUX=0\0");
+    if (!_InStatus(retVal, ESP_STATUS_OK) || _InStatus(retVal, ESP_STATUS_ERROR))
     {
-        respFlag = retTemp - rxBuffer + 5;
-        retVal |= ESP_STATUS_IPD;
+        _PTLeave();
+        return (retVal | ESP_STATUS_ERROR);
     }
 
-    //  Look for general status messages returned by ESP
-    if (strstr(rxBuffer,"WIFI CONN") != NULL)
+    //  Assemble command: Open socket to specified IP and port, TCP socket with
+    //  keep alive interval of 7200ms
+    StrBuilder cmd(_commBuf, sizeof(_commBuf));
+    cmd.Add(udp ? "AT+CIPSTART=\"UDP\",\"" : "AT+CIPSTART=\"TCP\",\"");
+    cmd.Add(ipAddr);
+    cmd.Add("\",");
+    cmd.AddNum(port);
+    if (!udp)
+        cmd.Add(",7200");
+    if (cmd.Overflow())
     {
-        retVal |= ESP_STATUS_CONNECTED;
-        wifiStatus = ESP_WIFI_CONNECTING;
+        _PTLeave();
+        return ESP_STATUS_ERROR;
     }
-    if (strstr(rxBuffer,"WIFI GOT IP") != NULL)
-        wifiStatus = ESP_WIFI_CONNECTED;
-    if (strstr(rxBuffer,"WIFI DISCONN") != NULL)
-        retVal |= ESP_STATUS_DISCN;
-    if (strstr(rxBuffer,"OK") != NULL)
-        retVal |= ESP_STATUS_OK;
-    if (strstr(rxBuffer,"busy...") != NULL)
-        retVal |= ESP_STATUS_BUSY;
-    if (strstr(rxBuffer,"FAIL") != NULL)
-        retVal |= ESP_STATUS_FAIL;
-    if (strstr(rxBuffer,"ERROR") != NULL)
-        retVal |= ESP_STATUS_ERROR;
-    if (strstr(rxBuffer,"READY") != NULL)
-        retVal |= ESP_STATUS_READY;
-    if (strstr(rxBuffer,"SEND OK") != NULL)
-        retVal |= ESP_STATUS_SENDOK;
-    if (strstr(rxBuffer,"SUCCESS") != NULL)
-        retVal |= ESP_RESPOND_SUCC;
-    if (strstr(rxBuffer,">") != NULL)
-        retVal |= ESP_STATUS_RECV;
-
-    //  If new socket is opened save socket id
-    if ((retTemp =strstr(rxBuffer,",CONNECT")) != NULL)
-    {
-        sockOflag = retTemp - rxBuffer - 1; //Sock ID position
-        //  Socket got opened, create new client for it
-        if (sockOflag >= 0)
-            _clients[rxBuffer[sockOflag] - 48] =
-                    new _espClient(rxBuffer[sockOflag] - 48, this);
-
-        retVal |= ESP_STATUS_SOCKOPEN;
-    }
-    //  If socket is closed save socket id
-    if ((retTemp =strstr(rxBuffer,",CLOSED")) != NULL)
-    {
-        //  Handles a case when multiple sockets are closed at the same time
-        //  e.g. when few sockets are opened to the same server, and server
-        //  goes down
-        while (retTemp != NULL)
-        {
-            sockCflag = retTemp - rxBuffer - 1; //Sock ID position
-            //  Socket got closed, find client with this ID and delete it
-            if (sockCflag >= 0)
-            {
-                delete _clients[rxBuffer[sockCflag] - 48];
-                _clients[rxBuffer[sockCflag] - 48] = 0;
-            }
 
-            retTemp =strstr(retTemp+1,",CLOSED");
-        }
-        retVal |= ESP_STATUS_SOCKCLOSE;
+    //  Open socket, turn on passthrough mode and start sending
+    retVal = _SendRAW(_commBuf, 0, ESP_SOCK_TIMEOUT);
+    if (_InStatus(retVal, ESP_STATUS_OK) && !_InStatus(retVal, ESP_STATUS_ERROR))
+        retVal = _SendRAW("AT+CIPMODE=1\0");
+    if (_InStatus(retVal, ESP_STATUS_OK) && !_InStatus(retVal, ESP_STATUS_ERROR))
+        retVal = _SendRAW("AT+CIPSEND\0", ESP_STATUS_RECV);
+    if (!_InStatus(retVal, ESP_STATUS_OK) || _InStatus(retVal, ESP_STATUS_ERROR))
+    {
+        _PTLeave();
+        return (retVal | ESP_STATUS_ERROR);
     }
 
-    //  IP address embedded, extract it
-    if (ipFlag >= 0)
+    //  ESP is ready to take data once it responds with prompt (which comes
+    //  after OK and without line terminator)
+    for (i = 0; i < 250; i++)
     {
-        int i = ipFlag;
-        memset(_ipStr, 0, 16);
-        while(((rxBuffer[i] == '.') || isdigit(rxBuffer[i])) && (i < rxLen))
-            { _ipStr[i-ipFlag] = rxBuffer[i]; i++; }
-
-        _ipAddress = _IPtoInt(_ipStr);
-        retVal |= ESP_GOT_IP;
-    }
-    //  TCP incoming data embedded, extract it
-    //  Data format:> +IPD,socketID,length:message
-    if (respFlag >= 0)
-    {
-        int i;
-        //  Get client who sent the incoming data (based on socket ID)
-        _espClient *cli = const_cast<_espClient*>(_clients[_IDtoIndex(rxBuffer[respFlag] - 48)]);
-
-        //  respFlag points to socket ID (single digit < 5)
-        i = respFlag+2; //Skip comma and go to first digit of length
-        //  Colon marks beginning of the message, everything before it and after
-        //  the current position(i) are digits of message length
-        uint8_t cmsgLen[3] = {0};
-        //  Extract message length
-        while(rxBuffer[i++] != ':') //  ++ here so colon is skipped when done
-            cmsgLen[i-1-respFlag-2] = rxBuffer[i-1];
-        //  Convert message length string to int and save it
-        cli->RespLen = (uint16_t)lroundf(stof(cmsgLen, i-1-respFlag));
-        // i now points to the first char of the actual received message
-        //  Use raspFlag to mark starting point
-        respFlag = i;
-        //  Loop until the end of received message
-        while((i-respFlag) < cli->RespLen)
-        {
-            cli->RespBody[i - respFlag] = rxBuffer[i];
-            i++;
-        }
-        //  Set flag that new response has been received
-        cli->_respRdy = true;
+        _ParseRx();
+        if (_InStatus(flowControl | _lineStatus, ESP_STATUS_RECV))
+            break;
+        HAL_DelayUS(1000);
+    }
+    _parser.Reset();
+    _lineStatus = ESP_NO_STATUS;
+    _ptMode = true;
+    //  No prompt, module might still be in passthrough mode so escape it
+    if (i == 250)
+    {
+        _PTEscape();
+        _PTLeave();
+        return ESP_STATUS_ERROR;
     }
 
-    return retVal;
-}
-
-///-----------------------------------------------------------------------------
-///                      Class constructor & destructor              [PROTECTED]
-///-----------------------------------------------------------------------------
+    //  Open client for the socket, it's never closed by ESP on its own
+    _SlotOpen(ESP_PT_SOCK)->_udp = udp;
+    TCPListen(true);
 
-ESP8266::ESP8266() : custHook(0), flowControl(ESP_NO_STATUS), _tcpServPort(0),
-                     _ipAddress(0), _servOpen(false), wifiStatus(0)
-{
-#ifdef __HAL_USE_EVENTLOG__
-    EMIT_EV(-1, EVENT_UNINITIALIZED);
-#endif  /* __HAL_USE_EVENTLOG__ */
+    return ESP_PT_SOCK;
 }
 
-ESP8266::~ESP8266()
+/**
+ * Leave passthrough mode: send data still waiting in the passthrough socket,
+ * terminate streaming by sending "+++" (preceded and followed by ESP_PT_GUARD
+ * ms of silence), close the socket and return to multiple connections mode.
+ * TCP server stopped by StartPassthrough() is started again.
+ * @note Blocking function, takes at least 2*ESP_PT_GUARD ms
+ * @return bitwise OR of ESP_STATUS_* returned when switching back to multiple
+ * connections mode, ESP_STATUS_ERROR if not in passthrough mode
+ */
+uint32_t ESP8266::StopPassthrough()
 {
-    Enable(false);
-}
+    _espClient *cli = GetClientBySockID(ESP_PT_SOCK);
 
-///-----------------------------------------------------------------------------
-///                      Miscellaneous functions                     [PROTECTED]
-///-----------------------------------------------------------------------------
+    if (!_ptMode)
+        return ESP_STATUS_ERROR;
+
+    if (cli != 0)
+        cli->Flush();
+    _PTEscape();
+
+    //  Socket is closed below, free its slot together with data it holds
+    _SlotClose(ESP_PT_SOCK);
+
+    return _PTLeave();
+}
 
 /**
- * Check whether the [flag]s are set in the [status] message
- * @param status to check for flags
- * @param flag bitwise OR of ESP_STATUS_* values to look for in status
- * @return true: if ALL flags are set in status
- *        false: if at least on flag is not set in status
+ * Check if module is in passthrough mode
+ * @return true: if in passthrough mode (only passthrough socket can be used),
+ *        false: otherwise
  */
-bool ESP8266::_InStatus(const uint32_t status, const uint32_t flag)
+bool ESP8266::Passthrough()
 {
-    return ((status & flag) > 0);
+    return _ptMode;
 }
 
 /**
- * Send command to ESP8266 module
- * Sends command passed in the null-terminated [txBuffer]. This is a blocking
- * function, awaiting reply from ESP. Function returns when status OK or ERROR
- * or any other status passed in [flags] have been received from ESP. Timeout
- * is value at which watchdog timer interrupts the process and returns ERROR flag.
- * @param txBuffer null-terminated string with command to execute
- * @param flags bitwise OR of ESP_STATUS_* values
+ * Check if socket with the specified [id] is open (alive)
+ * @param id ID of the socket to check
+ * @return alive status of particular socket
+ */
+bool ESP8266::ValidSocket(uint8_t id)
+{
+    return (GetClientBySockID(id) != 0);
+}
+
+/**
+ * Check if socket with the specified [id] is being opened by queued command
+ * (see OpenTCPSockAsync()/OpenUDPSockAsync())
+ * @param id ID of the socket to check
+ * @return true if ESP hasn't replied to command opening the socket yet
+ */
+bool ESP8266::SockPending(uint8_t id)
+{
+    return (id < ESP_MAX_CLI) && ((_sockPend & (1 << id)) > 0);
+}
+
+/**
+ * Get pointer to client object based on specified [index] in _client vector
+ * @param index desired index of client to get
+ * @return pointer to ESP client object under given index (if it's alive, if
+ *          not NULL pointer(0) returned)
+ */
+_espClient* ESP8266::GetClientByIndex(uint8_t index)
+{
+    if ((ESP_MAX_CLI > index) && _clients[index]._alive)
+        return &_clients[index];
+    else
+        return 0;
+}
+
+/**
+ * Get pointer to client object having specified socket [id]
+ * @param id socket id as returned by ESP on opened socket
+ * @return pointer to ESP client object under given id (if it exists, if not
+ *          NULL pointer(0) returned)
+ */
+_espClient* ESP8266::GetClientBySockID(uint8_t id)
+{
+    return GetClientByIndex(id);
+}
+
+///-----------------------------------------------------------------------------
+///                      Miscellaneous functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Queue command to ESP8266 module without waiting for reply. Command is issued
+ * as soon as all commands queued before it complete. Command completes when
+ * status OK, ERROR, FAIL or any other status passed in [flags] is received, or
+ * when there's no reply for [timeout] ms (watchdog timer reports ERROR).
+ * @note Completion routine is called from main context, while parsing reply. It
+ * can queue new commands but must not call blocking functions of this library
+ * @param cmd null-terminated string with command to execute
+ * @param done[optional] routine to call once command completes, receives [tag]
+ * and bitwise OR of ESP_STATUS_* returned by the ESP module
+ * @param tag[optional] value passed to completion routine
+ * @param flags[optional] bitwise OR of ESP_STATUS_* values
+ * @param timeout[optional] time in ms before the command is failed by WD timer
+ * @return ESP_NONBLOCKING_MODE if command was queued,
+ *         ESP_STATUS_BUSY if command queue is full,
+ *         ESP_STATUS_ERROR if command is too long or module is in
+ *         passthrough mode
+ */
+uint32_t ESP8266::SendAsync(const char *cmd,
+                            void((*done)(const uint8_t, const uint32_t)),
+                            uint8_t tag, uint32_t flags, uint32_t timeout)
+{
+    struct _espCmd *c;
+
+    if ((strlen(cmd) >= ESP_CMD_LEN) || _ptMode)
+        return ESP_STATUS_ERROR;
+
+    c = _CmdPush(cmd, flags, timeout);
+    if (c == 0)
+        return ESP_STATUS_BUSY;
+    c->done = done;
+    c->tag = tag;
+    _CmdCommit();
+
+    return ESP_NONBLOCKING_MODE;
+}
+
+/**
+ * Check if all queued commands have completed
+ * @return true: if command queue is empty,
+ *        false: if there's command waiting for reply
+ */
+bool ESP8266::CmdIdle()
+{
+    return (_cmdN == 0);
+}
+
+/**
+ * Queue request for signal strength of AP ESP is connected to. RSSI from the
+ * reply is saved into link metrics (see Stats()) once it arrives
+ * @return ESP_NONBLOCKING_MODE if request got queued,
+ *         ESP_STATUS_ERROR if ESP is not connected to AP (or is in passthrough
+ *         mode), ESP_STATUS_BUSY if command queue is full
+ */
+uint32_t ESP8266::SampleRSSI()
+{
+    if (wifiStatus != ESP_WIFI_CONNECTED)
+        return ESP_STATUS_ERROR;
+
+    return SendAsync("AT+CWJAP\?\0");
+}
+
+/**
+ * Get metrics of the link to ESP collected since initialization (or the last
+ * call to ResetStats())
+ * @return copy of link metrics
+ */
+struct _espStats ESP8266::Stats()
+{
+    return _stats;
+}
+
+/**
+ * Reset all link metrics to 0 (last RSSI sample is kept)
+ */
+void ESP8266::ResetStats()
+{
+    int8_t rssi = _stats.rssi;
+
+    memset((void*)&_stats, 0, sizeof(_stats));
+    _stats.rssi = rssi;
+}
+
+/**
+ * Release data received on a socket, allowing its space in Rx ring to be reused
+ * @param slc[in/out] slice of received data, invalidated on exit
+ */
+void ESP8266::Release(struct _espRxSlice &slc)
+{
+    if ((slc.id < ESP_RX_SLICES) && _rxHeld[slc.id].used)
+    {
+        BufferPool::GetI().Release(_rxHeld[slc.id].buf);
+        _rxHeld[slc.id].used = false;
+        _RxFree();
+    }
+
+    slc.data = 0;
+    slc.len = 0;
+    slc.id = ESP_RX_NOSLICE;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor              [PROTECTED]
+///-----------------------------------------------------------------------------
+
+ESP8266::ESP8266() : custHook(0), flowControl(ESP_NO_STATUS), _tcpServPort(0),
+                     _ipAddress(0), _servOpen(false), wifiStatus(0),
+                     _lineStatus(ESP_NO_STATUS), _ipdCli(0),
+                     _rxFlush(false), _ipdPos(0),
+                     _ipdMode(ESP_IPD_DROP),
+                     _cmdHead(0), _cmdN(0), _syncDone(false),
+                     _syncStatus(ESP_NO_STATUS), _sockPend(0),
+                     _sendBuf(ESP_SENDBUF_UNKNOWN), _ptMode(false), _ptServPort(0), _baud(ESP_DEF_BAUD),
+                     _flowCtrl(false), _baudDef(ESP_DEF_BAUD), _baudMax(0),
+                     _flowReq(false), _rxOverrunSeen(0), _rxErrorsSeen(0),
+                     _rxParsed(0)
+{
+    for (uint8_t i = 0; i < ESP_RX_SLICES; i++)
+        _rxHeld[i].used = false;
+    _ipdBuf.id = BUFP_INVALID;
+    memset((void*)&_stats, 0, sizeof(_stats));
+    //  Client slots are bound to their socket ID for good
+    for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
+    {
+        _clients[i]._parent = this;
+        _clients[i]._id = i;
+    }
+
+#ifdef __HAL_USE_EVENTLOG__
+    EMIT_EV(-1, EVENT_UNINITIALIZED);
+#endif  /* __HAL_USE_EVENTLOG__ */
+}
+
+ESP8266::~ESP8266()
+{
+    Enable(false);
+}
+
+///-----------------------------------------------------------------------------
+///                      Miscellaneous functions                     [PROTECTED]
+///-----------------------------------------------------------------------------
+
+/**
+ * Check whether the [flag]s are set in the [status] message
+ * @param status to check for flags
+ * @param flag bitwise OR of ESP_STATUS_* values to look for in status
+ * @return true: if ALL flags are set in status
+ *        false: if at least on flag is not set in status
+ */
+bool ESP8266::_InStatus(const uint32_t status, const uint32_t flag)
+{
+    return ((status & flag) > 0);
+}
+
+/**
+ * Parse data waiting in Rx ring. Called from main context, either by parsing
+ * task deferred from UART interrupt or while waiting for reply from ESP.
+ * Without task scheduler it's also called from software interrupt, which is
+ * held back while main context is parsing.
+ */
+void ESP8266::_ParseRx()
+{
+    const uint8_t *data;
+    uint16_t len, i, n;
+    uint32_t ev;
+    uint32_t start = _ESP_Cycles();
+    uint32_t bytesIn = _stats.bytesIn;
+    bool lost;
+
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(true);
+#endif  /* __USE_TASK_SCHEDULER__ */
+
+    //  Count errors reported by HAL since the last run
+    _stats.rxErrors += HAL_ESP_RxErrors() - _rxErrorsSeen;
+    _rxErrorsSeen = HAL_ESP_RxErrors();
+    lost = (HAL_ESP_RxOverrun() != _rxOverrunSeen);
+    _stats.rxOverruns += HAL_ESP_RxOverrun() - _rxOverrunSeen;
+    _rxOverrunSeen = HAL_ESP_RxOverrun();
+
+    //  In passthrough mode everything received is data of the only socket,
+    //  it's handed over in chunks as it comes in
+    while (_ptMode && ((len = min(HAL_ESP_RxAvail(), BUFP_BLOCK_SIZE)) > 0))
+    {
+        uint32_t pos = HAL_ESP_RxPosition();
+
+        HAL_ESP_RxConsume(len);
+        _rxParsed = pos + len;
+        _stats.bytesIn += len;
+        _RxDeliver(GetClientBySockID(ESP_PT_SOCK), pos, len);
+    }
+
+    //  Data is parsed directly from the ring, in up to 2 continuous blocks
+    while ((len = HAL_ESP_RxPeek(&data)) > 0)
+    {
+        //  Data got lost because Rx ring was full (overrun), or reader got moved
+        //  ahead of unparsed data, message being parsed is incomplete. Drop it
+        //  and resynchronize on the next line
+        if (lost || (HAL_ESP_RxPosition() != _rxParsed))
+        {
+            lost = false;
+            _parser.Reset();
+            _lineStatus = ESP_NO_STATUS;
+            _IPDAbort();
+        }
+
+        _stats.bytesIn += len;
+        for (i = 0; i < len; i += n)
+        {
+            //  Payload of +IPD frame is taken in continuous pieces, as much
+            //  of it as there is in the ring. Parser only skips over it
+            n = min(_parser.PayloadLeft(), len - i);
+            if (n > 0)
+            {
+                _IPDData(data + i, n);
+                HAL_ESP_RxConsume(n);
+                _ParseEvent(_parser.Skip(n));
+                continue;
+            }
+
+            n = 1;
+            HAL_ESP_RxConsume(1);
+            ev = _parser.Feed((char)data[i]);
+            if (ev & ATP_EV_IPD_HDR)
+                _ipdPos = HAL_ESP_RxPosition();
+            _ParseEvent(ev);
+        }
+        _rxParsed += len;
+    }
+
+    //  Free space in the ring that is not held by any consumer
+    _RxFree();
+
+    //  If watchdog timer timed out, terminate message received so far so that
+    //  its status gets reported
+    if (_rxFlush)
+    {
+        _rxFlush = false;
+        _ParseEvent(_parser.Flush());
+        _IPDAbort();
+        //  Fail command which didn't get reply in time
+        _CmdCheck();
+    }
+
+    //  Time only runs which had something to parse (parser is also polled
+    //  while waiting for reply)
+    if (_stats.bytesIn != bytesIn)
+    {
+        uint32_t us = _ESP_CyclesToUs(_ESP_Cycles() - start);
+
+        _stats.parseRuns++;
+        if (us > _stats.parseMaxUs)
+            _stats.parseMaxUs = us;
+        _StatsHist(_stats.parseTime, us);
+    }
+
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(false);
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Count sample into histogram of link metrics
+ * @param hist histogram with ESP_HIST_BINS bins (bin i counts values in range
+ * [2^i, 2^(i+1)), bin 0 also counts 0, last bin counts everything above)
+ * @param val value of the sample
+ */
+void ESP8266::_StatsHist(uint32_t *hist, uint32_t val)
+{
+    uint8_t bin = 0;
+
+    while ((val > 1) && (bin < (ESP_HIST_BINS - 1)))
+    {
+        val >>= 1;
+        bin++;
+    }
+    hist[bin]++;
+}
+
+/**
+ * Take hold of payload received on a socket so that it's not overwritten until
+ * consumer releases it. Payload that wrapped around the end of Rx ring is
+ * copied into pooled buffer to be continuous.
+ * @param pos position in Rx ring of the first byte of payload
+ * @param len length of payload
+ * @param buf[optional] pooled buffer payload was already copied into, slice
+ * takes over caller's reference to it ([pos] and [len] are then ignored)
+ * @return slice pointing to received payload, if all slices are taken or there
+ * is no free pooled buffer ID of slice is ESP_RX_NOSLICE (payload is dropped)
+ */
+struct _espRxSlice ESP8266::_RxHold(uint32_t pos, uint16_t len,
+                                    struct _bufSlice *buf)
+{
+    struct _espRxSlice retVal = { 0, 0, ESP_RX_NOSLICE };
+    const uint8_t *data;
+    uint16_t cont;
+    uint8_t i;
+
+    for (i = 0; i < ESP_RX_SLICES; i++)
+        if (!_rxHeld[i].used)
+            break;
+    if (i == ESP_RX_SLICES)
+        return retVal;
+
+    _rxHeld[i].pos = pos;
+    _rxHeld[i].buf.id = BUFP_INVALID;
+
+    cont = HAL_ESP_RxPeekAt(pos, &data);
+    //  Payload reassembled in pooled buffer as it arrived
+    if (buf != 0)
+    {
+        _rxHeld[i].buf = *buf;
+        buf->id = BUFP_INVALID;
+        data = BufferPool::GetI().Data(_rxHeld[i].buf);
+        len = _rxHeld[i].buf.len;
+    }
+    //  Payload wrapped around the end of the ring, copy it into pooled buffer
+    else if (cont < len)
+    {
+        if ((len > BUFP_BLOCK_SIZE) ||
+            !BufferPool::GetI().Acquire(_rxHeld[i].buf))
+            return retVal;
+
+        uint8_t *dst = BufferPool::GetI().Data(_rxHeld[i].buf);
+
+        memcpy((void*)dst, (void*)data, cont);
+        HAL_ESP_RxPeekAt(pos + cont, &data);
+        memcpy((void*)(dst + cont), (void*)data, len - cont);
+        _rxHeld[i].buf.len = len;
+        data = dst;
+    }
+
+    _rxHeld[i].used = true;
+    retVal.data = data;
+    retVal.len = len;
+    retVal.id = i;
+
+    return retVal;
+}
+
+/**
+ * Hand payload received on a socket to its client (queued behind payloads not
+ * yet taken, see _espClient::RxPolicy) and pass it to a user-defined function
+ * for further processing
+ * @param cli client data was received on, if 0 data is dropped
+ * @param pos position in Rx ring of the first byte of payload
+ * @param len length of payload
+ * @param buf[optional] pooled buffer holding the payload instead of Rx ring,
+ * reference to it is taken over if payload is delivered
+ */
+void ESP8266::_RxDeliver(_espClient *cli, uint32_t pos, uint16_t len,
+                         struct _bufSlice *buf)
+{
+    struct _espRxSlice slc;
+    uint32_t dropped;
+
+    if (cli == 0)
+    {
+        _stats.rxDropped++;
+        return;
+    }
+    dropped = cli->_rxDropped;
+
+    //  Payload dropped anyway shouldn't take a slice from payloads kept
+    if ((cli->_rxN >= ESP_RX_QUEUE) && (cli->RxPolicy == ESP_RX_DROP_NEWEST))
+    {
+        cli->_rxDropped++;
+        _stats.rxDropped++;
+        return;
+    }
+
+    slc = _RxHold(pos, len, buf);
+    //  All slices are held, oldest payload of the client makes room for it
+    if ((slc.id == ESP_RX_NOSLICE) && (cli->RxPolicy == ESP_RX_DROP_OLDEST) &&
+        cli->_RxPop(slc))
+    {
+        Release(slc);
+        cli->_rxDropped++;
+        slc = _RxHold(pos, len, buf);
+    }
+    //  Queue is full at this point only if oldest payload is to be dropped
+    if (slc.id != ESP_RX_NOSLICE)
+        cli->_RxPush(slc);
+    else
+        _stats.rxDropped++;
+    _stats.rxDropped += cli->_rxDropped - dropped;
+
+    if ((custHook != 0) && (slc.id != ESP_RX_NOSLICE))
+    {
+#if defined(__USE_TASK_SCHEDULER__)
+        //  If using task scheduler, schedule receiving as a new task
+        volatile TaskEntry tE(ESP_UID, ESP_T_RECVSOCK, 0);
+        tE.AddArg(&cli->_id, 1);
+        TaskScheduler::GetP()->SyncTask(tE);
+#else
+        //  If no task scheduler do everything in here
+        cli->_RxPop(slc);
+        custHook(cli->_id, slc.data, slc.len);
+        Release(slc);
+#endif  /* __USE_TASK_SCHEDULER__ */
+    }
+}
+
+/**
+ * Release space in Rx ring up to the first payload still held by a consumer
+ */
+void ESP8266::_RxFree()
+{
+    uint32_t tail = HAL_ESP_RxPosition();
+
+    for (uint8_t i = 0; i < ESP_RX_SLICES; i++)
+        if (_rxHeld[i].used && !BufferPool::Valid(_rxHeld[i].buf) &&
+            ((int32_t)(_rxHeld[i].pos - tail) < 0))
+            tail = _rxHeld[i].pos;
+    //  Payload being received in place has to stay in the ring as well
+    if ((_ipdMode == ESP_IPD_INPLACE) && ((int32_t)(_ipdPos - tail) < 0))
+        tail = _ipdPos;
+
+    HAL_ESP_RxRelease(tail);
+}
+
+/**
+ * Decide how payload of +IPD frame whose header was just parsed is received:
+ * streamed to client's hook, left in Rx ring (if short) or copied into pooled
+ * buffer piece by piece as it arrives (so that long payload doesn't have to fit
+ * into the ring at once)
+ * @param cli client payload is received on (0 if there's none)
+ * @param len length of payload
+ */
+void ESP8266::_IPDStart(_espClient *cli, uint16_t len)
+{
+    _ipdCli = cli;
+    _ipdMode = ESP_IPD_DROP;
+
+    if (cli == 0)
+        _stats.rxDropped++;
+    else if (cli->_rxStream != 0)
+        _ipdMode = ESP_IPD_STREAM;
+    else if (len <= ESP_RX_INPLACE)
+        _ipdMode = ESP_IPD_INPLACE;
+    else if ((len <= BUFP_BLOCK_SIZE) &&
+             BufferPool::GetI().Acquire(_ipdBuf))
+    {
+        _ipdBuf.len = 0;
+        _ipdMode = ESP_IPD_COPY;
+    }
+    else
+        _stats.rxDropped++;
+}
+
+/**
+ * Take piece of +IPD payload that just got parsed (continuous block in Rx
+ * ring, called before parser skips over it)
+ * @param data pointer to the first byte of the piece in Rx ring
+ * @param len length of the piece
+ */
+void ESP8266::_IPDData(const uint8_t *data, uint16_t len)
+{
+    if (_ipdMode == ESP_IPD_STREAM)
+        _ipdCli->_rxStream(_ipdCli->_id, data, len,
+                           _parser.PayloadLeft() - len);
+    else if (_ipdMode == ESP_IPD_COPY)
+    {
+        memcpy((void*)(BufferPool::GetI().Data(_ipdBuf) + _ipdBuf.len),
+               (void*)data, len);
+        _ipdBuf.len += len;
+    }
+}
+
+/**
+ * Hand over payload of +IPD frame once its last byte got parsed
+ */
+void ESP8266::_IPDEnd()
+{
+    if (_ipdMode == ESP_IPD_INPLACE)
+        _RxDeliver(_ipdCli, _ipdPos, _parser.IPDLength());
+    else if (_ipdMode == ESP_IPD_COPY)
+    {
+        _RxDeliver(_ipdCli, _ipdPos, _ipdBuf.len, &_ipdBuf);
+        //  Buffer is still here if payload couldn't be delivered
+        BufferPool::GetI().Release(_ipdBuf);
+    }
+
+    _ipdCli = 0;
+    _ipdMode = ESP_IPD_DROP;
+}
+
+/**
+ * Drop payload of +IPD frame being received (link got reset or data got
+ * overwritten). Stream hook is called with no data to let it know the payload
+ * it got so far is incomplete.
+ */
+void ESP8266::_IPDAbort()
+{
+    if (_ipdMode == ESP_IPD_COPY)
+        BufferPool::GetI().Release(_ipdBuf);
+    else if (_ipdMode == ESP_IPD_STREAM)
+        _ipdCli->_rxStream(_ipdCli->_id, 0, 0, 0);
+    if (_ipdMode != ESP_IPD_DROP)
+        _stats.rxDropped++;
+
+    _ipdCli = 0;
+    _ipdMode = ESP_IPD_DROP;
+}
+
+/**
+ * Act on events reported by the parser: manage sockets(clients), hand received
+ * data to clients, save IP address and update 'flowControl' once the line is
+ * complete
+ * @param ev bitwise OR of events returned by ATParser
+ * @return statuses(ESP_STATUS_*) contained in [ev]
+ */
+uint32_t ESP8266::_ParseEvent(uint32_t ev)
+{
+    //  Incoming data from socket, format: +IPD,socketID,length:message
+    if (ev & ATP_EV_IPD_HDR)
+        _IPDStart(GetClientBySockID(_parser.SockID()), _parser.IPDLength());
+    if (ev & ATP_EV_IPD_END)
+        _IPDEnd();
+
+    //  Connection to AP
+    if (ev & ESP_STATUS_CONNECTED)
+        wifiStatus = ESP_WIFI_CONNECTING;
+    if (ev & ATP_EV_WIFI_IP)
+        wifiStatus = ESP_WIFI_CONNECTED;
+    //  Signal strength of AP, unknown once connection to AP is lost
+    if (ev & ATP_EV_RSSI)
+    {
+        _stats.rssi = _parser.RSSI();
+        _stats.rssiSamples++;
+    }
+    if (ev & ESP_STATUS_DISCN)
+        _stats.rssi = 0;
+    if (ev & ESP_STATUS_BUSY)
+        _stats.busy++;
+
+    //  Buffered send: segment taken by ESP, delivery of earlier segment
+    //  confirmed (or failed) by the receiver
+    if (ev & ATP_EV_SEG_RECV)
+        _lineStatus |= ESP_STATUS_SEGRECV;
+    if ((ev & (ATP_EV_SEG_OK | ATP_EV_SEG_FAIL)) &&
+        (GetClientBySockID(_parser.SockID()) != 0))
+        GetClientBySockID(_parser.SockID())->_LargeAck(
+                                            (ev & ATP_EV_SEG_OK) > 0);
+
+    //  Socket got opened, take client slot for it
+    if ((ev & ESP_STATUS_SOCKOPEN) && (_parser.SockID() < ESP_MAX_CLI))
+    {
+        _stats.sockOpens++;
+        _SlotOpen(_parser.SockID());
+    }
+    //  Socket got closed, free slot of client with this ID (together with any
+    //  data it still holds)
+    if ((ev & ESP_STATUS_SOCKCLOSE) && (_parser.SockID() < ESP_MAX_CLI))
+    {
+        _stats.sockCloses++;
+        _SlotClose(_parser.SockID());
+    }
+
+    //  IP address embedded, save it
+    if (ev & ESP_GOT_IP)
+    {
+        memset(_ipStr, 0, sizeof(_ipStr));
+        strncpy(_ipStr, _parser.IPStr(), sizeof(_ipStr) - 1);
+        _ipAddress = _IPtoInt(_ipStr);
+    }
+
+    _lineStatus |= (ev & ATP_STATUS_MASK);
+
+    //  Message complete, publish its status. If there was an error from WD
+    //  timer leave it in so that we know there was a problem
+    if (ev & ATP_EV_LINE)
+    {
+        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+
+        if (flowControl == ESP_STATUS_ERROR)
+            flowControl |= _lineStatus;
+        else
+            flowControl = _lineStatus;
+        _lineStatus = ESP_NO_STATUS;
+        //  Check if reply to command being executed is complete
+        _CmdCheck();
+    }
+
+    return (ev & ATP_STATUS_MASK);
+}
+
+/**
+ * Send command to ESP8266 module
+ * Queues command passed in the null-terminated [txBuffer] and waits for reply
+ * from ESP. This is a blocking function, wrapper around command queue (see
+ * SendAsync()). Function returns when status OK, ERROR, FAIL or any other status
+ * passed in [flags] have been received from ESP. Timeout is value at which
+ * watchdog timer interrupts the process and returns ERROR flag. Commands queued
+ * before this one are executed first.
+ * @param txBuffer null-terminated string with command to execute
+ * @param flags bitwise OR of ESP_STATUS_* values
  * @param timeout time in ms before the sending process is interrupted by WD timer
+ * @param raw[optional] data to write to socket once ESP responds with prompt
+ * (used with CIPSEND command)
+ * @param rawLen[optional] length of data in [raw]
+ * @param prio[optional] priority class of data in [raw] (ESP_PRIO_*)
  * @return bitwise OR of ESP_STATUS_* returned by the ESP module
  */
-uint32_t ESP8266::_SendRAW(const char* txBuffer, uint32_t flags, uint32_t timeout)
+uint32_t ESP8266::_SendRAW(const char* txBuffer, uint32_t flags, uint32_t timeout,
+                           const char *raw, uint16_t rawLen, uint8_t prio)
 {
-    uint16_t txLen = 0;
+    struct _espCmd *cmd;
+
+    //  In non-blocking mode only queue the command
+    if (flags & ESP_NONBLOCKING_MODE)
+        return SendAsync(txBuffer, 0, 0, flags, timeout);
+
+    //  Commands can't be sent in passthrough mode, they'd end up in socket
+    if ((strlen(txBuffer) >= ESP_CMD_LEN) || _ptMode)
+        return ESP_STATUS_ERROR;
+
+    //  Wait for free space in command queue
+    while ((cmd = _CmdPush(txBuffer, flags, timeout, prio)) == 0)
+        _ParseRx();
+    cmd->raw = raw;
+    cmd->rawLen = rawLen;
+    cmd->done = _ESP_SyncDone;
+    _syncDone = false;
+    _CmdCommit();
+
+    //  Wait for reply, parsing data as it comes in
+    while (!_syncDone)
+        _ParseRx();
 
-    HAL_ESP_WDControl(false, timeout);
+    return _syncStatus;
+}
+
+/**
+ * Reserve space for a command at the end of command queue and initialize it.
+ * Command is not executed until it's committed by calling _CmdCommit().
+ * @param cmd null-terminated string with command to execute
+ * @param flags bitwise OR of ESP_STATUS_* values completing the command
+ * @param timeout time in ms before the command is failed by WD timer
+ * @param prio[optional] priority class of data sent by the command
+ * @return pointer to reserved command, 0 if command queue is full (for bulk
+ * data, if only slots kept for higher priorities are free)
+ */
+struct _espCmd* ESP8266::_CmdPush(const char *cmd, uint32_t flags,
+                                  uint32_t timeout, uint8_t prio)
+{
+    struct _espCmd *retVal;
+    uint8_t slots = ESP_CMDQ_LEN;
+
+    if (prio == ESP_PRIO_BULK)
+        slots -= ESP_CMDQ_CTRL;
+    if ((_cmdN >= slots) || (strlen(cmd) >= ESP_CMD_LEN))
+        return 0;
+
+    retVal = &_cmdQ[(_cmdHead + _cmdN) % ESP_CMDQ_LEN];
+    strcpy(retVal->cmd, cmd);
+    retVal->flags = flags & ~(uint32_t)(ESP_NONBLOCKING_MODE);
+    retVal->timeout = timeout;
+    retVal->buf.id = BUFP_INVALID;
+    retVal->buf.len = 0;
+    retVal->raw = 0;
+    retVal->rawLen = 0;
+    retVal->done = 0;
+    retVal->tag = 0;
+    retVal->state = ESP_CMD_QUEUED;
+    retVal->prio = (prio < ESP_PRIO_N) ? prio : (ESP_PRIO_N - 1);
+    retVal->queued = _ESP_Cycles();
+
+    return retVal;
+}
+
+/**
+ * Append command reserved by _CmdPush() to command queue and issue it right
+ * away if there are no other commands waiting for reply. Command sending data
+ * is moved ahead of queued sends of lower priority; it never passes other
+ * commands (e.g. opening or closing a socket) nor the command already sent.
+ * @note Pointer returned by _CmdPush() is not valid after this call
+ */
+void ESP8266::_CmdCommit()
+{
+    struct _espCmd tmp, *cur, *prev;
+    uint8_t i = _cmdN;
+
+    cur = &_cmdQ[(_cmdHead + i) % ESP_CMDQ_LEN];
+    if (BufferPool::Valid(cur->buf) || (cur->raw != 0))
+    {
+        while (i > 0)
+        {
+            prev = &_cmdQ[(_cmdHead + i - 1) % ESP_CMDQ_LEN];
+            if ((prev->state != ESP_CMD_QUEUED) ||
+                (!BufferPool::Valid(prev->buf) && (prev->raw == 0)) ||
+                (prev->prio <= cur->prio))
+                break;
+            tmp = *prev;
+            *prev = *cur;
+            *cur = tmp;
+            cur = prev;
+            i--;
+        }
+        if (i < _cmdN)
+            _stats.preempts++;
+    }
 
+    _cmdN++;
+    _CmdIssue();
+}
+
+/**
+ * Send first command in the queue to ESP (if it hasn't been sent yet) and
+ * start watchdog timer with its timeout
+ */
+void ESP8266::_CmdIssue()
+{
+    struct _espCmd *cmd = &_cmdQ[_cmdHead];
+
+    if ((_cmdN == 0) || (cmd->state != ESP_CMD_QUEUED))
+        return;
+
+    cmd->state = ESP_CMD_SENT;
+    cmd->issued = _ESP_Cycles();
+    _stats.bytesOut += strlen(cmd->cmd) + 2;
     //  Reset global status
     flowControl = ESP_NO_STATUS;
-    //  Wait for any ongoing transmission then flush UART port
-    while(HAL_ESP_UARTBusy());
-    _FlushUART();
-    while(HAL_ESP_UARTBusy());
 #ifdef __DEBUG_SESSION__
-    DEBUG_WRITE("Sending: %s \n", txBuffer);
+    DEBUG_WRITE("Sending: %s \n", cmd->cmd);
 #endif
-    //  Send char-by-char until reaching end of command
-    while (*(txBuffer + txLen) != '\0')
-    {
-        HAL_ESP_SendChar(*(txBuffer + txLen));
-        txLen++;
-    }
-    //  ESP messages terminated by \r\n
-    HAL_ESP_SendChar('\r');
-    HAL_ESP_SendChar('\n');
+    //  Queue command for sending, ESP messages terminated by \r\n
+    HAL_ESP_TxWrite((const uint8_t*)cmd->cmd, strlen(cmd->cmd));
+    HAL_ESP_TxWrite((const uint8_t*)"\r\n", 2);
 
-    //  Start listening for reply
+    //  Start listening for reply and start watchdog timer
     HAL_ESP_IntEnable(true);
+    HAL_ESP_WDControl(true, cmd->timeout);
+}
+
+/**
+ * Check status of the line just received against command being executed.
+ * Command sending data is advanced to writing its data once ESP responds with
+ * prompt. Completed command is removed from the queue and next one is issued.
+ */
+void ESP8266::_CmdCheck()
+{
+    struct _espCmd *cmd = &_cmdQ[_cmdHead];
+    uint32_t status = flowControl;
 
-    //  If non-blocking mode is not enabled wait for status
-    if (!(flags & ESP_NONBLOCKING_MODE))
+    if ((_cmdN == 0) || (cmd->state == ESP_CMD_QUEUED))
+        return;
+
+    //  Errors (including WD timeout) complete command in any state
+    if (!_InStatus(status, ESP_STATUS_ERROR | ESP_STATUS_FAIL))
     {
-        //  Start watchdog timer
-        HAL_ESP_WDControl(true, timeout);
+        //  Data written, waiting for confirmation
+        if (cmd->state == ESP_CMD_DATA)
+        {
+            if (!_InStatus(status, (cmd->flags != 0) ? cmd->flags :
+                                                       ESP_STATUS_SENDOK))
+            {
+                HAL_ESP_WDControl(true, cmd->timeout);
+                return;
+            }
+        }
+        //  Command sending data, write it once ESP is ready to receive it
+        else if (BufferPool::Valid(cmd->buf) || (cmd->raw != 0))
+        {
+            if (_InStatus(status, ESP_STATUS_RECV))
+            {
+                flowControl = ESP_NO_STATUS;
+                cmd->state = ESP_CMD_DATA;
+                if (cmd->raw != 0)
+                    _RAWPortWrite(cmd->raw, cmd->rawLen);
+                else
+                    _RAWPortWrite((char*)BufferPool::GetI().Data(cmd->buf),
+                                  cmd->buf.len);
+            }
+            HAL_ESP_WDControl(true, cmd->timeout);
+            return;
+        }
+        //  Any other command
+        else if (!_InStatus(status, ESP_STATUS_OK | cmd->flags))
+        {
+            HAL_ESP_WDControl(true, cmd->timeout);
+            return;
+        }
+    }
 
-        while( !(flowControl & ESP_STATUS_OK) &&
-                !(flowControl & ESP_STATUS_ERROR) &&
-                !(flowControl & flags));
+    _CmdDone(status);
+    //  Large sends and datagrams that found command queue full continue in the
+    //  freed slot
+    for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
+    {
+        _clients[i]._LargeNext();
+        _clients[i]._TxPackPoll();
+    }
+    _CmdIssue();
+}
 
-        HAL_DelayUS(1000);
-        //  Stop watchdog timer
-        HAL_ESP_WDControl(false, timeout);
-        return flowControl;
+/**
+ * Remove first command from the queue, release its data and call its
+ * completion routine
+ * @param status bitwise OR of ESP_STATUS_* command completed with
+ */
+void ESP8266::_CmdDone(uint32_t status)
+{
+    struct _espCmd *cmd = &_cmdQ[_cmdHead];
+    void (*done)(const uint8_t, const uint32_t) = cmd->done;
+    uint8_t tag = cmd->tag;
+
+    //  Stop watchdog timer
+    HAL_ESP_WDControl(false, 0);
+
+    //  Round trip of data send, from issuing CIPSEND to SEND OK (buffered
+    //  send: until ESP takes the segment)
+    if (BufferPool::Valid(cmd->buf) || (cmd->raw != 0))
+    {
+        if (_InStatus(status, (cmd->flags != 0) ? cmd->flags :
+                                                  ESP_STATUS_SENDOK))
+        {
+            uint32_t ms = _ESP_CyclesToUs(_ESP_Cycles() - cmd->issued) / 1000;
+
+            struct _espPrioStats *ps = &_stats.prio[cmd->prio];
+
+            _stats.sends++;
+            if (ms > _stats.sendRTTMaxMs)
+                _stats.sendRTTMaxMs = ms;
+            _StatsHist(_stats.sendRTT, ms);
+            //  Latency of priority class includes time spent in the queue
+            ms = _ESP_CyclesToUs(_ESP_Cycles() - cmd->queued) / 1000;
+            ps->sends++;
+            if (ms > ps->latMaxMs)
+                ps->latMaxMs = ms;
+            _StatsHist(ps->lat, ms);
+        }
+        else
+            _stats.sendFails++;
     }
-    else return ESP_NONBLOCKING_MODE;
+
+    BufferPool::GetI().Release(cmd->buf);
+    _cmdHead = (_cmdHead + 1) % ESP_CMDQ_LEN;
+    _cmdN--;
+
+    if (done != 0)
+        done(tag, status);
 }
 
 /**
  * Write bytes directly to port (used when sending data of TCP/UDP socket)
+ * Data is copied into Tx ring and sent by uDMA, function doesn't wait for it
+ * to be sent.
  * @param buffer data to send to serial port
  * @param bufLen length of data in [buffer]
  */
@@ -822,22 +1996,167 @@ void ESP8266::_RAWPortWrite(const char* buffer, uint16_t bufLen)
     DEBUG_WRITE("SendingRAWport: %s \n", buffer);
 #endif
 
-    for (uint16_t i = 0; i < bufLen; i++)
+    _stats.bytesOut += bufLen;
+    HAL_ESP_TxWrite((const uint8_t*)buffer, bufLen);
+}
+
+/**
+ * (Re)configure UART port at given baud rate and set up Rx and Tx rings. Data
+ * still in the rings is dropped, parsing starts from the beginning of a message
+ * @param baud baud rate
+ * @param flowCtrl true to use RTS/CTS flow control
+ */
+void ESP8266::_PortInit(uint32_t baud, bool flowCtrl)
+{
+    HAL_ESP_InitPort(baud, flowCtrl);
+    HAL_ESP_RegisterIntHandler(UART7RxIntHandler);
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_InitSoftInt(ESPParseIntHandler);
+#endif  /* __USE_TASK_SCHEDULER__ */
+    _baud = baud;
+    _flowCtrl = flowCtrl;
+    _rxParsed = HAL_ESP_RxPosition();
+    _parser.Reset();
+    _lineStatus = ESP_NO_STATUS;
+    _IPDAbort();
+}
+
+/**
+ * Switch module to a new baud rate and flow control setting, and follow it
+ * once module confirms the change
+ * @param baud baud rate
+ * @param flowCtrl true to use RTS/CTS flow control
+ * @return true if module confirmed the change, false if it's still at the old
+ * rate (or didn't reply)
+ */
+bool ESP8266::_BaudSet(uint32_t baud, bool flowCtrl)
+{
+    uint32_t retVal;
+    StrBuilder cmd(_commBuf, sizeof(_commBuf));
+
+    //  8 data bits, 1 stop bit, no parity, flow control on both lines (3)
+    cmd.Add("AT+UART_CUR=");
+    cmd.AddNum(baud);
+    cmd.Add(flowCtrl ? ",8,1,0,3" : ",8,1,0,0");
+    retVal = _SendRAW(cmd.Str());
+    if (!_InStatus(retVal, ESP_STATUS_OK) || _InStatus(retVal, ESP_STATUS_ERROR))
+        return false;
+
+    //  Module switches right after sending reply, port is switched once the
+    //  command is out on the wire (reply can come before uDMA reports it)
+    while ((HAL_ESP_TxPending() > 0) || HAL_ESP_UARTBusy());
+    HAL_DelayUS(2000);
+    _PortInit(baud, flowCtrl);
+
+    return true;
+}
+
+/**
+ * Test the link with commands producing long replies
+ * @return true if all of them succeeded without receive errors or overruns
+ */
+bool ESP8266::_BaudProbe()
+{
+    uint32_t errors = HAL_ESP_RxErrors();
+    uint32_t overruns = HAL_ESP_RxOverrun();
+    uint32_t retVal;
+
+    for (uint8_t i = 0; i < ESP_BAUD_PROBES; i++)
     {
-        while(HAL_ESP_UARTBusy());
-        HAL_ESP_SendChar(buffer[i]);
+        retVal = _SendRAW("AT+GMR\0", 0, 100);
+        if (!_InStatus(retVal, ESP_STATUS_OK) ||
+            _InStatus(retVal, ESP_STATUS_ERROR))
+            return false;
     }
+
+    return ((HAL_ESP_RxErrors() == errors) && (HAL_ESP_RxOverrun() == overruns));
 }
 
 /**
- * Empty UART's Rx buffer
+ * Go back to the last setting link worked with. Module is asked to switch over
+ * the unreliable link; if it can't be reached afterwards it's rebooted (and
+ * starts at its default rate). Later negotiations don't go above [baud].
+ * @param baud baud rate link worked at
+ * @param flowCtrl flow control setting link worked with
+ */
+void ESP8266::_BaudRevert(uint32_t baud, bool flowCtrl)
+{
+    _baudMax = baud;
+    _flowReq = flowCtrl;
+
+    if (!_BaudSet(baud, flowCtrl))
+        _PortInit(baud, flowCtrl);
+    if (_BaudProbe())
+        return;
+
+    //  Hold chip down long enough for it to reset
+    Enable(false);
+    HAL_DelayUS(10000);
+    InitHW(_baudDef);
+}
+
+/**
+ * Process data still waiting in Rx ring, so that it isn't taken as a reply to
+ * the next command
  */
 void ESP8266::_FlushUART()
 {
-    char temp = 0;
-    UNUSED(temp);   //    Suppress unused variable warning
-    while (HAL_ESP_CharAvail())
-        temp = HAL_ESP_GetChar();
+    _ParseRx();
+}
+
+/**
+ * Terminate streaming in passthrough mode. ESP takes "+++" as end of stream only
+ * if it comes in a packet of its own, so line is kept silent for ESP_PT_GUARD
+ * ms before and after it. Data received meanwhile is still handed to the
+ * passthrough socket.
+ */
+void ESP8266::_PTEscape()
+{
+    uint16_t i;
+
+    //  Wait for data still in Tx ring to go out, then keep the line silent
+    while (HAL_ESP_TxPending() > 0)
+        _ParseRx();
+    for (i = 0; i < ESP_PT_GUARD; i++)
+    {
+        HAL_DelayUS(1000);
+        _ParseRx();
+    }
+
+    _RAWPortWrite("+++", 3);
+    while (HAL_ESP_TxPending() > 0)
+        _ParseRx();
+    for (i = 0; i < ESP_PT_GUARD; i++)
+    {
+        HAL_DelayUS(1000);
+        _ParseRx();
+    }
+
+    //  Anything received from now on is reply to a command
+    _ptMode = false;
+    _parser.Reset();
+    _lineStatus = ESP_NO_STATUS;
+}
+
+/**
+ * Switch ESP from single connection mode (used by passthrough mode) back to
+ * multiple connections mode and restart TCP server if it was running before
+ * @return bitwise OR of ESP_STATUS_* returned when switching modes
+ */
+uint32_t ESP8266::_PTLeave()
+{
+    uint32_t retVal;
+
+    //  Errors are expected if passthrough wasn't fully set up, ignore them
+    _SendRAW("AT+CIPMODE=0\0");
+    _SendRAW("AT+CIPCLOSE\0");
+    retVal = _SendRAW("AT+CIPMUX=1\0");
+
+    if (_ptServPort != 0)
+        StartTCPServer(_ptServPort);
+    _ptServPort = 0;
+
+    return retVal;
 }
 
 /**
@@ -869,6 +2188,104 @@ uint32_t ESP8266::_IPtoInt(char *ipAddr)
     return retVal;
 }
 
+/**
+ * Assemble command opening TCP socket to specified IP and port (with keep alive
+ * interval of 7200ms), or UDP socket, in shared buffer. If socket with [sockID]
+ * already exists or is being opened, first free socket ID is used instead.
+ * @param ipAddr string containing IP address of server(null-terminated)
+ * @param port TCP socket port of server
+ * @param sockID desired socket ID to assign to this connection
+ * @param udp[optional] whether to open UDP socket instead of TCP one
+ * @return socket ID used in command,
+ *         ESP_MAX_CLI if ESP is not connected or there are no free sockets
+ */
+uint8_t ESP8266::_SockCmd(char *ipAddr, uint16_t port, uint8_t sockID,
+                          bool udp)
+{
+    //  Can't continue if ESP is not connected
+    if (wifiStatus != ESP_WIFI_CONNECTED)
+        return ESP_MAX_CLI;
+
+    //  Check if socket with this ID already exists, if not create it, if yes
+    //  fined first free socket ID and use it instead
+    if ((sockID >= ESP_MAX_CLI) || (GetClientBySockID(sockID) != 0) ||
+        (_sockPend & (1 << sockID)))
+    {
+        //  Find free socket number (0-(ESP_MAX_CLI-1) supported)
+        for (sockID = 0; sockID < ESP_MAX_CLI; sockID++)
+            if (!_clients[sockID]._alive && !(_sockPend & (1 << sockID)))
+                break;
+        //  If loop hit ESP_MAX_CLI there are no free sockets
+        if (sockID >= ESP_MAX_CLI)
+            return ESP_MAX_CLI;
+    }
+
+    //  Assemble command: Open TCP socket to specified IP and port, set
+    //  keep alive interval to 7200ms (UDP socket has no keep alive)
+    StrBuilder cmd(_commBuf, sizeof(_commBuf));
+    cmd.Add("AT+CIPSTART=");
+    cmd.AddNum(sockID);
+    cmd.Add(udp ? ",\"UDP\",\"" : ",\"TCP\",\"");
+    cmd.Add(ipAddr);
+    cmd.Add("\",");
+    cmd.AddNum(port);
+    if (!udp)
+        cmd.Add(",7200");
+    //  IP address string too long to fit in a command
+    if (cmd.Overflow())
+        return ESP_MAX_CLI;
+
+    return sockID;
+}
+
+/**
+ * Take slot of a socket that just got opened. Client in the slot is reset to
+ * default settings and gets new generation, handles to the socket previously
+ * open in this slot become stale.
+ * @param sockID socket ID of opened socket
+ * @return pointer to client in the slot
+ */
+_espClient* ESP8266::_SlotOpen(uint8_t sockID)
+{
+    _espClient *cli = &_clients[sockID];
+
+    //  Socket is already open (reported twice)
+    if (cli->_alive)
+        return cli;
+
+    cli->KeepAlive = true;
+    cli->Linger = ESP_TX_LINGER;
+    cli->Priority = ESP_PRIO_DATA;
+    cli->RxPolicy = ESP_RX_DROP_OLDEST;
+    cli->_rxStream = 0;
+    cli->_udp = false;
+    cli->_Clear();
+    cli->_gen++;
+    cli->_alive = true;
+
+    return cli;
+}
+
+/**
+ * Free slot of a socket that got closed, releasing data the client still holds
+ * @param sockID socket ID of closed socket
+ */
+void ESP8266::_SlotClose(uint8_t sockID)
+{
+    _espClient *cli = &_clients[sockID];
+
+    cli->_RxDrop();
+    BufferPool::GetI().Release(cli->_txBuf);
+    //  Datagrams waiting to be queued are dropped
+    BufferPool::GetI().Release(cli->_txPack);
+    cli->_txPackQ = cli->_txPackEnd = 0;
+    cli->_Clear();
+    cli->_alive = false;
+    //  Large send can't continue, its caller is told once segments still in
+    //  command queue complete
+    cli->_LargeAbort();
+}
+
 /**
  * Get client index in _clients vector based on its socket ID
  * @param sockID socket ID
@@ -887,124 +2304,73 @@ uint8_t ESP8266::_IDtoIndex(uint8_t sockID)
 /// Interrupt service routine for handling incoming data on UART (Tx)  [PRIVATE]
 ///-----------------------------------------------------------------------------
 
+/**
+ * UART interrupt only moves data between rings and UART and requests parsing,
+ * which runs outside of it (parser allocates, copies payloads and completes
+ * commands). Keep it that way, it runs above everything except encoders and
+ * task scheduler timers.
+ */
 void UART7RxIntHandler(void)
 {
     //  Grab a pointer to singleton
     ESP8266 &__esp = ESP8266::GetI();
 
-    static char rxBuffer[1024] ;
-    static uint16_t rxLen = 0;
-
-    HAL_ESP_ClearInt();             //  Clear interrupt
+    uint32_t start = _ESP_Cycles();
+    uint32_t intStatus = HAL_ESP_ClearInt();
+    uint32_t us;
+    bool boundary;
 
-    //  Loop while there are characters in receiving buffer
-    while (HAL_ESP_CharAvail())
-    {
-        char temp = HAL_ESP_GetChar();
-        //   Reset watchdog timer on every char - bus is active
+    //  Publish data moved into Rx ring by uDMA. Reset watchdog timer if
+    //  anything was received - bus is active
+    if (HAL_ESP_RxCollect(intStatus, &boundary) > 0)
+        HAL_ESP_WDControl(true, 0);
+    //  Continue sending data from Tx ring. Once everything is sent restart
+    //  watchdog timer, timeout for reply to a command counts from here
+    if (HAL_ESP_TxCollect(intStatus) && (__esp._cmdN > 0))
         HAL_ESP_WDControl(true, 0);
-
-        rxBuffer[rxLen++] = temp;
-        //  Keep in mind buffer size
-        rxLen %= sizeof(rxBuffer);
-    }
 
     /*
-     * If watchdog timer times out, artificially produce terminating sequence at
-     * the end of the buffer in order to trigger next if to read the content
+     * If watchdog timer times out (changing 'flowControl' to "error" and
+     * recalling this interrupt), message received so far has to be terminated
+     * so that its status gets reported
      */
-    if (( __esp.flowControl == ESP_STATUS_ERROR))
+    if (__esp.flowControl == ESP_STATUS_ERROR)
     {
-        rxBuffer[rxLen++] = '\r';
-        rxBuffer[rxLen++] = '\n';
+        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+        __esp._rxFlush = true;
 #ifdef __DEBUG_SESSION__
         DEBUG_WRITE("WATCHDOG!!\n");
 #endif
     }
 
-    //  Prevent parsing when buffer only contains \r\n and nothing else
-    if (rxLen == 2)
-    {
-        if ((rxBuffer[rxLen-2] == '\r') && (rxBuffer[rxLen-1] == '\n'))
-        {
-            HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
-            //  Reset receiving buffer and its size
-            memset(rxBuffer, '\0', sizeof(rxBuffer));
-            rxLen = 0;
-            return;
-        }
-    }
-    //  No point in starting parser for messages with such small size, return
-    else if (rxLen < 2)
+    //  Parse only once a complete line, prompt or +IPD frame is in the ring
+    //  (or line is idle), not on every uDMA transfer in the middle of a message
+    if ((boundary && (HAL_ESP_RxAvail() > 0)) || __esp._rxFlush)
     {
-        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
-        return;
-    }
-
-    /*
-     *  There are 3 occasions when we want to process data in input buffer:
-     *  1) We've reached terminator sequence of the message (\r\n)
-     *  2) ESP returned '> ' (without terminator) and awaits data
-     *  3) Watchdog timer has timed out changing 'flowControl' to "error"
-     *      (on timeout WD timer also recalls this interrupt)
-     */
-    if (((rxBuffer[rxLen-2] == '\r') && (rxBuffer[rxLen-1] == '\n'))
-      || ((rxBuffer[rxLen-2] == '>') && (rxBuffer[rxLen-1] == ' ' ))
-      || ( __esp.flowControl == ESP_STATUS_ERROR) )
-    {
-        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
-
-
-#ifdef __DEBUG_SESSION__
-    {
-        uint16_t i;
-        for (i = 0; i < rxLen; i++)
-            DEBUG_WRITE("0x%x ", rxBuffer[i]);
-        DEBUG_WRITE("\nParsing(%d): %s\n", rxLen, rxBuffer);
-    }
-#endif
-        //  Parse data in receiving buffer - if there was an error from WD timer
-        //  leave it in so that we know there was a problem
-        if (__esp.flowControl == ESP_STATUS_ERROR)
-            __esp.flowControl |= __esp.ParseResponse(rxBuffer, rxLen);
-        else
-            __esp.flowControl = __esp.ParseResponse(rxBuffer, rxLen);
-
-        //  If some data came from one of opened TCP sockets receive it and
-        //  pass it to a user-defined function for further processing
-        if ((__esp.custHook != 0) && (__esp.flowControl & ESP_STATUS_IPD))
-        {
-            for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
-                //  Skip null pointers
-                if (__esp.GetClientByIndex(i) != 0)
-                //  Check which socket received data
-                if (__esp.GetClientByIndex(i)->Ready())
-                {
 #if defined(__USE_TASK_SCHEDULER__)
-                //  If using task scheduler, schedule receiving outside this ISR
-                    volatile TaskEntry tE(ESP_UID, ESP_T_RECVSOCK, 0);
-                    tE.AddArg(&__esp.GetClientByIndex(i)->_id, 1);
-                    TaskScheduler::GetP()->SyncTask(tE);
+        //  Parsing task is scheduled from main context (no allocation here)
+        TaskScheduler::GetP()->Defer(ESP_UID, ESP_T_PARSE);
 #else
-                    //  If no task scheduler do everything in here
-                    _espClient* cli = __esp.GetClientByIndex(i);
-                    __esp.custHook(i, cli->RespBody, &(cli->RespLen));
+        //  Without task scheduler parse in the lowest-priority interrupt
+        HAL_ESP_SoftIntTrigger();
 #endif  /* __USE_TASK_SCHEDULER__ */
-                }
-            }
-        //  If ESP is running in server mode or status hasn't been OK/ERROR
-        //  (because after them ESP sends no more messages) then continue
-        //  listening on serial port for new messages
-        /*if (((__esp->flowControl & ESP_STATUS_OK) ||
-             (__esp->flowControl & ESP_STATUS_ERROR))
-            && !__esp->ServerOpened())
-            HAL_ESP_IntEnable(false);*/
+    }
 
+    us = _ESP_CyclesToUs(_ESP_Cycles() - start);
+    __esp._stats.isrRuns++;
+    if (us > __esp._stats.isrMaxUs)
+        __esp._stats.isrMaxUs = us;
+    __esp._StatsHist(__esp._stats.isrTime, us);
+}
 
-        //  Reset receiving buffer and its size
-        memset(rxBuffer, '\0', sizeof(rxBuffer));
-        rxLen = 0;
-    }
+#if !defined(__USE_TASK_SCHEDULER__)
+/**
+ * Software interrupt triggered by UART interrupt, parses received data
+ */
+void ESPParseIntHandler(void)
+{
+    ESP8266::GetI()._ParseRx();
 }
+#endif  /* __USE_TASK_SCHEDULER__ */
 
 #endif  /* __HAL_USE_ESP8266__ */
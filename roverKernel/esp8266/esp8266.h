@@ -5,7 +5,7 @@
  *      Author: Vedran Mikov
  *
  *  ESP8266 WiFi module communication library
- *  @version 1.4.5
+ *  @version 1.22.7
  *  V1.1.4
  *  +Connect/disconnect from AP, get acquired IP as string/int
  *	+Start TCP server and allow multiple connections, keep track of
@@ -54,8 +54,114 @@
  *  +Stability improvements, different placement of watchdog resets
  *  V1.4.5 - 2.9.2017
  *  +Bugfix in parser, fixed problem with multiple sockets closing at the same time
- *
- *  TODO:Add interface to send UDP packet
+ *  V1.5.0
+ *  +Sending data held in a pooled buffer (BufferPool) without copying it, also
+ *  available as a service from task scheduler
+ *  V1.6.0
+ *  +Responses are parsed incrementally as characters arrive (ATParser) instead
+ *  of buffering whole message and scanning it for every keyword. Data received
+ *  from sockets is copied to its client directly from UART interrupt
+ *  V1.7.0
+ *  +Received data is moved into Rx ring by uDMA and parsed in main context
+ *  (ESP_T_PARSE task, or while waiting for reply to a command). UART interrupt
+ *  only occurs when half of the ring is full or the line goes idle
+ *  V1.8.0
+ *  +Data received on a socket is no longer copied into its client. Consumers
+ *  get a read-only slice (_espRxSlice) pointing into Rx ring and release it
+ *  once done. Data is binary-safe (not terminated by \0). Removed
+ *  ParseResponse(), parsing only happens on data in Rx ring
+ *  V1.9.0
+ *  +Asynchronous command engine: AT commands are put in a queue and issued one
+ *  after another as soon as reply to the previous one is received, each with
+ *  its own timeout enforced by watchdog timer. Outcome is reported through
+ *  completion callback. Blocking functions are kept as wrappers waiting for
+ *  their command to complete. Sending data and opening sockets from task
+ *  scheduler no longer blocks other tasks
+ *  V1.10.0
+ *  +Commands and data are sent through Tx ring drained by uDMA, CPU doesn't
+ *  wait for data to go out on the wire. Watchdog timeout for reply counts from
+ *  the moment the last byte was sent
+ *  V1.11.0
+ *  +Data written to a socket through _espClient::Write() is coalesced into a
+ *  single send of up to 2048B, sent when full, on Flush() or after linger time
+ *  V1.12.0
+ *  +Support for UDP sockets (OpenUDPSock/OpenUDPSockAsync), data is sent
+ *  through the same _espClient interface as over TCP sockets
+ *  V1.13.0
+ *  +Passthrough mode (AT+CIPMODE=1): single socket to which data is streamed
+ *  without AT command per send, entered and left with StartPassthrough() and
+ *  StopPassthrough(). Multiple sockets are available again once it's left
+ *  V1.14.0
+ *  +Clients live in statically allocated slots (one per socket ID) instead of
+ *  being allocated on the heap when socket opens. Every opening of a socket
+ *  increments slot's generation so that stale handles can be detected
+ *  V1.15.0
+ *  +Commands are assembled with bounded string builder (StrBuilder) instead of
+ *  memset + series of strcat, commands that don't fit are rejected. Shared
+ *  command buffer shrunk to ESP_CMD_LEN
+ *  V1.16.0
+ *  +Link metrics (struct _espStats): traffic, CIPSEND round-trip histogram,
+ *  busy replies, watchdog timeouts, socket churn, parse time histogram and
+ *  RSSI of AP sampled periodically through AT+CWJAP? (ESP_T_RSSI service)
+ *  V1.17.0
+ *  +Baud rate negotiation (NegotiateBaud): link is stepped up through
+ *  AT+UART_CUR to the highest rate that passes test traffic without errors,
+ *  optionally with RTS/CTS flow control. Overruns of Rx ring and UART receive
+ *  errors are counted, parser drops message whose data got overwritten and
+ *  resynchronizes on the next line
+ *  V1.18.0
+ *  +Outbound data is sent in order of priority (ESP_PRIO_*) of its socket:
+ *  queued send moves ahead of queued sends of lower priority, so control
+ *  traffic overtakes bulk telemetry at the next send boundary. Last slots of
+ *  command queue are kept for traffic above bulk priority. Latency from
+ *  queueing to SEND OK is measured per priority class
+ *  V1.19.0
+ *  +Payload of +IPD frame is reassembled as it's parsed, across interrupts and
+ *  wraps of Rx ring: short payloads stay in the ring, longer ones are copied
+ *  into pooled buffer piece by piece so the ring never has to hold them whole.
+ *  Socket can stream payload to a hook instead (_espClient::SetRxStream()),
+ *  for frames of any length. Dropped payloads are counted
+ *  V1.20.0
+ *  +Large payloads are sent in segments (_espClient::SendLarge()). Over TCP
+ *  segments go through AT+CIPSENDBUF if firmware supports it: ESP takes a
+ *  segment right away and confirms its delivery later, so several segments
+ *  are in flight at once instead of waiting for SEND OK after every send
+ *  V1.21.0
+ *  +UART interrupt only publishes received data and requests parsing, it no
+ *  longer allocates a task: parsing is deferred through TaskScheduler::Defer()
+ *  or, without task scheduler, to the lowest-priority software interrupt.
+ *  Duration of UART interrupt is measured (isrTime)
+ *  V1.22.0
+ *  +Socket queues up to ESP_RX_QUEUE received payloads instead of holding only
+ *  the latest one, payload received while queue is full is dropped according
+ *  to socket's policy (oldest or newest payload) and counted
+ *  V1.22.1
+ *  +Queued socket opening returns ESP_SOCK_PENDING/ESP_SOCK_BUSY instead of
+ *  ESP_STATUS_BUSY, which collided with socket ID 2. Opening a socket is given
+ *  ESP_SOCK_TIMEOUT ms instead of the default command timeout
+ *  V1.22.2
+ *  +Half of Rx ring is handed back to uDMA only once data held in it (payload
+ *  handed out in place) is released, instead of being overwritten. uDMA stops
+ *  while the whole ring is held, data lost in the meantime is counted as an
+ *  overrun and parser resynchronizes on the next line
+ *  V1.22.3
+ *  +Short data sent by copy (up to ESP_TX_PACK_LEN) is packed into a pooled
+ *  buffer shared with other short data of the socket instead of taking a whole
+ *  buffer per send. Datagrams that find command queue full wait in that buffer
+ *  and are queued as commands complete
+ *  V1.22.4
+ *  +UART interrupt defers parsing only once end of line, prompt or +IPD frame
+ *  is received (HAL scans new data for boundaries), or line goes idle
+ *  V1.22.5
+ *  +Status macros are parenthesized, queueing a command no longer clears OK,
+ *  BUSY and SUCC completion flags together with non-blocking flag
+ *  V1.22.6
+ *  +ESP_T_SENDBUF accepts slice forwarded from preceding task in a chain,
+ *  forwarded slice is borrowed and sent without copying
+ *  V1.22.7
+ *  +Socket keeps at most one flush task scheduled for data passed to Write(),
+ *  task left over from data that was already sent is moved to the deadline of
+ *  data written since instead of flushing it early
  */
 #include "hwconfig.h"
 
@@ -66,11 +172,14 @@
 //  Define class prototype
 class ESP8266;
 //  Shared buffer for ESP library to assemble text requests in (declared extern
-//  because it's shared with espClient library
-extern char _commBuf[2048];
+//  because it's shared with espClient library, ESP_CMD_LEN bytes long)
+extern char _commBuf[];
 
-//  Include client library
+//  Include pool of shared buffers and client library
+#include "libs/bufferPool.h"
 #include "espClient.h"
+//  Include parser of ESP responses
+#include "atParser.h"
 
 //  Enable integration of this library with task scheduler but only if task
 //  scheduler is being compiled into this project
@@ -90,31 +199,43 @@ extern char _commBuf[2048];
     #define ESP_T_RECVSOCK  3   //  Receive data from specific socket ID
     #define ESP_T_CLOSETCP  4   //  Close socket with specific ID
     #define ESP_T_REBOOT    5   //  Reboot ESP module and UART bus
-    #define ESP_T_PARSE     6
+    #define ESP_T_PARSE     6   //  Parse data waiting in Rx ring
+    #define ESP_T_SENDBUF   7   //  Send pooled buffer through socket with ID
+    #define ESP_T_FLUSH     8   //  Send data written to socket with ID
+    #define ESP_T_RSSI      9   //  Sample signal strength of AP
 #endif
 
 /*		Communication settings	 	*/
 #define ESP_DEF_BAUD			1000000
+//  Highest baud rate tried by NegotiateBaud(), and number of test commands
+//  (AT+GMR, ~130B reply each) that have to pass at a new rate without error
+#define ESP_MAX_BAUD            4000000
+#define ESP_BAUD_PROBES         8
+//  Use RTS/CTS flow control on negotiated link (lines have to be wired, see
+//  HAL for the pins used)
+#define ESP_FLOW_CTRL           false
 
 /*		ESP8266 error codes		*/
 #define ESP_STATUS_LENGTH		13
 #define ESP_NO_STATUS			0
-#define ESP_STATUS_OK			1<<0
-#define ESP_STATUS_BUSY			1<<1
-#define ESP_RESPOND_SUCC		1<<2
-#define ESP_NONBLOCKING_MODE	1<<3
-#define ESP_STATUS_CONNECTED	1<<4
-#define ESP_STATUS_DISCN        1<<5
-#define ESP_STATUS_READY		1<<6
-#define ESP_STATUS_SOCKOPEN     1<<7
-#define ESP_STATUS_SOCKCLOSE	1<<8
-#define ESP_STATUS_RECV			1<<9
-#define ESP_STATUS_FAIL			1<<10
-#define ESP_STATUS_SENDOK		1<<11
-#define ESP_STATUS_ERROR		1<<12
-#define ESP_NORESPONSE          1<<13
-#define ESP_STATUS_IPD          1<<14
-#define ESP_GOT_IP              1<<15
+#define ESP_STATUS_OK			(1<<0)
+#define ESP_STATUS_BUSY			(1<<1)
+#define ESP_RESPOND_SUCC		(1<<2)
+#define ESP_NONBLOCKING_MODE	(1<<3)
+#define ESP_STATUS_CONNECTED	(1<<4)
+#define ESP_STATUS_DISCN        (1<<5)
+#define ESP_STATUS_READY		(1<<6)
+#define ESP_STATUS_SOCKOPEN     (1<<7)
+#define ESP_STATUS_SOCKCLOSE	(1<<8)
+#define ESP_STATUS_RECV			(1<<9)
+#define ESP_STATUS_FAIL			(1<<10)
+#define ESP_STATUS_SENDOK		(1<<11)
+#define ESP_STATUS_ERROR		(1<<12)
+#define ESP_NORESPONSE          (1<<13)
+#define ESP_STATUS_IPD          (1<<14)
+#define ESP_GOT_IP              (1<<15)
+//  Statuses above bit 15 are set by the library from parser events
+#define ESP_STATUS_SEGRECV      (1UL<<16)   //  Segment taken (CIPSENDBUF)
 
 #define ESP_WIFI_NONE           0
 #define ESP_WIFI_CONNECTING     1
@@ -122,6 +243,147 @@ extern char _commBuf[2048];
 
 //  Max number of clients allowed by ESP8266
 #define ESP_MAX_CLI     5
+//  Return codes of queued socket opening, outside of socket ID range so they
+//  can't be mistaken for one
+#define ESP_SOCK_PENDING    (ESP_MAX_CLI + 1)   //  Socket is already opening
+#define ESP_SOCK_BUSY       (ESP_MAX_CLI + 2)   //  Command queue is full
+//  Time in ms ESP is given to open a socket (DNS lookup and TCP handshake)
+#define ESP_SOCK_TIMEOUT    5000
+//  Max number of received payloads consumers can hold at the same time
+#define ESP_RX_SLICES   12
+//  Max number of commands waiting in command queue, and number of its slots
+//  bulk data can't take (kept free for control traffic)
+#define ESP_CMDQ_LEN    8
+#define ESP_CMDQ_CTRL   2
+//  Max length of a single command (without \r\n terminator)
+#define ESP_CMD_LEN     128
+//  Socket ID of the only socket available in passthrough mode
+#define ESP_PT_SOCK     0
+//  Time in ms the line has to stay silent before and after "+++" sequence that
+//  terminates passthrough mode
+#define ESP_PT_GUARD    1000
+//  Number of bins in histograms of link metrics. Bin i counts samples in range
+//  [2^i, 2^(i+1)) of histogram's unit (bin 0 also counts 0, last bin counts
+//  everything above its lower bound)
+#define ESP_HIST_BINS   10
+//  Suggested period (in ms) of sampling RSSI through ESP_T_RSSI service
+#define ESP_RSSI_PERIOD 5000
+
+/*      Priority classes of outbound data (lower value is sent first)  */
+#define ESP_PRIO_CTRL   0   //  Commands, acknowledgments, control replies
+#define ESP_PRIO_DATA   1   //  Regular data (default for all sockets)
+#define ESP_PRIO_BULK   2   //  Bulk data, e.g. telemetry and log dumps
+#define ESP_PRIO_N      3
+
+//  Longest +IPD payload kept in Rx ring until consumer releases it, longer
+//  payloads are copied into pooled buffer as they arrive
+#define ESP_RX_INPLACE  512
+
+/*      How payload of +IPD frame being received is handled     */
+#define ESP_IPD_DROP    0   //  Skipped (no client, too long, no buffer)
+#define ESP_IPD_INPLACE 1   //  Left in Rx ring, handed over as a slice
+#define ESP_IPD_COPY    2   //  Copied into pooled buffer as it arrives
+#define ESP_IPD_STREAM  3   //  Passed to client's stream hook as it arrives
+
+/*      States of a command in command queue    */
+#define ESP_CMD_QUEUED  0   //  Waiting for previous commands to complete
+#define ESP_CMD_SENT    1   //  Issued, waiting for reply (or prompt for data)
+#define ESP_CMD_DATA    2   //  Data written after prompt, waiting for SEND OK
+
+/*      Support of buffered sends (AT+CIPSENDBUF) by ESP's firmware     */
+#define ESP_SENDBUF_UNKNOWN 0   //  Not known yet, first segment probes it
+#define ESP_SENDBUF_ON      1
+#define ESP_SENDBUF_OFF     2
+
+/**
+ * Received payload held by a consumer. Payload stays in Rx ring at position
+ * [pos] or, if it wrapped around the end of the ring, is copied into pooled
+ * buffer [buf]
+ */
+struct _espRxHeld
+{
+    uint32_t            pos;
+    struct _bufSlice    buf;
+    bool                used;
+};
+
+/**
+ * AT command waiting in command queue. Commands sending data (CIPSEND) carry
+ * either a pooled buffer [buf] (holding one reference to it) or a pointer to
+ * caller's memory [raw] which has to stay valid until the command completes.
+ * Sends are ordered by [prio], other commands keep their place in the queue.
+ */
+struct _espCmd
+{
+    char                cmd[ESP_CMD_LEN];
+    //  Statuses (apart from OK/ERROR/FAIL) which complete the command; for
+    //  commands sending data the status completing it once data is written
+    //  (SEND OK if none)
+    uint32_t            flags;
+    //  Time in ms without reply after which the command fails
+    uint32_t            timeout;
+    //  Data written to the socket once ESP responds with prompt
+    struct _bufSlice    buf;
+    const char          *raw;
+    uint16_t            rawLen;
+    //  Routine called once command completes, with [tag] and final status
+    void                (*done)(const uint8_t, const uint32_t);
+    uint8_t             tag;
+    uint8_t             state;
+    //  Priority class of data sent by the command (ESP_PRIO_*)
+    uint8_t             prio;
+    //  Time the command was queued and sent to ESP (in timer cycles)
+    uint32_t            queued;
+    uint32_t            issued;
+};
+
+/**
+ * Metrics of data sends of a single priority class
+ */
+struct _espPrioStats
+{
+    uint32_t    sends;          //  Data sends confirmed by SEND OK
+    uint32_t    latMaxMs;       //  Longest latency of data send
+    //  Latency of data send from queueing it to SEND OK (bins in ms)
+    uint32_t    lat[ESP_HIST_BINS];
+};
+
+/**
+ * Metrics of the link to ESP, collected from the moment ESP is initialized or
+ * metrics were last reset. Time is measured only if task scheduler (its cycle
+ * counter) is compiled in, otherwise timings remain 0.
+ */
+struct _espStats
+{
+    uint32_t    bytesIn;        //  Bytes received from ESP
+    uint32_t    bytesOut;       //  Bytes sent to ESP (commands and data)
+    uint32_t    sends;          //  Data sends (CIPSEND) confirmed by SEND OK
+    uint32_t    sendFails;      //  Data sends failed (ERROR, FAIL or timeout)
+    uint32_t    sendRTTMaxMs;   //  Longest round trip of data send
+    //  Round trip of data send from issuing CIPSEND to SEND OK (bins in ms)
+    uint32_t    sendRTT[ESP_HIST_BINS];
+    uint32_t    busy;           //  "busy..." replies received from ESP
+    uint32_t    busyRetries;    //  Queued sends retried as blocking (queue full)
+    uint32_t    wdTimeouts;     //  Commands failed by watchdog timer
+    uint32_t    sockOpens;      //  Sockets opened (reported by ESP)
+    uint32_t    sockCloses;     //  Sockets closed (reported by ESP)
+    uint32_t    parseRuns;      //  Runs of parser which had data to parse
+    uint32_t    parseMaxUs;     //  Longest run of parser
+    //  Time spent parsing data received from ESP in a single run (bins in us)
+    uint32_t    parseTime[ESP_HIST_BINS];
+    uint32_t    isrRuns;        //  Runs of UART interrupt handler
+    uint32_t    isrMaxUs;       //  Longest run of UART interrupt handler
+    //  Time spent in a single run of UART interrupt handler (bins in us)
+    uint32_t    isrTime[ESP_HIST_BINS];
+    int8_t      rssi;           //  Last RSSI of AP in dBm (0 if unknown)
+    uint32_t    rssiSamples;    //  Number of RSSI samples taken
+    uint32_t    rxOverruns;     //  Rx ring overruns (ring full, data lost)
+    uint32_t    rxErrors;       //  UART receive errors (framing, FIFO overrun)
+    uint32_t    rxDropped;      //  Received payloads no consumer could take
+    uint32_t    preempts;       //  Sends queued ahead of lower priority sends
+    //  Sends of every priority class (indexed by ESP_PRIO_*)
+    struct _espPrioStats    prio[ESP_PRIO_N];
+};
 
 /**
  * ESP8266 class definition
@@ -129,20 +391,28 @@ extern char _commBuf[2048];
  * setting up a TCP server and managing open sockets. Socket creation/deletion
  * handled internally by interpreting status messages received from ESP. Class
  * _espClient provides direct interface to opened TCP sockets which can be accessed
- * from ESP8266::_clients vector
+ * from ESP8266::_clients slots
  */
 class ESP8266
 {
     /// Functions & classes needing direct access to all members
     friend class    _espClient;
     friend void     UART7RxIntHandler(void);
+    friend void     ESPParseIntHandler(void);
     friend void     _ESP_KernelCallback(void);
+    friend void     _ESP_SyncDone(const uint8_t tag, const uint32_t status);
+    friend void     _ESP_SockDone(const uint8_t tag, const uint32_t status);
+    friend void     _ESP_LargeDone(const uint8_t tag, const uint32_t status);
+    friend void     ESPWDISR();
 	public:
         //  Functions for returning static instance
         static ESP8266& GetI();
         static ESP8266* GetP();
         //  Functions for configuring ESP8266
 		uint32_t    InitHW(int32_t baud = ESP_DEF_BAUD);
+		uint32_t    NegotiateBaud(uint32_t maxBaud = ESP_MAX_BAUD,
+		                          bool flowCtrl = ESP_FLOW_CTRL);
+		uint32_t    Baud();
         void        Enable(bool enable);
         bool        IsEnabled();
         void        AddHook(void((*funPoint)(const uint8_t, const uint8_t*,
@@ -164,9 +434,31 @@ class ESP8266
 		uint32_t    OpenTCPSock(char *ipAddr, uint16_t port,
 		                        bool keepAlive=true, uint8_t sockID = 9);
 		bool        ValidSocket(uint8_t id);
+		bool        SockPending(uint8_t id);
+		uint32_t    OpenTCPSockAsync(char *ipAddr, uint16_t port,
+		                             bool keepAlive=true, uint8_t sockID = 9);
+		//  Functions related to UDP sockets
+		uint32_t    OpenUDPSock(char *ipAddr, uint16_t port, uint8_t sockID = 9);
+		uint32_t    OpenUDPSockAsync(char *ipAddr, uint16_t port,
+		                             uint8_t sockID = 9);
+		//  Functions related to passthrough mode
+		uint32_t    StartPassthrough(char *ipAddr, uint16_t port,
+		                             bool udp = false);
+		uint32_t    StopPassthrough();
+		bool        Passthrough();
 		uint32_t    Send(const char* arg, ...) { return ESP_NO_STATUS; }
-		//  Miscellaneous functions
-		uint32_t 	ParseResponse(char* rxBuffer, uint16_t rxLen);
+		//  Functions for queuing commands without waiting for reply
+		uint32_t    SendAsync(const char *cmd,
+		                      void((*done)(const uint8_t, const uint32_t)) = 0,
+		                      uint8_t tag = 0, uint32_t flags = 0,
+		                      uint32_t timeout = 250);
+		bool        CmdIdle();
+		//  Functions related to link metrics
+		uint32_t    SampleRSSI();
+		struct _espStats    Stats();
+		void        ResetStats();
+		//  Functions to release data received on sockets
+		void        Release(struct _espRxSlice &slc);
 
 		//  Status variable for error codes returned by ESP
 		volatile uint32_t	flowControl;
@@ -181,11 +473,41 @@ class ESP8266
 
 		bool        _InStatus(const uint32_t status, const uint32_t flag);
 		uint32_t	_SendRAW(const char* txBuffer, uint32_t flags = 0,
-		                     uint32_t timeout = 250);//150
+		                     uint32_t timeout = 250,//150
+		                     const char *raw = 0, uint16_t rawLen = 0,
+		                     uint8_t prio = ESP_PRIO_DATA);
+		uint8_t     _SockCmd(char *ipAddr, uint16_t port, uint8_t sockID,
+		                     bool udp = false);
+		struct _espCmd* _CmdPush(const char *cmd, uint32_t flags,
+		                         uint32_t timeout, uint8_t prio = ESP_PRIO_DATA);
+		void        _CmdCommit();
+		void        _CmdIssue();
+		void        _CmdCheck();
+		void        _CmdDone(uint32_t status);
 		void        _RAWPortWrite(const char* buffer, uint16_t bufLen);
 		void	    _FlushUART();
+		void        _PTEscape();
+		uint32_t    _PTLeave();
 		uint32_t    _IPtoInt(char *ipAddr);
 		uint8_t     _IDtoIndex(uint8_t sockID);
+		_espClient* _SlotOpen(uint8_t sockID);
+		void        _SlotClose(uint8_t sockID);
+		void        _ParseRx();
+		void        _RxDeliver(_espClient *cli, uint32_t pos, uint16_t len,
+		                       struct _bufSlice *buf = 0);
+		uint32_t    _ParseEvent(uint32_t ev);
+		struct _espRxSlice  _RxHold(uint32_t pos, uint16_t len,
+		                            struct _bufSlice *buf = 0);
+		void        _IPDStart(_espClient *cli, uint16_t len);
+		void        _IPDData(const uint8_t *data, uint16_t len);
+		void        _IPDEnd();
+		void        _IPDAbort();
+		void        _RxFree();
+		void        _StatsHist(uint32_t *hist, uint32_t val);
+		void        _PortInit(uint32_t baud, bool flowCtrl);
+		bool        _BaudSet(uint32_t baud, bool flowCtrl);
+		bool        _BaudProbe();
+		void        _BaudRevert(uint32_t baud, bool flowCtrl);
 
         //  Hook to user routine called when data from socket is received
         void    ((*custHook)(const uint8_t, const uint8_t*, const uint16_t));
@@ -196,10 +518,53 @@ class ESP8266
 		uint16_t    _tcpServPort;
 		//  Specifies whether the TCP server is currently running
 		bool        _servOpen;
-		//  List of all opened sockets (clients) currently communicating with
-		//  ESP. It's important that pointers itself are volatile, not _espClient
-		//  object because pointers get changed within ISR. Array index is socket ID!
-		_espClient volatile *_clients[ESP_MAX_CLI];
+		//  Slots of all sockets (clients) that can communicate with ESP, slot is
+		//  in use while its client is alive. Array index is socket ID!
+		_espClient  _clients[ESP_MAX_CLI];
+		//  Parser of incoming characters, status flags found in the current
+		//  line and client currently receiving +IPD payload
+		ATParser    _parser;
+		uint32_t    _lineStatus;
+		_espClient  *_ipdCli;
+		//  Set when message has to be terminated because WD timer timed out
+		volatile bool   _rxFlush;
+		//  Received payloads currently held by consumers
+		struct _espRxHeld   _rxHeld[ESP_RX_SLICES];
+		//  Position in Rx ring of the first byte of payload being received, how
+		//  it's handled (ESP_IPD_*) and buffer it's copied into
+		uint32_t    _ipdPos;
+		uint8_t     _ipdMode;
+		struct _bufSlice    _ipdBuf;
+		//  Command queue, first command in the queue is the one being executed
+		struct _espCmd  _cmdQ[ESP_CMDQ_LEN];
+		uint8_t     _cmdHead;
+		volatile uint8_t    _cmdN;
+		//  Outcome of command issued by a blocking function
+		volatile bool       _syncDone;
+		volatile uint32_t   _syncStatus;
+		//  Bitmask of socket IDs being opened by a queued command
+		volatile uint8_t    _sockPend;
+		//  Whether firmware supports buffered sends (ESP_SENDBUF_*)
+		uint8_t     _sendBuf;
+		//  Set while in passthrough mode, everything received is data of
+		//  socket ESP_PT_SOCK and everything sent goes to the socket as-is
+		volatile bool       _ptMode;
+		//  Port of TCP server stopped when passthrough mode was entered
+		uint16_t    _ptServPort;
+		//  Link metrics
+		struct _espStats    _stats;
+		//  Baud rate and flow control link runs at, rate module starts at after
+		//  power-up and highest rate (with flow control) negotiation was asked for
+		uint32_t    _baud;
+		bool        _flowCtrl;
+		uint32_t    _baudDef;
+		uint32_t    _baudMax;
+		bool        _flowReq;
+		//  Overruns and receive errors reported by HAL so far, and position in Rx
+		//  ring parsing continues from (reader jumps ahead on overrun)
+		uint32_t    _rxOverrunSeen;
+		uint32_t    _rxErrorsSeen;
+		uint32_t    _rxParsed;
 		//  Interface with task scheduler - provides memory space and function
 		//  to call in order for task scheduler to request service from this module
 #if defined(__USE_TASK_SCHEDULER__)
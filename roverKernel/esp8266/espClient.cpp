@@ -4,9 +4,10 @@
  *  Created on: Mar 4, 2017
  *      Author: Vedran
  */
-#include "espClient.h"
+#include "esp8266.h"
 #include "HAL/hal.h"
 #include "libs/myLib.h"
+#include "libs/strBuilder.h"
 
 #include <stdio.h>
 
@@ -17,23 +18,61 @@
 #include "serialPort/uartHW.h"
 #endif
 
+//  Completion routine of commands issued by blocking functions (esp8266.cpp)
+void _ESP_SyncDone(const uint8_t tag, const uint32_t status);
+
+/**
+ * Completion routine of a segment queued by large send, continues the send
+ * @param tag socket ID segment was sent to
+ * @param status bitwise OR of ESP_STATUS_* returned by the ESP module
+ */
+void _ESP_LargeDone(const uint8_t tag, const uint32_t status)
+{
+    if (tag < ESP_MAX_CLI)
+        ESP8266::GetI()._clients[tag]._LargeSent(status);
+}
+
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor                [PUBLIC]
 ///-----------------------------------------------------------------------------
-_espClient::_espClient() : KeepAlive(true), _parent(0), _id(0) ,_alive(false)
+_espClient::_espClient() : KeepAlive(true), Linger(ESP_TX_LINGER),
+                           Priority(ESP_PRIO_DATA),
+                           RxPolicy(ESP_RX_DROP_OLDEST), _parent(0), _id(0),
+                           _alive(false), _udp(false), _gen(0), _rxDropped(0),
+                           _rxStream(0), _flushPend(false), _flushAt(0)
 {
     _Clear();
+    _txBuf.id = BUFP_INVALID;
+    _txPack.id = BUFP_INVALID;
+    _txPackQ = _txPackEnd = 0;
+    memset((void*)&_lg, 0, sizeof(_lg));
 }
 
 _espClient::_espClient(uint8_t id, ESP8266 *par)
-    : KeepAlive(true), _parent(par), _id(id), _alive(true)
+    : KeepAlive(true), Linger(ESP_TX_LINGER), Priority(ESP_PRIO_DATA),
+      RxPolicy(ESP_RX_DROP_OLDEST), _parent(par), _id(id), _alive(true),
+      _udp(false), _gen(0), _rxDropped(0), _rxStream(0), _flushPend(false),
+      _flushAt(0)
 {
     _Clear();
+    _txBuf.id = BUFP_INVALID;
+    _txPack.id = BUFP_INVALID;
+    _txPackQ = _txPackEnd = 0;
+    memset((void*)&_lg, 0, sizeof(_lg));
 }
 _espClient::_espClient(const _espClient &arg)
-    : KeepAlive(arg.KeepAlive), _parent(arg._parent), _id(arg._id), _alive(arg._alive)
+    : KeepAlive(arg.KeepAlive), Linger(arg.Linger), Priority(arg.Priority),
+      RxPolicy(arg.RxPolicy), _parent(arg._parent), _id(arg._id),
+      _alive(arg._alive), _udp(arg._udp), _gen(arg._gen),
+      _rxDropped(arg._rxDropped), _rxStream(arg._rxStream), _flushPend(false),
+      _flushAt(0)
 {
     _Clear();
+    //  Written data can't have 2 owners, it stays with the original client
+    _txBuf.id = BUFP_INVALID;
+    _txPack.id = BUFP_INVALID;
+    _txPackQ = _txPackEnd = 0;
+    memset((void*)&_lg, 0, sizeof(_lg));
 }
 
 void _espClient::operator= (const _espClient &arg)
@@ -41,9 +80,16 @@ void _espClient::operator= (const _espClient &arg)
     _parent = arg._parent;
     _id = arg._id;
     _alive = arg._alive;
-    _respRdy = arg._respRdy;
+    _udp = arg._udp;
+    _gen = arg._gen;
     KeepAlive = arg.KeepAlive;
-    memcpy((void*)RespBody, (void*)(arg.RespBody), sizeof(RespBody));
+    Linger = arg.Linger;
+    Priority = arg.Priority;
+    RxPolicy = arg.RxPolicy;
+    _rxDropped = arg._rxDropped;
+    _rxStream = arg._rxStream;
+    //  Received data can't have 2 owners, it stays with the original client
+    _Clear();
 }
 
 ///-----------------------------------------------------------------------------
@@ -51,7 +97,8 @@ void _espClient::operator= (const _espClient &arg)
 ///-----------------------------------------------------------------------------
 
 /**
- * Send data to a client over open TCP socket
+ * Send data to a client over open TCP socket (or a datagram over UDP socket)
+ * @note Blocking function, returns once ESP confirms data was sent
  * @param buffer NULL-TERMINATED(!) data to send
  * @param bufferLen[optional] len of the buffer, if not provided function looks
  * for first occurrence of \0 in buffer and takes that as length
@@ -59,113 +106,646 @@ void _espClient::operator= (const _espClient &arg)
  */
 uint32_t _espClient::SendTCP(char *buffer, uint16_t bufferLen)
 {
-    uint16_t bufLen = bufferLen;
-    uint8_t numStr[6] = {0};
+    uint16_t bufLen = _SendCmd(buffer, bufferLen);
+
+    //  In passthrough mode data goes to the socket as-is
+    if (_parent->_ptMode)
+    {
+        _parent->_RAWPortWrite(buffer, bufLen);
+        return (ESP_STATUS_OK | ESP_STATUS_SENDOK);
+    }
+
+    //  Data is written from the caller's buffer once ESP is ready to receive it
+    return _parent->_SendRAW(_commBuf, 0, _SendTimeout(), buffer, bufLen,
+                             Priority);
+}
+/**
+ * Send data held in a pooled buffer to a client over open TCP socket. Data is
+ * written to the port directly from the pool, without copying it.
+ * @note Blocking function, returns once ESP confirms data was sent
+ * @note Caller keeps its reference to the buffer, slice is not released here
+ * @param slc slice of pooled buffer holding data to send
+ * @return status of send process (binary or of ESP_* flags received while sending)
+ */
+uint32_t _espClient::SendTCP(const struct _bufSlice &slc)
+{
+    if (!BufferPool::Valid(slc) || (slc.len == 0))
+        return ESP_STATUS_ERROR;
+
+    return SendTCP((char*)BufferPool::GetI().Data(slc), slc.len);
+}
+
+/**
+ * Queue data to be sent to a client over open TCP socket, without waiting for
+ * it to be sent. Data is copied into pooled buffer, data up to ESP_TX_PACK_LEN
+ * long shares the buffer with other short data sent through the socket.
+ * Datagram (UDP socket) sent without completion routine that finds command
+ * queue full waits in the buffer and is queued once a command completes.
+ * @param buffer NULL-TERMINATED(!) data to send
+ * @param bufferLen[optional] len of the buffer, if not provided function looks
+ * for first occurrence of \0 in buffer and takes that as length
+ * @param done[optional] routine called once data is sent (or sending failed),
+ * receives socket ID and status of send process
+ * @return ESP_NONBLOCKING_MODE if data was queued,
+ *         ESP_STATUS_BUSY if command queue or buffer pool is full,
+ *         ESP_STATUS_ERROR if data doesn't fit into pooled buffer
+ */
+uint32_t _espClient::SendTCPAsync(char *buffer, uint16_t bufferLen,
+                                  void((*done)(const uint8_t, const uint32_t)))
+{
+    struct _bufSlice slc;
+    uint32_t retVal;
 
     //  If buffer length is not provided find it by looking for \0 char in string
     if (bufferLen == 0)
+        bufferLen = strlen(buffer);
+    if ((bufferLen == 0) || (bufferLen > BUFP_BLOCK_SIZE))
+        return ESP_STATUS_ERROR;
+
+    //  In passthrough mode data is copied straight into Tx ring
+    if (_parent->_ptMode)
     {
-        //  Dangerous, might end up in memory access violation
-        while (buffer[bufLen++] != '\0');   //  Find \0
-        bufLen--;   //Exclude \0 char from size of buffer
+        _parent->_RAWPortWrite(buffer, bufferLen);
+        if (done != 0)
+            done(_id, ESP_STATUS_OK | ESP_STATUS_SENDOK);
+        return ESP_NONBLOCKING_MODE;
     }
 
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPSEND=");
-    itoa(_id, numStr);
-    strcat(_commBuf, (char*)numStr);
-    strcat(_commBuf, ",");
-    memset(numStr, 0, sizeof(numStr));
-    itoa(bufLen, numStr);
-    strcat(_commBuf, (char*)numStr);
+    if (bufferLen <= ESP_TX_PACK_LEN)
+    {
+        bool wait = _udp && (done == 0);
+
+        //  Datagrams waiting in the buffer are sent first
+        if ((_txPackQ < _txPackEnd) && !wait)
+            return ESP_STATUS_BUSY;
+        if (!_TxPack(buffer, bufferLen))
+            return ESP_STATUS_BUSY;
+        if ((_txPackQ + 2 + bufferLen) < _txPackEnd)
+            return ESP_NONBLOCKING_MODE;
+
+        retVal = _TxPackNext(done);
+        if ((retVal == ESP_STATUS_BUSY) && wait)
+            return ESP_NONBLOCKING_MODE;
+        if (retVal != ESP_NONBLOCKING_MODE)
+            _txPackEnd = _txPackQ;
+        return retVal;
+    }
+
+    if (!BufferPool::GetI().Acquire(slc))
+        return ESP_STATUS_BUSY;
+    memcpy((void*)BufferPool::GetI().Data(slc), (void*)buffer, bufferLen);
+    slc.len = bufferLen;
+
+    //  Queued command takes its own reference to the buffer
+    retVal = SendTCPAsync(slc, done);
+    BufferPool::GetI().Release(slc);
+
+    return retVal;
+}
 
-    if (_parent->_SendRAW(_commBuf, ESP_STATUS_RECV, 600))
+/**
+ * Queue data held in a pooled buffer to be sent to a client over open TCP
+ * socket, without waiting for it to be sent and without copying it.
+ * @note Caller keeps its reference to the buffer, queued command retains the
+ * buffer until data is sent
+ * @param slc slice of pooled buffer holding data to send
+ * @param done[optional] routine called once data is sent (or sending failed),
+ * receives socket ID and status of send process
+ * @return ESP_NONBLOCKING_MODE if data was queued,
+ *         ESP_STATUS_BUSY if command queue is full,
+ *         ESP_STATUS_ERROR if slice is not valid
+ */
+uint32_t _espClient::SendTCPAsync(const struct _bufSlice &slc,
+                                  void((*done)(const uint8_t, const uint32_t)))
+{
+    struct _espCmd *cmd;
+
+    if (!BufferPool::Valid(slc) || (slc.len == 0))
+        return ESP_STATUS_ERROR;
+
+    //  In passthrough mode data is copied straight into Tx ring
+    if (_parent->_ptMode)
     {
-        _parent->flowControl = ESP_NO_STATUS;
-        HAL_ESP_WDControl(true, 600);
+        _parent->_RAWPortWrite((char*)BufferPool::GetI().Data(slc), slc.len);
+        if (done != 0)
+            done(_id, ESP_STATUS_OK | ESP_STATUS_SENDOK);
+        return ESP_NONBLOCKING_MODE;
+    }
 
-        //  If ESP is not in server mode we need to manually start listening
-        //  for incoming data from ESP
-        if (!_parent->_servOpen)
-            HAL_ESP_IntEnable(true);
+    _SendCmd((char*)BufferPool::GetI().Data(slc), slc.len);
+    cmd = _parent->_CmdPush(_commBuf, 0, _SendTimeout(), Priority);
+    if (cmd == 0)
+        return ESP_STATUS_BUSY;
 
-        //  Write data we want to send
-        _parent->_RAWPortWrite(buffer, bufLen);
+    BufferPool::GetI().Retain(slc);
+    cmd->buf = slc;
+    cmd->done = done;
+    cmd->tag = _id;
+    _parent->_CmdCommit();
 
-        //  Listen for potential response
-        while (_parent->flowControl == ESP_NO_STATUS);
+    return ESP_NONBLOCKING_MODE;
+}
+
+/**
+ * Send data of any length to a client over open TCP socket (or as a series of
+ * datagrams over UDP socket), in segments of ESP_SEG_LEN bytes sent straight
+ * from caller's memory
+ * @note Blocking function, returns once all data is delivered or sending fails
+ * @param data data to send
+ * @param len length of data in bytes
+ * @return status of send process (binary or of ESP_* flags received while
+ * sending, see SendLargeAsync())
+ */
+uint32_t _espClient::SendLarge(const uint8_t *data, uint32_t len)
+{
+    uint32_t retVal;
+
+    //  Wait for command queue to take the first segment (and for large send
+    //  still in progress on this socket to complete)
+    while (1)
+    {
+        _parent->_syncDone = false;
+        retVal = SendLargeAsync(data, len, _ESP_SyncDone);
+        if (retVal != ESP_STATUS_BUSY)
+            break;
+        _parent->_ParseRx();
     }
-    //   Stop watchdog timer (started in ISR)
-    //HAL_ESP_WDControl(false, 0);
-    return _parent->flowControl;
+    if (retVal != ESP_NONBLOCKING_MODE)
+        return retVal;
+
+    while (!_parent->_syncDone)
+        _parent->_ParseRx();
+
+    return _parent->_syncStatus;
 }
+
 /**
- * Read response from TCP socket(client) saved in internal buffer
- * Internal buffer with response is filled as soon as response is received in
- * an interrupt. This function only copies response from internal buffer to a
- * user provided one and then clears internal (and data-ready flag).
- * @param buffer pointer to user-provided buffer for incoming data
- * @param bufferLen used to return [buffer] size to user
- * @return true: if response was present and is copied into the provided buffer
- *        false: if no response is available
+ * Start sending data of any length to a client over open TCP socket (or as a
+ * series of datagrams over UDP socket), without waiting for it to be sent.
+ * Data is split into segments of ESP_SEG_LEN bytes written to the port
+ * straight from caller's memory. Over TCP segments are sent through buffered
+ * send (AT+CIPSENDBUF) if ESP's firmware supports it: ESP takes a segment right
+ * away and confirms its delivery later, so up to ESP_SEG_WINDOW segments are
+ * in flight at once. Otherwise (and over UDP) every segment waits for SEND OK.
+ * Data written to the socket through Write() before is sent first.
+ * @note [data] has to stay valid until [done] is called
+ * @note Only one large send can be in progress on a socket
+ * @param data data to send
+ * @param len length of data in bytes
+ * @param done[optional] routine called once all data is delivered (status
+ * ESP_STATUS_OK | ESP_STATUS_SENDOK) or sending failed (status of the failure),
+ * receives socket ID and status of send process
+ * @return ESP_NONBLOCKING_MODE if sending started,
+ *         ESP_STATUS_BUSY if command queue is full or large send is already in
+ *         progress on this socket,
+ *         ESP_STATUS_ERROR if there's no data or socket is closed
  */
-bool _espClient::Receive(char *buffer, uint16_t *bufferLen)
+uint32_t _espClient::SendLargeAsync(const uint8_t *data, uint32_t len,
+                                    void((*done)(const uint8_t, const uint32_t)))
 {
-    (*bufferLen) = 0;
-    //  Check if there's new data received
-    if (_respRdy)
+    if ((data == 0) || (len == 0) || !_alive)
+        return ESP_STATUS_ERROR;
+
+    //  In passthrough mode data is copied straight into Tx ring
+    if (_parent->_ptMode)
+    {
+        for (uint32_t i = 0; i < len; i += ESP_SEG_LEN)
+            _parent->_RAWPortWrite((const char*)(data + i),
+                                   ((len - i) > ESP_SEG_LEN) ? ESP_SEG_LEN :
+                                                               (len - i));
+        if (done != 0)
+            done(_id, ESP_STATUS_OK | ESP_STATUS_SENDOK);
+        return ESP_NONBLOCKING_MODE;
+    }
+
+    //  Segments of previous large send (even if it was aborted) still queued
+    if ((_lg.data != 0) || (_lg.cmds > 0))
+        return ESP_STATUS_BUSY;
+
+    Flush();
+    _lg.data = data;
+    _lg.len = len;
+    _lg.queued = 0;
+    _lg.unacked = 0;
+    _lg.status = ESP_NO_STATUS;
+    _lg.done = done;
+    _LargeNext();
+
+    //  Send continues from completion of its segments, it has to have one
+    if (_lg.cmds == 0)
+    {
+        _lg.data = 0;
+        return ESP_STATUS_BUSY;
+    }
+
+    return ESP_NONBLOCKING_MODE;
+}
+
+/**
+ * Write data to a socket, coalescing it with other data written to the same
+ * socket. Written data is sent in a single send once there's 2048B of it (max
+ * ESP can take in a single send), on call to Flush() or [Linger] ms after the
+ * first byte was written, whichever comes first. Data passed in a single call
+ * is never split between two sends.
+ * @note Without task scheduler data is sent once buffer is full or on Flush()
+ * @param data data to send
+ * @param len length of data in bytes
+ * @return ESP_NONBLOCKING_MODE if data was written,
+ *         ESP_STATUS_BUSY if there's no free pooled buffer to hold the data,
+ *         ESP_STATUS_ERROR if data is longer than a single send
+ */
+uint32_t _espClient::Write(const uint8_t *data, uint16_t len)
+{
+    if ((len == 0) || (len > BUFP_BLOCK_SIZE))
+        return ESP_STATUS_ERROR;
+
+    //  In passthrough mode ESP coalesces data itself, write it right away
+    if (_parent->_ptMode)
+    {
+        _parent->_RAWPortWrite((const char*)data, len);
+        return ESP_NONBLOCKING_MODE;
+    }
+
+    //  Data doesn't fit into what's left of the buffer, send the buffer first
+    if (BufferPool::Valid(_txBuf) && (len > (BUFP_BLOCK_SIZE - _txBuf.len)))
+        Flush();
+
+    //  Take new buffer, data written into it gets sent after linger time
+    if (!BufferPool::Valid(_txBuf))
     {
-        //  Fill argument buffer
-        while(RespBody[(*bufferLen)] != 0)
+        if (!BufferPool::GetI().Acquire(_txBuf))
+            return ESP_STATUS_BUSY;
+        _txBuf.len = 0;
+#if defined(__USE_TASK_SCHEDULER__)
+        //  Socket has at most one flush task scheduled, if one is still
+        //  pending from previous buffer it's moved to new deadline once it
+        //  runs (see _FlushDue())
+        if (Linger > 0)
         {
-            buffer[(*bufferLen)] = RespBody[(*bufferLen)];
-            (*bufferLen)++;
+            _flushAt = msSinceStartup + Linger;
+            if (!_flushPend)
+            {
+                _flushPend = true;
+                TaskScheduler::GetP()->SyncTask(ESP_UID, ESP_T_FLUSH,
+                                                -((int64_t)Linger));
+                TaskScheduler::GetP()->AddArgs(&_id, 1);
+            }
         }
+#endif
+    }
 
-        //  Clear response body & flag
-        _Clear();
+    memcpy((void*)(BufferPool::GetI().Data(_txBuf) + _txBuf.len),
+           (void*)data, len);
+    _txBuf.len += len;
 
-        //  Check if it's supposed to stay open, if not force closing or schedule
-        //  closing(preferred) of socket
-        if (!KeepAlive)
-        {
 #if defined(__USE_TASK_SCHEDULER__)
-            TaskScheduler::GetP()->SyncTask(ESP_UID, ESP_T_CLOSETCP, 0);
-            TaskScheduler::GetP()->AddArgs(&_id, 1);
+    //  Send data right away if buffer is full or linger time is 0
+    if ((_txBuf.len == BUFP_BLOCK_SIZE) || (Linger == 0))
+        Flush();
 #else
-            Close();
+    if (_txBuf.len == BUFP_BLOCK_SIZE)
+        Flush();
 #endif
-        }
 
-        return true;
+    return ESP_NONBLOCKING_MODE;
+}
+
+/**
+ * Send data written to this socket through Write() that wasn't sent yet
+ * @note On UDP socket data is dropped if command queue is full, rather than
+ * waiting to send it right away
+ * @return ESP_NONBLOCKING_MODE if data was queued for sending, status of send
+ * process if it had to be sent right away (command queue full), or
+ * ESP_STATUS_OK if there was no data to send
+ */
+uint32_t _espClient::Flush()
+{
+    uint32_t retVal = ESP_STATUS_OK;
+
+    if (!BufferPool::Valid(_txBuf))
+        return retVal;
+
+    //  Queued command takes its own reference to the buffer
+    if (_txBuf.len > 0)
+    {
+        retVal = SendTCPAsync(_txBuf);
+        if ((retVal == ESP_STATUS_BUSY) && !_udp)
+            retVal = SendTCP(_txBuf);
     }
-    else return false;
+    BufferPool::GetI().Release(_txBuf);
+
+    return retVal;
+}
+
+/**
+ * Stream data received on this socket to a hook as it arrives, instead of
+ * handing it over in slices through Receive(). Payload of every +IPD frame is
+ * passed in continuous pieces straight from Rx ring (called from parser, in
+ * main context), so frames of any length can be received without holding
+ * space in the ring. Hook gets socket ID, piece of data, its length and number
+ * of bytes of the frame still to come (0 on the last piece of frame). Hook
+ * called with no data (0 pointer) means the frame got cut (link reset or
+ * overrun) and what was received of it should be dropped.
+ * @note Hook must not call blocking functions of ESP library
+ * @note Setting is cleared once socket closes
+ * @param hook routine to stream data to, 0 to hand it over in slices again
+ */
+void _espClient::SetRxStream(void((*hook)(const uint8_t, const uint8_t*,
+                                          const uint16_t, const uint16_t)))
+{
+    _rxStream = hook;
+}
+
+/**
+ * Take the oldest response received on TCP socket(client), without copying it
+ * Ownership of received data is passed to the caller, which has to release it
+ * by calling Release() once done. Responses received since stay queued (up to
+ * ESP_RX_QUEUE of them, see RxPolicy) and are taken by following calls.
+ * @param slc[out] slice pointing to received data
+ * @return true: if response was present and is handed over through [slc]
+ *        false: if no response is available
+ */
+bool _espClient::Receive(struct _espRxSlice &slc)
+{
+    bool retVal;
+
+    //  Parser runs in software interrupt if there's no task scheduler
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(true);
+#endif  /* __USE_TASK_SCHEDULER__ */
+    retVal = _RxPop(slc);
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(false);
+#endif  /* __USE_TASK_SCHEDULER__ */
+
+    //  Check if there's new data received
+    if (!retVal)
+        return false;
+    _KeepAlive();
+
+    return true;
+}
+
+/**
+ * Read response from TCP socket(client) into user-provided buffer
+ * Copies received data (binary-safe) and releases it. Receive(_espRxSlice&)
+ * should be preferred as it avoids copying.
+ * @param buffer pointer to user-provided buffer for incoming data
+ * @param bufferLen used to return [buffer] size to user
+ * @return true: if response was present and is copied into the provided buffer
+ *        false: if no response is available
+ */
+bool _espClient::Receive(char *buffer, uint16_t *bufferLen)
+{
+    struct _espRxSlice slc;
+
+    (*bufferLen) = 0;
+    if (!Receive(slc))
+        return false;
+
+    memcpy((void*)buffer, (void*)slc.data, slc.len);
+    (*bufferLen) = slc.len;
+    Release(slc);
+
+    return true;
+}
+
+/**
+ * Release data received on this socket, once user is done with it
+ * @param slc[in/out] slice of received data, invalidated on exit
+ */
+void _espClient::Release(struct _espRxSlice &slc)
+{
+    _parent->Release(slc);
+}
+
+/**
+ * Check if this is a UDP socket (data is sent as datagrams, without delivery
+ * confirmation from the receiver)
+ * @return true: if socket is UDP socket
+ *        false: if socket is TCP socket
+ */
+bool _espClient::Datagram()
+{
+    return _udp;
+}
+
+/**
+ * Get generation of the socket, number identifying connection currently open
+ * in this client's slot (changes every time a socket is opened in the slot)
+ * @return generation of the socket
+ */
+uint8_t _espClient::Generation()
+{
+    return _gen;
+}
+
+/**
+ * Check if connection a handle to this client was taken from is still open.
+ * Handle is stale if socket got closed since, even if another socket with the
+ * same ID was opened in the meantime.
+ * @param generation generation of the socket at the time handle was taken
+ * @return true: if the same connection is still open
+ *        false: otherwise
+ */
+bool _espClient::Valid(uint8_t generation)
+{
+    return (_alive && (_gen == generation));
 }
 
 /**
  * Check is socket has any new data ready for user
- * @note Used when manually reading response body from member variable to check
- * whether new data is available. If used, Done() MUST be called when done
- * processing data in response body. Alternative: use Receive() function instead
+ * @note New data is taken by calling Receive(), or dropped by calling Done()
  * @return true: if there's new data from that socket
  *        false: otherwise
  */
 bool _espClient::Ready()
 {
-    return _respRdy;
+    return (_rxN > 0);
+}
+
+/**
+ * Get number of responses received on this socket and not yet taken
+ * @return number of queued responses (up to ESP_RX_QUEUE)
+ */
+uint8_t _espClient::Pending()
+{
+    return _rxN;
+}
+
+/**
+ * Get number of responses dropped because they were received while the queue
+ * was full (counted for the slot, across sockets opened in it)
+ * @return number of dropped responses
+ */
+uint32_t _espClient::RxDropped()
+{
+    return _rxDropped;
 }
 
 /**
- * Clear response body, flags and maintain socket alive if specified
- * @note Has to be called if user manually reads response body by reading member
- * variable directly, and not through Receive() function call
+ * Drop all data received on this socket without reading it, clear flags and
+ * maintain socket alive if specified
  */
 void _espClient::Done()
 {
-    //  Clear response body & flag
-    _Clear();
-    //  Check if it's supposed to stay open, if not force closing or schedule
-    //  closing(preferred) of socket
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(true);
+#endif  /* __USE_TASK_SCHEDULER__ */
+    //  Release received data & clear flag
+    _RxDrop();
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(false);
+#endif  /* __USE_TASK_SCHEDULER__ */
+    _KeepAlive();
+}
+
+/**
+ * Force closing TCP socket with the client, data written to the socket that
+ * is still waiting to be sent is sent first. Closing passthrough socket leaves
+ * passthrough mode.
+ * @note Slot is freed once ESP confirms closing (passthrough socket's slot is
+ * freed right away). Received data still held in the queue is released here,
+ * even if ESP fails closing without reporting it
+ * @return status of close process (binary or of ESP_* flags received while closing)
+ */
+uint32_t _espClient::Close()
+{
+    uint32_t retVal;
+
+    if (_parent->_ptMode)
+        return _parent->StopPassthrough();
+
+    Flush();
+
+    StrBuilder cmd(_commBuf, ESP_CMD_LEN);
+    cmd.Add("AT+CIPCLOSE=");
+    cmd.AddNum(_id);
+
+    _alive = false;
+    retVal = _parent->_SendRAW(_commBuf);
+
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(true);
+#endif  /* __USE_TASK_SCHEDULER__ */
+    _RxDrop();
+#if !defined(__USE_TASK_SCHEDULER__)
+    HAL_ESP_SoftIntMask(false);
+#endif  /* __USE_TASK_SCHEDULER__ */
+
+    return retVal;
+}
+
+/**
+ * Assemble command for sending data through this socket in shared buffer
+ * @param buffer data to send
+ * @param bufferLen len of the buffer, if 0 function looks for first occurrence
+ * of \0 in buffer and takes that as length
+ * @return length of data to send
+ */
+uint16_t _espClient::_SendCmd(const char *buffer, uint16_t bufferLen)
+{
+    uint16_t bufLen = bufferLen;
+    StrBuilder cmd(_commBuf, ESP_CMD_LEN);
+
+    //  If buffer length is not provided find it by looking for \0 char in string
+    if (bufferLen == 0)
+    {
+        //  Dangerous, might end up in memory access violation
+        while (buffer[bufLen++] != '\0');   //  Find \0
+        bufLen--;   //Exclude \0 char from size of buffer
+    }
+
+    cmd.Add("AT+CIPSEND=");
+    cmd.AddNum(_id);
+    cmd.Add(',');
+    cmd.AddNum(bufLen);
+
+    return bufLen;
+}
+
+/**
+ * Get time in ms to wait for ESP to confirm data was sent. TCP data is confirmed
+ * once the receiver acknowledges it, UDP datagram as soon as it's transmitted.
+ * @return timeout for reply to send command
+ */
+uint32_t _espClient::_SendTimeout()
+{
+    return (_udp ? 100 : 600);
+}
+
+/**
+ * Forget received data (without releasing it) and clear flag for response ready
+ */
+void _espClient::_Clear()
+{
+    _rxHead = 0;
+    _rxN = 0;
+}
+
+/**
+ * Queue payload received on this socket. If the queue is full, payload chosen
+ * by RxPolicy is dropped (released) and counted.
+ * @param slc slice holding the payload, taken over by the queue
+ * @return true if [slc] got queued, false if it got dropped instead
+ */
+bool _espClient::_RxPush(const struct _espRxSlice &slc)
+{
+    struct _espRxSlice old;
+
+    if (_rxN >= ESP_RX_QUEUE)
+    {
+        _rxDropped++;
+        if (RxPolicy == ESP_RX_DROP_NEWEST)
+        {
+            old = slc;
+            _parent->Release(old);
+            return false;
+        }
+        _RxPop(old);
+        _parent->Release(old);
+    }
+
+    _rxQ[(_rxHead + _rxN) % ESP_RX_QUEUE] = slc;
+    _rxN++;
+
+    return true;
+}
+
+/**
+ * Take the oldest payload out of the queue (caller takes it over)
+ * @param slc[out] slice holding the payload
+ * @return true if there was a payload queued, false otherwise
+ */
+bool _espClient::_RxPop(struct _espRxSlice &slc)
+{
+    if (_rxN == 0)
+        return false;
+
+    slc = _rxQ[_rxHead];
+    _rxHead = (_rxHead + 1) % ESP_RX_QUEUE;
+    _rxN--;
+
+    return true;
+}
+
+/**
+ * Release all payloads in the queue
+ */
+void _espClient::_RxDrop()
+{
+    struct _espRxSlice slc;
+
+    while (_RxPop(slc))
+        _parent->Release(slc);
+}
+
+/**
+ * Check if socket is supposed to stay open after data was received, if not
+ * force closing or schedule closing(preferred) of socket
+ */
+void _espClient::_KeepAlive()
+{
     if (!KeepAlive)
     {
 #if defined(__USE_TASK_SCHEDULER__)
@@ -178,29 +758,245 @@ void _espClient::Done()
 }
 
 /**
- * Force closing TCP socket with the client
- * @note Object is deleted in ParseResponse function, once ESP confirms closing
- * @return status of close process (binary or of ESP_* flags received while closing)
+ * Pack short data into socket's buffer, behind data packed before it. Once data
+ * doesn't fit buffer is given up (commands sending data in it keep it until
+ * they complete) and a new one is taken, unless there are datagrams waiting
+ * in it. Buffer that isn't used by any command is reused from the beginning.
+ * @param data data to pack
+ * @param len length of data, at most ESP_TX_PACK_LEN
+ * @return true if data got packed, false if there's no space for it
  */
-uint32_t _espClient::Close()
+bool _espClient::_TxPack(const char *data, uint16_t len)
+{
+    uint8_t *rec;
+
+    if (BufferPool::Valid(_txPack) && (_txPackQ == _txPackEnd))
+    {
+        if (BufferPool::GetI().RefCount(_txPack) == 1)
+            _txPackQ = _txPackEnd = 0;
+        else if (((uint32_t)_txPackEnd + 2 + len) > BUFP_BLOCK_SIZE)
+            BufferPool::GetI().Release(_txPack);
+    }
+    if (!BufferPool::Valid(_txPack))
+    {
+        if (!BufferPool::GetI().Acquire(_txPack))
+            return false;
+        _txPackQ = _txPackEnd = 0;
+    }
+    if (((uint32_t)_txPackEnd + 2 + len) > BUFP_BLOCK_SIZE)
+        return false;
+
+    rec = BufferPool::GetI().Data(_txPack) + _txPackEnd;
+    memcpy((void*)rec, (void*)&len, 2);
+    memcpy((void*)(rec + 2), (void*)data, len);
+    _txPackEnd += 2 + len;
+
+    return true;
+}
+
+/**
+ * Queue the first data waiting in socket's pack buffer (see _TxPack())
+ * @param done[optional] routine called once data is sent (or sending failed)
+ * @return ESP_NONBLOCKING_MODE if data was queued,
+ *         ESP_STATUS_BUSY if command queue is full
+ */
+uint32_t _espClient::_TxPackNext(void((*done)(const uint8_t, const uint32_t)))
 {
-    uint8_t strNum[6] = {0};
+    struct _bufSlice slc;
+    uint16_t len;
+    uint32_t retVal;
 
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPCLOSE=");
-    itoa(_id, strNum);
-    strcat(_commBuf, (char*)strNum);
+    memcpy((void*)&len, (void*)(BufferPool::GetI().Data(_txPack) + _txPackQ), 2);
+    slc = BufferPool::Slice(_txPack, _txPackQ + 2, len);
+    retVal = SendTCPAsync(slc, done);
+    if (retVal == ESP_NONBLOCKING_MODE)
+        _txPackQ += 2 + len;
 
-    _alive = false;
-    return _parent->_SendRAW(_commBuf);
+    return retVal;
 }
 
 /**
- * Clear response body and flag for response ready
+ * Called once a command completes: queue datagrams waiting in pack buffer for
+ * free slot in command queue, and give the buffer back to the pool once all
+ * data packed into it got sent
  */
-void _espClient::_Clear()
+void _espClient::_TxPackPoll()
 {
-    memset((void*)RespBody, 0, sizeof(RespBody));
-    RespLen = 0;
-    _respRdy = false;
+    while ((_txPackQ < _txPackEnd) &&
+           (_TxPackNext(0) == ESP_NONBLOCKING_MODE));
+
+    if ((_txPackQ == _txPackEnd) &&
+        (BufferPool::GetI().RefCount(_txPack) == 1))
+    {
+        BufferPool::GetI().Release(_txPack);
+        _txPackQ = _txPackEnd = 0;
+    }
+}
+
+/**
+ * Called from flush task scheduled by Write(): send written data if its linger
+ * time expired. Task could have been scheduled for data that was already sent
+ * (buffer filled up or got flushed), in that case it's moved to the deadline
+ * of data written since, so socket never has more than one flush task pending
+ */
+void _espClient::_FlushDue()
+{
+    _flushPend = false;
+
+    if (!_alive || !BufferPool::Valid(_txBuf))
+        return;
+
+#if defined(__USE_TASK_SCHEDULER__)
+    if (_flushAt > msSinceStartup)
+    {
+        int64_t wait = (int64_t)(_flushAt - msSinceStartup);
+
+        _flushPend = true;
+        TaskScheduler::GetP()->SyncTask(ESP_UID, ESP_T_FLUSH, -wait);
+        TaskScheduler::GetP()->AddArgs(&_id, 1);
+        return;
+    }
+#endif
+
+    Flush();
+}
+
+/**
+ * Queue next segments of large send, as many as its window allows. Segments
+ * sent through CIPSEND complete on SEND OK, ESP_SEG_QUEUED of them are queued
+ * so that the next one is issued as soon as the previous one completes.
+ * Buffered segments (CIPSENDBUF) complete as soon as ESP takes them; while
+ * it's not known if firmware supports buffered sends, a single segment probes
+ * it. Stops without error if command queue is full, send continues once one of
+ * its segments (or any other command) completes.
+ */
+void _espClient::_LargeNext()
+{
+    struct _espCmd *cmd;
+    uint8_t window = ESP_SEG_QUEUED;
+    bool buffered = !_udp && (_parent->_sendBuf != ESP_SENDBUF_OFF);
+    uint16_t n;
+
+    if (buffered)
+        window = (_parent->_sendBuf == ESP_SENDBUF_ON) ? ESP_SEG_WINDOW : 1;
+
+    while ((_lg.data != 0) && (_lg.status == ESP_NO_STATUS) &&
+           (_lg.queued < _lg.len) && ((_lg.cmds + _lg.unacked) < window))
+    {
+        StrBuilder str(_commBuf, ESP_CMD_LEN);
+
+        n = ((_lg.len - _lg.queued) > ESP_SEG_LEN) ? ESP_SEG_LEN :
+                                                     (_lg.len - _lg.queued);
+        str.Add(buffered ? "AT+CIPSENDBUF=" : "AT+CIPSEND=");
+        str.AddNum(_id);
+        str.Add(',');
+        str.AddNum(n);
+
+        cmd = _parent->_CmdPush(_commBuf,
+                                buffered ? ESP_STATUS_SEGRECV : ESP_NO_STATUS,
+                                _SendTimeout(), Priority);
+        if (cmd == 0)
+            return;
+        cmd->raw = (const char*)(_lg.data + _lg.queued);
+        cmd->rawLen = n;
+        cmd->done = _ESP_LargeDone;
+        cmd->tag = _id;
+        _lg.queued += n;
+        _lg.cmds++;
+        _parent->_CmdCommit();
+    }
+}
+
+/**
+ * Segment of large send completed its command: it got sent (CIPSEND), taken by
+ * ESP (CIPSENDBUF), or failed. Failed probe of buffered send means firmware
+ * doesn't support it, segment is sent again through CIPSEND.
+ * @param status bitwise OR of ESP_STATUS_* command completed with
+ */
+void _espClient::_LargeSent(uint32_t status)
+{
+    bool probe = !_udp && (_parent->_sendBuf == ESP_SENDBUF_UNKNOWN);
+
+    if (_lg.cmds > 0)
+        _lg.cmds--;
+    if (_lg.data == 0)
+        return;
+
+    if (_parent->_InStatus(status, ESP_STATUS_SEGRECV))
+    {
+        _parent->_sendBuf = ESP_SENDBUF_ON;
+        _lg.unacked++;
+    }
+    else if (!_parent->_InStatus(status, ESP_STATUS_SENDOK))
+    {
+        //  Probe is the only segment queued, all data before it is delivered
+        if (probe)
+        {
+            _parent->_sendBuf = ESP_SENDBUF_OFF;
+            _lg.queued = ((_lg.queued - 1) / ESP_SEG_LEN) * ESP_SEG_LEN;
+        }
+        else if (_lg.status == ESP_NO_STATUS)
+            _lg.status = status;
+    }
+
+    _LargeNext();
+    _LargeEnd();
+}
+
+/**
+ * Receiver confirmed delivery of a buffered segment of large send (or ESP
+ * reported it couldn't be delivered)
+ * @param ok true if segment was delivered, false if sending it failed
+ */
+void _espClient::_LargeAck(bool ok)
+{
+    if ((_lg.data == 0) || (_lg.unacked == 0))
+        return;
+
+    _lg.unacked--;
+    if (!ok && (_lg.status == ESP_NO_STATUS))
+        _lg.status = ESP_STATUS_FAIL;
+
+    _LargeNext();
+    _LargeEnd();
+}
+
+/**
+ * Abort large send in progress (socket got closed), confirmations of segments
+ * ESP took are not waited for
+ */
+void _espClient::_LargeAbort()
+{
+    if (_lg.data == 0)
+        return;
+
+    if (_lg.status == ESP_NO_STATUS)
+        _lg.status = ESP_STATUS_ERROR;
+    _lg.unacked = 0;
+    _LargeEnd();
+}
+
+/**
+ * Complete large send once all its data is delivered, or once it failed and
+ * none of its segments is left in command queue. Caller is told the outcome
+ * through completion routine.
+ */
+void _espClient::_LargeEnd()
+{
+    void (*done)(const uint8_t, const uint32_t) = _lg.done;
+    uint32_t status = _lg.status;
+
+    if ((_lg.data == 0) || (_lg.cmds > 0))
+        return;
+    if (status == ESP_NO_STATUS)
+    {
+        if ((_lg.queued < _lg.len) || (_lg.unacked > 0))
+            return;
+        status = ESP_STATUS_OK | ESP_STATUS_SENDOK;
+    }
+
+    _lg.data = 0;
+    _lg.unacked = 0;
+    if (done != 0)
+        done(_id, status);
 }
@@ -8,20 +8,74 @@
 #ifndef ROVERKERNEL_ESP8266_ESPCLIENT_H_
 #define ROVERKERNEL_ESP8266_ESPCLIENT_H_
 
-//  Define class prototype
+//  Define class prototypes
 class _espClient;
+class ESP8266;
 
 
-#include "esp8266.h"
+#include "libs/bufferPool.h"
 
+//  ID of a slice which doesn't hold any received data
+#define ESP_RX_NOSLICE  0xFF
+//  Default time in ms data written to a socket waits to be sent together with
+//  data written after it
+#define ESP_TX_LINGER   20
+//  Length of segments SendLarge() splits data into (max ESP takes in one send)
+#define ESP_SEG_LEN     2048
+//  Max number of segments of SendLarge() that are queued or taken by ESP and
+//  not yet confirmed by the receiver (buffered send, AT+CIPSENDBUF)
+#define ESP_SEG_WINDOW  4
+//  Max number of segments queued at once when sending through AT+CIPSEND
+#define ESP_SEG_QUEUED  2
+//  Data up to this long sent by copy is packed together with other short data
+//  into a single pooled buffer of the socket, instead of taking a whole buffer
+#define ESP_TX_PACK_LEN 256
+//  Max number of received payloads a socket holds for its user
+#define ESP_RX_QUEUE    4
+//  Payload dropped when payload is received on a socket whose queue is full
+#define ESP_RX_DROP_OLDEST  0   //  Oldest payload in the queue (default)
+#define ESP_RX_DROP_NEWEST  1   //  Payload just received
 
 /**
- * _espClient class - wrapper for TCP client connected to ESP server
+ * Read-only view of data received on a socket. Data stays in ESP's Rx ring
+ * (it's never copied) until the holder releases the slice through
+ * _espClient::Release() or ESP8266::Release()
+ */
+struct _espRxSlice
+{
+    const uint8_t   *data;  //  Pointer to the first byte of received data
+    uint16_t        len;    //  Number of bytes received
+    uint8_t         id;     //  Handle of held data (ESP_RX_NOSLICE if none)
+};
+
+/**
+ * Large send in progress on a socket (see _espClient::SendLarge()). Data is
+ * sent from caller's memory, segment by segment.
+ */
+struct _espLargeTx
+{
+    const uint8_t   *data;  //  Data to send, 0 if no large send is in progress
+    uint32_t        len;    //  Length of data
+    uint32_t        queued; //  Bytes of data handed to command queue so far
+    uint8_t         cmds;   //  Segments in command queue (also after abort)
+    uint8_t         unacked;//  Segments ESP took, not confirmed by receiver
+    uint32_t        status; //  Status of the first failure (0 if none)
+    //  Routine called once all data is delivered or sending failed
+    void            (*done)(const uint8_t, const uint32_t);
+};
+
+
+/**
+ * _espClient class - wrapper for TCP client connected to ESP server, or UDP
+ * socket exchanging datagrams with remote side
  */
 class _espClient
 {
     friend class    ESP8266;
     friend void     UART7RxIntHandler(void);
+    friend void     _ESP_KernelCallback(void);
+    friend void     _ESP_SockDone(const uint8_t tag, const uint32_t status);
+    friend void     _ESP_LargeDone(const uint8_t tag, const uint32_t status);
     public:
         _espClient();
         _espClient(uint8_t id, ESP8266 *par);
@@ -30,19 +84,59 @@ class _espClient
         void        operator= (const _espClient &arg);
 
         uint32_t    SendTCP(char *buffer, uint16_t bufferLen = 0);
+        uint32_t    SendTCP(const struct _bufSlice &slc);
+        uint32_t    SendTCPAsync(char *buffer, uint16_t bufferLen = 0,
+                        void((*done)(const uint8_t, const uint32_t)) = 0);
+        uint32_t    SendTCPAsync(const struct _bufSlice &slc,
+                        void((*done)(const uint8_t, const uint32_t)) = 0);
+        uint32_t    SendLarge(const uint8_t *data, uint32_t len);
+        uint32_t    SendLargeAsync(const uint8_t *data, uint32_t len,
+                        void((*done)(const uint8_t, const uint32_t)) = 0);
+        uint32_t    Write(const uint8_t *data, uint16_t len);
+        uint32_t    Flush();
+        void        SetRxStream(void((*hook)(const uint8_t, const uint8_t*,
+                                             const uint16_t, const uint16_t)));
+        bool        Receive(struct _espRxSlice &slc);
         bool        Receive(char *buffer, uint16_t *bufferLen);
+        void        Release(struct _espRxSlice &slc);
         bool        Ready();
+        uint8_t     Pending();
+        uint32_t    RxDropped();
+        bool        Datagram();
+        uint8_t     Generation();
+        bool        Valid(uint8_t generation);
         void        Done();
         uint32_t    Close();
 
         //  Keep socket alive (don't terminate it after first round of communication)
         volatile bool       KeepAlive;
-        //  Buffer for data received on this socket
-        volatile char       RespBody[1024];
-        volatile uint16_t   RespLen;
+        //  Time in ms data passed to Write() waits for more data before it's
+        //  sent (0 - send right away)
+        uint16_t            Linger;
+        //  Priority class of data sent through this socket (ESP_PRIO_*), data
+        //  of higher priority overtakes data queued before it
+        uint8_t             Priority;
+        //  Payload dropped once received payloads fill the queue
+        //  (ESP_RX_DROP_*)
+        uint8_t             RxPolicy;
 
     private:
         void        _Clear();
+        bool        _RxPush(const struct _espRxSlice &slc);
+        bool        _RxPop(struct _espRxSlice &slc);
+        void        _RxDrop();
+        uint16_t    _SendCmd(const char *buffer, uint16_t bufferLen);
+        uint32_t    _SendTimeout();
+        void        _KeepAlive();
+        void        _LargeNext();
+        void        _LargeSent(uint32_t status);
+        void        _LargeAck(bool ok);
+        void        _LargeAbort();
+        void        _LargeEnd();
+        bool        _TxPack(const char *data, uint16_t len);
+        uint32_t    _TxPackNext(void((*done)(const uint8_t, const uint32_t)));
+        void        _TxPackPoll();
+        void        _FlushDue();
 
         //  Pointer to a parent device of of this client
         ESP8266         *_parent;
@@ -50,8 +144,35 @@ class _espClient
         uint8_t         _id;
         //  Specifies whether the socket is alive
         volatile bool   _alive;
-        //  Specifies whether there's a response from this client ready to read
-        volatile bool   _respRdy;
+        //  Specifies whether this is UDP socket (TCP otherwise)
+        bool            _udp;
+        //  Number of times a socket was opened in this client's slot
+        uint8_t         _gen;
+        //  Data received on this socket, not yet taken by the user: queue of
+        //  payloads in the order they arrived, starting at _rxHead
+        struct _espRxSlice  _rxQ[ESP_RX_QUEUE];
+        uint8_t         _rxHead;
+        volatile uint8_t    _rxN;
+        //  Received payloads dropped because the queue was full
+        uint32_t        _rxDropped;
+        //  Hook received data is streamed to as it arrives (0 if data is
+        //  handed over in slices instead)
+        void    (*_rxStream)(const uint8_t, const uint8_t*, const uint16_t,
+                             const uint16_t);
+        //  Data written to this socket, waiting to be sent in a single send
+        struct _bufSlice    _txBuf;
+        //  Set while flush task for this socket is scheduled, data written into
+        //  _txBuf is due to be sent at _flushAt (ms since startup)
+        bool            _flushPend;
+        uint64_t        _flushAt;
+        //  Buffer short data sent by copy is packed into, as records of length
+        //  (2B) followed by data. Records from _txPackQ on are datagrams waiting
+        //  for free slot in command queue, free space starts at _txPackEnd
+        struct _bufSlice    _txPack;
+        uint16_t        _txPackQ;
+        uint16_t        _txPackEnd;
+        //  Large send in progress
+        struct _espLargeTx  _lg;
 };
 
 #endif /* ROVERKERNEL_ESP8266_ESPCLIENT_H_ */
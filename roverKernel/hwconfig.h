@@ -15,8 +15,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-//  Define platform in use in hal.h
+//  Define platform in use in hal.h (host builds define __BOARD_HOST__ on the
+//  compiler command line instead)
+#if !defined(__BOARD_HOST__)
 #define __BOARD_TM4C1294NCPDT__
+#endif
 
 /*
  * Compile all libraries in debug mode, allowing them to print debug data to
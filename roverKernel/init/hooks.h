@@ -58,6 +58,8 @@ static void ESPDataReceived(const uint8_t sockID, const uint8_t *buf, const uint
         else
             strcat((char*)response, "NACK\0");
 
+        //  Queued with control priority, reply goes out ahead of telemetry
+        //  waiting to be sent (see Platform::InitHW())
         Platform::GetI().commands.Send(response);
     }
     else
@@ -66,19 +68,4 @@ static void ESPDataReceived(const uint8_t sockID, const uint8_t *buf, const uint
     }
 }
 
-/**
- * Function called when a radar scan is completed, dumps data to a socket Id=0
- * if socket exists
- * @param scanData
- * @param scanLen
- */
-static void RADScanComplete(uint8_t* scanData, uint16_t* scanLen)
-{
-    //  Once scan is completed schedule sending data through command socket
-    TaskScheduler::GetP()->SyncTask(ESP_UID, ESP_T_SENDTCP, 0);
-    TaskScheduler::GetP()->AddArg<uint8_t>(P_TO_SOCK(P_COMMANDS));  //Socket ID
-
-    TaskScheduler::GetP()->AddArgs((void*)scanData, *scanLen);
-}
-
 #endif /* ROVERKERNEL_INIT_HOOKS_H_ */
@@ -101,9 +101,10 @@ void _PLAT_KernelCallback(void)
 
             telemetryFrame += '\n';
 
-            //  Send over telemetry stream
+            //  Write into telemetry stream, frame is sent together with event
+            //  log frames following it
             __plat._ker.retVal =
-                    __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str());
+                    __plat.telemetry.Write((uint8_t*)telemetryFrame.c_str());
 
 #ifdef __DEBUG_SESSION__
             DEBUG_WRITE("\nSending frame(%d), len:%d \n  %s \n",     \
@@ -113,7 +114,10 @@ void _PLAT_KernelCallback(void)
 
             //  If previous sending failed, no need to force next sending, pass
             if (__plat._ker.retVal != STATUS_OK)
+            {
+                __plat.telemetry.Flush();
                 return;
+            }
 
             //  If there are any unsent events, ship them off now
             if (EventLog::GetI().EventCount() > 0)
@@ -132,8 +136,8 @@ void _PLAT_KernelCallback(void)
                     telemetryFrame += tostr<int16_t>(node->taskID) + ":";
                     telemetryFrame += tostr<uint16_t>(node->event) + ":";
 
-                    __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
-                                                   telemetryFrame.length());
+                    __plat.telemetry.Write((uint8_t*)telemetryFrame.c_str(),
+                                                    telemetryFrame.length());
 
 #ifdef __DEBUG_SESSION__
                     DEBUG_WRITE("\nSending frame(%d), len:%d \n  %s \n",     \
@@ -145,6 +149,8 @@ void _PLAT_KernelCallback(void)
                     nodesSent++;
                 }
             }
+            //  Send all frames written so far in a single send
+            __plat.telemetry.Flush();
 
             //  Telemetry doesn't affect status, if it fails, software
             //  does best-effort to try and resend it
@@ -161,6 +167,8 @@ void _PLAT_KernelCallback(void)
             //  Reboot only if 0x17 was sent as argument
             if (__plat._ker.args[0] == 0x17)
             {
+                //  Preserve periodic tasks so they resume right after reset
+                __plat.ts->Snapshot();
                 HAL_BOARD_Reset();
             }
         }
@@ -194,10 +202,11 @@ void _PLAT_KernelCallback(void)
                 telemetryFrame += tostr<int16_t>(ee.taskID) + ":";
                 telemetryFrame += tostr<uint16_t>(ee.event) + ":";
 
-                //  Send telemetry frame
-                __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
-                                               telemetryFrame.length());
+                //  Write telemetry frame, all are sent together once done
+                __plat.telemetry.Write((uint8_t*)telemetryFrame.c_str(),
+                                                telemetryFrame.length());
             }
+            __plat.telemetry.Flush();
             //  Telemetry can't affect status, it's only a best-effort to
             //  deliver data
             __plat._ker.retVal = STATUS_OK;
@@ -254,11 +263,36 @@ void _PLAT_KernelCallback(void)
                 telemetryFrame += tostr<uint16_t>((uint16_t)task->Perf.msAcc) + ":";
                 telemetryFrame += tostr<uint32_t>((uint32_t)task->Perf.accRT) + ":";
                 telemetryFrame += tostr<uint16_t>((uint16_t)task->Perf.maxRT) + ":";
+                telemetryFrame += tostr<uint16_t>((uint16_t)task->Perf.maxStartMiss) + ":";
+
+                //  Write telemetry frame, all are sent together once done
+                __plat.telemetry.Write((uint8_t*)telemetryFrame.c_str(),
+                                                telemetryFrame.length());
+            }
+
+            //  Report hard-tier callbacks, format:
+            //  5*:slot:enabled:runs:overruns:maxRunUs:maxJitterUs:tickJitterUs:
+            for (int8_t i = 0; i < HTS_MAX_TASKS; i++)
+            {
+                if (!__plat.hts->Registered(i))
+                    continue;
+
+                struct _htsStats stats = __plat.hts->Stats(i);
 
-                //  Send telemetry frame
-                __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
-                                               telemetryFrame.length());
+                telemetryFrame =  "5*:";
+                telemetryFrame += tostr<int16_t>(i) + ":";
+                telemetryFrame += tostr<uint16_t>(__plat.hts->Enabled(i)) + ":";
+                telemetryFrame += tostr<uint32_t>(stats.runs) + ":";
+                telemetryFrame += tostr<uint32_t>(stats.overruns) + ":";
+                telemetryFrame += tostr<uint32_t>(stats.maxRunUs) + ":";
+                telemetryFrame += tostr<uint32_t>(stats.maxJitterUs) + ":";
+                telemetryFrame += tostr<uint32_t>(__plat.hts->TickJitterUs()) + ":";
+
+                //  Write telemetry frame, all are sent together once done
+                __plat.telemetry.Write((uint8_t*)telemetryFrame.c_str(),
+                                                telemetryFrame.length());
             }
+            __plat.telemetry.Flush();
             //  Telemetry can't affect status, it's only a best-effort to
             //  deliver data
             __plat._ker.retVal = STATUS_OK;
@@ -303,6 +337,88 @@ void _PLAT_KernelCallback(void)
             __plat._ker.retVal = STATUS_OK;
         }
         break;
+#ifdef __HAL_USE_ESP8266__
+    /*
+     * Send metrics of the link to ESP (traffic, latency, errors, RSSI), so they
+     * can be correlated with telemetry frames that went missing
+     * args[] = none
+     * retVal STATUS_OK
+     */
+    case PLAT_T_ESP_DUMP:
+        {
+            std::string telemetryFrame;
+            struct _espStats stats = __plat.esp->Stats();
+
+            //  Format (histograms are comma-separated bins, see _espStats):
+            //  6*:[time]:bytesIn:bytesOut:sends:sendFails:sendRTTMaxMs:
+            //  sendRTT:busy:busyRetries:wdTimeouts:sockOpens:sockCloses:
+            //  parseRuns:parseMaxUs:parseTime:rssi:rssiSamples:rxOverruns:
+            //  rxErrors:baud:preempts:
+            //  followed by sends:latMaxMs:lat: of every priority class and
+            //  rxDropped:isrRuns:isrMaxUs:isrTime:
+            //  and attempts:failures:connects:backoffMs: of keep-alive of
+            //  telemetry and commands streams
+            telemetryFrame =  "6*:";
+            telemetryFrame += "[" + tostr<uint32_t>((uint32_t)msSinceStartup) + "]:";
+            telemetryFrame += tostr<uint32_t>(stats.bytesIn) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.bytesOut) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.sends) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.sendFails) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.sendRTTMaxMs) + ":";
+            for (uint8_t i = 0; i < ESP_HIST_BINS; i++)
+                telemetryFrame += tostr<uint32_t>(stats.sendRTT[i]) +
+                                  ((i < (ESP_HIST_BINS - 1)) ? "," : ":");
+            telemetryFrame += tostr<uint32_t>(stats.busy) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.busyRetries) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.wdTimeouts) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.sockOpens) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.sockCloses) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.parseRuns) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.parseMaxUs) + ":";
+            for (uint8_t i = 0; i < ESP_HIST_BINS; i++)
+                telemetryFrame += tostr<uint32_t>(stats.parseTime[i]) +
+                                  ((i < (ESP_HIST_BINS - 1)) ? "," : ":");
+            telemetryFrame += tostr<int16_t>(stats.rssi) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.rssiSamples) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.rxOverruns) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.rxErrors) + ":";
+            telemetryFrame += tostr<uint32_t>(__plat.esp->Baud()) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.preempts) + ":";
+            for (uint8_t p = 0; p < ESP_PRIO_N; p++)
+            {
+                telemetryFrame += tostr<uint32_t>(stats.prio[p].sends) + ":";
+                telemetryFrame += tostr<uint32_t>(stats.prio[p].latMaxMs) + ":";
+                for (uint8_t i = 0; i < ESP_HIST_BINS; i++)
+                    telemetryFrame += tostr<uint32_t>(stats.prio[p].lat[i]) +
+                                      ((i < (ESP_HIST_BINS - 1)) ? "," : ":");
+            }
+            telemetryFrame += tostr<uint32_t>(stats.rxDropped) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.isrRuns) + ":";
+            telemetryFrame += tostr<uint32_t>(stats.isrMaxUs) + ":";
+            for (uint8_t i = 0; i < ESP_HIST_BINS; i++)
+                telemetryFrame += tostr<uint32_t>(stats.isrTime[i]) +
+                                  ((i < (ESP_HIST_BINS - 1)) ? "," : ":");
+            //  Reconnects of telemetry and commands streams
+            DataStream *streams[] = { &__plat.telemetry, &__plat.commands };
+            for (uint8_t s = 0; s < 2; s++)
+            {
+                struct _dataKAStats ka = streams[s]->KeepAliveStats();
+
+                telemetryFrame += tostr<uint32_t>(ka.attempts) + ":";
+                telemetryFrame += tostr<uint32_t>(ka.failures) + ":";
+                telemetryFrame += tostr<uint32_t>(ka.connects) + ":";
+                telemetryFrame += tostr<uint32_t>(ka.backoffMs) + ":";
+            }
+
+            __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
+                                           telemetryFrame.length());
+
+            //  Telemetry can't affect status, it's only a best-effort to
+            //  deliver data
+            __plat._ker.retVal = STATUS_OK;
+        }
+        break;
+#endif  /* __HAL_USE_ESP8266__ */
     default:
         break;
     }
@@ -360,6 +476,10 @@ void Platform::InitHW()
 #ifdef __HAL_USE_TASKSCH__
         ts = TaskScheduler::GetP();
         ts->InitHW(1);
+        //  Configure base tick of hard real-time tier, timer starts once the
+        //  first callback is registered
+        hts = HardScheduler::GetP();
+        hts->InitHW(HTS_TICK_US);
 #endif
 
     //  Emit status of platform
@@ -375,6 +495,8 @@ void Platform::InitHW()
 #ifdef __HAL_USE_ESP8266__
         esp = ESP8266::GetP();
         esp->InitHW();
+        //  Speed up the link as far as it stays free of errors
+        esp->NegotiateBaud();
         esp->AddHook(ESPDataReceived);
         //  Connect to AP in non-blocking mode, allowing everything else to
         //  be initialized while ESP establishes connection in the background
@@ -384,6 +506,9 @@ void Platform::InitHW()
         //  still connecting to AP they will gracefully fail to bind until
         //  connection is established (error handled by DataStream module)
         DataStream_InitHW();
+        //  Replies to commands overtake telemetry waiting to be sent
+        telemetry.SetPriority(ESP_PRIO_BULK);
+        commands.SetPriority(ESP_PRIO_CTRL);
         telemetry.BindToSocketID(P_TO_SOCK(P_TELEMETRY), true);
 
         //  Delay binding second socket so that the two tasks have different
@@ -405,7 +530,6 @@ void Platform::InitHW()
 #ifdef __HAL_USE_RADAR__
         rad = RadarModule::GetP();
         rad->InitHW();
-        rad->AddHook(RADScanComplete);
 #endif
 
         //  Run post-initialization stuff
@@ -487,7 +611,8 @@ void Platform::Execute(const uint8_t* buf, const uint16_t len, int *err)
 #endif
 
     //  This one is special: Radar scan task needs to be repeated 160 times,
-    //  with period of 40ms(to reposition radar head)
+    //  with period of 40ms(to reposition radar head). Task ends on its own
+    //  once the scan is complete
     if ((argv[0] == RADAR_UID) && (argv[1] == RADAR_T_SCAN))
     {
         argv[3] = 40;
@@ -497,6 +622,19 @@ void Platform::Execute(const uint8_t* buf, const uint16_t len, int *err)
     ts->SyncTaskPer(argv[0], argv[1], argv[2], argv[3], argv[4]);
     //  Pass location and size of arguments
     ts->AddArgs((void*)(buf+it), argv[5]);
+
+#ifdef __HAL_USE_RADAR__
+    //  Once radar scan completes send scan data through command socket. Send
+    //  is chained to the scan so it runs right after the scan completes and
+    //  gets the slice of pooled buffer holding scan data forwarded, data is
+    //  sent straight from radar's buffer
+    if ((argv[0] == RADAR_UID) &&
+        ((argv[1] == RADAR_T_SCAN) || (argv[1] == RADAR_T_BLOCKINGSCAN)))
+    {
+        ts->ChainTask(ESP_UID, ESP_T_SENDBUF, true);
+        ts->AddArg<uint8_t>(P_TO_SOCK(P_COMMANDS));  //  Socket ID
+    }
+#endif
 }
 
 /**
@@ -505,19 +643,36 @@ void Platform::Execute(const uint8_t* buf, const uint16_t len, int *err)
  */
 void Platform::_PostInit()
 {
+    //  Periodic tasks are already in task list if it was restored from
+    //  snapshot taken before warm reset, schedule them only on cold start
+    bool schedule = !ts->Restored();
+
 #ifdef __HAL_USE_MPU9250__
     //  Create periodic task that will read sensor data
-    ts->SyncTaskPer(MPU_UID, MPU_T_GET_DATA, -50, 10, T_PERIODIC);
+    if (schedule)
+        ts->SyncTaskPer(MPU_UID, MPU_T_GET_DATA, -50, 10, T_PERIODIC);
     #ifdef __HAL_USE_MPU9250_NODMP__
         mpu->SetupAHRS(0.01, 0.9, 0.01);
     #endif
 
 #endif
 
-    //  Schedule periodic telemetry sending every 1s
-    ts->SyncTaskPer(PLAT_UID, PLAT_T_TEL, -1000, 1000, T_PERIODIC);
-    //  Startup speed loop for the engines
-    ts->SyncTaskPer(ENGINES_UID, ENG_T_SPEEDLOOP, -150, 150, T_PERIODIC);
+    if (schedule)
+    {
+        //  Schedule periodic telemetry sending every 1s
+        ts->SyncTaskPer(PLAT_UID, PLAT_T_TEL, -1000, 1000, T_PERIODIC);
+        //  Startup speed loop for the engines
+        ts->SyncTaskPer(ENGINES_UID, ENG_T_SPEEDLOOP, -150, 150, T_PERIODIC);
+#ifdef __HAL_USE_ESP8266__
+        //  Sample RSSI of AP and report metrics of link to ESP shortly after
+        //  the reply to RSSI request is in
+        ts->SyncTaskPer(ESP_UID, ESP_T_RSSI, -ESP_RSSI_PERIOD,
+                        ESP_RSSI_PERIOD, T_PERIODIC);
+        ts->AddArg<uint8_t>(0);
+        ts->SyncTaskPer(PLAT_UID, PLAT_T_ESP_DUMP, -(ESP_RSSI_PERIOD + 200),
+                        ESP_RSSI_PERIOD, T_PERIODIC);
+#endif
+    }
 
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_OK);
@@ -529,7 +684,8 @@ void Platform::_PostInit()
 ///                      Class constructor & destructor              [PROTECTED]
 ///-----------------------------------------------------------------------------
 Platform::Platform()
-    : telemetry(TCP_SERVER_IP, P_TELEMETRY), commands(TCP_SERVER_IP, P_COMMANDS)
+    : telemetry(TCP_SERVER_IP, P_TELEMETRY, P_TEL_DATAGRAM),
+      commands(TCP_SERVER_IP, P_COMMANDS)
 {
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_UNINITIALIZED);
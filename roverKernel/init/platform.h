@@ -18,6 +18,7 @@
 #include "radar/radarGP2.h"
 #include "mpu9250/mpu9250.h"
 #include "taskScheduler/taskScheduler.h"
+#include "taskScheduler/hardScheduler.h"
 
 #include "network/dataStream.h"
 
@@ -37,6 +38,11 @@
  * Server expects telemetry stream on TCP port 2700
  */
 #define P_TELEMETRY     2700
+/*
+ * Set to true to send telemetry as UDP datagrams to the same port (frames that
+ * ESP can't take right away are dropped instead of stalling the rover)
+ */
+#define P_TEL_DATAGRAM  false
 /*
  * Commands data stream
  * This stream brings commands from server to rover. On received frame from
@@ -60,6 +66,7 @@
     #define PLAT_T_SOFT_REBOOT    3   //  Perform soft reboot, only reset states
     #define PLAT_T_TS_DUMP        4   //  Report task scheduler data
     #define PLAT_T_ENG_DUMP       5   //  Report telemetry from engines
+    #define PLAT_T_ESP_DUMP       6   //  Report metrics of link to ESP
 
 //  ID of this device when exchanging messages
 const char DEVICE_ID[] = {"ROVER1"};
@@ -77,6 +84,8 @@ class Platform
 
         //  Task scheduler is a requirement for platform
         volatile TaskScheduler *ts;
+        //  Hard real-time tier of task scheduling
+        HardScheduler *hts;
 
 #ifdef __HAL_USE_ESP8266__
         ESP8266 *esp;
@@ -0,0 +1,216 @@
+/**
+ * bufferPool.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "bufferPool.h"
+#include "libs/myLib.h"
+#include "HAL/hal.h"
+
+///-----------------------------------------------------------------------------
+///         Functions for returning static instance                     [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Return reference to a singleton
+ * @return reference to an internal static instance
+ */
+BufferPool& BufferPool::GetI()
+{
+    static BufferPool singletonInstance;
+    return singletonInstance;
+}
+
+/**
+ * Return pointer to a singleton
+ * @return pointer to a internal static instance
+ */
+BufferPool* BufferPool::GetP()
+{
+    return &(BufferPool::GetI());
+}
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Take a free buffer from the pool. Returned slice spans whole buffer (offset 0,
+ * length BUFP_BLOCK_SIZE) and its holder is the only owner of the buffer
+ * (reference count 1). Holder shrinks the slice to the length of actual data.
+ * @param slc[out] slice pointing to acquired buffer, on failure id of the slice
+ * is set to BUFP_INVALID
+ * @return true if free buffer was found, false if pool is exhausted
+ */
+bool BufferPool::Acquire(struct _bufSlice &slc)
+{
+    bool retVal = false;
+
+    slc.id = BUFP_INVALID;
+    slc.offset = 0;
+    slc.len = 0;
+
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    for (uint8_t i = 0; i < BUFP_BLOCK_NUM; i++)
+        if (_refCnt[i] == 0)
+        {
+            _refCnt[i] = 1;
+            slc.id = i;
+            slc.len = BUFP_BLOCK_SIZE;
+            retVal = true;
+            break;
+        }
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+
+    return retVal;
+}
+
+/**
+ * Register new holder of a buffer referenced by the slice (increase reference
+ * count of the buffer)
+ * @param slc slice referencing buffer to retain
+ */
+void BufferPool::Retain(const struct _bufSlice &slc)
+{
+    if (!Valid(slc))
+        return;
+
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    if (_refCnt[slc.id] > 0)
+        _refCnt[slc.id]++;
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+}
+
+/**
+ * Drop holder of a buffer referenced by the slice (decrease reference count of
+ * the buffer). Buffer returns to the pool when its last holder releases it.
+ * @param slc[in/out] slice referencing buffer to release, invalidated on exit
+ */
+void BufferPool::Release(struct _bufSlice &slc)
+{
+    if (!Valid(slc))
+        return;
+
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    if (_refCnt[slc.id] > 0)
+        _refCnt[slc.id]--;
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+
+    slc.id = BUFP_INVALID;
+    slc.len = 0;
+}
+
+/**
+ * Get pointer to the first byte of data referenced by the slice
+ * @param slc slice referencing data
+ * @return pointer to data, or 0 if slice is not valid
+ */
+uint8_t* BufferPool::Data(const struct _bufSlice &slc)
+{
+    if (!Valid(slc))
+        return 0;
+
+    return (_data[slc.id] + slc.offset);
+}
+
+/**
+ * Get number of bytes that can be written starting from the beginning of slice
+ * @param slc slice referencing data
+ * @return space in buffer from first byte of slice to the end of the buffer
+ */
+uint16_t BufferPool::Capacity(const struct _bufSlice &slc)
+{
+    if (!Valid(slc))
+        return 0;
+
+    return (BUFP_BLOCK_SIZE - slc.offset);
+}
+
+/**
+ * Get number of holders of a buffer referenced by the slice
+ * @param slc slice referencing buffer
+ * @return reference count of the buffer, 0 if slice is not valid
+ */
+uint8_t BufferPool::RefCount(const struct _bufSlice &slc)
+{
+    if (!Valid(slc))
+        return 0;
+
+    return _refCnt[slc.id];
+}
+
+/**
+ * Get number of buffers that are currently free
+ * @return number of free buffers in the pool
+ */
+uint8_t BufferPool::FreeCount()
+{
+    uint8_t retVal = 0;
+
+    for (uint8_t i = 0; i < BUFP_BLOCK_NUM; i++)
+        if (_refCnt[i] == 0)
+            retVal++;
+
+    return retVal;
+}
+
+/**
+ * Check whether the slice references an existing buffer
+ * @param slc slice to check
+ * @return true if slice references one of the buffers in the pool
+ */
+bool BufferPool::Valid(const struct _bufSlice &slc)
+{
+    return ((slc.id < BUFP_BLOCK_NUM) &&
+            (((uint32_t)slc.offset + slc.len) <= BUFP_BLOCK_SIZE));
+}
+
+/**
+ * Create a sub-range of existing slice sharing the same buffer
+ * @note Reference count is not changed, if the new slice is going to be kept
+ * after the original one is released it has to be retained
+ * @param slc original slice
+ * @param offset offset of sub-range from the beginning of the original slice
+ * @param len length of sub-range, cropped to fit within the original slice
+ * @return new slice, or an invalid slice if [offset] is out of range
+ */
+struct _bufSlice BufferPool::Slice(const struct _bufSlice &slc,
+                                   uint16_t offset, uint16_t len)
+{
+    struct _bufSlice retVal = { BUFP_INVALID, 0, 0 };
+
+    if (!Valid(slc) || (offset > slc.len))
+        return retVal;
+
+    retVal.id = slc.id;
+    retVal.offset = slc.offset + offset;
+    retVal.len = min(len, slc.len - offset);
+
+    return retVal;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor              [PROTECTED]
+///-----------------------------------------------------------------------------
+
+BufferPool::BufferPool()
+{
+    for (uint8_t i = 0; i < BUFP_BLOCK_NUM; i++)
+        _refCnt[i] = 0;
+}
+
+BufferPool::~BufferPool()
+{}
@@ -0,0 +1,87 @@
+/**
+ * bufferPool.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Kernel-wide pool of fixed-size, reference-counted data buffers. Producers of
+ *  large payloads (radar scans, network data...) fill a buffer from the pool
+ *  once and then pass a small handle (slice) to it between kernel modules,
+ *  through task scheduler arguments, data streams and ESP transmit path instead
+ *  of copying the payload at every hop. Buffer is returned to the pool once the
+ *  last holder of a handle to it releases it.
+ *
+ *  @version 1.1.0
+ *  V1.0.0
+ *  +Fixed number of statically allocated buffers, reference counting and
+ *  slicing of buffers into sub-ranges sharing the same memory
+ *  V1.1.0
+ *  +Number of holders of a buffer can be read (RefCount()), so that its owner
+ *  knows when it's the only one left and can reuse the buffer
+ */
+#ifndef ROVERKERNEL_LIBS_BUFFERPOOL_H_
+#define ROVERKERNEL_LIBS_BUFFERPOOL_H_
+
+#include "hwconfig.h"
+
+//  Size of a single buffer in the pool (2048 is max length of continuous
+//  stream ESP can handle in a single send)
+#define BUFP_BLOCK_SIZE     2048
+//  Number of buffers in the pool
+#define BUFP_BLOCK_NUM      4
+//  ID of a slice which doesn't point to any buffer
+#define BUFP_INVALID        0xFF
+
+/**
+ * Handle to a range of bytes inside one of the buffers in the pool
+ * Slice is a plain structure so it can be passed by value and copied into task
+ * scheduler arguments. Copying a slice doesn't change reference count of the
+ * buffer, holder that keeps a copy must call BufferPool::Retain() on it and
+ * BufferPool::Release() once done.
+ */
+struct _bufSlice
+{
+    uint8_t     id;     //  Index of buffer in the pool (BUFP_INVALID if none)
+    uint16_t    offset; //  Index of first byte of slice within the buffer
+    uint16_t    len;    //  Number of bytes in the slice
+};
+
+/**
+ * BufferPool class definition
+ * Singleton managing memory and reference counters of all pooled buffers.
+ * All functions are safe to call from within interrupts.
+ */
+class BufferPool
+{
+    public:
+        //  Functions for returning static instance
+        static BufferPool& GetI();
+        static BufferPool* GetP();
+
+        //  Functions for obtaining and returning buffers
+        bool        Acquire(struct _bufSlice &slc);
+        void        Retain(const struct _bufSlice &slc);
+        void        Release(struct _bufSlice &slc);
+        //  Functions for accessing data in a buffer
+        uint8_t*    Data(const struct _bufSlice &slc);
+        uint16_t    Capacity(const struct _bufSlice &slc);
+        uint8_t     RefCount(const struct _bufSlice &slc);
+        uint8_t     FreeCount();
+
+        static bool Valid(const struct _bufSlice &slc);
+        static struct _bufSlice Slice(const struct _bufSlice &slc,
+                                      uint16_t offset, uint16_t len);
+
+    protected:
+        BufferPool();
+        ~BufferPool();
+        BufferPool(BufferPool &) {}                 //  No definition - forbid this
+        void operator=(BufferPool const &) {}       //  No definition - forbid this
+
+        //  Memory space of all buffers
+        uint8_t             _data[BUFP_BLOCK_NUM][BUFP_BLOCK_SIZE];
+        //  Number of holders of each buffer, buffer is free when it's 0
+        volatile uint8_t    _refCnt[BUFP_BLOCK_NUM];
+};
+
+#endif /* ROVERKERNEL_LIBS_BUFFERPOOL_H_ */
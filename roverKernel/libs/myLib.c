@@ -166,32 +166,65 @@ int32_t stoiv (volatile uint8_t *nums, volatile uint8_t strLen)
 /**
  * Convert any integer number to string
  * @param num input number to convert
- * @param str char array to store convert integer to
+ * @param str char array to store convert integer to (at least 12 bytes long
+ * for any int32_t number), string is null-terminated
+ * @return number of characters written to [str], excluding terminating \0
  */
-void itoa (int32_t num, uint8_t *str)
+uint8_t itoa (int32_t num, uint8_t *str)
 {
     uint8_t it = 0;
+    uint8_t digits = 0;
+    uint8_t tmp[10];
+    //  Work with magnitude in unsigned type, -INT32_MIN doesn't fit in int32_t
+    uint32_t mag = (uint32_t)num;
 
     if (num < 0)
     {
         str[it++]= '-';
-        num = labs(num);
+        mag = 0 - mag;
     }
 
-    uint8_t digits = 1;
+    //  Digits come out from the right to the left of the number, collect them
+    //  first and then copy them in correct order (48 is ASCII offset for digit)
+    do
+    {
+        tmp[digits++] = (uint8_t)(48 + mag % 10);
+        mag /= 10;
+    }
+    while (mag > 0);
+
+    while (digits > 0)
+        str[it++] = tmp[--digits];
+    str[it] = '\0';
+
+    return it;
+}
 
-    //  Find length of the string
-    while ( (num / ((int32_t)powf(10.0f, (float)digits))) > 0)
-        digits++;
+/**
+ * Calculate CRC-16 (CCITT polynomial 0x1021) of a byte array. Can be called
+ * repeatedly on consecutive chunks of data by passing previous result as [crc]
+ * @param data byte array to calculate checksum of
+ * @param len length of [data] array
+ * @param crc initial value of CRC (0xFFFF when starting new checksum)
+ * @return CRC-16 of [data] array
+ */
+uint16_t crc16 (const uint8_t *data, uint16_t len, uint16_t crc)
+{
+    uint16_t i;
+    uint8_t bit;
 
-    //  We'll start adding digits from the right to the left of the number,
-    //  adjust iterator accordingly
-    it += (digits -1);
-    //  Convert digits to string (48 is ASCII offset for digit)
-    while ((digits--) > 0)
+    for (i = 0; i < len; i++)
     {
-        str[it--] = (uint8_t)(48 + num % 10);
-        num /=10;
+        crc ^= ((uint16_t)data[i] << 8);
+
+        for (bit = 0; bit < 8; bit++)
+        {
+            if ((crc & 0x8000) != 0)
+                crc = (crc << 1) ^ 0x1021;
+            else
+                crc = (crc << 1);
+        }
     }
-}
 
+    return crc;
+}
@@ -38,7 +38,10 @@ int32_t stoi (uint8_t *nums, uint8_t strLen);
 int32_t stoiv (volatile uint8_t *nums, volatile uint8_t strLen);
 
 /*      Functions to convert number to string           */
-void    itoa (int32_t num, uint8_t *str);
+uint8_t itoa (int32_t num, uint8_t *str);
+
+/*      Checksum functions          */
+uint16_t crc16 (const uint8_t *data, uint16_t len, uint16_t crc);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,146 @@
+/**
+ * strBuilder.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "strBuilder.h"
+#include "libs/myLib.h"
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Append null-terminated string
+ * @param str string to append
+ * @return false if any text got cut since the last Reset(), true otherwise
+ */
+bool StrBuilder::Add(const char *str)
+{
+    char *dst = _buf + _len;
+    char *end = _buf + _cap - 1;    //  Last char is reserved for \0
+
+    while ((*str != '\0') && (dst < end))
+        *(dst++) = *(str++);
+    *dst = '\0';
+    _len = dst - _buf;
+
+    if (*str != '\0')
+        _ovf = true;
+
+    return !_ovf;
+}
+
+/**
+ * Append [len] characters of a string (string doesn't need to be terminated)
+ * @param str string to append
+ * @param len number of characters to append
+ * @return false if any text got cut since the last Reset(), true otherwise
+ */
+bool StrBuilder::Add(const char *str, uint16_t len)
+{
+    if ((_len + len) >= _cap)
+    {
+        len = _cap - _len - 1;
+        _ovf = true;
+    }
+    memcpy((void*)(_buf + _len), (void*)str, len);
+    _len += len;
+    _buf[_len] = '\0';
+
+    return !_ovf;
+}
+
+/**
+ * Append single character
+ * @param c character to append
+ * @return false if any text got cut since the last Reset(), true otherwise
+ */
+bool StrBuilder::Add(char c)
+{
+    if ((_len + 1) >= _cap)
+    {
+        _ovf = true;
+        return false;
+    }
+    _buf[_len++] = c;
+    _buf[_len] = '\0';
+
+    return !_ovf;
+}
+
+/**
+ * Append integer number in decimal form
+ * @param num number to append
+ * @return false if any text got cut since the last Reset(), true otherwise
+ */
+bool StrBuilder::AddNum(int32_t num)
+{
+    uint8_t numStr[12];
+    uint8_t len;
+
+    //  Format straight into the buffer if the longest number fits in it
+    if ((_len + sizeof(numStr)) <= _cap)
+    {
+        _len += itoa(num, (uint8_t*)(_buf + _len));
+        return !_ovf;
+    }
+
+    len = itoa(num, numStr);
+    return Add((char*)numStr, len);
+}
+
+/**
+ * Empty the string and clear overflow flag
+ */
+void StrBuilder::Reset()
+{
+    _len = 0;
+    _ovf = false;
+    _buf[0] = '\0';
+}
+
+/**
+ * Get assembled string
+ * @return pointer to null-terminated string in the buffer
+ */
+const char* StrBuilder::Str()
+{
+    return _buf;
+}
+
+/**
+ * Get length of assembled string
+ * @return number of characters in the string (excluding \0)
+ */
+uint16_t StrBuilder::Len()
+{
+    return _len;
+}
+
+/**
+ * Check if some text didn't fit in the buffer since the last Reset()
+ * @return true if string in the buffer got cut, false otherwise
+ */
+bool StrBuilder::Overflow()
+{
+    return _ovf;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                 [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Start building string in a buffer, buffer is emptied
+ * @param buf buffer to assemble string in
+ * @param cap size of the buffer in bytes (including space for \0), must be >0
+ */
+StrBuilder::StrBuilder(char *buf, uint16_t cap) : _buf(buf), _cap(cap)
+{
+    Reset();
+}
+
+StrBuilder::~StrBuilder()
+{}
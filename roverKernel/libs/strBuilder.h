@@ -0,0 +1,56 @@
+/**
+ * strBuilder.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Fixed-capacity string builder used to assemble text (e.g. AT commands) in a
+ *  caller-provided buffer. Builder keeps track of current length so appending
+ *  doesn't rescan the string from its beginning like strcat does, and never
+ *  writes past the end of the buffer. String is always null-terminated; once
+ *  some text didn't fit in the buffer builder is marked as overflowed and the
+ *  string is kept cut at the last character that fit.
+ *
+ *  @version 1.0.0
+ *  V1.0.0
+ *  +Appending strings, characters and integer numbers (formatted without
+ *  floating point math) with bounds checking
+ */
+#ifndef ROVERKERNEL_LIBS_STRBUILDER_H_
+#define ROVERKERNEL_LIBS_STRBUILDER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * StrBuilder class definition
+ * Object is meant to be created on stack around a static buffer, it only holds
+ * pointer to the buffer and doesn't own it.
+ */
+class StrBuilder
+{
+    public:
+        StrBuilder(char *buf, uint16_t cap);
+        ~StrBuilder();
+
+        bool        Add(const char *str);
+        bool        Add(const char *str, uint16_t len);
+        bool        Add(char c);
+        bool        AddNum(int32_t num);
+        void        Reset();
+
+        const char* Str();
+        uint16_t    Len();
+        bool        Overflow();
+
+    private:
+        //  Buffer holding the string and its size (including \0)
+        char        *_buf;
+        uint16_t    _cap;
+        //  Length of string currently in the buffer (excluding \0)
+        uint16_t    _len;
+        //  Turns true once something couldn't be appended in full
+        bool        _ovf;
+};
+
+#endif /* ROVERKERNEL_LIBS_STRBUILDER_H_ */
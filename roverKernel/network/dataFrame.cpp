@@ -0,0 +1,351 @@
+/**
+ * dataFrame.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "dataFrame.h"
+#include "libs/myLib.h"
+
+#include <string.h>
+
+//  Decoding states, byte expected next
+#define DATAF_ST_SYNC       0   //  Sync byte
+#define DATAF_ST_LEN        1   //  Byte of payload length
+#define DATAF_ST_TYPE       2   //  Type of payload
+#define DATAF_ST_SEQ        3   //  Sequence number
+#define DATAF_ST_DATA       4   //  Byte of payload
+#define DATAF_ST_CRC        5   //  Byte of CRC
+#define DATAF_ST_READY      6   //  None, frame is complete
+
+///-----------------------------------------------------------------------------
+///                      Encoding                                       [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Encode payload into a frame
+ * @param out[out] buffer to write frame into
+ * @param outCap size of [out] buffer, frame takes DATAF_HDR_LEN(len) + len +
+ * DATAF_CRC_LEN bytes
+ * @param type type of payload
+ * @param seq sequence number of frame
+ * @param payload payload to send (can be 0 if [len] is 0)
+ * @param len length of payload
+ * @return length of the frame written into [out], 0 if it doesn't fit in
+ */
+uint16_t DataFrame::Encode(uint8_t *out, uint16_t outCap, uint8_t type,
+                           uint8_t seq, const uint8_t *payload, uint16_t len)
+{
+    uint32_t total = (uint32_t)DATAF_HDR_LEN(len) + len + DATAF_CRC_LEN;
+    uint16_t pos;
+
+    if (total > outCap)
+        return 0;
+
+    pos = Header(out, type, seq, len);
+    if (len > 0)
+        memcpy((void*)(out + pos), (void*)payload, len);
+    Trailer(out + pos + len, out, payload, len);
+
+    return (uint16_t)total;
+}
+
+/**
+ * Encode frame header, for payload sent separately from it
+ * @param hdr[out] buffer to write header into (DATAF_HDR_LEN(len) bytes)
+ * @param type type of payload
+ * @param seq sequence number of frame
+ * @param len length of payload
+ * @return length of header
+ */
+uint8_t DataFrame::Header(uint8_t *hdr, uint8_t type, uint8_t seq, uint16_t len)
+{
+    uint8_t pos = 0;
+
+    hdr[pos++] = DATAF_SYNC;
+    //  Length, 7 bits at a time (least significant first)
+    do
+    {
+        hdr[pos] = len & 0x7F;
+        len >>= 7;
+        if (len > 0)
+            hdr[pos] |= 0x80;
+        pos++;
+    } while (len > 0);
+    hdr[pos++] = type;
+    hdr[pos++] = seq;
+
+    return pos;
+}
+
+/**
+ * Encode frame trailer (CRC-16), for payload sent separately from header
+ * @param crc[out] buffer to write trailer into (DATAF_CRC_LEN bytes)
+ * @param hdr header of the frame as returned by Header()
+ * @param payload payload of the frame
+ * @param len length of payload
+ */
+void DataFrame::Trailer(uint8_t *crc, const uint8_t *hdr, const uint8_t *payload,
+                        uint16_t len)
+{
+    uint16_t val;
+
+    //  Sync byte is not covered by CRC
+    val = crc16(hdr + 1, DATAF_HDR_LEN(len) - 1, 0xFFFF);
+    val = crc16(payload, len, val);
+    crc[0] = (val >> 8) & 0xFF;
+    crc[1] = val & 0xFF;
+}
+
+///-----------------------------------------------------------------------------
+///                      Decoding                                       [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Feed received data into decoder. Function returns as soon as a frame is
+ * complete (check Ready()), or once all data is taken. Data following the
+ * complete frame is fed by calling the function again:
+ *      while (1) {
+ *          n = dec.Feed(data, len); data += n; len -= n;
+ *          if (!dec.Ready()) break;
+ *          ...use dec.Frame()...
+ *      }
+ * Frame returned by Frame() stays valid until the next call to Feed()
+ * @param data received data
+ * @param len length of received data
+ * @return number of bytes of [data] taken by decoder
+ */
+uint16_t DataFrame::Feed(const uint8_t *data, uint16_t len)
+{
+    uint16_t i = 0;
+    uint8_t c;
+
+    //  Previous frame was handed over, start with the next one
+    if (_state == DATAF_ST_READY)
+    {
+        _state = DATAF_ST_SYNC;
+        _pos = 0;
+    }
+
+    while (1)
+    {
+        //  Bytes of a dropped frame are decoded again before any new data
+        if (_rd < _rdEnd)
+            c = _buf[_rd++];
+        else if (i < len)
+            c = data[i++];
+        else
+            break;
+
+        if (_Byte(c))
+            break;
+    }
+
+    return i;
+}
+
+/**
+ * Check whether a complete frame is waiting to be taken through Frame()
+ * @return true if frame is complete, false otherwise
+ */
+bool DataFrame::Ready()
+{
+    return (_state == DATAF_ST_READY);
+}
+
+/**
+ * Get the frame completed by the last call to Feed()
+ * @return decoded frame, payload of length 0 if no frame is complete
+ */
+struct _dataFrame DataFrame::Frame()
+{
+    struct _dataFrame frm;
+
+    memset((void*)&frm, 0, sizeof(frm));
+    if (_state != DATAF_ST_READY)
+        return frm;
+
+    frm.type = _buf[_hdr - 2];
+    frm.seq = _buf[_hdr - 1];
+    frm.data = _buf + _hdr;
+    frm.len = _len;
+
+    return frm;
+}
+
+/**
+ * Drop frame being decoded, including data waiting to be decoded again
+ * (counters are kept)
+ */
+void DataFrame::Reset()
+{
+    _state = DATAF_ST_SYNC;
+    _pos = 0;
+    _rd = _rdEnd = 0;
+}
+
+/**
+ * Get length of the longest payload decoder can receive
+ * @return max length of payload in bytes
+ */
+uint16_t DataFrame::MaxPayload()
+{
+    uint16_t len;
+
+    //  Shortest header (without sync byte) and CRC
+    if (_cap < (DATAF_HDR_LEN(0) - 1 + DATAF_CRC_LEN))
+        return 0;
+
+    len = _cap - (DATAF_HDR_LEN(0) - 1 + DATAF_CRC_LEN);
+    //  Longer payloads take more bytes to encode their length
+    while ((DATAF_HDR_LEN(len) - 1 + len + DATAF_CRC_LEN) > _cap)
+        len--;
+
+    return len;
+}
+
+/**
+ * Get decoder counters
+ * @return copy of decoder counters
+ */
+struct _dataFrameStats DataFrame::Stats()
+{
+    return _stats;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions             [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Take a single byte into the frame being decoded
+ * @param c received byte
+ * @return true if the byte completed a valid frame, false otherwise
+ */
+bool DataFrame::_Byte(uint8_t c)
+{
+    uint32_t val;
+    uint16_t crc;
+
+    if (_state == DATAF_ST_SYNC)
+    {
+        if (c == DATAF_SYNC)
+        {
+            _state = DATAF_ST_LEN;
+            _pos = 0;
+            _len = 0;
+            _lenShift = 0;
+        }
+        else
+            _stats.skipped++;
+        return false;
+    }
+
+    //  Everything following sync byte is kept, in case frame turns out to be
+    //  corrupted and has to be decoded again from the next sync byte
+    if (_pos >= _cap)
+    {
+        _stats.lenErrors++;
+        _Resync();
+        return false;
+    }
+    _buf[_pos++] = c;
+
+    switch (_state)
+    {
+    case DATAF_ST_LEN:
+        val = _len | ((uint32_t)(c & 0x7F) << _lenShift);
+        _len = (uint16_t)val;
+        _lenShift += 7;
+        if (val > 0xFFFF)
+        {
+            _stats.lenErrors++;
+            _Resync();
+        }
+        else if ((c & 0x80) == 0)
+        {
+            _hdr = _pos + 2;
+            //  Frame has to fit in the buffer, without sync byte
+            if (((uint32_t)_hdr + _len + DATAF_CRC_LEN) > _cap)
+            {
+                _stats.lenErrors++;
+                _Resync();
+            }
+            else
+                _state = DATAF_ST_TYPE;
+        }
+        else if (_pos >= DATAF_LEN_MAX)
+        {
+            _stats.lenErrors++;
+            _Resync();
+        }
+        break;
+    case DATAF_ST_TYPE:
+        _state = DATAF_ST_SEQ;
+        break;
+    case DATAF_ST_SEQ:
+        _state = (_len > 0) ? DATAF_ST_DATA : DATAF_ST_CRC;
+        break;
+    case DATAF_ST_DATA:
+        if (_pos == (_hdr + _len))
+            _state = DATAF_ST_CRC;
+        break;
+    case DATAF_ST_CRC:
+        if (_pos < (_hdr + _len + DATAF_CRC_LEN))
+            break;
+        crc = crc16(_buf, _hdr + _len, 0xFFFF);
+        if ((_buf[_pos - 2] == ((crc >> 8) & 0xFF)) &&
+            (_buf[_pos - 1] == (crc & 0xFF)))
+        {
+            _state = DATAF_ST_READY;
+            _stats.frames++;
+            return true;
+        }
+        _stats.crcErrors++;
+        _Resync();
+        break;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+/**
+ * Drop frame being decoded and queue its bytes (following its sync byte) to
+ * be decoded again, ahead of bytes still waiting to be decoded again. Sync
+ * byte of dropped frame was false or frame got cut by a lost byte, valid frame
+ * can start anywhere after it.
+ */
+void DataFrame::_Resync()
+{
+    uint16_t left = _rdEnd - _rd;
+
+    //  Bytes waiting to be decoded again always lie behind stored bytes of
+    //  the current frame, join them into a single block
+    if (left > 0)
+        memmove((void*)(_buf + _pos), (void*)(_buf + _rd), left);
+    _rd = 0;
+    _rdEnd = _pos + left;
+    _pos = 0;
+    _state = DATAF_ST_SYNC;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                 [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Create decoder assembling frames in a buffer
+ * @param buf buffer to assemble frames in (decoder doesn't own it)
+ * @param cap size of the buffer in bytes
+ */
+DataFrame::DataFrame(uint8_t *buf, uint16_t cap) : _buf(buf), _cap(cap),
+    _pos(0), _state(DATAF_ST_SYNC), _len(0), _lenShift(0), _hdr(0), _rd(0),
+    _rdEnd(0)
+{
+    memset((void*)&_stats, 0, sizeof(_stats));
+}
+
+DataFrame::~DataFrame()
+{}
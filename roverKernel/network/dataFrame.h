@@ -0,0 +1,119 @@
+/**
+ * dataFrame.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Binary framing of data exchanged through data streams. Every frame carries
+ *  its own length, so payload can hold any byte without escaping and receiver
+ *  doesn't have to scan for delimiters. Frame layout:
+ *      sync(1B)|length(varint, 1-3B)|type(1B)|seq(1B)|payload|CRC-16(2B)
+ *  Length is the length of payload, encoded 7 bits per byte starting with the
+ *  least significant ones (bit 7 set if more bytes follow). CRC-16 (CCITT, see
+ *  crc16() in myLib.h) covers everything between sync byte and CRC itself and
+ *  is sent most significant byte first.
+ *  Decoder is fed with data as it arrives, in chunks of any length, and
+ *  assembles frame in a caller-provided buffer (no dynamic memory). Frame whose
+ *  CRC or length is invalid is dropped and decoder resynchronizes on the next
+ *  sync byte following the start of the dropped frame, so no valid frame
+ *  received after corrupted data is lost. Frame whose length got corrupted is
+ *  only dropped once as many bytes as the length claims have arrived (frames
+ *  received in the meantime are then decoded from decoder's buffer).
+ *
+ *  @version 1.0.0
+ *  V1.0.0
+ *  +Frame encoding, incremental decoding with resynchronization after
+ *  corrupted or truncated frames, decoder statistics
+ */
+#ifndef ROVERKERNEL_NETWORK_DATAFRAME_H_
+#define ROVERKERNEL_NETWORK_DATAFRAME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//  First byte of every frame
+#define DATAF_SYNC          0xA5
+//  Max number of bytes of encoded payload length
+#define DATAF_LEN_MAX       3
+//  Length of frame header (sync, length, type, seq) for payload of given length
+#define DATAF_HDR_LEN(x)    (4 + ((x) >= 128) + ((x) >= 16384))
+//  Length of trailer (CRC-16)
+#define DATAF_CRC_LEN       2
+//  Max number of bytes frame adds to its payload
+#define DATAF_OVERHEAD      (1 + DATAF_LEN_MAX + 2 + DATAF_CRC_LEN)
+
+/**
+ * Frame received by the decoder
+ */
+struct _dataFrame
+{
+    uint8_t         type;   //  Type of payload (defined by user of the stream)
+    uint8_t         seq;    //  Sequence number assigned by sender
+    const uint8_t   *data;  //  Payload (points into decoder's buffer)
+    uint16_t        len;    //  Length of payload
+};
+
+/**
+ * Counters of a frame decoder
+ */
+struct _dataFrameStats
+{
+    uint32_t    frames;     //  Valid frames decoded
+    uint32_t    crcErrors;  //  Frames dropped because of CRC mismatch
+    uint32_t    lenErrors;  //  Frames dropped because of invalid length
+    uint32_t    skipped;    //  Bytes skipped while looking for sync byte
+};
+
+/**
+ * DataFrame class definition
+ * Incremental frame decoder working in a buffer provided by its owner, buffer
+ * has to hold the longest expected frame without sync byte (payload +
+ * DATAF_OVERHEAD - 1). Encoding is provided through static functions.
+ */
+class DataFrame
+{
+    public:
+        DataFrame(uint8_t *buf, uint16_t cap);
+        ~DataFrame();
+
+        //  Encoding
+        static uint16_t Encode(uint8_t *out, uint16_t outCap, uint8_t type,
+                               uint8_t seq, const uint8_t *payload,
+                               uint16_t len);
+        static uint8_t  Header(uint8_t *hdr, uint8_t type, uint8_t seq,
+                               uint16_t len);
+        static void     Trailer(uint8_t *crc, const uint8_t *hdr,
+                                const uint8_t *payload, uint16_t len);
+
+        //  Decoding
+        uint16_t    Feed(const uint8_t *data, uint16_t len);
+        bool        Ready();
+        struct _dataFrame Frame();
+        void        Reset();
+        uint16_t    MaxPayload();
+        struct _dataFrameStats Stats();
+
+    private:
+        bool        _Byte(uint8_t c);
+        void        _Resync();
+
+        //  Buffer frame is assembled in (without sync byte) and its size
+        uint8_t     *_buf;
+        uint16_t    _cap;
+        //  Number of bytes of current frame stored in the buffer
+        uint16_t    _pos;
+        //  Decoding state (DATAF_ST_*, see dataFrame.cpp)
+        uint8_t     _state;
+        //  Payload length decoded so far and shift of the next length byte
+        uint16_t    _len;
+        uint8_t     _lenShift;
+        //  Length of header stored in the buffer (length, type, seq)
+        uint8_t     _hdr;
+        //  Bytes of a dropped frame left to be decoded again, _buf[_rd.._rdEnd)
+        uint16_t    _rd;
+        uint16_t    _rdEnd;
+        //  Decoder counters
+        struct _dataFrameStats  _stats;
+};
+
+#endif /* ROVERKERNEL_NETWORK_DATAFRAME_H_ */
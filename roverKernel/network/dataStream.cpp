@@ -36,6 +36,23 @@
  */
 static _kernelEntry _dsKer;
 
+/**
+ * Take data stream object whose address is the argument of the task being
+ * executed. Address is stored as a pointer-sized integer (uintptr_t) so it
+ * isn't truncated on targets with 64-bit pointers (host build).
+ * @return pointer to data stream object, 0 if arguments don't hold an address
+ */
+static DataStream* _DATAS_TaskStream()
+{
+    uintptr_t ptr = 0;
+
+    if (_dsKer.argN != sizeof(ptr))
+        return 0;
+    memcpy(&ptr, (void*)_dsKer.args, sizeof(ptr));
+
+    return (DataStream*)ptr;
+}
+
 /**
  * Callback routine to invoke service offered by this module from task scheduler
  * @note It is assumed that once this function is called task scheduler has
@@ -55,25 +72,29 @@ void _DATAS_KernelCallback(void)
     switch (_dsKer.serviceID)
     {
     /*
-     * Keep-alive event, check if the socket is still alive, if not try to reconnect
+     * Keep-alive event, check if the socket is still alive, if not try to
+     * reconnect (once the backoff delay expires)
      * args[] = pointerToDatastreamObject(DataStream*)
-     * retVal ESP library error code (if > 5); or socket ID (if <=5)
      */
     case DATAS_T_KA:
         {
-            //  Pointer is encoded into integer number
-            uint32_t ptr = 0;
-            memcpy(&ptr, (void*)_dsKer.args, 4);
-            DataStream *ds = (DataStream*)ptr;
-
-            _espClient *socket = ESP8266::GetI().GetClientBySockID(ds->socketID);
-
-            /*
-             * If socket has been closed GetClientBySockID returns 0. To reopen
-             * it we just call BindToScoketID as it already handles that
-             */
-            if (socket == 0)
-                ds->BindToSocketID(ds->socketID);
+            DataStream *ds = _DATAS_TaskStream();
+
+            if (ds != 0)
+                ds->_KeepAlive();
+        }
+        break;
+    /*
+     * Windowed mode of a stream, take ACKs and frames received so far and send
+     * again frames not acknowledged in time
+     * args[] = pointerToDatastreamObject(DataStream*)
+     */
+    case DATAS_T_WIN:
+        {
+            DataStream *ds = _DATAS_TaskStream();
+
+            if (ds != 0)
+                ds->_WinPoll();
         }
         break;
     default:
@@ -98,16 +119,37 @@ void DataStream_InitHW()
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor                 [PUBLIC]
 ///-----------------------------------------------------------------------------
-DataStream::DataStream(): socketID(0), _port(0), _socket(0), _keepAlive(false)
+DataStream::DataStream(): socketID(0), _port(0), _socket(0), _sockGen(0),
+                          _keepAlive(false), _kaOpen(false), _kaNextMs(0),
+                          _kaBackoffMs(DATAS_KA_MIN), _kaRxMs(0), _kaSeed(1),
+                          _linger(ESP_TX_LINGER), _prio(ESP_PRIO_DATA),
+                          _rxStream(0), _rxPolicy(ESP_RX_DROP_OLDEST),
+                          _datagram(false), _frameDec(0), _frameOff(0),
+                          _frameSeq(0), _framePend(false), _winTask(false)
 {
     memset((void*)_serverip, 0, sizeof(_serverip));
+    memset((void*)&_win, 0, sizeof(_win));
+    memset((void*)&_kaStats, 0, sizeof(_kaStats));
+    memset((void*)&_frameSlc, 0, sizeof(_frameSlc));
+    _frameSlc.id = ESP_RX_NOSLICE;
 }
 
-DataStream::DataStream(uint8_t *ip, uint16_t port)
-    : socketID(0), _port(port), _socket(0), _keepAlive(false)
+DataStream::DataStream(uint8_t *ip, uint16_t port, bool datagram)
+    : socketID(0), _port(port), _socket(0), _sockGen(0), _keepAlive(false),
+      _kaOpen(false), _kaNextMs(0), _kaBackoffMs(DATAS_KA_MIN), _kaRxMs(0),
+      _linger(ESP_TX_LINGER), _prio(ESP_PRIO_DATA), _rxStream(0),
+      _rxPolicy(ESP_RX_DROP_OLDEST), _datagram(datagram), _frameDec(0),
+      _frameOff(0), _frameSeq(0), _framePend(false), _winTask(false)
 {
     uint8_t i;
 
+    memset((void*)&_win, 0, sizeof(_win));
+    memset((void*)&_kaStats, 0, sizeof(_kaStats));
+    //  Streams reconnecting at the same time spread their attempts differently
+    _kaSeed = ((uint32_t)(uintptr_t)this ^ port) | 1;
+    memset((void*)&_frameSlc, 0, sizeof(_frameSlc));
+    _frameSlc.id = ESP_RX_NOSLICE;
+
     //  Find ip address length
     for (i = 0; ip[i] != 0; i++);
     memcpy((void*)_serverip, (void*)ip, i);
@@ -118,11 +160,16 @@ DataStream::~DataStream()
     if (_keepAlive)
     {
         //  Delete periodic task attempting to reconnect to server
-        uint32_t arg = (uint32_t)this;
-        TaskScheduler::GetP()->RemoveTask(DATAS_UID, DATAS_T_KA, (void*)&arg, sizeof(uint32_t));
+        uintptr_t arg = (uintptr_t)this;
+        TaskScheduler::GetP()->RemoveTask(DATAS_UID, DATAS_T_KA, (void*)&arg,
+                                          sizeof(arg));
     }
-    //  Close the socket before deleting data stream
-    _socket->Close();
+    //  Delete periodic task of windowed mode
+    SetWindow(0, 0, 0);
+    Release(_frameSlc);
+    //  Close the socket before deleting data stream (if it's still open)
+    if (_Socket() != 0)
+        _socket->Close();
 }
 
 ///-----------------------------------------------------------------------------
@@ -146,9 +193,12 @@ uint8_t DataStream::BindToSocketID(uint8_t sockID, bool sched)
 #if defined(__USE_TASK_SCHEDULER__)
     if (!_keepAlive && sched)
     {
-    //  Schedule periodic check for health of the underlying socket, period 4s
-    TaskScheduler::GetI().SyncTaskPer(DATAS_UID, DATAS_T_KA, -4000, 4000, T_PERIODIC);
-    TaskScheduler::GetI().AddArg<uint32_t>((uint32_t)this);
+    //  Schedule periodic check for health of the underlying socket. Argument
+    //  is address of this object so task is left out of snapshot
+    TaskScheduler::GetI().SyncTaskPer(DATAS_UID, DATAS_T_KA, -DATAS_KA_TICK,
+                                      DATAS_KA_TICK, T_PERIODIC);
+    TaskScheduler::GetI().AddArg<uintptr_t>((uintptr_t)this);
+    TaskScheduler::GetI().NoSnapshot();
     _keepAlive = true;
     }
 #endif
@@ -163,85 +213,316 @@ uint8_t DataStream::BindToSocketID(uint8_t sockID, bool sched)
         return 111;
     }
 
-    //  Check if the socket is already opened
-    _socket = ESP8266::GetI().GetClientBySockID(sockID);
+    //  Check if the socket is already opened, if so bind to it (connection
+    //  that's open at the moment)
+    socketID = sockID;
+    _socket = 0;
 
-    if (_socket!= 0)
-        socketID = sockID;
-    else
+    if (_Socket() == 0)
     {   // Attempt to open a socket if IP address exists
         if (_serverip[0] == 0)
         {
             //  Save socket ID for next try and return
-            socketID = sockID;
             return 222;
         }
-        //  Attempt to open the socket and check for error codes (> max clients)
+        //  Queue opening the socket and check for error codes (> max clients),
+        //  socket that's already being opened is waited for like a queued one.
+        //  Socket becomes available once ESP opens it
         uint32_t status;
-        status = ESP8266::GetI().OpenTCPSock((char*)_serverip, _port, 1, sockID);
+        if (_datagram)
+            status = ESP8266::GetI().OpenUDPSockAsync((char*)_serverip, _port, sockID);
+        else
+            status = ESP8266::GetI().OpenTCPSockAsync((char*)_serverip, _port, 1, sockID);
         if (status < ESP_MAX_CLI)
             socketID = status;
+        else if (status == ESP_SOCK_PENDING)
+            socketID = sockID;
         else
         {
             //  Save socket ID for next try and return
-            socketID = sockID;
             return 127;
         }
-
-        //  Get reference to opened socket
-        _socket = ESP8266::GetI().GetClientBySockID(sockID);
+        //  Stream binds to the socket once ESP opens it (see _Socket())
     }
     //  As a confirmation return socket id
     return socketID;
 }
 
+/**
+ * Enter or leave passthrough mode of ESP module with this stream bound to its
+ * only socket. In passthrough mode data sent through the stream goes to the
+ * server without waiting for ESP to take each send, but no other socket can be
+ * used. Once passthrough mode is left stream rebinds to its socket ID as a
+ * regular socket (other streams reopen their sockets on their own).
+ * @param enable true to enter passthrough mode, false to leave it
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t DataStream::Passthrough(bool enable)
+{
+    ESP8266 &esp = ESP8266::GetI();
+
+    if (enable)
+    {
+        if (esp.StartPassthrough((char*)_serverip, _port, _datagram) != ESP_PT_SOCK)
+            return STATUS_PROG_ERR;
+        socketID = ESP_PT_SOCK;
+        _socket = 0;
+        _Socket();
+    }
+    else
+    {
+        if (!esp.Passthrough() || (socketID != ESP_PT_SOCK))
+            return STATUS_PROG_ERR;
+        esp.StopPassthrough();
+        if (BindToSocketID(socketID) >= ESP_MAX_CLI)
+            return STATUS_PROG_ERR;
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Get handle of the socket this stream is bound to. Handle is kept as long as
+ * the connection it was taken from stays open. If it got closed (even if socket
+ * with the same ID was opened since) handle is stale and is taken again from
+ * the socket currently open under stream's socket ID.
+ * @return handle of the socket, 0 if there's no open socket with stream's ID
+ */
+_espClient* DataStream::_Socket()
+{
+    if ((_socket == 0) || !_socket->Valid(_sockGen))
+    {
+        _socket = ESP8266::GetI().GetClientBySockID(socketID);
+        if (_socket != 0)
+        {
+            _sockGen = _socket->Generation();
+            //  Connection is checked again in the shortest period, but backoff
+            //  isn't reset until data is received through it
+            _kaStats.connects++;
+            _kaNextMs = msSinceStartup + DATAS_KA_MIN;
+            //  Newly opened socket hands data over in slices by default
+            if (_rxStream != 0)
+                _socket->SetRxStream(_rxStream);
+            _socket->RxPolicy = _rxPolicy;
+            //  Frame cut by the old connection won't be completed
+            if (_frameDec != 0)
+                _frameDec->Reset();
+            _framePend = false;
+            //  Peer starts counting frames of new connection from 0
+            if (_win.window > 0)
+                _WinRestart();
+        }
+    }
+
+    return _socket;
+}
+
 /**
  * Send either a null terminated string with no buffer len, or any string of a
- * certain length through the stream. Function checks whether the bounded socket
- * is still alive, if not tries to reopen it.
+ * certain length through the stream. Data is sent only if the bound socket is
+ * open, reopening closed socket is left to keep-alive task (see _KeepAlive())
  * @note Wrapper for low-level espClient:: function
+ * @note In datagram mode data is dropped if it can't be queued for sending
  * @param buffer
  * @param bufferLen
- * @param reopen set if true function also tries to reopen socket if it's closed
  * @return error-code, one of STATUS_* macros from myLib.h
  */
-uint32_t DataStream::Send(uint8_t *buffer, uint16_t bufferLen, bool reopen)
+uint32_t DataStream::Send(uint8_t *buffer, uint16_t bufferLen)
+{
+    uint32_t retVal = ESP_STATUS_ERROR;
+
+    //  Check if the socket is still opened, queue data for sending (send it
+    //  right away if command queue is full, unless it's a datagram)
+    if (_Socket() != 0)
+    {
+        _socket->Priority = _prio;
+        retVal = _socket->SendTCPAsync((char*)buffer, bufferLen);
+        if ((retVal == ESP_STATUS_BUSY) && !_datagram)
+            retVal = _socket->SendTCP((char*)buffer, bufferLen);
+    }
+
+    //  Convert ESP library error code to a common error codes from myLib.h
+    if ((retVal & (ESP_STATUS_OK | ESP_NONBLOCKING_MODE)) > 0)
+        return STATUS_OK;
+    else
+        return STATUS_PROG_ERR;
+}
+
+/**
+ * Send data held in a pooled buffer through the stream without copying it
+ * @note Caller keeps its reference to the buffer, slice is not released here
+ * @note In datagram mode data is dropped if it can't be queued for sending
+ * @param slc slice of pooled buffer holding data to send
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t DataStream::Send(const struct _bufSlice &slc)
 {
     uint32_t retVal = ESP_STATUS_ERROR;
 
+    //  Check if the socket is still opened, queue data for sending (send it
+    //  right away if command queue is full, unless it's a datagram)
+    if (_Socket() != 0)
+    {
+        _socket->Priority = _prio;
+        retVal = _socket->SendTCPAsync(slc);
+        if ((retVal == ESP_STATUS_BUSY) && !_datagram)
+            retVal = _socket->SendTCP(slc);
+    }
+
+    //  Convert ESP library error code to a common error codes from myLib.h
+    if ((retVal & (ESP_STATUS_OK | ESP_NONBLOCKING_MODE)) > 0)
+        return STATUS_OK;
+    else
+        return STATUS_PROG_ERR;
+}
+
+/**
+ * Send data of any length through the stream, in segments sent straight from
+ * caller's memory (see _espClient::SendLarge())
+ * @note Blocking function, returns once all data is delivered or sending fails
+ * @param data data to send
+ * @param len length of data in bytes
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t DataStream::SendLarge(const uint8_t *data, uint32_t len)
+{
+    uint32_t retVal = ESP_STATUS_ERROR;
 
-    _socket = ESP8266::GetI().GetClientBySockID(socketID);
-
-    //  Check if the socket is still opened
-    if (_socket != 0)
-        retVal = _socket->SendTCP((char*)buffer, bufferLen);
-    //  If it isn't try to reopen it; if succeeded, send data
-//    else
-//    {
-//        if (!reopen) return ESP_STATUS_ERROR;
-//        //  Try to rebind socket
-//        retVal = BindToSocketID(socketID);
-//#ifdef __DEBUG_SESSION__
-//        DEBUG_WRITE("Rebinding returns %d \n", retVal);
-//#endif /* __DEBUG_SESSION__ */
-//        //  If succeeded, send data
-//        if (retVal < ESP_MAX_CLI)
-//            retVal = _socket->SendTCP((char*)buffer, bufferLen);
-//        //  If ESP is not connected to AP still return OK error message
-//        else if (retVal == 111)
-//            retVal = ESP_STATUS_OK;
-//        //  Any other return value points to error in process of sending/binding
-//        else
-//            retVal = ESP_STATUS_ERROR;
-//    }
+    if (_Socket() != 0)
+    {
+        _socket->Priority = _prio;
+        retVal = _socket->SendLarge(data, len);
+    }
 
     //  Convert ESP library error code to a common error codes from myLib.h
-    if ((retVal & ESP_STATUS_OK) > 0)
+    if (((retVal & ESP_STATUS_OK) > 0) && ((retVal & ESP_STATUS_ERROR) == 0))
         return STATUS_OK;
     else
         return STATUS_PROG_ERR;
 }
 
+/**
+ * Write a frame into the stream without sending it right away. Frames written
+ * within linger time (see SetLinger()) are sent together in a single send,
+ * saving a round-trip to ESP for every frame. Call Flush() to send them sooner.
+ * @note Wrapper for low-level espClient:: function
+ * @param buffer data to write
+ * @param bufferLen[optional] len of the buffer, if not provided function looks
+ * for first occurrence of \0 in buffer and takes that as length
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t DataStream::Write(uint8_t *buffer, uint16_t bufferLen)
+{
+    uint32_t retVal = ESP_STATUS_ERROR;
+
+    if (bufferLen == 0)
+        bufferLen = strlen((char*)buffer);
+
+
+    if (_Socket() != 0)
+    {
+        _socket->Linger = _linger;
+        _socket->Priority = _prio;
+        retVal = _socket->Write(buffer, bufferLen);
+        //  No buffer to write into, send frame on its own (after data written
+        //  before it)
+        if (retVal == ESP_STATUS_BUSY)
+        {
+            _socket->Flush();
+            return Send(buffer, bufferLen);
+        }
+    }
+
+    //  Convert ESP library error code to a common error codes from myLib.h
+    if ((retVal & (ESP_STATUS_OK | ESP_NONBLOCKING_MODE)) > 0)
+        return STATUS_OK;
+    else
+        return STATUS_PROG_ERR;
+}
+
+/**
+ * Send all frames written into the stream that haven't been sent yet
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t DataStream::Flush()
+{
+    uint32_t retVal = ESP_STATUS_ERROR;
+
+    if (_Socket() != 0)
+    {
+        _socket->Priority = _prio;
+        retVal = _socket->Flush();
+    }
+
+    //  Convert ESP library error code to a common error codes from myLib.h
+    if ((retVal & (ESP_STATUS_OK | ESP_NONBLOCKING_MODE)) > 0)
+        return STATUS_OK;
+    else
+        return STATUS_PROG_ERR;
+}
+
+/**
+ * Set time written frames wait to be sent together with frames written after
+ * them
+ * @param ms linger time in ms, 0 to send every frame right away
+ */
+void DataStream::SetLinger(uint16_t ms)
+{
+    _linger = ms;
+}
+
+/**
+ * Set priority class of data sent through the stream. Data of higher priority
+ * is sent ahead of lower priority data waiting in ESP's queue (of any stream),
+ * once the send in progress completes.
+ * @param prio priority class, one of ESP_PRIO_* macros
+ */
+void DataStream::SetPriority(uint8_t prio)
+{
+    _prio = prio;
+}
+
+/**
+ * Stream data received through the stream to a hook as it arrives, instead of
+ * handing it over through Receive(). Setting is kept when socket is reopened.
+ * @note See _espClient::SetRxStream() for arguments passed to the hook
+ * @param hook routine to stream data to, 0 to receive data through Receive()
+ */
+void DataStream::SetRxStream(void((*hook)(const uint8_t, const uint8_t*,
+                                          const uint16_t, const uint16_t)))
+{
+    _rxStream = hook;
+    if (_Socket() != 0)
+        _socket->SetRxStream(hook);
+}
+
+/**
+ * Set which message is dropped once messages received through the stream fill
+ * socket's queue (ESP_RX_QUEUE messages not yet taken by Receive()). Setting
+ * is kept when socket is reopened.
+ * @param policy ESP_RX_DROP_OLDEST to keep the latest messages (default),
+ * ESP_RX_DROP_NEWEST to keep the earliest ones
+ */
+void DataStream::SetRxPolicy(uint8_t policy)
+{
+    _rxPolicy = policy;
+    if (_Socket() != 0)
+        _socket->RxPolicy = policy;
+}
+
+/**
+ * Get number of messages dropped because they were received while socket's
+ * queue was full
+ * @return number of dropped messages (0 if socket isn't open)
+ */
+uint32_t DataStream::RxDropped()
+{
+    if (_Socket() == 0)
+        return 0;
+
+    return _socket->RxDropped();
+}
+
 /**
  * Receive data from the stream (if there's any)
  * @note Wrapper for low-level espClient:: function
@@ -253,21 +534,580 @@ bool DataStream::Receive(uint8_t *buffer, uint16_t *bufferLen)
 {
     //  Check if the socket is still opened, if it isn't there's no use in
     //  reopening it as there will be no new data to read; so just return
-    _socket = ESP8266::GetI().GetClientBySockID(socketID);
-    if (_socket!= 0)
+    if (_Socket() == 0)
+        return false;
+
+    //  Fetch response (if there's any) and save it into a buffer
+    if (!_socket->Receive((char*)buffer, bufferLen))
+        return false;
+    _Received();
+
+    return true;
+}
+
+/**
+ * Receive data from the stream (if there's any) without copying it
+ * @note Received data has to be released by calling Release() once done
+ * @param slc[out] slice pointing to received data
+ * @return true: if new data is available through [slc], false otherwise
+ */
+bool DataStream::Receive(struct _espRxSlice &slc)
+{
+    if (_Socket() == 0)
+        return false;
+
+    if (!_socket->Receive(slc))
         return false;
+    _Received();
 
-    //  Check if there's response ready
-    if (_socket->Ready())
+    return true;
+}
+
+/**
+ * Release data obtained through Receive(), once done with it
+ * @param slc[in/out] slice of received data, invalidated on exit
+ */
+void DataStream::Release(struct _espRxSlice &slc)
+{
+    ESP8266::GetI().Release(slc);
+}
+
+/**
+ * Decode data received through the stream into frames (see dataFrame.h). Once
+ * set, received data has to be taken through ReceiveFrame() only.
+ * @param dec decoder to assemble frames in, 0 to stop decoding frames
+ */
+void DataStream::SetFraming(DataFrame *dec)
+{
+    Release(_frameSlc);
+    _frameOff = 0;
+    _framePend = false;
+    _frameDec = dec;
+    if (_frameDec != 0)
+        _frameDec->Reset();
+}
+
+/**
+ * Send payload through the stream as a single frame (see dataFrame.h), with
+ * the next sequence number of the stream. Frame is assembled in a pooled
+ * buffer and queued for sending. If it doesn't fit in one, or there's no free
+ * pooled buffer, frame is sent in pieces straight from caller's memory
+ * (blocking, not in datagram mode as frame has to be a single datagram).
+ * In windowed mode (see SetWindow()) frame is kept until peer acknowledges it
+ * and function doesn't block, frame has to fit into a slot of the window.
+ * @param type type of payload (defined by user of the stream)
+ * @param payload data to send (any bytes, can be 0 if [len] is 0)
+ * @param len length of payload
+ * @return error-code, one of STATUS_* macros from myLib.h (in windowed mode
+ * STATUS_PROG_ERR if window is full, see InFlight())
+ */
+uint32_t DataStream::SendFrame(uint8_t type, const uint8_t *payload,
+                               uint16_t len)
+{
+    uint32_t retVal = ESP_STATUS_ERROR;
+    struct _bufSlice slc;
+    uint8_t hdr[DATAF_HDR_LEN(0xFFFF)];
+    uint8_t crc[DATAF_CRC_LEN];
+    uint16_t n = 0;
+
+    if (_win.window > 0)
+        return _WinSend(type, payload, len);
+
+    if (_Socket() == 0)
+        return STATUS_PROG_ERR;
+    _socket->Priority = _prio;
+
+    if (BufferPool::GetI().Acquire(slc))
     {
-        //  Fetch response and save it into a buffer
-        memcpy((void*)buffer, (void*)(_socket->RespBody), _socket->RespLen);
-        (*bufferLen) = _socket->RespLen;
-        _socket->Done();
-        return true;
+        n = DataFrame::Encode(BufferPool::GetI().Data(slc),
+                              BufferPool::GetI().Capacity(slc), type,
+                              _frameSeq, payload, len);
+        if (n > 0)
+        {
+            slc.len = n;
+            retVal = _socket->SendTCPAsync(slc);
+            if ((retVal == ESP_STATUS_BUSY) && !_datagram)
+                retVal = _socket->SendTCP(slc);
+        }
+        BufferPool::GetI().Release(slc);
+    }
+
+    if ((n == 0) && !_datagram)
+    {
+        n = DataFrame::Header(hdr, type, _frameSeq, len);
+        DataFrame::Trailer(crc, hdr, payload, len);
+        retVal = _socket->SendTCP((char*)hdr, n);
+        if (((retVal & ESP_STATUS_OK) > 0) && (len > 0))
+            retVal = _socket->SendLarge(payload, len);
+        if (((retVal & ESP_STATUS_OK) > 0) && ((retVal & ESP_STATUS_ERROR) == 0))
+            retVal = _socket->SendTCP((char*)crc, DATAF_CRC_LEN);
+        //  Frame cut in the middle is dropped by receiver (CRC mismatch)
+        if ((retVal & ESP_STATUS_ERROR) > 0)
+            retVal = ESP_STATUS_ERROR;
+    }
+
+    //  Convert ESP library error code to a common error codes from myLib.h
+    if ((retVal & (ESP_STATUS_OK | ESP_NONBLOCKING_MODE)) > 0)
+    {
+        _frameSeq++;
+        return STATUS_OK;
     }
     else
+        return STATUS_PROG_ERR;
+}
+
+/**
+ * Take the next complete frame received through the stream, set up with
+ * SetFraming(). Data is fed into decoder as it's received, corrupted frames are
+ * dropped (see DataFrame::Stats()). In windowed mode frames are handed over
+ * in order and only once, and they are acknowledged to the peer once there are
+ * no more frames to hand over.
+ * @note Frame returned is valid until the next call to ReceiveFrame()
+ * @param frm[out] received frame, payload points into decoder's buffer
+ * @return true if a frame was received, false if there is none (yet)
+ */
+bool DataStream::ReceiveFrame(struct _dataFrame &frm)
+{
+    if (_frameDec == 0)
+        return false;
+
+    //  Frame already taken from decoder by windowed mode
+    if (_framePend)
+    {
+        _framePend = false;
+        frm = _frameDec->Frame();
+        return true;
+    }
+
+    while (_NextFrame(frm))
+        if ((_win.window == 0) || _WinAccept(frm))
+            return true;
+
+    _WinAck();
+    return false;
+}
+
+/**
+ * Use windowed reliable delivery of frames sent and received through the
+ * stream, set up with SetFraming(). Up to [window] frames sent by SendFrame()
+ * are in flight at once, every frame is kept in a slot of [ring] until peer
+ * acknowledges it. Peer acknowledges frames with a DATAS_ACK frame carrying
+ * sequence number of the next frame it expects (all frames before it are
+ * received). If the oldest frame isn't acknowledged within [rtoMs], it and all
+ * frames following it are sent again (go-back-N), sooner if peer repeats the
+ * same ACK DATAS_WIN_DUPACK times (it received frames after a lost one).
+ * Frames received are handed over by ReceiveFrame() in order, and acknowledged
+ * the same way. Both sides count frames from 0 on every new connection, frames
+ * in flight are numbered again and sent once stream is bound to a new
+ * connection.
+ * @note ACKs are also taken (and retransmission done) by a periodic task, so
+ * streams that only send don't have to call ReceiveFrame()
+ * @param ring memory for slots of the window (stream doesn't own it), frame
+ * sent can take up to [ringLen]/[window] bytes (payload + DATAF_OVERHEAD)
+ * @param ringLen size of [ring] in bytes
+ * @param window max number of frames in flight (up to DATAS_WIN_MAX), 0 to
+ * leave windowed mode (frames in flight are dropped)
+ * @param rtoMs time in ms frame waits to be acknowledged before it's sent again
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t DataStream::SetWindow(uint8_t *ring, uint16_t ringLen, uint8_t window,
+                               uint16_t rtoMs)
+{
+    struct _dataWinStats stats = _win.stats;
+
+    if (window > DATAS_WIN_MAX)
+        return STATUS_ARG_ERR;
+    if ((window > 0) && ((ring == 0) || ((ringLen / window) <
+                         (DATAF_HDR_LEN(0) + DATAF_CRC_LEN))))
+        return STATUS_ARG_ERR;
+    //  ACKs can't be received without decoder
+    if ((window > 0) && (_frameDec == 0))
+        return STATUS_PROG_ERR;
+
+    //  Counters are kept
+    memset((void*)&_win, 0, sizeof(_win));
+    _win.stats = stats;
+    _win.ring = ring;
+    _win.slotLen = (window > 0) ? (ringLen / window) : 0;
+    _win.window = window;
+    _win.rtoMs = rtoMs;
+
+#if defined(__USE_TASK_SCHEDULER__)
+    uintptr_t arg = (uintptr_t)this;
+
+    if ((window > 0) && !_winTask)
+    {
+        //  Argument is address of this object, leave task out of snapshot
+        TaskScheduler::GetI().SyncTaskPer(DATAS_UID, DATAS_T_WIN,
+                                          -DATAS_WIN_PERIOD,
+                                          DATAS_WIN_PERIOD, T_PERIODIC);
+        TaskScheduler::GetI().AddArg<uintptr_t>(arg);
+        TaskScheduler::GetI().NoSnapshot();
+        _winTask = true;
+    }
+    else if ((window == 0) && _winTask)
+    {
+        TaskScheduler::GetP()->RemoveTask(DATAS_UID, DATAS_T_WIN, (void*)&arg,
+                                          sizeof(arg));
+        _winTask = false;
+    }
+#endif
+
+    return STATUS_OK;
+}
+
+/**
+ * Get number of frames sent in windowed mode and not yet acknowledged by peer
+ * @return number of frames in flight
+ */
+uint8_t DataStream::InFlight()
+{
+    return _win.n;
+}
+
+/**
+ * Get counters of windowed mode
+ * @return copy of counters
+ */
+struct _dataWinStats DataStream::WindowStats()
+{
+    return _win.stats;
+}
+
+/**
+ * Get counters of keep-alive (attempts to reopen socket of the stream)
+ * @return copy of counters
+ */
+struct _dataKAStats DataStream::KeepAliveStats()
+{
+    _kaStats.backoffMs = _kaBackoffMs;
+
+    return _kaStats;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions             [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Keep-alive check, called periodically by task scheduler. Check is skipped
+ * while data keeps being received. If socket got closed it's reopened, but
+ * every attempt that doesn't bring data back doubles the delay before the next
+ * one (up to DATAS_KA_MAX, with random jitter so streams don't retry all at
+ * once), not to waste time on a server that is down. While ESP is opening the
+ * socket nothing is done, delay is counted from the moment opening completes
+ * or fails (as seen by the next check, DATAS_KA_TICK apart).
+ */
+void DataStream::_KeepAlive()
+{
+    uint64_t now = msSinceStartup;
+
+    if (now < _kaNextMs)
+        return;
+
+    //  Socket is being opened (by this or any other call), wait for outcome
+    if (ESP8266::GetI().SockPending(socketID))
+        return;
+
+    //  Data received recently, connection is alive
+    if ((_kaRxMs > 0) && ((now - _kaRxMs) < DATAS_KA_MIN))
+    {
+        _kaStats.skipped++;
+        _kaOpen = false;
+        _kaNextMs = _kaRxMs + DATAS_KA_MIN;
+        return;
+    }
+
+    /*
+     * If socket has been closed _Socket() returns 0. To reopen it we
+     * just call BindToScoketID as it already handles that
+     */
+    if (_Socket() != 0)
+    {
+        //  Attempt succeeded, but backoff isn't reset until data is received
+        if (_kaOpen)
+            _KABackoff(0);
+        _kaOpen = false;
+        _kaNextMs = now + DATAS_KA_MIN;
+        return;
+    }
+
+    //  Socket queued by the last attempt failed to open (or got closed already)
+    if (_kaOpen)
+    {
+        _kaOpen = false;
+        _kaStats.failures++;
+        _KABackoff(now);
+        return;
+    }
+
+    _kaStats.attempts++;
+    if (BindToSocketID(socketID) < ESP_MAX_CLI)
+    {
+        //  Opening got queued, outcome is known once ESP replies
+        _kaOpen = true;
+        return;
+    }
+    _kaStats.failures++;
+    _KABackoff(now);
+}
+
+/**
+ * Schedule the next attempt to reopen socket and double the delay after it
+ * @param now time in ms the delay is counted from, 0 to only double the delay
+ */
+void DataStream::_KABackoff(uint64_t now)
+{
+    uint32_t delay;
+
+    if (now > 0)
+    {
+        //  Random delay within +-DATAS_KA_JITTER percent (xorshift generator)
+        _kaSeed ^= _kaSeed << 13;
+        _kaSeed ^= _kaSeed >> 17;
+        _kaSeed ^= _kaSeed << 5;
+        delay = _kaBackoffMs - (_kaBackoffMs * DATAS_KA_JITTER) / 100;
+        delay += _kaSeed % ((_kaBackoffMs * 2 * DATAS_KA_JITTER) / 100 + 1);
+        _kaNextMs = now + delay;
+    }
+
+    //  Delay keeps doubling until data is received over reopened connection
+    _kaBackoffMs *= 2;
+    if (_kaBackoffMs > DATAS_KA_MAX)
+        _kaBackoffMs = DATAS_KA_MAX;
+}
+
+/**
+ * Note that data was received through the stream: connection works, so
+ * keep-alive doesn't have to check it and, once it's lost, reopening it starts
+ * again with the shortest delay
+ */
+void DataStream::_Received()
+{
+    _kaRxMs = msSinceStartup;
+    _kaBackoffMs = DATAS_KA_MIN;
+}
+
+/**
+ * Take the next frame decoded from data received through the stream
+ * @param frm[out] decoded frame, payload points into decoder's buffer
+ * @return true if a frame was decoded, false if there is none (yet)
+ */
+bool DataStream::_NextFrame(struct _dataFrame &frm)
+{
+    uint16_t n;
+
+    while (1)
+    {
+        n = _frameDec->Feed(_frameSlc.data + _frameOff,
+                            _frameSlc.len - _frameOff);
+        _frameOff += n;
+        if (_frameDec->Ready())
+        {
+            frm = _frameDec->Frame();
+            return true;
+        }
+
+        //  All data received so far is decoded, continue with the next piece
+        Release(_frameSlc);
+        _frameOff = 0;
+        if (!Receive(_frameSlc))
+            return false;
+    }
+}
+
+/**
+ * Keep a frame in the window and send it, in windowed mode
+ * @param type type of payload (DATAS_ACK is reserved)
+ * @param payload data to send (can be 0 if [len] is 0)
+ * @param len length of payload
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t DataStream::_WinSend(uint8_t type, const uint8_t *payload,
+                              uint16_t len)
+{
+    uint8_t slot;
+    uint16_t n;
+
+    if (type == DATAS_ACK)
+        return STATUS_ARG_ERR;
+
+    //  Frames acknowledged since the last check free their slots
+    if (_win.n >= _win.window)
+        _WinPoll();
+    if (_win.n >= _win.window)
+    {
+        _win.stats.full++;
+        return STATUS_PROG_ERR;
+    }
+
+    slot = (_win.head + _win.n) % _win.window;
+    n = DataFrame::Encode(_win.ring + slot * _win.slotLen, _win.slotLen, type,
+                          _win.base + _win.n, payload, len);
+    if (n == 0)
+        return STATUS_ARG_ERR;
+    _win.len[slot] = n;
+    _win.payload[slot] = len;
+
+    //  Oldest frame in flight starts waiting for ACK
+    if (_win.n == 0)
+        _win.sentMs = msSinceStartup;
+    _win.n++;
+    _win.stats.sent++;
+
+    //  Frame is sent again if it doesn't make it now (or once stream gets
+    //  bound to a new connection)
+    if (_Socket() != 0)
+        _WinTx(_win.ring + slot * _win.slotLen, n);
+
+    return STATUS_OK;
+}
+
+/**
+ * Process a frame received in windowed mode. ACK frees slots of frames it
+ * acknowledges, any other frame is accepted only if it's the next one
+ * expected (it's acknowledged in any case, to let peer know what's missing).
+ * @param frm received frame
+ * @return true if frame is to be handed over to user of the stream
+ */
+bool DataStream::_WinAccept(const struct _dataFrame &frm)
+{
+    uint8_t acked;
+
+    if (frm.type == DATAS_ACK)
+    {
+        //  Frames before the one peer expects next are received, ACK for no
+        //  frame in flight is either stale or duplicate
+        acked = frm.seq - _win.base;
+        //  Peer received a frame following a lost one, repeated ACK makes
+        //  frames in flight time out right away (once per timeout)
+        if ((acked == 0) && (_win.n > 0) && (++_win.dupAcks == DATAS_WIN_DUPACK))
+        {
+            _win.stats.fastRetransmits++;
+            _win.sentMs = msSinceStartup - _win.rtoMs;
+        }
+        if ((acked == 0) || (acked > _win.n))
+            return false;
+        _win.dupAcks = 0;
+        _win.base = frm.seq;
+        _win.head = (_win.head + acked) % _win.window;
+        _win.n -= acked;
+        _win.stats.acked += acked;
+        //  Next frame in flight starts waiting for ACK
+        _win.sentMs = msSinceStartup;
         return false;
+    }
+
+    _win.ackPend = true;
+    if (frm.seq != _win.rxNext)
+    {
+        _win.stats.dropped++;
+        return false;
+    }
+    _win.rxNext++;
+    _win.stats.delivered++;
+
+    return true;
+}
+
+/**
+ * Acknowledge frames received in windowed mode, if there are any not
+ * acknowledged yet
+ */
+void DataStream::_WinAck()
+{
+    uint8_t ack[DATAF_HDR_LEN(0) + DATAF_CRC_LEN];
+
+    if (!_win.ackPend || (_Socket() == 0))
+        return;
+
+    DataFrame::Encode(ack, sizeof(ack), DATAS_ACK, _win.rxNext, 0, 0);
+    _WinTx(ack, sizeof(ack));
+    _win.ackPend = false;
+    _win.stats.acks++;
+}
+
+/**
+ * Periodic work of windowed mode: take ACKs received so far, acknowledge
+ * frames received and send again frames in flight if the oldest one wasn't
+ * acknowledged in time. Received frame that is to be handed over stops taking
+ * of data until it's taken by ReceiveFrame().
+ */
+void DataStream::_WinPoll()
+{
+    struct _dataFrame frm;
+    uint8_t i, slot;
+
+    if ((_win.window == 0) || (_frameDec == 0))
+        return;
+
+    while (!_framePend && _NextFrame(frm))
+        _framePend = _WinAccept(frm);
+    _WinAck();
+
+    if ((_win.n == 0) || ((msSinceStartup - _win.sentMs) < _win.rtoMs) ||
+        (_Socket() == 0))
+        return;
+
+    //  Go back to the oldest frame, frames are written together into as few
+    //  sends as possible
+    _win.stats.timeouts++;
+    _win.dupAcks = 0;
+    _socket->Priority = _prio;
+    for (i = 0; i < _win.n; i++)
+    {
+        slot = (_win.head + i) % _win.window;
+        if (_socket->Write(_win.ring + slot * _win.slotLen, _win.len[slot]) ==
+            ESP_STATUS_BUSY)
+        {
+            _socket->Flush();
+            _WinTx(_win.ring + slot * _win.slotLen, _win.len[slot]);
+        }
+        _win.stats.retransmits++;
+    }
+    _socket->Flush();
+    _win.sentMs = msSinceStartup;
+}
+
+/**
+ * Start windowed mode over a new connection: both sides count frames from 0,
+ * frames in flight are numbered again and sent at the next check
+ */
+void DataStream::_WinRestart()
+{
+    uint8_t i, slot, hdr;
+    uint8_t *frame;
+
+    for (i = 0; i < _win.n; i++)
+    {
+        slot = (_win.head + i) % _win.window;
+        frame = _win.ring + slot * _win.slotLen;
+        hdr = DATAF_HDR_LEN(_win.payload[slot]);
+        frame[hdr - 1] = i;
+        DataFrame::Trailer(frame + hdr + _win.payload[slot], frame, frame + hdr,
+                           _win.payload[slot]);
+    }
+    _win.base = 0;
+    _win.rxNext = 0;
+    _win.ackPend = false;
+    //  Make frames in flight time out right away
+    _win.sentMs = msSinceStartup - _win.rtoMs;
+}
+
+/**
+ * Send a frame (or ACK) of windowed mode through the socket, without failing
+ * the caller if it can't be sent (frame is sent again after timeout)
+ * @param data frame to send
+ * @param len length of frame
+ */
+void DataStream::_WinTx(uint8_t *data, uint16_t len)
+{
+    uint32_t retVal;
+
+    _socket->Priority = _prio;
+    retVal = _socket->SendTCPAsync((char*)data, len);
+    if ((retVal == ESP_STATUS_BUSY) && !_datagram)
+        _socket->SendTCP((char*)data, len);
 }
 
 
@@ -10,7 +10,7 @@
  *  can be integrated with task scheduler to periodically check if the stream is
  *  opened and try to reconnect in case of a failure.
  *
- *  @version 1.3.2
+ *  @version 1.16.3
  *  V1.0 - 17.3.2017
  *  +Created document
  *  +Functionality: Initialize data stream with server IP & port, bind to opened
@@ -36,6 +36,65 @@
  *  V1.3.2 - 2.9.2017
  *  DataStream::Send function now offers user to choose whether to attempt to
  *  rebind closed socket
+ *  V1.4.0
+ *  +Send data held in a pooled buffer (BufferPool) without copying it
+ *  V1.4.1
+ *  +Keep-alive task is not scheduled again if task scheduler restored it from
+ *  snapshot after warm reset
+ *  V1.5.0
+ *  +Receive data without copying it (slice into ESP's Rx ring), copying
+ *  Receive() is now binary-safe
+ *  V1.6.0
+ *  +Sending data and reopening socket don't wait for ESP to reply, data is
+ *  queued in ESP's command queue (Send() reports queued data as sent)
+ *  V1.7.0
+ *  +Small frames can be written to the stream with Write(), they are coalesced
+ *  and sent together in a single send (see _espClient::Write())
+ *  V1.8.0
+ *  +Datagram mode: stream can run over UDP socket, data is sent best-effort
+ *  (dropped instead of waiting when ESP can't take it right away)
+ *  V1.9.0
+ *  +Stream can put ESP into passthrough mode and run over its only socket,
+ *  data is then streamed to the server without AT command for every send
+ *  V1.9.1
+ *  +Socket handle is kept together with its generation and only looked up
+ *  again once the connection it was taken from is closed
+ *  V1.10.0
+ *  +Priority class of stream's data (SetPriority()), data of control streams
+ *  overtakes bulk data queued in ESP before it
+ *  V1.11.0
+ *  +Received data can be streamed to a hook as it arrives (SetRxStream()),
+ *  for payloads too long to be handed over in a single slice
+ *  V1.12.0
+ *  +Payload of any length can be sent at once (SendLarge()), segments of it
+ *  are in flight together if ESP supports buffered sends
+ *  V1.13.0
+ *  +Optional framing layer (see dataFrame.h): SendFrame() sends payload as a
+ *  frame with length, type, sequence number and CRC-16, ReceiveFrame() hands
+ *  over complete frames decoded from received data, in a decoder provided by
+ *  user of the stream (SetFraming())
+ *  V1.14.0
+ *  +Windowed reliable delivery of frames (SetWindow()): up to N frames are in
+ *  flight without waiting for peer to acknowledge each one, peer acknowledges
+ *  them cumulatively and frames not acknowledged in time are sent again from
+ *  a fixed retransmit ring
+ *  V1.15.0
+ *  +Keep-alive backs off exponentially (with jitter, up to a cap) while socket
+ *  can't be reopened, received data resets the backoff and makes the check
+ *  unnecessary, reconnect statistics (KeepAliveStats())
+ *  V1.16.0
+ *  +Received messages are queued in the socket (up to ESP_RX_QUEUE), policy of
+ *  dropping messages once the queue is full can be set (SetRxPolicy()) and
+ *  dropped messages are counted (RxDropped())
+ *  V1.16.1
+ *  +Keep-alive doesn't reopen socket while ESP is still opening it, backoff
+ *  is counted from the moment opening completes or fails
+ *  V1.16.2
+ *  +Keep-alive and window tasks are always scheduled again on startup, they
+ *  reference this object and are left out of task scheduler snapshot
+ *  V1.16.3
+ *  -Removed unused reopen argument of Send(), closed socket is reopened only
+ *  by keep-alive task
  *
  */
 #include "hwconfig.h"
@@ -44,7 +103,8 @@
 #if !defined(ROVERKERNEL_NETWORK_DATASTREAM_H_) && defined(__HAL_USE_ESP8266__)
 #define ROVERKERNEL_NETWORK_DATASTREAM_H_
 
-#include "esp8266/espClient.h"
+#include "esp8266/esp8266.h"
+#include "network/dataFrame.h"
 
 //  Enable integration of this library with task scheduler but only if task
 //  scheduler is being compiled into this project
@@ -59,6 +119,7 @@
     #define DATAS_UID       4
     //  Definitions of ServiceID for service offered by this module
     #define DATAS_T_KA      0   //  Keep alive socket
+    #define DATAS_T_WIN     1   //  Take ACKs, retransmit unacknowledged frames
 
 //  Function to register data stream as a kernel module into the task scheduler,
 //  not implemented within the class because DataStream doesn't follow singleton
@@ -68,39 +129,187 @@ void DataStream_InitHW();
 
 #endif
 
+//  Period in ms of keep-alive task, delay between attempts to reopen socket
+//  starts at DATAS_KA_MIN and doubles with every failed attempt up to
+//  DATAS_KA_MAX, spread randomly by +-DATAS_KA_JITTER percent
+#define DATAS_KA_TICK       1000
+#define DATAS_KA_MIN        4000
+#define DATAS_KA_MAX        64000
+#define DATAS_KA_JITTER     25
+
+/**
+ * Counters of keep-alive of a data stream
+ */
+struct _dataKAStats
+{
+    uint32_t    attempts;   //  Attempts to reopen socket
+    uint32_t    failures;   //  ...of those, failed right away
+    uint32_t    connects;   //  Connections stream got bound to
+    uint32_t    skipped;    //  Checks skipped because data was received
+    uint32_t    backoffMs;  //  Delay before the next attempt
+};
+
+//  Max number of frames in flight in windowed mode (see SetWindow())
+#define DATAS_WIN_MAX       16
+//  Default time in ms frame waits to be acknowledged before it's sent again
+#define DATAS_WIN_RTO       300
+//  Period in ms of checking for ACKs and unacknowledged frames
+#define DATAS_WIN_PERIOD    10
+//  Number of repeated ACKs after which frames in flight are sent again
+//  without waiting for timeout
+#define DATAS_WIN_DUPACK    2
+//  Type of frame acknowledging frames received in windowed mode (sequence
+//  number of the frame is the sequence number of the next frame expected)
+#define DATAS_ACK           0xFF
+
+/**
+ * Counters of windowed mode of a data stream
+ */
+struct _dataWinStats
+{
+    uint32_t    sent;       //  Frames sent for the first time
+    uint32_t    retransmits;//  Frames sent again
+    uint32_t    timeouts;   //  Times frames in flight were sent again
+    uint32_t    fastRetransmits;//  ...of those, because of repeated ACKs
+    uint32_t    acked;      //  Frames acknowledged by peer
+    uint32_t    full;       //  Frames rejected because window was full
+    uint32_t    delivered;  //  Frames received in order
+    uint32_t    dropped;    //  Frames received out of order or more than once
+    uint32_t    acks;       //  ACKs sent to peer
+};
+
+/**
+ * State of windowed mode of a data stream. Frames in flight are kept in slots
+ * of a ring provided by user of the stream, in the order they were sent.
+ */
+struct _dataWin
+{
+    uint8_t     *ring;      //  Slots holding copies of frames in flight
+    uint16_t    slotLen;    //  Size of a single slot
+    uint8_t     window;     //  Number of slots, 0 if windowed mode is off
+    uint16_t    rtoMs;      //  Time frame waits to be acknowledged
+    uint8_t     base;       //  Sequence number of the oldest frame in flight
+    uint8_t     head;       //  Slot of the oldest frame in flight
+    uint8_t     n;          //  Number of frames in flight
+    uint16_t    len[DATAS_WIN_MAX];     //  Length of frame in a slot
+    uint16_t    payload[DATAS_WIN_MAX]; //  Length of its payload
+    uint64_t    sentMs;     //  Time frames in flight were last (re)sent
+    uint8_t     dupAcks;    //  Repeated ACKs since then
+    uint8_t     rxNext;     //  Sequence number of the next frame expected
+    bool        ackPend;    //  Received frames have to be acknowledged
+    struct _dataWinStats    stats;
+};
+
 /**
  * Definition of DataStream class. High level network communication object that
  * utilizes network sockets handled by ESP8266 library to establish a two-way
  * data stream with TCP server. Once the data stream has been bounded to a
  * socket it maintains the connectivity through periodic health-checks (using
- * task scheduler) and attempts reconnect in case of lost connection.
+ * task scheduler) and attempts reconnect in case of lost connection. In
+ * datagram mode stream exchanges UDP datagrams with the server instead.
  */
 class DataStream
 {
     friend void _DATAS_KernelCallback(void);
     public:
         DataStream();
-        DataStream(uint8_t *ip, uint16_t port);
+        DataStream(uint8_t *ip, uint16_t port, bool datagram = false);
         ~DataStream();
 
         uint8_t     BindToSocketID(uint8_t sockID, bool sched = false);
+        uint32_t    Passthrough(bool enable);
 
-        uint32_t    Send(uint8_t *buffer, uint16_t bufferLen = 0, bool reopen = true);
+        uint32_t    Send(uint8_t *buffer, uint16_t bufferLen = 0);
+        uint32_t    Send(const struct _bufSlice &slc);
+        uint32_t    SendLarge(const uint8_t *data, uint32_t len);
+        uint32_t    Write(uint8_t *buffer, uint16_t bufferLen = 0);
+        uint32_t    Flush();
+        void        SetLinger(uint16_t ms);
+        void        SetPriority(uint8_t prio);
+        void        SetRxStream(void((*hook)(const uint8_t, const uint8_t*,
+                                             const uint16_t, const uint16_t)));
+        void        SetRxPolicy(uint8_t policy);
+        uint32_t    RxDropped();
         bool        Receive(uint8_t *buffer, uint16_t *bufferLen);
+        bool        Receive(struct _espRxSlice &slc);
+        void        Release(struct _espRxSlice &slc);
+
+        //  Framing layer
+        void        SetFraming(DataFrame *dec);
+        uint32_t    SendFrame(uint8_t type, const uint8_t *payload,
+                              uint16_t len);
+        bool        ReceiveFrame(struct _dataFrame &frm);
+
+        //  Windowed reliable delivery of frames
+        uint32_t    SetWindow(uint8_t *ring, uint16_t ringLen, uint8_t window,
+                              uint16_t rtoMs = DATAS_WIN_RTO);
+        uint8_t     InFlight();
+        struct _dataWinStats WindowStats();
+
+        struct _dataKAStats KeepAliveStats();
 
         //  Socket ID as returned from ESP8266
         uint8_t     socketID;
 
     private:
+        _espClient* _Socket();
+        void        _KeepAlive();
+        void        _KABackoff(uint64_t now);
+        void        _Received();
+        bool        _NextFrame(struct _dataFrame &frm);
+        uint32_t    _WinSend(uint8_t type, const uint8_t *payload,
+                             uint16_t len);
+        bool        _WinAccept(const struct _dataFrame &frm);
+        void        _WinAck();
+        void        _WinPoll();
+        void        _WinRestart();
+        void        _WinTx(uint8_t *data, uint16_t len);
+
         //  String containing server IP address of underlying socket
         uint8_t     _serverip[20];
         //  Port number of server to which this stream is opened
         uint16_t    _port;
-        //  Socket handle
+        //  Socket handle and generation of the socket it was taken from
         _espClient* _socket;
+        uint8_t     _sockGen;
         //  Turns true once this data stream has scheduled periodic checking
         //  of socket's health (whether we're still connected to the server)
         bool        _keepAlive;
+        //  Set while socket opening queued by keep-alive waits for outcome
+        bool        _kaOpen;
+        //  Time of the next check, delay before the next attempt to reopen
+        //  socket, time data was last received (0 if never), state of jitter
+        //  generator and keep-alive counters
+        uint64_t    _kaNextMs;
+        uint32_t    _kaBackoffMs;
+        uint64_t    _kaRxMs;
+        uint32_t    _kaSeed;
+        struct _dataKAStats _kaStats;
+        //  Time in ms written data waits to be coalesced with more data
+        uint16_t    _linger;
+        //  Priority class of data sent through the stream (ESP_PRIO_*)
+        uint8_t     _prio;
+        //  Hook received data is streamed to (see _espClient::SetRxStream())
+        void    (*_rxStream)(const uint8_t, const uint8_t*, const uint16_t,
+                             const uint16_t);
+        //  Message dropped once received messages fill socket's queue
+        //  (ESP_RX_DROP_*)
+        uint8_t     _rxPolicy;
+        //  Turns true if stream runs over UDP socket instead of TCP socket
+        bool        _datagram;
+        //  Decoder of received frames (0 if stream isn't framed), received data
+        //  being decoded and offset of its first byte not fed into decoder
+        DataFrame   *_frameDec;
+        struct _espRxSlice  _frameSlc;
+        uint16_t    _frameOff;
+        //  Sequence number of the next frame sent
+        uint8_t     _frameSeq;
+        //  Turns true if a received frame is taken from the decoder but not
+        //  yet handed over through ReceiveFrame()
+        bool        _framePend;
+        //  Windowed mode, turns true once its periodic task is scheduled
+        struct _dataWin _win;
+        bool        _winTask;
 };
 
 
@@ -48,12 +48,34 @@ void _RADAR_KernelCallback(void)
      * data byte is either 1(fine scan) or 0(coarse scan).
      * args[] = none
      * retVal one of myLib.h STATUS_* error codes
+     * outArgs[] = slice(_bufSlice) holding scan data, borrowed from radar
      */
     case RADAR_T_SCAN:
         {
             static float horAngle = 0.0;
             static uint16_t scanLen = 0;
 
+            //  New scan task always starts a new scan. If previous scan task
+            //  was killed halfway through, return radar to starting position
+            //  first and measure once it gets there (in next step)
+            if (__rD._ker.firstRun && (scanLen != 0))
+            {
+                horAngle = 0.0;
+                scanLen = 0;
+                HAL_RAD_SetHorAngle(horAngle);
+                __rD._ker.retry = true;
+                return;
+            }
+
+            //  Take new buffer from the pool at the start of each scan, if
+            //  pool is empty try again in next step without using up a repeat
+            if ((scanLen == 0) && (__rD._NewScanBuf() != STATUS_OK))
+            {
+                __rD._ker.retry = true;
+                __rD._ker.retVal = STATUS_PROG_ERR;
+                break;
+            }
+
             if (horAngle < 160)
             {
                 uint32_t dist;
@@ -96,8 +118,17 @@ void _RADAR_KernelCallback(void)
             }
             else
             {
-                __rD.custHook(__rD._scanData, &scanLen);
+                //  Expose slice holding scan data as output of this task so
+                //  it can be forwarded to a chained task without copying
+                __rD._scanSlc.len = scanLen;
+                __rD._ker.outArgs = (uint8_t*)&(__rD._scanSlc);
+                __rD._ker.outArgN = sizeof(struct _bufSlice);
+
+                if (__rD.custHook != 0)
+                    __rD.custHook(__rD._scanData, &scanLen);
                 __rD._scanComplete = true;
+                //  Scan is done, end the task and run its chain right away
+                __rD._ker.done = true;
                 horAngle = 0.0;
                 scanLen = 0;
 
@@ -149,10 +180,16 @@ void _RADAR_KernelCallback(void)
          * Measures current distance and sets new angle
          * args[] = none
          * retVal one of myLib.h STATUS_* error codes
+         * outArgs[] = slice(_bufSlice) holding scan data, borrowed from radar
          */
     case RADAR_T_BLOCKINGSCAN:
     {
             __rD._ker.retVal = __rD.Scan(true);
+            if (__rD._ker.retVal != STATUS_OK)
+                break;
+            //  Expose slice holding scan data as output of this task
+            __rD._ker.outArgs = (uint8_t*)&(__rD._scanSlc);
+            __rD._ker.outArgN = sizeof(struct _bufSlice);
     }
         break;
     default:
@@ -209,8 +246,6 @@ void RadarModule::InitHW()
 
     //SetHorAngle(0);
     SetVerAngle(100);
-    //  Reserve memory space to fit measurements
-    _scanData = new uint8_t[162];
 
 #if defined(__USE_TASK_SCHEDULER__)
     //  Register module services with task scheduler
@@ -341,9 +376,14 @@ uint32_t RadarModule::Scan(bool hook)
     uint16_t scanLen = 0;
     uint32_t retVal;
 
+    //  Take new buffer from the pool for this scan
+    retVal = _NewScanBuf();
+    if (retVal != STATUS_OK)
+        return retVal;
 
     //  Initiate scan
     retVal = Scan(_scanData, &scanLen);
+    _scanSlc.len = scanLen;
 
     //  Call user's function to process data from the scan
     if ((custHook != 0) && hook)
@@ -377,6 +417,10 @@ bool RadarModule::ScanReady()
  */
 void RadarModule::ReadBuffer(uint8_t *buffer, uint16_t *bufferLen)
 {
+    *bufferLen = 0;
+    if (_scanData == 0)
+        return;
+
     if (_fineScan)
         *bufferLen = 1280;
     else
@@ -384,6 +428,27 @@ void RadarModule::ReadBuffer(uint8_t *buffer, uint16_t *bufferLen)
 
     memcpy((void*)buffer, (void*)_scanData, *bufferLen);
 }
+
+/**
+ * Get handle to the data of last completed scan without copying it
+ * @note Returned slice is retained on behalf of the caller, caller has to
+ * release it through BufferPool::Release() once done with data. Data in the
+ * slice stays intact after new scan is started.
+ * @return slice of pooled buffer holding last scan, invalid slice if none
+ */
+struct _bufSlice RadarModule::ScanSlice()
+{
+    struct _bufSlice retVal = _scanSlc;
+
+    if (!BufferPool::Valid(retVal) || (retVal.len == 0))
+    {
+        retVal.id = BUFP_INVALID;
+        return retVal;
+    }
+
+    BufferPool::GetI().Retain(retVal);
+    return retVal;
+}
 /**
  * Set horizontal angle of radar to a specified value (0� right, 160� left)
  * @param angle
@@ -402,12 +467,39 @@ void RadarModule::SetVerAngle(float angle)
     HAL_RAD_SetVerAngle(angle); //  Direct call to HAL
 }
 
+///-----------------------------------------------------------------------------
+///                      Class member function definitions           [PROTECTED]
+///-----------------------------------------------------------------------------
+
+/**
+ * Drop buffer holding previous scan and take a new one from the buffer pool.
+ * Previous buffer returns to the pool only if nobody else is holding it.
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t RadarModule::_NewScanBuf()
+{
+    BufferPool::GetI().Release(_scanSlc);
+    _scanData = 0;
+
+    if (!BufferPool::GetI().Acquire(_scanSlc))
+        return STATUS_PROG_ERR;
+
+    _scanSlc.len = 0;
+    _scanData = BufferPool::GetI().Data(_scanSlc);
+
+    return STATUS_OK;
+}
+
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor              [PROTECTED]
 ///-----------------------------------------------------------------------------
 
 RadarModule::RadarModule() : _scanComplete(false), _scanData(0), _fineScan(false)
 {
+    _scanSlc.id = BUFP_INVALID;
+    _scanSlc.offset = 0;
+    _scanSlc.len = 0;
+
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_UNINITIALIZED);
 #endif  /* __HAL_USE_EVENTLOG__ */
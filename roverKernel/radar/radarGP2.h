@@ -6,7 +6,7 @@
  *
  *  IR-sensor based radar (on 2D gimbal)
  *  (library Infrared Proximity Sensor, Sharp GP2Y0A21YK)
- *  @version 1.3.0
+ *  @version 1.4.2
  *  v1.1
  *  +Packed sensor functions and data into a C++ object
  *  V1.2
@@ -24,6 +24,17 @@
  *  -Removed fine scanning option
  *  *Radar scan implemented through series of periodic tasks in task scheduler
  *  in order to avoid long hangs while scanning
+ *  V1.4.0
+ *  +Scan data buffer is taken from kernel buffer pool (BufferPool) at the start
+ *  of each scan. Holders of the previous scan can keep it while a new one is
+ *  being taken, without copying the data
+ *  V1.4.1
+ *  +Scan tasks output slice of pooled buffer holding scan data instead of raw
+ *  data, so chained task can send it straight from the pool
+ *  V1.4.2
+ *  +Scan task ends (and runs its chain) as soon as the scan is complete, step
+ *  that finds buffer pool empty doesn't use up a repeat, new scan task resets
+ *  state left behind by a scan task that was killed halfway through
  */
 #include "hwconfig.h"
 
@@ -37,6 +48,8 @@
 #define __USE_TASK_SCHEDULER__
 #endif  /* __HAL_USE_TASKSCH__ */
 
+#include "libs/bufferPool.h"
+
 //  Check if this library is set to use task scheduler
 #if defined(__USE_TASK_SCHEDULER__)
     #include "taskScheduler/taskScheduler.h"
@@ -71,6 +84,7 @@ class RadarModule
 		uint32_t    Scan(bool hook = false);
 		bool        ScanReady();
 		void        ReadBuffer(uint8_t *buffer, uint16_t *bufferLen);
+		struct _bufSlice ScanSlice();
 
 		void SetHorAngle(float angle);
         void SetVerAngle(float angle);
@@ -88,10 +102,14 @@ class RadarModule
         RadarModule(RadarModule &arg) {}          //  No definition - forbid this
         void operator=(RadarModule const &arg) {} //  No definition - forbid this
 
+        uint32_t    _NewScanBuf();
+
         //  Flag to signal scan being completed
 		bool    _scanComplete;
-		//  Dynamically allocated buffer for sensor data (allocated before scan)
+		//  Buffer for sensor data (taken from buffer pool before each scan)
 		uint8_t *_scanData;
+		//  Slice of pooled buffer holding sensor data, _scanData points into it
+		struct _bufSlice _scanSlc;
 		//  Flag for user to request fine scan
 		bool    _fineScan;
 		//  Interface with task scheduler - provides memory space and function
@@ -0,0 +1,343 @@
+/**
+ * hardScheduler.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "hardScheduler.h"
+
+#if defined(__HAL_USE_TASKSCH__)   //  Compile only if module is enabled
+
+#include "libs/myLib.h"
+
+/**
+ * Calculate absolute difference between actual and expected cycle count
+ * @param actual measured number of cycles
+ * @param expected expected number of cycles
+ * @return absolute difference of the two (in cycles)
+ */
+static inline uint32_t _HTS_Deviation(uint32_t actual, uint32_t expected)
+{
+    return (actual > expected) ? (actual - expected) : (expected - actual);
+}
+
+/**
+ * Hard-tier timer interrupt
+ * Measures jitter of base tick and runs every enabled callback whose period has
+ * elapsed, measuring its start-time jitter and runtime. Callback exceeding its
+ * budget HTS_OVERRUN_LIMIT times in a row gets disabled.
+ */
+void _HTS_TickISR(void)
+{
+    HardScheduler &__hts = HardScheduler::GetI();
+    uint32_t now = HAL_TS_GetCycles();
+    uint32_t dev;
+
+    //  Jitter of the base tick
+    if (__hts._lastTick != 0)
+    {
+        dev = _HTS_Deviation(now - __hts._lastTick, __hts._tickCyc);
+        if (dev > __hts._tickJitter)
+            __hts._tickJitter = dev;
+    }
+    __hts._lastTick = now;
+
+    for (uint8_t i = 0; i < HTS_MAX_TASKS; i++)
+    {
+        HardScheduler::_htsTask &task = __hts._tasks[i];
+        uint32_t start, runtime;
+
+        if (!task.enabled || (--task.countdown > 0))
+            continue;
+        task.countdown = task.period;
+
+        //  Start-time jitter relative to the previous run of this callback
+        start = HAL_TS_GetCycles();
+        if (task.stats.runs > 0)
+        {
+            dev = _HTS_Deviation(start - task.lastStart,
+                                 task.period * __hts._tickCyc);
+            if (dev > task.stats.maxJitterUs)
+                task.stats.maxJitterUs = dev;
+        }
+        task.lastStart = start;
+
+        task.callback();
+
+        runtime = HAL_TS_GetCycles() - start;
+        task.stats.runs++;
+        if (runtime > task.stats.maxRunUs)
+            task.stats.maxRunUs = runtime;
+
+        //  Enforce runtime budget
+        if (runtime > task.budget)
+        {
+            task.stats.overruns++;
+            if (++task.overrunSeq >= HTS_OVERRUN_LIMIT)
+                task.enabled = false;
+        }
+        else
+            task.overrunSeq = 0;
+    }
+}
+
+///-----------------------------------------------------------------------------
+///         Functions for returning static instance                     [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Return reference to a singleton
+ * @return reference to an internal static instance
+ */
+HardScheduler& HardScheduler::GetI()
+{
+    static HardScheduler singletonInstance;
+    return singletonInstance;
+}
+
+/**
+ * Return pointer to a singleton
+ * @return pointer to a internal static instance
+ */
+HardScheduler* HardScheduler::GetP()
+{
+    return &(HardScheduler::GetI());
+}
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Initialize hardware timer providing base tick of hard tier. Timer is started
+ * by the first Register() and stopped once the last callback is unregistered
+ * @param tickUs period of base tick (in us)
+ */
+void HardScheduler::InitHW(uint32_t tickUs)
+{
+    _tickCyc = tickUs * HAL_TS_CyclesPerUS();
+
+    HAL_TS_InitHardTimer(tickUs, _HTS_TickISR);
+    //  Callbacks might have been registered before hardware got initialized
+    if (_active > 0)
+        HAL_TS_StartHardTimer();
+}
+
+/**
+ * Register callback to be executed from hard-tier timer interrupt
+ * @note Callback runs with all other interrupts blocked, it must be short and
+ * must not block. Use Post() to pass results to soft tier.
+ * @param callback function to call
+ * @param periodTicks period of execution, in number of base ticks (>0)
+ * @param budgetUs max allowed runtime of callback (in us)
+ * @return slot ID of registered callback, HTS_INVALID if there's no free slot
+ */
+int8_t HardScheduler::Register(void((*callback)(void)), uint16_t periodTicks,
+                               uint32_t budgetUs)
+{
+    int8_t retVal = HTS_INVALID;
+
+    if ((callback == 0) || (periodTicks == 0))
+        return HTS_INVALID;
+
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    for (uint8_t i = 0; i < HTS_MAX_TASKS; i++)
+    {
+        if (_tasks[i].callback != 0)
+            continue;
+
+        memset((void*)&(_tasks[i]), 0, sizeof(_tasks[i]));
+        _tasks[i].callback = callback;
+        _tasks[i].period = periodTicks;
+        _tasks[i].countdown = periodTicks;
+        _tasks[i].budget = budgetUs * HAL_TS_CyclesPerUS();
+        _tasks[i].enabled = true;
+        retVal = i;
+
+        //  First callback starts the timer, jitter is measured from next tick
+        if (_active++ == 0)
+        {
+            _lastTick = 0;
+            HAL_TS_StartHardTimer();
+        }
+        break;
+    }
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+
+    return retVal;
+}
+
+/**
+ * Remove callback from hard tier and free its slot. Timer is stopped once there
+ * are no callbacks left
+ * @param slot slot ID as returned by Register()
+ */
+void HardScheduler::Unregister(int8_t slot)
+{
+    if ((slot < 0) || (slot >= HTS_MAX_TASKS))
+        return;
+
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    if (_tasks[slot].callback != 0)
+    {
+        _tasks[slot].enabled = false;
+        _tasks[slot].callback = 0;
+
+        if (--_active == 0)
+            HAL_TS_StopHardTimer();
+    }
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+}
+
+/**
+ * Check whether there is a callback registered in the slot
+ * @param slot slot ID
+ * @return true if slot holds a callback (enabled or disabled)
+ */
+bool HardScheduler::Registered(int8_t slot)
+{
+    if ((slot < 0) || (slot >= HTS_MAX_TASKS))
+        return false;
+
+    return (_tasks[slot].callback != 0);
+}
+
+/**
+ * Check whether callback in the slot is being executed. Callback gets disabled
+ * after exceeding its runtime budget HTS_OVERRUN_LIMIT times in a row.
+ * @param slot slot ID
+ * @return true if callback is enabled
+ */
+bool HardScheduler::Enabled(int8_t slot)
+{
+    if ((slot < 0) || (slot >= HTS_MAX_TASKS))
+        return false;
+
+    return _tasks[slot].enabled;
+}
+
+/**
+ * Get runtime statistics of callback in the slot
+ * @param slot slot ID
+ * @return statistics with times converted to microseconds
+ */
+struct _htsStats HardScheduler::Stats(int8_t slot)
+{
+    struct _htsStats retVal = { 0, 0, 0, 0 };
+    uint32_t cpu = HAL_TS_CyclesPerUS();
+
+    if ((slot < 0) || (slot >= HTS_MAX_TASKS))
+        return retVal;
+
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+    retVal = _tasks[slot].stats;
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+
+    retVal.maxRunUs /= cpu;
+    retVal.maxJitterUs /= cpu;
+
+    return retVal;
+}
+
+/**
+ * Get max deviation of base tick from its ideal period
+ * @return max jitter of base tick (in us)
+ */
+uint32_t HardScheduler::TickJitterUs()
+{
+    return (_tickJitter / HAL_TS_CyclesPerUS());
+}
+
+/**
+ * Queue message for soft tier, it gets scheduled as task to be executed as soon
+ * as possible. Lock-free, may only be called from hard-tier callbacks.
+ * @param libUID UID of kernel module to call
+ * @param taskID service of kernel module to call
+ * @param data arguments of the task
+ * @param len length of [data] (max HTS_MSG_LEN)
+ * @return true if queued, false if queue is full or message too long
+ */
+bool HardScheduler::Post(uint8_t libUID, uint8_t taskID,
+                         const void *data, uint8_t len)
+{
+    uint8_t head = _head;
+    uint8_t next = (head + 1) & (HTS_QUEUE_LEN - 1);
+
+    if ((next == _tail) || (len > HTS_MSG_LEN))
+    {
+        _dropped++;
+        return false;
+    }
+
+    _queue[head].libUID = libUID;
+    _queue[head].taskID = taskID;
+    _queue[head].len = len;
+    for (uint8_t i = 0; i < len; i++)
+        _queue[head].data[i] = ((const uint8_t*)data)[i];
+
+    //  Publish message only once it's completely written
+    _head = next;
+
+    return true;
+}
+
+/**
+ * Take oldest message queued by hard tier. Lock-free, may only be called from
+ * main context.
+ * @param msg[out] message taken from the queue
+ * @return true if message was taken, false if queue is empty
+ */
+bool HardScheduler::Fetch(struct _htsMsg &msg)
+{
+    uint8_t tail = _tail;
+
+    if (tail == _head)
+        return false;
+
+    msg.libUID = _queue[tail].libUID;
+    msg.taskID = _queue[tail].taskID;
+    msg.len = _queue[tail].len;
+    for (uint8_t i = 0; i < msg.len; i++)
+        msg.data[i] = _queue[tail].data[i];
+
+    //  Free the slot only once message has been copied out
+    _tail = (tail + 1) & (HTS_QUEUE_LEN - 1);
+
+    return true;
+}
+
+/**
+ * Get number of messages dropped because soft tier didn't keep up
+ * @return number of dropped messages
+ */
+uint32_t HardScheduler::Dropped()
+{
+    return _dropped;
+}
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor              [PROTECTED]
+///-----------------------------------------------------------------------------
+
+HardScheduler::HardScheduler() : _tickCyc(0), _lastTick(0), _tickJitter(0),
+                                 _active(0), _head(0), _tail(0), _dropped(0)
+{
+    memset((void*)_tasks, 0, sizeof(_tasks));
+}
+
+HardScheduler::~HardScheduler()
+{
+    HAL_TS_StopHardTimer();
+}
+
+#endif  /* __HAL_USE_TASKSCH__ */
@@ -0,0 +1,143 @@
+/**
+ * hardScheduler.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Hard real-time tier of task scheduling. Small callbacks are registered into
+ *  fixed slots and executed directly from a periodic, highest-priority hardware
+ *  timer interrupt at a fixed rate (multiple of base tick). Each callback has a
+ *  runtime budget; callback overrunning it repeatedly is disabled. Results are
+ *  handed off to the soft tier (TaskScheduler) through a lock-free single-
+ *  producer/single-consumer queue of messages which TS_GlobalCheck() turns into
+ *  regular tasks. Runtime and start-time jitter of every slot, as well as
+ *  jitter of the base tick, are measured with cycle counter resolution.
+ *  @note Jitter is bounded by the longest section of code running with
+ *  interrupts disabled (HAL_BOARD_InterruptEnable(false))
+ *
+ *  @version 1.0.1
+ *  V1.0.0
+ *  +Fixed number of slots executed from timer ISR, runtime budget, jitter
+ *  statistics and message queue towards soft tier
+ *  V1.0.1
+ *  +Timer runs only while there's at least one callback registered, so idle
+ *  hard tier doesn't interrupt the rest of the system
+ */
+#include "hwconfig.h"
+
+//  Compile following section only if hwconfig.h says to include this module
+#if !defined(ROVERKERNEL_TASKSCHEDULER_HARDSCHEDULER_H_) \
+    && defined(__HAL_USE_TASKSCH__)
+#define ROVERKERNEL_TASKSCHEDULER_HARDSCHEDULER_H_
+
+#include "HAL/hal.h"
+
+//  Period of base tick of hard tier (in us)
+#define HTS_TICK_US         100
+//  Max number of callbacks registered in hard tier
+#define HTS_MAX_TASKS       4
+//  Length of message queue towards soft tier (has to be power of 2)
+#define HTS_QUEUE_LEN       16
+//  Max size of data carried by one message
+#define HTS_MSG_LEN         12
+//  Number of consecutive budget overruns after which callback is disabled
+#define HTS_OVERRUN_LIMIT   3
+//  Returned when callback can't be registered
+#define HTS_INVALID         (-1)
+
+/**
+ * Runtime statistics of a single hard-tier callback
+ */
+struct _htsStats
+{
+    uint32_t    runs;           //  Number of times callback has run
+    uint32_t    overruns;       //  Number of runs longer than budget
+    uint32_t    maxRunUs;       //  Max runtime (in us)
+    uint32_t    maxJitterUs;    //  Max deviation from ideal start time (in us)
+};
+
+/**
+ * Message from hard tier to soft tier, scheduled as task in soft tier
+ * args[] of the task are [data] of the message
+ */
+struct _htsMsg
+{
+    uint8_t     libUID;             //  UID of kernel module to call
+    uint8_t     taskID;             //  Service of the kernel module to call
+    uint8_t     len;                //  Number of bytes in [data]
+    uint8_t     data[HTS_MSG_LEN];  //  Task arguments
+};
+
+/**
+ * HardScheduler class definition
+ * Singleton holding hard-tier slots. Register()/Unregister() are called from
+ * main context, Post() only from within hard-tier callbacks and Fetch() only
+ * from main context (soft tier).
+ */
+class HardScheduler
+{
+    //  Functions & classes needing direct access to all members
+    friend void _HTS_TickISR(void);
+    public:
+        static HardScheduler& GetI();
+        static HardScheduler* GetP();
+
+        void        InitHW(uint32_t tickUs = HTS_TICK_US);
+
+        int8_t      Register(void((*callback)(void)), uint16_t periodTicks,
+                             uint32_t budgetUs);
+        void        Unregister(int8_t slot);
+        bool        Registered(int8_t slot);
+        bool        Enabled(int8_t slot);
+
+        //  Runtime measurements
+        struct _htsStats Stats(int8_t slot);
+        uint32_t    TickJitterUs();
+
+        //  Handoff of results to soft tier
+        bool        Post(uint8_t libUID, uint8_t taskID,
+                         const void *data, uint8_t len);
+        bool        Fetch(struct _htsMsg &msg);
+        uint32_t    Dropped();
+
+    protected:
+        HardScheduler();
+        ~HardScheduler();
+        HardScheduler(HardScheduler &) {}           //  No definition - forbid this
+        void operator=(HardScheduler const &) {}    //  No definition - forbid this
+
+        /**
+         * Slot of a hard-tier callback
+         */
+        struct _htsTask
+        {
+            void (*callback)(void);     //  Function to call
+            uint16_t    period;         //  Period in base ticks
+            uint16_t    countdown;      //  Ticks left until next run
+            uint32_t    budget;         //  Max allowed runtime (in cycles)
+            uint32_t    lastStart;      //  Cycle counter at last start
+            uint8_t     overrunSeq;     //  Consecutive overruns
+            volatile bool enabled;      //  Callback is being executed
+            struct _htsStats stats;     //  Runtime statistics (cycles in ISR)
+        };
+
+        struct _htsTask     _tasks[HTS_MAX_TASKS];
+        //  Length of base tick in cycles
+        uint32_t            _tickCyc;
+        //  Cycle counter at the start of last tick
+        uint32_t            _lastTick;
+        //  Max deviation of base tick from its period (in cycles)
+        uint32_t            _tickJitter;
+        //  Number of registered callbacks, timer runs only while it's >0
+        uint8_t             _active;
+
+        //  Message queue towards soft tier; _head written only by producer
+        //  (timer ISR), _tail written only by consumer (main context)
+        volatile struct _htsMsg _queue[HTS_QUEUE_LEN];
+        volatile uint8_t    _head;
+        volatile uint8_t    _tail;
+        //  Number of messages dropped because queue was full
+        volatile uint32_t   _dropped;
+};
+
+#endif /* ROVERKERNEL_TASKSCHEDULER_HARDSCHEDULER_H_ */
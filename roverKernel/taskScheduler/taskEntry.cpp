@@ -11,23 +11,26 @@
 ///                      Class constructors & destructor                [PUBLIC]
 ///-----------------------------------------------------------------------------
 TaskEntry::TaskEntry() : _libuid(0), _task(0), _argN(0), _timestamp(0),
-        _args(0), _PID(0)
+        _args(0), _PID(0), _chain(0), _fwdOut(false), _noSnap(false),
+        _started(false)
 {
 }
 
 TaskEntry::TaskEntry(uint8_t uid, uint8_t task, uint32_t time,
                      int32_t period, int32_t repeats)
             :_libuid(uid), _task(task), _timestamp(time),
-             _argN(0), _args(0), _period(period), _repeats(repeats), _PID(0)
+             _argN(0), _args(0), _period(period), _repeats(repeats), _PID(0),
+             _chain(0), _fwdOut(false), _noSnap(false), _started(false)
 {
 }
 
-TaskEntry::TaskEntry(const TaskEntry& arg) :  _argN(0), _args(0)
+TaskEntry::TaskEntry(const TaskEntry& arg) :  _argN(0), _args(0), _chain(0)
 {
     *this = (const TaskEntry&)arg;
 }
 
-TaskEntry::TaskEntry(const volatile TaskEntry& arg) :  _argN(0), _args(0)
+TaskEntry::TaskEntry(const volatile TaskEntry& arg) :  _argN(0), _args(0),
+        _chain(0)
 {
     *this = (const volatile TaskEntry&)arg;
 }
@@ -37,6 +40,9 @@ TaskEntry::~TaskEntry()
     //  If there's any dynamically allocated data release it
     if (_args != 0)
         delete [] _args;
+    //  Chained tasks are owned by this task, release them as well
+    if (_chain != 0)
+        delete _chain;
 }
 
 ///-----------------------------------------------------------------------------
@@ -73,6 +79,31 @@ void TaskEntry::AddArg(void* arg, uint16_t argLen) volatile
     _args = temp;
 }
 
+/**
+ * Append a task to the end of chain of tasks following this one. Chained task
+ * is executed by the task scheduler in the same dispatch pass right after the
+ * preceding task has completed (for periodic tasks: after their last repeat).
+ * @param uid UID of library to call
+ * @param task task ID within the library to execute
+ * @param fwdOut if true chained task receives output buffer of the preceding
+ * task as forwarded arguments (see _kernelEntry::fwdArgs)
+ * @return pointer to newly chained task (so arguments can be appended to it)
+ */
+TaskEntry* TaskEntry::Chain(uint8_t uid, uint8_t task, bool fwdOut) volatile
+{
+    TaskEntry *link = new TaskEntry(uid, task, 0);
+    TaskEntry * volatile *tail = &_chain;
+
+    //  Find last task in the chain
+    while ((*tail) != 0)
+        tail = &((*tail)->_chain);
+
+    link->_fwdOut = fwdOut;
+    *tail = link;
+
+    return link;
+}
+
 uint8_t TaskEntry::GetLibUID() const volatile
 {
     return (uint8_t)_libuid;
@@ -116,6 +147,14 @@ TaskEntry& TaskEntry::operator= (const TaskEntry& arg)
 
     _args = new uint8_t[_argN];
     memcpy((void*)_args, (void*)(arg._args), _argN);
+
+    //  Deep-copy chain of tasks following this one
+    if (_chain != 0)
+        delete _chain;
+    _chain = (arg._chain != 0) ? new TaskEntry(*(arg._chain)) : 0;
+    _fwdOut = arg._fwdOut;
+    _noSnap = arg._noSnap;
+    _started = arg._started;
     return *this;
 }
 
@@ -132,6 +171,14 @@ volatile TaskEntry& TaskEntry::operator= (const volatile TaskEntry& arg)
 
     _args = new uint8_t[_argN];
     memcpy((void*)_args, (void*)(arg._args), _argN);
+
+    //  Deep-copy chain of tasks following this one
+    if (_chain != 0)
+        delete _chain;
+    _chain = (arg._chain != 0) ? new TaskEntry(*(arg._chain)) : 0;
+    _fwdOut = arg._fwdOut;
+    _noSnap = arg._noSnap;
+    _started = arg._started;
     return *this;
 }
 
@@ -148,5 +195,13 @@ volatile TaskEntry& TaskEntry::operator= (volatile TaskEntry& arg) volatile
 
     _args = new uint8_t[_argN];
     memcpy((void*)_args, (void*)(arg._args), _argN);
+
+    //  Deep-copy chain of tasks following this one
+    if (_chain != 0)
+        delete _chain;
+    _chain = (arg._chain != 0) ? new TaskEntry(*(arg._chain)) : 0;
+    _fwdOut = arg._fwdOut;
+    _noSnap = arg._noSnap;
+    _started = arg._started;
     return (volatile TaskEntry&) *this;
 }
@@ -18,6 +18,7 @@ class TaskEntry
     // Functions & classes needing direct access to all members
     friend class TaskScheduler;
     friend void TS_GlobalCheck(void);
+    friend void _TS_Dispatch(TaskEntry &tE, uint8_t *fwdArgs, uint16_t fwdArgN);
     friend class LinkedList;
     public:
         TaskEntry();
@@ -28,6 +29,7 @@ class TaskEntry
         ~TaskEntry();
 
         void        AddArg(void* arg, uint16_t argLen) volatile;
+        TaskEntry*  Chain(uint8_t uid, uint8_t task, bool fwdOut) volatile;
 
         uint8_t     GetLibUID() const volatile;
         uint8_t     GetTaskUID() const volatile;
@@ -62,6 +64,18 @@ class TaskEntry
         int32_t             _repeats;
         //  Unique process ID
         volatile uint16_t   _PID;
+        //  Task to execute once this task completes (0 if there's none). Chained
+        //  task is owned by this object and can have its own chained task
+        TaskEntry           *_chain;
+        //  When true, output buffer of the preceding task in chain is passed to
+        //  this task as forwarded arguments (pointer, data is not copied)
+        bool                _fwdOut;
+        //  When true, task isn't saved into snapshot of task list because its
+        //  arguments reference objects in RAM (see TaskScheduler::NoSnapshot())
+        bool                _noSnap;
+        //  Set once the task has been executed for the first time, periodic
+        //  task keeps it across repeats (see _kernelEntry::firstRun)
+        bool                _started;
 };
 
 #endif /* ROVERKERNEL_TASKSCHEDULER_TASKENTRY_C_ */
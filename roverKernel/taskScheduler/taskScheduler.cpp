@@ -10,6 +10,7 @@
 
 #include "libs/myLib.h"
 #include "HAL/hal.h"
+#include "hardScheduler.h"
 
 #include <ctype.h>
 
@@ -105,6 +106,16 @@ void _TS_KernelCallback(void)
             __ts._ker.retVal = STATUS_OK;
         }
         break;
+    /*
+     *  Save snapshot of periodic tasks to be restored after warm reset
+     *  args[] = none
+     *  retVal on of myLib.h STATUS_* macros
+     */
+    case TASKSCHED_T_SNAPSHOT:
+        {
+            __ts._ker.retVal = __ts.Snapshot();
+        }
+        break;
     default:
         break;
     }
@@ -176,6 +187,9 @@ void TaskScheduler::InitHW(uint32_t timeStepMS) volatile
     _ker.callBackFunc = _TS_KernelCallback;
     TS_RegCallback((struct _kernelEntry*)&_ker, TASKSCHED_UID);
 
+    //  If coming from warm reset, restore periodic tasks from before reset
+    _restored = _Restore();
+
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_INITIALIZED);
 #endif  /* __HAL_USE_EVENTLOG__ */
@@ -280,6 +294,7 @@ void TaskScheduler::SyncTask(uint8_t libUID, uint8_t taskID,
         volatile uint32_t siz = _taskLog.size;
 #endif
     _lastIndex = _taskLog.AddSort(teTemp);
+    _lastChain = 0;
 #if defined(__DEBUG_SESSION2__)
         if ((_taskLog.size-siz) != 1)
         {
@@ -346,6 +361,7 @@ void TaskScheduler::SyncTaskPer(uint8_t libUID, uint8_t taskID, int64_t time,
         volatile uint32_t siz = _taskLog.size;
 #endif
     _lastIndex = _taskLog.AddSort(teTemp);
+    _lastChain = 0;
 #if defined(__DEBUG_SESSION2__)
         if ((_taskLog.size-siz) != 1)
         {
@@ -389,6 +405,7 @@ void TaskScheduler::SyncTask(TaskEntry te) volatile
         //  Save pointer to newly added task so additional arguments can be
         //  appended to it through AddArgs function call
         _lastIndex = _taskLog.AddSort(te);
+        _lastChain = 0;
 #if defined(__DEBUG_SESSION2__)
         if ((_taskLog.size-siz) != 1)
         {
@@ -415,9 +432,39 @@ void TaskScheduler::SyncTask(TaskEntry te) volatile
 }
 
 /**
- * Add arguments for the last pushed task. Any arguments added through here are
- * appended to the existing arguments provided for this task. So this function
- * can be repeatedly called to append multiple arguments.
+ * Chain a task to the last pushed task. Chained task is not placed in the task
+ * list, instead it's executed in the same dispatch pass right after the task it
+ * is chained to has completed. Periodic task is considered completed after its
+ * last repeat or once its kernel module declares it done through
+ * _kernelEntry::done (tasks repeated indefinitely run their chain only then).
+ * Calling this function multiple times creates a chain of tasks executed in
+ * the order they were chained. Arguments added after this call through
+ * AddArgs()/AddArg<T>() are appended to the newly chained task.
+ * @note Once PopFront() function has been called it's not possible to chain
+ * new tasks (because it's unknown if the _lastIndex node got deleted or not)
+ * @param libUID UID of library to call
+ * @param taskID task ID within the library to execute
+ * @param fwdOutput if true, output buffer of the preceding task in chain (as
+ * set by its kernel module in _kernelEntry::outArgs) is passed to the chained
+ * task by reference through _kernelEntry::fwdArgs; data is not copied
+ */
+void TaskScheduler::ChainTask(uint8_t libUID, uint8_t taskID,
+                              bool fwdOutput) volatile
+{
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    if (_lastIndex != 0)
+        _lastChain = _lastIndex->data.Chain(libUID, taskID, fwdOutput);
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+}
+
+/**
+ * Add arguments for the last pushed (or chained) task. Any arguments added
+ * through here are appended to the existing arguments provided for this task.
+ * So this function can be repeatedly called to append multiple arguments.
  * @note Once PopFront() function has been called it's not possible to append
  * new arguments (because it's unknown if the _lastIndex node got deleted or not)
  * @param arg byte array of data to append (regardless of data type)
@@ -428,13 +475,38 @@ void TaskScheduler::AddArgs(void* arg, uint16_t argLen) volatile
     //  Sensitive task, disable all interrupts
     HAL_BOARD_InterruptEnable(false);
 
-    if (_lastIndex != 0)
+    if (_lastChain != 0)
+        _lastChain->AddArg(arg, argLen);
+    else if (_lastIndex != 0)
         _lastIndex->data.AddArg(arg, argLen);
 
     //  Sensitive task done, enable interrupts again
     HAL_BOARD_InterruptEnable(true);
 }
 
+/**
+ * Request execution of a task as soon as possible, from interrupt context.
+ * Unlike SyncTask() it doesn't allocate memory, doesn't disable interrupts and
+ * doesn't touch the task list (or the task main context is adding arguments
+ * to), it only marks task as pending. Pending tasks are scheduled in the next
+ * TS_GlobalCheck() with a single argument byte (0). Requesting a task which is
+ * already pending has no effect.
+ * @note Interrupts requesting tasks of the same kernel module must not preempt
+ * one another
+ * @param libUID UID of library to call
+ * @param taskID task ID within the library to execute (<TS_DEFER_TASKS)
+ * @return true if task is pending, false if IDs are out of range
+ */
+bool TaskScheduler::Defer(uint8_t libUID, uint8_t taskID) volatile
+{
+    if ((libUID >= NUM_OF_MODULES) || (taskID >= TS_DEFER_TASKS))
+        return false;
+
+    _deferred[libUID] |= (1UL << taskID);
+
+    return true;
+}
+
 /**
  * Find and delete the task in task list matching these arguments
  * @param libUID
@@ -482,11 +554,188 @@ bool TaskScheduler::RemoveTask(uint16_t PIDarg) volatile
     return retVal;
 }
 
+///-----------------------------------------------------------------------------
+///                      Snapshot of scheduler state                    [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/*
+ * Snapshot layout (multi-byte values in native byte order):
+ *  header: imageID(4B)|version(1B)|taskCount(1B)
+ *  task:   libUID(1B)|taskID(1B)|argN(2B)|phase(4B)|period(4B)|repeats(4B)|args
+ * Phase is time (in ms) left until next execution of the task. Image ID
+ * identifies firmware image that made the snapshot (see HAL_TS_ImageID()), as
+ * task and argument layout is only guaranteed to match within the same image.
+ */
+#define TS_SNAP_HDR_LEN     6
+#define TS_SNAP_TASK_LEN    16
+
+//  Buffer for assembling/parsing snapshot (kept off the stack because of size)
+static uint8_t _tsSnapBuf[HAL_TS_SNAP_SIZE];
+
+/**
+ * Save snapshot of all periodic tasks currently in the task list to memory
+ * preserved across warm reset. Snapshot is restored on next startup by
+ * InitHW(). Tasks with chained tasks, one-shot tasks and tasks marked with
+ * NoSnapshot() are not saved.
+ * @note Call right before triggering software reset, as no further changes in
+ * the task list are captured
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint8_t TaskScheduler::Snapshot() volatile
+{
+    uint8_t *buf = _tsSnapBuf;
+    uint16_t len = TS_SNAP_HDR_LEN;
+    uint8_t taskCount = 0;
+    uint32_t imageID = HAL_TS_ImageID();
+    uint8_t retVal = STATUS_OK;
+
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    for (volatile _llnode *node = _taskLog.head; node != 0; node = node->_next)
+    {
+        volatile TaskEntry &tE = node->data;
+        uint16_t argN = tE._argN;
+        int32_t phase = (int32_t)(tE._timestamp - (uint32_t)msSinceStartup);
+
+        if ((tE._period == 0) || (tE._chain != 0) || tE._noSnap)
+            continue;
+
+        //  Stop if there's no more space, save as much as fits
+        if ((len + TS_SNAP_TASK_LEN + argN) > HAL_TS_SNAP_SIZE)
+        {
+            retVal = STATUS_PROG_ERR;
+            break;
+        }
+
+        //  Tasks that missed their starting time run as soon as restored
+        if (phase < 0)
+            phase = 0;
+
+        buf[len++] = tE._libuid;
+        buf[len++] = tE._task;
+        memcpy(buf + len, &argN, sizeof(argN));
+        len += sizeof(argN);
+        memcpy(buf + len, &phase, sizeof(phase));
+        len += sizeof(phase);
+        memcpy(buf + len, (void*)&tE._period, sizeof(tE._period));
+        len += sizeof(tE._period);
+        memcpy(buf + len, (void*)&tE._repeats, sizeof(tE._repeats));
+        len += sizeof(tE._repeats);
+        memcpy(buf + len, (void*)tE._args, argN);
+        len += argN;
+
+        taskCount++;
+    }
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+
+    memcpy(buf, &imageID, sizeof(imageID));
+    buf[4] = TS_SNAP_VERSION;
+    buf[5] = taskCount;
+
+    if (HAL_TS_SnapshotSave(buf, len) != HAL_OK)
+        retVal = STATUS_PROG_ERR;
+
+    return retVal;
+}
+
+/**
+ * Check whether task list was restored from snapshot on startup. Modules use
+ * this to skip scheduling periodic tasks which were already restored.
+ * @return true if tasks were restored from snapshot, false otherwise
+ */
+bool TaskScheduler::Restored() volatile
+{
+    return _restored;
+}
+
+/**
+ * Exclude the last task added from snapshot of task list. Used for tasks whose
+ * arguments reference objects in RAM (e.g. object pointers), as those objects
+ * don't exist after reset. Owner of such task schedules it again on startup
+ * regardless of Restored().
+ */
+void TaskScheduler::NoSnapshot() volatile
+{
+    //  Sensitive task, disable all interrupts
+    HAL_BOARD_InterruptEnable(false);
+
+    if (_lastIndex != 0)
+        _lastIndex->data._noSnap = true;
+
+    //  Sensitive task done, enable interrupts again
+    HAL_BOARD_InterruptEnable(true);
+}
+
+///-----------------------------------------------------------------------------
+///                      Class member function definitions           [PROTECTED]
+///-----------------------------------------------------------------------------
+
+/**
+ * Restore periodic tasks from snapshot saved before warm reset, in one pass
+ * @return true if snapshot was found and restored, false otherwise
+ */
+bool TaskScheduler::_Restore() volatile
+{
+    uint8_t *buf = _tsSnapBuf;
+    uint16_t len, it = TS_SNAP_HDR_LEN;
+    uint32_t imageID;
+
+    len = HAL_TS_SnapshotLoad(buf, HAL_TS_SNAP_SIZE, HAL_BOARD_WarmReset());
+    if (len < TS_SNAP_HDR_LEN)
+        return false;
+
+    //  Snapshot made by a different firmware or in different format is useless
+    memcpy(&imageID, buf, sizeof(imageID));
+    if ((imageID != HAL_TS_ImageID()) || (buf[4] != TS_SNAP_VERSION))
+        return false;
+
+    for (uint8_t i = 0; i < buf[5]; i++)
+    {
+        uint16_t argN;
+        int32_t phase, period, repeats;
+
+        if ((it + TS_SNAP_TASK_LEN) > len)
+            return false;
+
+        memcpy(&argN, buf + it + 2, sizeof(argN));
+        memcpy(&phase, buf + it + 4, sizeof(phase));
+        memcpy(&period, buf + it + 8, sizeof(period));
+        memcpy(&repeats, buf + it + 12, sizeof(repeats));
+
+        if ((it + TS_SNAP_TASK_LEN + argN) > len)
+            return false;
+
+        //  Repeats are stored as already decreased counter, no need to adjust
+        TaskEntry teTemp(buf[it], buf[it + 1], (uint32_t)msSinceStartup + phase,
+                         period, repeats);
+        teTemp.AddArg(buf + it + TS_SNAP_TASK_LEN, argN);
+
+        //  Sensitive task, disable all interrupts
+        HAL_BOARD_InterruptEnable(false);
+        _taskLog.AddSort(teTemp);
+        //  Sensitive task done, enable interrupts again
+        HAL_BOARD_InterruptEnable(true);
+
+        it += TS_SNAP_TASK_LEN + argN;
+    }
+
+    _lastIndex = 0;
+    _lastChain = 0;
+
+    return true;
+}
+
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor              [PROTECTED]
 ///-----------------------------------------------------------------------------
-TaskScheduler::TaskScheduler() : _lastIndex(0)
+TaskScheduler::TaskScheduler() : _lastIndex(0), _lastChain(0), _restored(false)
 {
+    for (uint8_t i = 0; i < NUM_OF_MODULES; i++)
+        _deferred[i] = 0;
+
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_UNINITIALIZED);
 #endif  /* __HAL_USE_EVENTLOG__ */
@@ -516,6 +765,33 @@ void _TSSyncCallback(void)
     msSinceStartup += HAL_TS_GetTimeStepMS();
 }
 
+/**
+ * Make task data available to kernel module and call it to execute the task
+ * @param tE task to execute (its kernel module must be registered)
+ * @param fwdArgs output of preceding task in chain (0 if there's none)
+ * @param fwdArgN length of [fwdArgs] array
+ */
+void _TS_Dispatch(TaskEntry &tE, uint8_t *fwdArgs, uint16_t fwdArgN)
+{
+    volatile struct _kernelEntry *ker = __kernelVector[tE._libuid];
+
+    ker->serviceID = tE._task;
+    ker->argN = tE._argN;
+    ker->args = (uint8_t*)tE._args;
+    ker->fwdArgs = fwdArgs;
+    ker->fwdArgN = fwdArgN;
+    //  Module sets its output buffer during execution if it has one
+    ker->outArgs = 0;
+    ker->outArgN = 0;
+    //  Module sets these if periodic task is done or needs another try
+    ker->firstRun = !tE._started;
+    ker->done = false;
+    ker->retry = false;
+
+    // Call kernel module to execute task
+    ker->callBackFunc();
+}
+
 /**
  * Task scheduler callback routine
  * This routine has to be called in order to execute tasks pushed in task queue
@@ -527,27 +803,68 @@ void TS_GlobalCheck(void)
 {
     //  Grab reference to singleton
     volatile TaskScheduler &__taskSch = TaskScheduler::GetI();
+    struct _htsMsg msg;
+
+    //  Schedule results handed off from hard real-time tier
+    while (HardScheduler::GetI().Fetch(msg))
+    {
+        if ((msg.libUID >= NUM_OF_MODULES) ||
+            !TaskScheduler::ValidKernModule(msg.libUID))
+            continue;
+
+        __taskSch.SyncTask(msg.libUID, msg.taskID, T_ASAP);
+        __taskSch.AddArgs((void*)msg.data, msg.len);
+    }
+
+    //  Schedule tasks requested from interrupts through Defer()
+    for (uint8_t i = 0; i < NUM_OF_MODULES; i++)
+    {
+        uint32_t pending;
+        uint8_t dummy = 0;
+
+        if (__taskSch._deferred[i] == 0)
+            continue;
+
+        //  Take pending bits, interrupt can set new ones in the meantime
+        HAL_BOARD_InterruptEnable(false);
+        pending = __taskSch._deferred[i];
+        __taskSch._deferred[i] = 0;
+        HAL_BOARD_InterruptEnable(true);
+
+        if (!TaskScheduler::ValidKernModule(i))
+            continue;
+
+        for (uint8_t t = 0; t < TS_DEFER_TASKS; t++)
+        {
+            if ((pending & (1UL << t)) == 0)
+                continue;
+            __taskSch.SyncTask(i, t, T_ASAP);
+            __taskSch.AddArgs(&dummy, 1);
+        }
+    }
 
     //  Check if there is task scheduled to execute
     if (!__taskSch.IsEmpty())
         //  Check if the first task had to be executed already
-        while((__taskSch.PeekFront()._timestamp <= msSinceStartup) &&
-              (!__taskSch.IsEmpty()))
+        while((!__taskSch.IsEmpty()) &&
+              (__taskSch.PeekFront()._timestamp <= msSinceStartup))
         {
             // Take out first entry to process it
             TaskEntry tE(__taskSch.PopFront());
             uint64_t tStart = (uint64_t)msSinceStartup;
+            //  Time of next execution is taken before executing the task to
+            //  keep time punctuality (used only if task is rescheduled)
+            uint32_t next = msSinceStartup + labs(tE._period);
+            //  Task is completed once it's not going to be rescheduled anymore
+            bool completed, retry;
 
             //  If we're going to repeat this task then it makes sense to
-            //  measure its performance, run task-start hook  and calculate new
-            //  starting time for this task
+            //  measure its performance and run task-start hook
             if ((tE._period != 0) && (tE._repeats != 0))
             {
 #ifdef _TS_PERF_ANALYSIS_
                 tE.Perf.TaskStartHook((uint64_t)msSinceStartup, tE._timestamp, HAL_TS_GetTimeStepMS());
 #endif
-                //  Change time of execution based on period (for next execution)
-                tE._timestamp = msSinceStartup + labs(tE._period);
             }
 
             // Check if module is registered in task scheduler
@@ -561,25 +878,56 @@ void TS_GlobalCheck(void)
             DEBUG_WRITE("-(%d)> %s\n", tE._argN, tE._args);
 #endif
 
-            // Make task data available to kernel
-            __kernelVector[tE._libuid]->serviceID = tE._task;
-            __kernelVector[tE._libuid]->argN = tE._argN;
-            __kernelVector[tE._libuid]->args = (uint8_t*)tE._args;
+            //  Call kernel module to execute task
+            _TS_Dispatch(tE, 0, 0);
+            tE._started = true;
+            retry = __kernelVector[tE._libuid]->retry;
+
+            //  Periodic task is rescheduled until its repeats run out, unless
+            //  module declared it done. Execution module asked to retry
+            //  doesn't use up a repeat (and can't be the last one)
+            if (__kernelVector[tE._libuid]->done)
+                completed = true;
+            else if (retry)
+                completed = (tE._period == 0);
+            else
+                completed = !((tE._period != 0) && (tE._repeats != 0));
 
-            // Call kernel module to execute task
-            __kernelVector[tE._libuid]->callBackFunc();
+            //  Once completed, run chained tasks in the same pass, forwarding
+            //  output of each task to the next one if requested
+            if (completed && (tE._chain != 0))
+            {
+                uint8_t *out = __kernelVector[tE._libuid]->outArgs;
+                uint16_t outN = __kernelVector[tE._libuid]->outArgN;
+
+                for (TaskEntry *link = tE._chain; link != 0; link = link->_chain)
+                {
+                    //  Chain is broken if module is not registered
+                    if (__kernelVector[link->_libuid] == 0)
+                        break;
+
+                    if (link->_fwdOut)
+                        _TS_Dispatch(*link, out, outN);
+                    else
+                        _TS_Dispatch(*link, 0, 0);
+
+                    out = __kernelVector[link->_libuid]->outArgs;
+                    outN = __kernelVector[link->_libuid]->outArgN;
+                }
+            }
 
-            //  If there's a period specified, reschedule task
+            //  If task isn't completed, reschedule it based on its period
             //  Run post-execution hook for calculating performance
-            if ((tE._period != 0) && (tE._repeats != 0))
+            if (!completed)
             {
 #ifdef _TS_PERF_ANALYSIS_
                 tE.Perf.TaskEndHook((uint64_t)msSinceStartup);
 #endif
                 //  If using repeat counter decrease it
-                if (tE._repeats > 0)
+                if ((tE._repeats > 0) && !retry)
                     tE._repeats--;
-                //  Reschedule the task
+                //  Change time of execution based on period and reschedule
+                tE._timestamp = next;
                 __taskSch.SyncTask(tE);
             }
         }
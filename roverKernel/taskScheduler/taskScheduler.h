@@ -5,7 +5,7 @@
  *      Author: Vedran Mikov
  *
  *  Task scheduler library
- *  @version 2.8.0
+ *  @version 2.13.0
  *  V1.1
  *  +Implementation of queue of tasks with various parameters. Tasks identified
  *      by unique integer number (defined by higher level library)
@@ -54,6 +54,31 @@
  *  +Periodically called functions switched to inline, declared in header
  *  +Implemented kernel callback for TS, allowing enable/disable signal for
  *  SysTick timer to be sent remotely
+ *  V2.9.0
+ *  +Task chaining: task can have a chain of tasks that are executed in the same
+ *  dispatch pass right after it completes. Chained task can receive output
+ *  buffer of preceding task by reference through _kernelEntry::fwdArgs
+ *  V2.10.0
+ *  +Snapshot of periodic tasks (phase, period, repeats, args) can be saved to
+ *  memory preserved across warm reset and is restored in InitHW(). Modules
+ *  check Restored() to skip re-scheduling of their periodic tasks
+ *  V2.11.0
+ *  +TaskScheduler is the soft tier of two-tier scheduling, hard real-time tier
+ *  is implemented in HardScheduler (hardScheduler.h). Messages posted by hard
+ *  tier are scheduled as tasks in TS_GlobalCheck()
+ *  V2.12.0
+ *  +Deferred tasks: interrupt handler can request a task through Defer(),
+ *  which only sets a pending bit without allocating or touching task list.
+ *  Pending tasks are scheduled in TS_GlobalCheck()
+ *  V2.12.1
+ *  +Tasks whose arguments reference objects in RAM are marked with
+ *  NoSnapshot() and left out of snapshot, their owners always re-register
+ *  them. Snapshot is keyed on identifier of firmware image provided by HAL
+ *  V2.13.0
+ *  +Periodic task is told through _kernelEntry::firstRun when it's executed
+ *  for the first time. Module can end the task before its repeats run out
+ *  (_kernelEntry::done, chain runs right away) or have the execution not count
+ *  as a repeat (_kernelEntry::retry) when it couldn't do its work
  *
  *  TODO:
  *  Implement UTC clock feature. If at some point program finds out what the
@@ -78,7 +103,10 @@
  * TS_RegCallback function). CallBackEntry holds: a) Function to be called when
  * someone requests a service from kernel module; b) ServiceID of service to be
  * executed; c)Memory space used for arguments for callback function; d) Return
- * variable of the service execution
+ * variable of the service execution; e) Output of preceding task in a chain,
+ * f) Output buffer of this service that can be forwarded to next task in chain
+ * and g) Flags through which periodic task learns it's executed for the first
+ * time and tells task scheduler it's done or that execution has to be retried
  */
 struct _kernelEntry
 {
@@ -87,6 +115,13 @@ struct _kernelEntry
     uint8_t *args;                  // Arguments for service execution
     uint16_t argN;                  // Length of *args array
     int32_t  retVal;                // (Optional) Return variable of service exec
+    uint8_t *fwdArgs;               // (Chained tasks) Output of preceding task
+    uint16_t fwdArgN;               // Length of *fwdArgs array
+    uint8_t *outArgs;               // (Optional) Output buffer of service exec
+    uint16_t outArgN;               // Length of *outArgs array
+    bool     firstRun;              // (Periodic tasks) First execution of task
+    bool     done;                  // (Optional) Set to end periodic task now
+    bool     retry;                 // (Optional) Set to not use up a repeat
 };
 
 
@@ -100,6 +135,13 @@ struct _kernelEntry
     //  Definitions of ServiceID for service offered by this module
     #define TASKSCHED_T_ENABLE      0
     #define TASKSCHED_T_KILL        1
+    #define TASKSCHED_T_SNAPSHOT    2
+
+//  Max ID of task that can be requested through Defer() (+1)
+#define TS_DEFER_TASKS      32
+
+//  Version of snapshot format, snapshot with different version is not restored
+#define TS_SNAP_VERSION     1
 
 //  Enable debug information printed on serial port
 //#define __DEBUG_SESSION2__
@@ -161,14 +203,26 @@ class TaskScheduler
 		                 int32_t period, int32_t rep) volatile;
 		void SyncTask(TaskEntry te) volatile;
 
-		//  Add arguments for the last task added
+		//  Chain task to be executed once the last task added completes
+		void ChainTask(uint8_t libUID, uint8_t taskID,
+		               bool fwdOutput = false) volatile;
+
+		//  Add arguments for the last task added (or chained)
 		void AddArgs(void* arg, uint16_t argLen) volatile;
 
+		//  Request task from interrupt context
+		bool Defer(uint8_t libUID, uint8_t taskID) volatile;
+
 		//  Remove task for task list
 		void RemoveTask(uint8_t libUID, uint8_t taskID,
 		                void* arg, uint16_t argLen) volatile;
 		bool RemoveTask(uint16_t PIDarg) volatile;
 
+		//  Preserve periodic tasks across warm reset
+		uint8_t Snapshot() volatile;
+		bool    Restored() volatile;
+		void    NoSnapshot() volatile;
+
 		///---------------------------------------------------------------------
 		///                      Inline functions                       [PUBLIC]
 		///---------------------------------------------------------------------
@@ -195,7 +249,9 @@ class TaskScheduler
             //  Sensitive task, disable all interrupts
 		    HAL_BOARD_InterruptEnable(false);
 
-		    if (_lastIndex != 0)
+		    if (_lastChain != 0)
+		        _lastChain->AddArg((void*)&arg, sizeof(arg));
+		    else if (_lastIndex != 0)
 		        _lastIndex->data.AddArg((void*)&arg, sizeof(arg));
 
 		    //  Sensitive task done, enable interrupts again
@@ -243,6 +299,7 @@ class TaskScheduler
         }
 #endif
             _lastIndex = 0;
+            _lastChain = 0;
             HAL_BOARD_InterruptEnable(true);
             return retVal;
         }
@@ -262,6 +319,7 @@ class TaskScheduler
         TaskScheduler(TaskScheduler &arg) {}        //  No definition - forbid this
         void operator=(TaskScheduler const &arg) {} //  No definition - forbid this
 
+        bool                _Restore() volatile;
 
 		//  Queue of tasks to be executed, implemented as doubly linked list
 		volatile LinkedList	_taskLog;
@@ -272,6 +330,14 @@ class TaskScheduler
 		 *  a volatile object (object can be removed from within interrupt)
 		 */
 		volatile _llnode* volatile _lastIndex;
+		//  Pointer to last task chained to _lastIndex (0 if no task has been
+		//  chained since last task was added). Arguments are appended to it.
+		TaskEntry* volatile _lastChain;
+		//  True if task list was restored from snapshot on startup
+		bool                _restored;
+		//  Tasks requested through Defer() and not yet scheduled, bit N of
+		//  entry M is set if task N of kernel module with UID M is pending
+		volatile uint32_t   _deferred[NUM_OF_MODULES];
 
         //  Interface with task scheduler - provides memory space and function
         //  to call in order for task scheduler to request service from this module
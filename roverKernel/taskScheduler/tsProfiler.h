@@ -5,12 +5,14 @@
  *      Author: Vedran Mikov
  *
  *  Task scheduler extension for profiling of tasks (measuring run-time statistics)
- *  @version 1.0
+ *  @version 1.2
  *  V1.0
  *  +Creation of file, definition of class object for holding task-performance data
  *  V1.1
  *  +Added ability to measure average task runtime by accumulating all run times
  *  into a 32-bit counter and dividing by number of runs
+ *  V1.2
+ *  +Added max start-time jitter (max time by which the task missed its start)
  */
 
 #ifndef ROVERKERNEL_TASKSCHEDULER_TSPROFILER_H_
@@ -21,7 +23,8 @@ class Performance
 {
     public:
         Performance(): startTimeMissTot(0), startTimeMissCnt(0), taskRuns(0),
-                       maxRT(0), _lastStartT(0), msAcc(0), accRT(0) {};
+                       maxRT(0), _lastStartT(0), msAcc(0), accRT(0),
+                       maxStartMiss(0) {};
         ~Performance() {};
 
         void TaskStartHook(const uint64_t &timestamp,
@@ -36,6 +39,10 @@ class Performance
                 startTimeMissCnt++;
                 startTimeMissTot += (uint32_t)(timestamp - taskStartTime);
             }
+            //  Track jitter as the worst start-time miss seen so far
+            if ((timestamp > taskStartTime) &&
+                ((timestamp - taskStartTime) > maxStartMiss))
+                maxStartMiss = (uint16_t)(timestamp - taskStartTime);
 
             //  Save timestamp for calculating execution time
             _lastStartT = timestamp;
@@ -64,6 +71,7 @@ class Performance
             maxRT = arg.maxRT;
             msAcc = arg.msAcc;
             accRT = arg.accRT;
+            maxStartMiss = arg.maxStartMiss;
 
             return *this;
         }
@@ -77,6 +85,7 @@ class Performance
             maxRT = arg.maxRT;
             msAcc = arg.msAcc;
             accRT = arg.accRT;
+            maxStartMiss = arg.maxStartMiss;
 
             return *this;
         }
@@ -89,6 +98,7 @@ class Performance
             maxRT = arg.maxRT;
             msAcc = arg.msAcc;
             accRT = arg.accRT;
+            maxStartMiss = arg.maxStartMiss;
 
             return *this;
         }
@@ -101,6 +111,7 @@ class Performance
             maxRT = arg.maxRT;
             msAcc = arg.msAcc;
             accRT = arg.accRT;
+            maxStartMiss = arg.maxStartMiss;
         }
 
     public:
@@ -117,6 +128,8 @@ class Performance
         uint16_t msAcc;
         //  Accumulated task runtime in seconds
         uint32_t accRT;
+        //  Max time by which the task missed its starting time (in ms)
+        uint16_t maxStartMiss;
 
     protected:
         //  Last start time of the task -> used to calculate runtime
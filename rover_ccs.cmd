@@ -54,8 +54,10 @@ MEMORY
 SECTIONS
 {
     .intvecs:   > APP_BASE
-    .text   :   > FLASH
-    .const  :   > FLASH
+    /* CRC of code & constants identifies firmware image (hal_ts_tm4c.c)  */
+    .text   :   > FLASH, crc_table(_tsImageCrc, algorithm=CRC32_PRIME)
+    .const  :   > FLASH, crc_table(_tsImageCrc, algorithm=CRC32_PRIME)
+    .TI.crctab : > FLASH
     .cinit  :   > FLASH
     .pinit  :   > FLASH
     .init_array : > FLASH
@@ -65,6 +67,9 @@ SECTIONS
     .bss    :   > SRAM
     .sysmem :   > SRAM
     .stack  :   > SRAM
+
+    /* Not initialized on start-up, content survives software reset       */
+    .tssnap :   > SRAM, type = NOINIT
 }
 
 __STACK_TOP = __stack + 256;